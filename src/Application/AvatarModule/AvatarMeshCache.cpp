@@ -0,0 +1,203 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "AvatarMeshCache.h"
+#include "AssetAPI.h"
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include <Ogre.h>
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace Avatar
+{
+    static inline bool IsHidden(const std::vector<uint>& sorted_vertices, uint vertex)
+    {
+        return std::binary_search(sorted_vertices.begin(), sorted_vertices.end(), vertex);
+    }
+
+    /// Removes the triangles using any of the given vertices from the first submesh of the mesh. The vertex list must be sorted.
+    static void HideVertices(Ogre::Mesh* mesh, const std::vector<uint>& vertices_to_hide)
+    {
+        // Under current system, it seems vertices should only be hidden from first submesh
+        if (!mesh->getNumSubMeshes())
+            return;
+        Ogre::SubMesh *submesh = mesh->getSubMesh(0);
+        if (!submesh)
+            return;
+        Ogre::IndexData *data = submesh->indexData;
+        if (!data)
+            return;
+        Ogre::HardwareIndexBufferSharedPtr ibuf = data->indexBuffer;
+        if (ibuf.isNull())
+            return;
+
+        u32* lIdx = static_cast<u32*>(ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
+        u16* pIdx = reinterpret_cast<u16*>(lIdx);
+        bool use32bitindexes = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
+
+        // Compact the kept triangles to the start of the buffer in one pass
+        size_t kept = 0;
+        for (size_t n = data->indexStart; n + 2 < data->indexStart + data->indexCount; n += 3)
+        {
+            uint i0 = use32bitindexes ? lIdx[n] : pIdx[n];
+            uint i1 = use32bitindexes ? lIdx[n+1] : pIdx[n+1];
+            uint i2 = use32bitindexes ? lIdx[n+2] : pIdx[n+2];
+            if (IsHidden(vertices_to_hide, i0) || IsHidden(vertices_to_hide, i1) || IsHidden(vertices_to_hide, i2))
+                continue;
+
+            size_t dest = data->indexStart + kept;
+            if (use32bitindexes)
+            {
+                lIdx[dest] = lIdx[n];
+                lIdx[dest+1] = lIdx[n+1];
+                lIdx[dest+2] = lIdx[n+2];
+            }
+            else
+            {
+                pIdx[dest] = pIdx[n];
+                pIdx[dest+1] = pIdx[n+1];
+                pIdx[dest+2] = pIdx[n+2];
+            }
+            kept += 3;
+        }
+        data->indexCount = kept;
+        ibuf->unlock();
+    }
+
+    AvatarMeshCache::AvatarMeshCache() :
+        nextVariantId_(0)
+    {
+    }
+
+    AvatarMeshCache::~AvatarMeshCache()
+    {
+        // Ogre may have been shut down already
+        if (!Ogre::MeshManager::getSingletonPtr())
+            return;
+
+        foreach(const Variant &variant, variants_)
+        {
+            try
+            {
+                Ogre::MeshManager::getSingleton().remove(variant.variantName.toStdString());
+            }
+            catch(...) {}
+        }
+    }
+
+    QString AvatarMeshCache::AcquireVariant(const QString &meshName, const QString &skeletonName, const std::set<uint> &verticesToHide)
+    {
+        PROFILE(AvatarMeshCache_AcquireVariant);
+
+        Ogre::MeshManager& mesh_mgr = Ogre::MeshManager::getSingleton();
+        std::string baseName = AssetAPI::SanitateAssetRef(meshName.toStdString());
+        Ogre::MeshPtr baseMesh = mesh_mgr.getByName(baseName);
+        // For local meshes, mesh will not get automatically loaded until used in an entity. Load now if necessary
+        if (baseMesh.isNull())
+        {
+            try
+            {
+                mesh_mgr.load(meshName.toStdString(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+                baseMesh = mesh_mgr.getByName(meshName.toStdString());
+            }
+            catch(Ogre::Exception& e)
+            {
+                LogError("AvatarMeshCache::AcquireVariant: Could not load mesh " + meshName + ": " + e.what());
+                return QString();
+            }
+        }
+        if (baseMesh.isNull())
+        {
+            LogError("AvatarMeshCache::AcquireVariant: Mesh " + meshName + " does not exist");
+            return QString();
+        }
+
+        std::vector<uint> hiddenVertices(verticesToHide.begin(), verticesToHide.end()); // Sorted, since std::set is ordered
+        const uint hash = KeyHash(meshName, skeletonName, hiddenVertices);
+        const u64 baseHandle = baseMesh->getHandle();
+
+        for(QMultiHash<uint, Variant>::iterator iter = variants_.find(hash); iter != variants_.end() && iter.key() == hash; ++iter)
+        {
+            Variant &variant = iter.value();
+            if (variant.baseHandle == baseHandle && variant.meshName == meshName && variant.skeletonName == skeletonName &&
+                variant.hiddenVertices == hiddenVertices)
+            {
+                ++variant.refCount;
+                return variant.variantName;
+            }
+        }
+
+        Variant variant;
+        variant.meshName = meshName;
+        variant.skeletonName = skeletonName;
+        variant.baseHandle = baseHandle;
+        variant.hiddenVertices.swap(hiddenVertices);
+        variant.variantName = "AvatarMeshVariant_" + QString::number(nextVariantId_++);
+        variant.refCount = 1;
+
+        try
+        {
+            Ogre::MeshPtr mesh = baseMesh->clone(variant.variantName.toStdString());
+            mesh->setAutoBuildEdgeLists(false);
+            HideVertices(mesh.get(), variant.hiddenVertices);
+        }
+        catch(Ogre::Exception& e)
+        {
+            LogError("AvatarMeshCache::AcquireVariant: Could not clone mesh " + meshName + ": " + e.what());
+            return QString();
+        }
+
+        variants_.insert(hash, variant);
+        variantHashes_[variant.variantName] = hash;
+        return variant.variantName;
+    }
+
+    void AvatarMeshCache::ReleaseVariant(const QString &variantName)
+    {
+        QHash<QString, uint>::iterator hashIter = variantHashes_.find(variantName);
+        if (hashIter == variantHashes_.end())
+        {
+            LogWarning("AvatarMeshCache::ReleaseVariant: Unknown mesh variant " + variantName);
+            return;
+        }
+
+        const uint hash = hashIter.value();
+        for(QMultiHash<uint, Variant>::iterator iter = variants_.find(hash); iter != variants_.end() && iter.key() == hash; ++iter)
+        {
+            Variant &variant = iter.value();
+            if (variant.variantName != variantName)
+                continue;
+            if (--variant.refCount > 0)
+                return;
+
+            // Entities still using the mesh keep it alive until they are destroyed
+            try
+            {
+                Ogre::MeshManager::getSingleton().remove(variantName.toStdString());
+            }
+            catch(Ogre::Exception& e)
+            {
+                LogWarning("AvatarMeshCache::ReleaseVariant: Could not remove mesh variant: " + std::string(e.what()));
+            }
+            variants_.erase(iter);
+            variantHashes_.erase(hashIter);
+            return;
+        }
+    }
+
+    uint AvatarMeshCache::KeyHash(const QString &meshName, const QString &skeletonName, const std::vector<uint> &hiddenVertices)
+    {
+        // FNV-1a over the vertex indices, combined with the name hashes
+        uint hash = 2166136261u;
+        for(size_t i = 0; i < hiddenVertices.size(); ++i)
+        {
+            hash ^= hiddenVertices[i];
+            hash *= 16777619u;
+        }
+        return hash ^ qHash(meshName) ^ (qHash(skeletonName) * 31);
+    }
+}
@@ -0,0 +1,66 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "AvatarModuleApi.h"
+#include "CoreTypes.h"
+
+#include <QString>
+#include <QHash>
+#include <QMultiHash>
+
+#include <set>
+#include <vector>
+
+namespace Avatar
+{
+    /// Shares the modified avatar meshes between avatars with identical appearance.
+    /** Attachments of an avatar may hide vertices of the base mesh, which requires a modified copy of the mesh.
+        The cache keeps one copy per (base mesh, skeleton, hidden vertex set) key, so that all avatars wearing
+        the same outfit use the same mesh. The copies are reference counted and removed from Ogre when unused.
+
+        Morph weights are not part of the key, since they are set per Ogre entity and do not modify the mesh. */
+    class AV_MODULE_API AvatarMeshCache
+    {
+    public:
+        AvatarMeshCache();
+        ~AvatarMeshCache();
+
+        /// Returns the Ogre resource name of the mesh variant for the given key and adds a reference to it. Creates the variant if necessary.
+        /** @param meshName Ogre resource name of the base mesh.
+            @param skeletonName Ogre resource name of the skeleton that will be set to the mesh, or empty.
+            @param verticesToHide Vertices of the first submesh. Triangles using any of them are removed.
+            @return Name of the variant mesh, or empty if the base mesh could not be loaded. */
+        QString AcquireVariant(const QString &meshName, const QString &skeletonName, const std::set<uint> &verticesToHide);
+
+        /// Releases a reference acquired with AcquireVariant. The variant mesh is removed when the last reference is released.
+        void ReleaseVariant(const QString &variantName);
+
+        /// Returns the number of mesh variants currently alive.
+        int NumVariants() const { return variantHashes_.size(); }
+
+    private:
+        struct Variant
+        {
+            QString meshName;
+            QString skeletonName;
+            /// Ogre resource handle of the base mesh. Changes if the base mesh asset is reloaded.
+            u64 baseHandle;
+            std::vector<uint> hiddenVertices;
+            QString variantName;
+            int refCount;
+        };
+
+        /// Returns hash of a variant key.
+        static uint KeyHash(const QString &meshName, const QString &skeletonName, const std::vector<uint> &hiddenVertices);
+
+        /// Variants by their key hash. Colliding keys are told apart by comparing the full key.
+        QMultiHash<uint, Variant> variants_;
+        /// Key hash of each variant by variant mesh name.
+        QHash<QString, uint> variantHashes_;
+        /// Running number for variant mesh names.
+        uint nextVariantId_;
+    };
+
+    typedef boost::shared_ptr<AvatarMeshCache> AvatarMeshCachePtr;
+}
@@ -3,6 +3,7 @@
 #include "StableHeaders.h"
 #include "AvatarModule.h"
 #include "AvatarEditor.h"
+#include "AvatarMeshCache.h"
 #include "InputAPI.h"
 #include "Scene.h"
 #include "SceneAPI.h"
@@ -29,6 +30,8 @@ namespace Avatar
     void AvatarModule::Load()
     {
         framework_->Scene()->RegisterComponentFactory(ComponentFactoryPtr(new GenericComponentFactory<EC_Avatar>));
+        if (!framework_->IsHeadless())
+            mesh_cache_ = AvatarMeshCachePtr(new AvatarMeshCache());
 
         ///\todo This doesn't need to be loaded in headless server mode.
         // Note: need to register in Initialize(), because in PostInitialize() AssetModule refreshes the local asset storages, and that 
@@ -59,6 +62,8 @@ namespace Avatar
         avatar_handler_.reset();
         avatar_controllable_.reset();
         avatar_editor_.reset();
+        // EC_Avatars keep the cache alive until they are destroyed
+        mesh_cache_.reset();
     }
 
     void AvatarModule::Update(f64 frametime)
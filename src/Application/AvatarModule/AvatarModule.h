@@ -17,10 +17,12 @@ namespace Avatar
     class AvatarHandler;
     class AvatarControllable;
     class AvatarEditor;
+    class AvatarMeshCache;
 
     typedef boost::shared_ptr<AvatarHandler> AvatarHandlerPtr;
     typedef boost::shared_ptr<AvatarControllable> AvatarControllablePtr;
     typedef boost::shared_ptr<AvatarEditor> AvatarEditorPtr;
+    typedef boost::shared_ptr<AvatarMeshCache> AvatarMeshCachePtr;
 
     class AV_MODULE_API AvatarModule : public IModule
     {
@@ -41,6 +43,9 @@ namespace Avatar
         AvatarEditorPtr GetAvatarEditor() { return avatar_editor_; }
         AvatarControllablePtr GetAvatarControllable() { return avatar_controllable_; }
 
+        /// Returns the cache of avatar mesh variants shared by all EC_Avatars.
+        AvatarMeshCachePtr GetMeshCache() { return mesh_cache_; }
+
         /// Console command: start editing a specific entity's avatar
         void EditAvatar(const QString &entityName);
 
@@ -56,6 +61,7 @@ namespace Avatar
         AvatarHandlerPtr avatar_handler_;
         AvatarControllablePtr avatar_controllable_;
         AvatarEditorPtr avatar_editor_;
+        AvatarMeshCachePtr mesh_cache_;
     };
 }
 
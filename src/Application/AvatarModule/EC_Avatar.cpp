@@ -4,6 +4,8 @@
 #define OGRE_INTEROP
 #include "DebugOperatorNew.h"
 #include "EC_Avatar.h"
+#include "AvatarModule.h"
+#include "AvatarMeshCache.h"
 #include "EC_Mesh.h"
 #include "EC_AnimationController.h"
 #include "EC_Placeable.h"
@@ -13,6 +15,7 @@
 #include "Entity.h"
 #include "OgreConversionUtils.h"
 #include "Profiler.h"
+#include "Framework.h"
 #include <Ogre.h>
 #include <QDomDocument>
 
@@ -23,7 +26,6 @@
 void ApplyBoneModifier(Entity* entity, const BoneModifier& modifier, float value);
 void ResetBones(Entity* entity);
 Ogre::Bone* GetAvatarBone(Entity* entity, const std::string& bone_name);
-void HideVertices(Ogre::Entity*, std::set<uint> vertices_to_hide);
 void GetInitialDerivedBonePosition(Ogre::Node* bone, Ogre::Vector3& position);
 
 // Regrettable magic value
@@ -39,10 +41,15 @@ EC_Avatar::EC_Avatar(Scene* scene) :
     avatarAssetListener_ = AssetRefListenerPtr(new AssetRefListener());
     connect(avatarAssetListener_.get(), SIGNAL(Loaded(AssetPtr)), this, SLOT(OnAvatarAppearanceLoaded(AssetPtr)), Qt::UniqueConnection);
     connect(avatarAssetListener_.get(), SIGNAL(TransferFailed(IAssetTransfer *, QString)), this, SLOT(OnAvatarAppearanceFailed(IAssetTransfer*, QString)));
+
+    Avatar::AvatarModule *avatarModule = framework ? framework->GetModule<Avatar::AvatarModule>() : 0;
+    if (avatarModule)
+        meshCache_ = avatarModule->GetMeshCache();
 }
 
 EC_Avatar::~EC_Avatar()
 {
+    ReleaseMeshVariant();
 }
 
 void EC_Avatar::OnAvatarAppearanceFailed(IAssetTransfer* transfer, QString reason)
@@ -217,33 +224,31 @@ void EC_Avatar::SetupMeshAndMaterials()
     if (!mesh)
         return;
     
-    // Mesh needs to be cloned if there are attachments which need to hide vertices
-    bool need_mesh_clone = false;
-    
+    // A modified mesh is needed if there are attachments which need to hide vertices
     const std::vector<AvatarAttachment>& attachments = desc->attachments_;
     std::set<uint> vertices_to_hide;
     for (uint i = 0; i < attachments.size(); ++i)
-    {
-        if (attachments[i].vertices_to_hide_.size())
-        {
-            need_mesh_clone = true;
-            for (uint j = 0; j < attachments[i].vertices_to_hide_.size(); ++j)
-                vertices_to_hide.insert(attachments[i].vertices_to_hide_[j]);
-        }
-    }
+        for (uint j = 0; j < attachments[i].vertices_to_hide_.size(); ++j)
+            vertices_to_hide.insert(attachments[i].vertices_to_hide_[j]);
     
     QString meshName = LookupAsset(desc->mesh_);
-    
-    if (desc->skeleton_.length())
-    {
-        QString skeletonName = LookupAsset(desc->skeleton_);
-        mesh->SetMeshWithSkeleton(meshName.toStdString(), skeletonName.toStdString(), need_mesh_clone);
-    }
+    QString skeletonName = desc->skeleton_.length() ? LookupAsset(desc->skeleton_) : QString();
+    
+    // Avatars with the same mesh, skeleton and hidden vertices share the modified mesh.
+    // Acquire the new variant before releasing the old one, so that an unchanged variant is not rebuilt
+    QString oldVariant = meshVariant_;
+    meshVariant_.clear();
+    if (!vertices_to_hide.empty() && meshCache_ && mesh->ViewEnabled())
+        meshVariant_ = meshCache_->AcquireVariant(meshName, skeletonName, vertices_to_hide);
+    const QString &usedMeshName = meshVariant_.isEmpty() ? meshName : meshVariant_;
+    
+    if (!skeletonName.isEmpty())
+        mesh->SetMeshWithSkeleton(usedMeshName.toStdString(), skeletonName.toStdString(), false);
     else
-        mesh->SetMesh(meshName, need_mesh_clone);
+        mesh->SetMesh(usedMeshName, false);
     
-    if (need_mesh_clone)
-        HideVertices(mesh->GetEntity(), vertices_to_hide);
+    if (!oldVariant.isEmpty() && meshCache_)
+        meshCache_->ReleaseVariant(oldVariant);
     
     for (uint i = 0; i < desc->materials_.size(); ++i)
         mesh->SetMaterial(i, LookupAsset(desc->materials_[i]));
@@ -329,6 +334,13 @@ QString EC_Avatar::LookupAsset(const QString& ref)
     return framework->Asset()->ResolveAssetRef(descName, ref);
 }
 
+void EC_Avatar::ReleaseMeshVariant()
+{
+    if (!meshVariant_.isEmpty() && meshCache_)
+        meshCache_->ReleaseVariant(meshVariant_);
+    meshVariant_.clear();
+}
+
 void ResetBones(Entity* entity)
 {
     EC_Mesh* mesh = entity->GetComponent<EC_Mesh>().get();
@@ -532,71 +544,3 @@ Ogre::Bone* GetAvatarBone(Entity* entity, const std::string& bone_name)
         return 0;
     return skeleton->getBone(bone_name);
 }
-
-void HideVertices(Ogre::Entity* entity, std::set<uint> vertices_to_hide)
-{
-    if (!entity)
-        return;
-    Ogre::MeshPtr mesh = entity->getMesh();
-    if (mesh.isNull())
-        return;
-    if (!mesh->getNumSubMeshes())
-        return;
-    for (uint m = 0; m < 1; ++m)
-    {
-        // Under current system, it seems vertices should only be hidden from first submesh
-        Ogre::SubMesh *submesh = mesh->getSubMesh(m);
-        if (!submesh)
-            return;
-        Ogre::IndexData *data = submesh->indexData;
-        if (!data)
-            return;
-        Ogre::HardwareIndexBufferSharedPtr ibuf = data->indexBuffer;
-        if (ibuf.isNull())
-            return;
-
-        unsigned long* lIdx = static_cast<unsigned long*>(ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-        unsigned short* pIdx = reinterpret_cast<unsigned short*>(lIdx);
-        bool use32bitindexes = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
-
-        for (uint n = 0; n < data->indexCount; n += 3)
-        {
-            if (!use32bitindexes)
-            {
-                if (vertices_to_hide.find(pIdx[n]) != vertices_to_hide.end() ||
-                    vertices_to_hide.find(pIdx[n+1]) != vertices_to_hide.end() ||
-                    vertices_to_hide.find(pIdx[n+2]) != vertices_to_hide.end())
-                {
-                    if (n + 3 < data->indexCount)
-                    {
-                        for (size_t i = n ; i<data->indexCount-3 ; ++i)
-                        {
-                            pIdx[i] = pIdx[i+3];
-                        }
-                    }
-                    data->indexCount -= 3;
-                    n -= 3;
-                }
-            }
-            else
-            {
-                if (vertices_to_hide.find(lIdx[n]) != vertices_to_hide.end() ||
-                    vertices_to_hide.find(lIdx[n+1]) != vertices_to_hide.end() ||
-                    vertices_to_hide.find(lIdx[n+2]) != vertices_to_hide.end())
-                {
-                    if (n + 3 < data->indexCount)
-                    {
-                        for (size_t i = n ; i<data->indexCount-3 ; ++i)
-                        {
-                            lIdx[i] = lIdx[i+3];
-                        }
-                    }
-                    data->indexCount -= 3;
-                    n -= 3;
-                }
-            }
-        }
-        ibuf->unlock();
-    }
-}
-
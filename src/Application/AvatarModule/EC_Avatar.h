@@ -11,6 +11,12 @@ struct BoneModifier;
 class AvatarDescAsset;
 typedef boost::shared_ptr<AvatarDescAsset> AvatarDescAssetPtr;
 
+namespace Avatar
+{
+    class AvatarMeshCache;
+    typedef boost::shared_ptr<AvatarMeshCache> AvatarMeshCachePtr;
+}
+
 /// Avatar component.
 /** <table class="header">
     <tr>
@@ -85,9 +91,15 @@ private:
     void SetupAttachments();
     /// Lookup absolute asset reference
     QString LookupAsset(const QString& ref);
+    /// Releases the mesh variant in use, if any
+    void ReleaseMeshVariant();
 
     /// Ref listener for the avatar asset
     AssetRefListenerPtr avatarAssetListener_;
     /// Last set avatar asset
     boost::weak_ptr<AvatarDescAsset> avatarAsset_;
+    /// Cache of the mesh variants with hidden vertices. Null in headless mode
+    Avatar::AvatarMeshCachePtr meshCache_;
+    /// Name of the mesh variant acquired from the cache, or empty if the plain avatar mesh is in use
+    QString meshVariant_;
 };
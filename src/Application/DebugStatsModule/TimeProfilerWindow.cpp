@@ -1592,26 +1592,28 @@ void TimeProfilerWindow::RefreshSceneComplexityProfilingData()
         // Get Ogre meshes from terrain EC
         else if (terrain)
         {
-            for(int y = 0; y < terrain->PatchHeight(); ++y)
-                for(int x = 0; x < terrain->PatchWidth(); ++x)
+            for(int i = 0; i < terrain->NumChunks(); ++i)
+            {
+                Ogre::Entity *chunk_entity = terrain->GetChunkEntity(i);
+                if (!chunk_entity)
+                    continue;
+                ogre_entity = chunk_entity;
+                Ogre::Mesh* ogre_mesh = ogre_entity->getMesh().get();
+                scene_meshes.insert(ogre_mesh);
+                // The LOD levels of a chunk are submeshes sharing the same vertices, and only one of them is visible at a time
+                if (ogre_mesh->sharedVertexData)
+                    mesh_instance_vertices += ogre_mesh->sharedVertexData->vertexCount;
+                for(uint j = 0; j < ogre_entity->getNumSubEntities(); ++j)
                 {
-                    Ogre::SceneNode *node = terrain->GetPatch(x, y).node;
-                    if (!node)
-                        continue;
-                    if (!node->numAttachedObjects())
-                        continue;
-                    ogre_entity = dynamic_cast<Ogre::Entity*>(node->getAttachedObject(0));
-                    if (ogre_entity)
-                    {
-                        Ogre::Mesh* ogre_mesh = ogre_entity->getMesh().get();
-                        scene_meshes.insert(ogre_mesh);
-                        GetVerticesAndTrianglesFromMesh(ogre_mesh, mesh_instance_vertices, mesh_instance_triangles);
-                        mesh_instances++;
-                        std::set<Ogre::Material*> temp_mat;
-                        GetMaterialsFromEntity(ogre_entity, temp_mat);
-                        GetTexturesFromMaterials(temp_mat, scene_textures);
-                    }
+                    Ogre::SubEntity *subentity = ogre_entity->getSubEntity(j);
+                    if (subentity->isVisible() && subentity->getSubMesh()->indexData)
+                        mesh_instance_triangles += subentity->getSubMesh()->indexData->indexCount / 3;
                 }
+                mesh_instances++;
+                std::set<Ogre::Material*> temp_mat;
+                GetMaterialsFromEntity(ogre_entity, temp_mat);
+                GetTexturesFromMaterials(temp_mat, scene_textures);
+            }
         }
         
         {
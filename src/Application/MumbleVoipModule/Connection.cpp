@@ -85,7 +85,6 @@ namespace MumbleLib
             authenticated_(false),
             celt_mode_(0),
             celt_encoder_(0),
-            celt_decoder_(0),
             sending_audio_(false),
             receiving_audio_(true),
             frame_sequence_(0),
@@ -149,8 +148,6 @@ namespace MumbleLib
 
         QMutexLocker locker1(&mutex_raw_udp_tunnel_);
 
-        UninitializeCELT();
-
         QMutexLocker locker2(&mutex_encode_queue_);
         while (encode_queue_.size() > 0)
         {
@@ -172,6 +169,9 @@ namespace MumbleLib
         }
         lock_users_.unlock();
 
+        // User objects own CELT decoders created from the mode
+        UninitializeCELT();
+
         lock_state_.lockForRead();
         if (state_ != STATE_ERROR)
         {
@@ -278,8 +278,6 @@ namespace MumbleLib
         celt_encoder_ctl(celt_encoder_, CELT_SET_PREDICTION(0));
         celt_encoder_ctl(celt_encoder_, CELT_SET_BITRATE(BitrateForDecoder()));
 
-        celt_decoder_ = CreateCELTDecoder();
-
         LogDebug("CELT initialized.");
     }
 
@@ -288,48 +286,11 @@ namespace MumbleLib
         QMutexLocker encoder_locker(&mutex_encoder_);
         celt_encoder_destroy(celt_encoder_);
         celt_encoder_ = 0;
-        celt_decoder_destroy(celt_decoder_);
-        celt_decoder_ = 0;
         celt_mode_destroy(celt_mode_);
         celt_mode_ = 0;
         LogDebug("CELT uninitialized.");
     }
 
-    CELTDecoder* Connection::CreateCELTDecoder()
-    {
-        int error = 0;
-        CELTDecoder* decoder = celt_decoder_create_custom(celt_mode_, MumbleVoip::NUMBER_OF_CHANNELS, &error);
-        switch (error)
-        {
-        case CELT_OK:
-           return decoder;
-        case CELT_BAD_ARG:
-            LogError("Cannot create CELT decoder: CELT_BAD_ARG");
-            return 0;
-        case CELT_INVALID_MODE:
-            LogError("Cannot create CELT decoder: CELT_INVALID_MODE");
-            return 0;
-        case CELT_INTERNAL_ERROR:
-            LogError("Cannot create CELT decoder: CELT_INTERNAL_ERROR");
-            return 0;
-        case CELT_CORRUPTED_DATA:
-            LogError("Cannot create CELT decoder: CELT_CORRUPTED_DATA");
-            return 0;
-        case CELT_UNIMPLEMENTED:
-            LogError("Cannot create CELT decoder: CELT_UNIMPLEMENTED");
-            return 0;
-        case CELT_INVALID_STATE:
-            LogError("Cannot create CELT decoder: CELT_INVALID_STATE");
-            return 0;
-        case CELT_ALLOC_FAIL:
-            LogError("Cannot create CELT decoder: CELT_ALLOC_FAIL");
-            return 0;
-        default:
-            LogError("Cannot create CELT decoder: unknow reason");
-            return 0;
-        }
-    }
-
     void Connection::Join(QString channel_name)
     {
         QMutexLocker locker1(&mutex_authentication_);
@@ -394,6 +355,25 @@ namespace MumbleLib
         return AudioPacket(0,0);
     }
 
+    QList<AudioPacket> Connection::GetAudioPackets()
+    {
+        QList<AudioPacket> packets;
+        lock_users_.lockForRead();
+        foreach(User* user, users_)
+        {
+            // Never block main thread, the user will be polled again on next frame
+            if (!user->tryLock())
+                continue;
+
+            MumbleVoip::PCMAudioFrame* frame = user->GetAudioFrames();
+            user->unlock();
+            if (frame)
+                packets.append(AudioPacket(user, frame));
+        }
+        lock_users_.unlock();
+        return packets;
+    }
+
     void Connection::SendAudio(bool send)
     {
         sending_audio_ = send;
@@ -600,6 +580,8 @@ namespace MumbleLib
         data_stream >> session;
         data_stream >> seq;
 
+        MumbleVoip::EncodedFrame frames[MAX_FRAMES_IN_RECEIVED_PACKET];
+        int frame_count = 0;
         bool last_frame = true;
         do
         {
@@ -609,14 +591,20 @@ namespace MumbleLib
             const char* frame_data = data_stream.charPtr();
             data_stream.skip(frame_size);
 
-            if (frame_size > 0)
-				HandleIncomingCELTFrame(session, (unsigned char*)frame_data, frame_size);
+            if (frame_count < MAX_FRAMES_IN_RECEIVED_PACKET)
+            {
+                frames[frame_count].data = (const unsigned char*)frame_data;
+                frames[frame_count].size = frame_size;
+                frame_count++;
+            }
 	    }
         while (!last_frame && data_stream.isValid());
         if (!data_stream.isValid())
         {
             LogWarning("Syntax error in RawUdpTunnel packet.");
         }
+        else if (frame_count > 0)
+            HandleIncomingVoicePacket(session, seq, frames, frame_count);
 
         int bytes_left = data_stream.left();
         if (bytes_left)
@@ -660,7 +648,7 @@ namespace MumbleLib
         if (QString(mumble_user.name.c_str()) == user_name_)
             return;
 
-        User* user = new User(mumble_user, channel);
+        User* user = new User(mumble_user, channel, celt_mode_);
         user->SetPlaybackBufferMaxLengthMs(playback_buffer_length_ms_);
         user->moveToThread(this->thread()); //! @todo Do we need this?
         
@@ -736,7 +724,7 @@ namespace MumbleLib
         return 0;
     }
 
-    void Connection::HandleIncomingCELTFrame(int session, unsigned char* data, int size)
+    void Connection::HandleIncomingVoicePacket(int session, int sequence, const MumbleVoip::EncodedFrame* frames, int count)
     {
         lock_users_.lockForRead();
         User* user = users_[session];
@@ -748,53 +736,17 @@ namespace MumbleLib
             return;
         }
 
-        MumbleVoip::PCMAudioFrame* audio_frame = new MumbleVoip::PCMAudioFrame(MumbleVoip::SAMPLE_RATE, MumbleVoip::SAMPLE_WIDTH, MumbleVoip::NUMBER_OF_CHANNELS, MumbleVoip::SAMPLES_IN_FRAME*MumbleVoip::SAMPLE_WIDTH/8);
-        int ret = celt_decode(celt_decoder_, data, size, (celt_int16*)audio_frame->DataPtr(), MumbleVoip::SAMPLES_IN_FRAME);
-
-        if (ret >= 0) // CELT_OK = 0
+        // Frames are decoded here in the mumble library thread, main thread only
+        // takes ready PCM data from the jitter buffer of the user
+        if (user->tryLock(5)) // 5 ms
         {
-            if (user->tryLock(5)) // 5 ms
-            {
-                user->AddToPlaybackBuffer(audio_frame);
-                user->unlock();
-                return;
-            }
-            else
-            {
-                LogWarning("Audio packet dropped: user object locked");
-            }
+            user->AddToPlaybackBuffer(sequence, frames, count);
+            user->unlock();
         }
-        else // Error
+        else
         {
-            switch (ret)
-            {
-                case CELT_BAD_ARG:
-                    LogError("CELT decoding error: CELT_BAD_ARG");
-                    break;
-                case CELT_INVALID_MODE:
-                    LogError("CELT decoding error: CELT_INVALID_MODE");
-                    break;
-                case CELT_INTERNAL_ERROR:
-                    LogError("CELT decoding error: CELT_INTERNAL_ERROR");
-                    break;
-                case CELT_CORRUPTED_DATA:
-                    LogError("CELT decoding error: CELT_CORRUPTED_DATA");
-                    break;
-                case CELT_UNIMPLEMENTED:
-                    LogError("CELT decoding error: CELT_UNIMPLEMENTED");
-                    break;
-                case CELT_INVALID_STATE:
-                    LogError("CELT decoding error: CELT_INVALID_STATE");
-                    break;
-                case CELT_ALLOC_FAIL:
-                    LogError("CELT decoding error: CELT_ALLOC_FAIL");
-                    break;
-                default:
-                    LogError("CELT decoding error: Unknown return enum: " + QString::number(ret));
-                    break;
-            }
+            LogWarning("Audio packet dropped: user object locked");
         }
-        delete audio_frame;
     }
 
     void Connection::SetEncodingQuality(double quality)
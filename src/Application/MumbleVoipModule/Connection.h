@@ -5,6 +5,7 @@
 #include "MumbleFwd.h"
 #include "MumbleDefines.h"
 #include "StatisticsHandler.h"
+#include "JitterBuffer.h"
 
 #include "Math/float3.h"
 
@@ -78,6 +79,11 @@ namespace MumbleLib
         //! The caller must delete audio frame object after usage
         virtual AudioPacket GetAudioPacket();
 
+        //! @return one <user,audio frame> pair for every user with audio ready for playback.
+        //!         All ready audio of the user is merged into the single frame.
+        //! The caller must delete audio frame objects after usage
+        virtual QList<AudioPacket> GetAudioPackets();
+
         //! Encode and send given frame to Mumble server
         //! Frame object is NOT deleted by this method 
         virtual void SendAudioFrame(MumbleVoip::PCMAudioFrame* frame, float3 users_position);
@@ -169,7 +175,7 @@ namespace MumbleLib
 
     private slots:
         void AddToUserList(User* user);
-        void HandleIncomingCELTFrame(int session, unsigned char* data, int size);
+        void HandleIncomingVoicePacket(int session, int sequence, const MumbleVoip::EncodedFrame* frames, int count);
         void UpdateUserStates();
 
     private:
@@ -179,13 +185,13 @@ namespace MumbleLib
         static const int ENCODE_BUFFER_SIZE_ = 4000;
         static const int USER_STATE_CHECK_TIME_MS = 1000;
         static const int FRAME_BUFFER_SIZE = 256;
+        static const int MAX_FRAMES_IN_RECEIVED_PACKET = 32;
 
         char encoded_frame_data_[MumbleVoip::FRAMES_PER_PACKET][FRAME_BUFFER_SIZE];
         int encoded_frame_length_[MumbleVoip::FRAMES_PER_PACKET];
 
         void InitializeCELT();
         void UninitializeCELT();
-        CELTDecoder* CreateCELTDecoder();
         int BitrateForDecoder();
 
         State state_;
@@ -200,8 +206,7 @@ namespace MumbleLib
         QString current_server_;
 
         CELTMode* celt_mode_;
-        CELTEncoder* celt_encoder_;
-        CELTDecoder* celt_decoder_;
+        CELTEncoder* celt_encoder_; // Decoders are per user, see JitterBuffer
         MumbleVoip::StatisticsHandler statistics_;
 
         unsigned char encode_buffer_[ENCODE_BUFFER_SIZE_];
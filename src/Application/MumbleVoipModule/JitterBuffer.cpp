@@ -0,0 +1,297 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "CoreDefines.h"
+#include "LoggingFunctions.h"
+
+#include "JitterBuffer.h"
+#include "PCMAudioFrame.h"
+#include "MumbleDefines.h"
+
+#include <celt/celt_types.h>
+#include <celt/celt.h>
+
+#include <cmath>
+
+#include "MemoryLeakCheck.h"
+
+namespace MumbleVoip
+{
+    const double JitterBuffer::UNDERRUN_MARGIN_DECAY = 0.99;
+
+    /// Length of one audio frame in ms
+    static const int FRAME_MS = 1000 * SAMPLES_IN_FRAME / SAMPLE_RATE;
+
+    static QString CELTErrorString(int error)
+    {
+        switch (error)
+        {
+        case CELT_BAD_ARG:
+            return "CELT_BAD_ARG";
+        case CELT_INVALID_MODE:
+            return "CELT_INVALID_MODE";
+        case CELT_INTERNAL_ERROR:
+            return "CELT_INTERNAL_ERROR";
+        case CELT_CORRUPTED_DATA:
+            return "CELT_CORRUPTED_DATA";
+        case CELT_UNIMPLEMENTED:
+            return "CELT_UNIMPLEMENTED";
+        case CELT_INVALID_STATE:
+            return "CELT_INVALID_STATE";
+        case CELT_ALLOC_FAIL:
+            return "CELT_ALLOC_FAIL";
+        default:
+            return "Unknown return enum: " + QString::number(error);
+        }
+    }
+
+    JitterBuffer::JitterBuffer(CELTMode* mode, int max_length_ms) :
+        decoder_(0),
+        max_length_ms_(max_length_ms),
+        next_sequence_(0),
+        sequence_known_(false),
+        arrival_known_(false),
+        last_arrival_ms_(0),
+        last_packet_sequence_(0),
+        jitter_ms_(0),
+        underrun_margin_ms_(0),
+        playing_(false),
+        last_played_sequence_(0),
+        playback_end_ms_(0),
+        received_frame_count_(0),
+        concealed_frame_count_(0),
+        late_frame_count_(0),
+        dropped_frame_count_(0),
+        underrun_count_(0)
+    {
+        clock_.start();
+
+        if (!mode)
+            return;
+
+        int error = 0;
+        decoder_ = celt_decoder_create_custom(mode, NUMBER_OF_CHANNELS, &error);
+        if (error != CELT_OK)
+        {
+            LogError("Cannot create CELT decoder: " + CELTErrorString(error));
+            decoder_ = 0;
+        }
+    }
+
+    JitterBuffer::~JitterBuffer()
+    {
+        Clear();
+        if (decoder_)
+            celt_decoder_destroy(decoder_);
+        decoder_ = 0;
+    }
+
+    int JitterBuffer::AddPacket(int first_sequence, const EncodedFrame* frames, int count)
+    {
+        if (!decoder_)
+            return 0;
+
+        UpdateJitter(first_sequence);
+
+        int added = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            int sequence = first_sequence + i;
+            received_frame_count_++;
+
+            if (sequence_known_)
+            {
+                int gap = sequence - next_sequence_;
+                if (gap < 0 && gap > -MAX_LATE_FRAMES)
+                {
+                    // Duplicate or arrived after the gap was already concealed
+                    late_frame_count_++;
+                    continue;
+                }
+                if (gap > 0 && gap <= MAX_CONCEALED_FRAMES)
+                {
+                    for(int j = 0; j < gap; ++j)
+                    {
+                        PCMAudioFrame* concealed = Decode(0, 0);
+                        if (!concealed)
+                            break;
+                        Frame f = { next_sequence_ + j, concealed };
+                        frames_.push_back(f);
+                        concealed_frame_count_++;
+                        added++;
+                    }
+                }
+                // Longer gaps are silence between talk spurts and are not concealed
+            }
+
+            sequence_known_ = true;
+            next_sequence_ = sequence + 1;
+
+            // Zero length frame marks the end of a talk spurt
+            if (frames[i].size <= 0)
+                continue;
+
+            PCMAudioFrame* frame = Decode(frames[i].data, frames[i].size);
+            if (!frame)
+                continue;
+            Frame f = { sequence, frame };
+            frames_.push_back(f);
+            added++;
+        }
+
+        DropOldestFrames();
+        return added;
+    }
+
+    PCMAudioFrame* JitterBuffer::TakeFrame()
+    {
+        if (!CheckReadyForPlayback())
+            return 0;
+
+        Frame f = frames_.takeFirst();
+        NotifyFramesPlayed(f.sequence, 1);
+        return f.frame;
+    }
+
+    PCMAudioFrame* JitterBuffer::TakeFrames()
+    {
+        if (!CheckReadyForPlayback())
+            return 0;
+
+        if (frames_.size() == 1)
+        {
+            Frame f = frames_.takeFirst();
+            NotifyFramesPlayed(f.sequence, 1);
+            return f.frame;
+        }
+
+        int data_size = 0;
+        foreach(const Frame &f, frames_)
+            data_size += f.frame->DataSize();
+
+        PCMAudioFrame* merged = new PCMAudioFrame(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, data_size);
+        char* dest = merged->DataPtr();
+        foreach(const Frame &f, frames_)
+        {
+            memcpy(dest, f.frame->DataPtr(), f.frame->DataSize());
+            dest += f.frame->DataSize();
+            delete f.frame;
+        }
+        NotifyFramesPlayed(frames_.last().sequence, frames_.size());
+        frames_.clear();
+        return merged;
+    }
+
+    void JitterBuffer::Clear()
+    {
+        foreach(const Frame &f, frames_)
+            delete f.frame;
+        frames_.clear();
+        playing_ = false;
+        sequence_known_ = false;
+        arrival_known_ = false;
+    }
+
+    int JitterBuffer::LengthMs() const
+    {
+        return frames_.size() * FRAME_MS;
+    }
+
+    int JitterBuffer::TargetLengthMs() const
+    {
+        // One full packet must always be buffered as frames arrive packet at a time
+        int target = FRAMES_PER_PACKET * FRAME_MS + static_cast<int>(3 * jitter_ms_ + underrun_margin_ms_);
+        if (target > max_length_ms_)
+            target = max_length_ms_;
+        return target;
+    }
+
+    void JitterBuffer::SetMaxLengthMs(int max_length_ms)
+    {
+        max_length_ms_ = max_length_ms;
+        DropOldestFrames();
+    }
+
+    PCMAudioFrame* JitterBuffer::Decode(const unsigned char* data, int size)
+    {
+        PCMAudioFrame* frame = new PCMAudioFrame(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, SAMPLES_IN_FRAME*SAMPLE_WIDTH/8);
+        int ret = celt_decode(decoder_, data, size, (celt_int16*)frame->DataPtr(), SAMPLES_IN_FRAME);
+        if (ret >= 0) // CELT_OK = 0
+            return frame;
+
+        LogError("CELT decoding error: " + CELTErrorString(ret));
+        delete frame;
+        return 0;
+    }
+
+    void JitterBuffer::UpdateJitter(int sequence)
+    {
+        int now = clock_.elapsed();
+        if (arrival_known_)
+        {
+            // Only consecutive packets of the same talk spurt tell about network jitter
+            int sequence_delta = sequence - last_packet_sequence_;
+            if (sequence_delta > 0 && sequence_delta <= FRAMES_PER_PACKET + MAX_CONCEALED_FRAMES)
+            {
+                double d = fabs(static_cast<double>((now - last_arrival_ms_) - sequence_delta * FRAME_MS));
+                jitter_ms_ += (d - jitter_ms_) / 16.0;
+            }
+        }
+        arrival_known_ = true;
+        last_arrival_ms_ = now;
+        last_packet_sequence_ = sequence;
+        underrun_margin_ms_ *= UNDERRUN_MARGIN_DECAY;
+    }
+
+    bool JitterBuffer::CheckReadyForPlayback()
+    {
+        if (frames_.isEmpty())
+            return false;
+
+        int now = clock_.elapsed();
+        if (playing_)
+        {
+            if (now <= playback_end_ms_)
+                return true;
+
+            // Everything given to playback has been played out already. If the talk spurt
+            // continues we had an audible gap and should buffer more from now on.
+            playing_ = false;
+            if (frames_.first().sequence == last_played_sequence_ + 1)
+            {
+                underrun_count_++;
+                underrun_margin_ms_ += UNDERRUN_MARGIN_STEP_MS;
+                if (underrun_margin_ms_ > UNDERRUN_MARGIN_MAX_MS)
+                    underrun_margin_ms_ = UNDERRUN_MARGIN_MAX_MS;
+            }
+        }
+
+        // Start playback when target is reached, or when nothing more has been received for a while
+        int target = TargetLengthMs();
+        if (LengthMs() >= target || now - last_arrival_ms_ > target)
+        {
+            playing_ = true;
+            return true;
+        }
+        return false;
+    }
+
+    void JitterBuffer::NotifyFramesPlayed(int last_sequence, int count)
+    {
+        int now = clock_.elapsed();
+        if (playback_end_ms_ < now)
+            playback_end_ms_ = now;
+        playback_end_ms_ += count * FRAME_MS;
+        last_played_sequence_ = last_sequence;
+    }
+
+    void JitterBuffer::DropOldestFrames()
+    {
+        while (!frames_.isEmpty() && LengthMs() > max_length_ms_)
+        {
+            delete frames_.takeFirst().frame;
+            dropped_frame_count_++;
+        }
+    }
+}
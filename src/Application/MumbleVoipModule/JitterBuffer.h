@@ -0,0 +1,130 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "MumbleFwd.h"
+
+#include <QList>
+#include <QTime>
+
+namespace MumbleVoip
+{
+    //! One CELT encoded frame inside a received voice packet. Data is not owned.
+    struct EncodedFrame
+    {
+        const unsigned char* data;
+        int size;
+    };
+
+    //! Adaptive jitter buffer for one remote speaker.
+    //!
+    //! Owns the CELT decoder of the speaker: received frames are decoded in
+    //! the mumble library thread by AddPacket and lost frames are concealed
+    //! using the CELT packet loss concealment. The main thread only takes
+    //! ready PCM frames out with TakeFrame or TakeFrames.
+    //!
+    //! At the start of every talk spurt playback is held back until the buffered
+    //! audio reaches the target length. The target length adapts to the measured
+    //! network jitter (RFC 3550 interarrival jitter) and to playback underruns.
+    //!
+    //! The class is not thread safe by itself, the owning User object must be locked
+    //! when the buffer is accessed.
+    class JitterBuffer
+    {
+    public:
+        //! @param mode CELT mode the decoder is created for, owned by the connection
+        //! @param max_length_ms Maximum length of buffered audio, oldest frames are dropped beyond this
+        JitterBuffer(CELTMode* mode, int max_length_ms);
+        virtual ~JitterBuffer();
+
+        //! Decode frames of one received voice packet into the buffer
+        //! Missing frames between the previous and this packet are concealed.
+        //! @param first_sequence sequence number of the first frame in packet
+        //! @param frames encoded frames in sequence order
+        //! @param count number of frames
+        //! @return number of frames added to buffer (including concealed frames)
+        int AddPacket(int first_sequence, const EncodedFrame* frames, int count);
+
+        //! @return oldest audio frame ready for playback, 0 if nothing is ready
+        //! @note caller must delete audio frame object after usage
+        PCMAudioFrame* TakeFrame();
+
+        //! @return all audio frames ready for playback merged into a single frame, 0 if nothing is ready
+        //! @note caller must delete audio frame object after usage
+        PCMAudioFrame* TakeFrames();
+
+        //! Discard all buffered audio and restart the talk spurt detection
+        void Clear();
+
+        //! @return length of buffered audio in ms
+        int LengthMs() const;
+
+        //! @return current adaptive target length in ms
+        int TargetLengthMs() const;
+
+        //! @return estimated network jitter in ms
+        double JitterMs() const { return jitter_ms_; }
+
+        void SetMaxLengthMs(int max_length_ms);
+        int MaxLengthMs() const { return max_length_ms_; }
+
+        //! @return number of frames received from network
+        int ReceivedFrameCount() const { return received_frame_count_; }
+
+        //! @return number of frames which were lost, arrived too late or were dropped because of buffer overflow
+        int LostFrameCount() const { return concealed_frame_count_ + late_frame_count_ + dropped_frame_count_; }
+
+        //! @return number of playback underruns
+        int UnderrunCount() const { return underrun_count_; }
+
+    private:
+        //! Max number of consecutive frames concealed, a longer gap starts a new talk spurt
+        static const int MAX_CONCEALED_FRAMES = 5;
+        //! Sequence numbers further behind than this are treated as a restarted sequence
+        static const int MAX_LATE_FRAMES = 100;
+        //! Extra target length added for each playback underrun
+        static const int UNDERRUN_MARGIN_STEP_MS = 10;
+        static const int UNDERRUN_MARGIN_MAX_MS = 200;
+        //! Underrun margin decay factor per received packet
+        static const double UNDERRUN_MARGIN_DECAY;
+
+        struct Frame
+        {
+            int sequence;
+            PCMAudioFrame* frame;
+        };
+
+        //! Decode one frame. Packet loss concealment is used if data is 0.
+        PCMAudioFrame* Decode(const unsigned char* data, int size);
+        //! Update interarrival jitter estimate with a packet received now
+        void UpdateJitter(int sequence);
+        //! @return true if buffered frames can be given to playback
+        bool CheckReadyForPlayback();
+        //! Book keeping for frames given to playback
+        void NotifyFramesPlayed(int last_sequence, int count);
+        void DropOldestFrames();
+
+        CELTDecoder* decoder_;
+        QList<Frame> frames_;
+        int max_length_ms_;
+        int next_sequence_;
+        bool sequence_known_;
+
+        QTime clock_;
+        bool arrival_known_;
+        int last_arrival_ms_;
+        int last_packet_sequence_;
+        double jitter_ms_;
+        double underrun_margin_ms_;
+
+        bool playing_;
+        int last_played_sequence_;
+        int playback_end_ms_;
+
+        int received_frame_count_;
+        int concealed_frame_count_;
+        int late_frame_count_;
+        int dropped_frame_count_;
+        int underrun_count_;
+    };
+}
@@ -35,6 +35,7 @@ namespace MumbleVoip
 
     class ServerInfo;
     class PCMAudioFrame;
+    class JitterBuffer;
     class SettingsWidget;
 }
 
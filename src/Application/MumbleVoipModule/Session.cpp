@@ -448,12 +448,9 @@ namespace MumbleVoip
         if (!audio_receiving_enabled_)
             return;
 
-        for(;;) // until we have 'em all
+        // One merged frame per speaker so that every speaker costs a single sound buffer per frame
+        foreach(MumbleLib::AudioPacket packet, connection_->GetAudioPackets())
         {
-            MumbleLib::AudioPacket packet = connection_->GetAudioPacket();
-            if (packet.second == 0)
-                break; // there was nothing to play
-
             bool source_muted = false;
             foreach(Participant* participant, participants_)
             {
@@ -528,8 +525,9 @@ namespace MumbleVoip
             if (!user)
                 continue;
             int buffer_len = user->PlaybackBufferLengthMs();
+            int buffer_target = user->PlaybackBufferTargetLengthMs();
             int drop = static_cast<int>( 100*user->VoicePacketDropRatio() );
-            QString line = QString("    participant %1:   audio buffer=%2 ms   frame loss=%3 %").arg(p->Name()).arg(buffer_len).arg(drop);
+            QString line = QString("    participant %1:   audio buffer=%2/%3 ms   frame loss=%4 %").arg(p->Name()).arg(buffer_len).arg(buffer_target).arg(drop);
             lines.append(line);
         }
         return lines;
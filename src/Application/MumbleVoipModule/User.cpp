@@ -19,26 +19,21 @@
 
 namespace MumbleLib
 {
-    User::User(const ::MumbleClient::User& user, ::MumbleLib::Channel* channel)
+    User::User(const ::MumbleClient::User& user, ::MumbleLib::Channel* channel, CELTMode* celt_mode)
         : user_(user),
           speaking_(false),
           position_known_(false),
           position_(0,0,0),
           left_(false),
           channel_(channel),
-          received_voice_packet_count_(0),
-          voice_packet_drop_count_(0),
-          playback_buffer_max_length_ms(DEFAUL_PLAYBACK_BUFFER_MAX_LENGTH_MS_)
+          playback_buffer_(new MumbleVoip::JitterBuffer(celt_mode, DEFAUL_PLAYBACK_BUFFER_MAX_LENGTH_MS_))
     {
         last_audio_frame_time_.start(); // initialize time state so that restart is possible later
     }
 
     User::~User()
     {
-        foreach(MumbleVoip::PCMAudioFrame* audio, playback_queue_)
-            SAFE_DELETE(audio);
-
-        playback_queue_.clear();
+        SAFE_DELETE(playback_buffer_);
     }
 
     QString User::Name() const
@@ -86,17 +81,12 @@ namespace MumbleLib
         return speaking_;
     }
 
-    void User::AddToPlaybackBuffer(MumbleVoip::PCMAudioFrame* frame)
+    void User::AddToPlaybackBuffer(int sequence, const MumbleVoip::EncodedFrame* frames, int count)
     {
-        received_voice_packet_count_++;
-        // Buffer overflow handling: We drop the oldest packet in the buffer
-        if (PlaybackBufferLengthMs() > playback_buffer_max_length_ms )
-        {
-            MumbleVoip::PCMAudioFrame* frame = GetAudioFrame();
-            SAFE_DELETE(frame);
-        }
+        // Buffer overflow, packet loss and reordering are handled by the jitter buffer
+        if (playback_buffer_->AddPacket(sequence, frames, count) == 0)
+            return;
 
-        playback_queue_.push_back(frame);
         last_audio_frame_time_.restart();
 
         if (!speaking_)
@@ -121,22 +111,29 @@ namespace MumbleLib
 
     int User::PlaybackBufferLengthMs() const
     {
-        return 1000 * playback_queue_.size() * MumbleVoip::SAMPLES_IN_FRAME / MumbleVoip::SAMPLE_RATE;
+        return playback_buffer_->LengthMs();
+    }
+
+    int User::PlaybackBufferTargetLengthMs() const
+    {
+        return playback_buffer_->TargetLengthMs();
     }
     
     MumbleVoip::PCMAudioFrame* User::GetAudioFrame()
     {
-        if (playback_queue_.size() == 0)
-            return 0;
+        return playback_buffer_->TakeFrame();
+    }
 
-        return playback_queue_.takeFirst();
+    MumbleVoip::PCMAudioFrame* User::GetAudioFrames()
+    {
+        return playback_buffer_->TakeFrames();
     }
 
     double User::VoicePacketDropRatio() const
     {
-        if (received_voice_packet_count_ == 0)
+        if (playback_buffer_->ReceivedFrameCount() == 0)
             return 0;
-        return static_cast<double>(voice_packet_drop_count_)/received_voice_packet_count_;
+        return static_cast<double>(playback_buffer_->LostFrameCount())/playback_buffer_->ReceivedFrameCount();
     }
 
     void User::CheckSpeakingState()
@@ -175,7 +172,7 @@ namespace MumbleLib
 
     void User::SetPlaybackBufferMaxLengthMs(int value)
     {
-        playback_buffer_max_length_ms = value;
+        playback_buffer_->SetMaxLengthMs(value);
     }
 
 } // namespace MumbleLib
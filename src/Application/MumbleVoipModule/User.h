@@ -13,6 +13,7 @@
 #include <QTime>
 
 #include "LibMumbleClient.h"
+#include "JitterBuffer.h"
 
 namespace MumbleLib
 {
@@ -27,7 +28,8 @@ namespace MumbleLib
         //! Default constructor
         //! @param user
         //! @param channel The channel where the user are located
-        User(const ::MumbleClient::User& user, Channel* channel);
+        //! @param celt_mode CELT mode used to create the voice decoder of this user
+        User(const ::MumbleClient::User& user, Channel* channel, CELTMode* celt_mode);
 
         //! Destructor
         virtual ~User();
@@ -59,10 +61,24 @@ namespace MumbleLib
         //! @return length of playback buffer is ms for this user 
         virtual int PlaybackBufferLengthMs() const ;
 
+        //! @return current adaptive target length of playback buffer in ms
+        virtual int PlaybackBufferTargetLengthMs() const;
+
         //! @return oldest audio frame available for playback 
         //! @note caller must delete audio frame object after usage
         virtual MumbleVoip::PCMAudioFrame* GetAudioFrame();
 
+        //! @return all audio frames available for playback as a single frame
+        //! @note caller must delete audio frame object after usage
+        virtual MumbleVoip::PCMAudioFrame* GetAudioFrames();
+
+        //! Decode received voice packet to playback buffer.
+        //! Called from the mumble library thread, user object must be locked.
+        //! @param sequence sequence number of the first frame in packet
+        //! @param frames CELT encoded frames of the packet
+        //! @param count number of frames
+        void AddToPlaybackBuffer(int sequence, const MumbleVoip::EncodedFrame* frames, int count);
+
         //! Set user status to be left
         virtual void SetLeft() { left_ = true; emit Left(); }
 
@@ -76,11 +92,6 @@ namespace MumbleLib
         virtual int CurrentChannelID() const; 
 
     public slots:
-        //! Put audio frame to end of playback buffer 
-        //! If playback buffer is full it is cleared first.
-        //! @param farme Audio data frame received from network and ment to be for playback locally
-        void AddToPlaybackBuffer(MumbleVoip::PCMAudioFrame* frame);
-
         //! Updatedes user last known position
         //! Also set position_known_ flag up
         //! @param pos the curren position of this user
@@ -101,13 +112,10 @@ namespace MumbleLib
         float3 position_;
         bool position_known_;
 
-        QList<MumbleVoip::PCMAudioFrame*> playback_queue_;
+        MumbleVoip::JitterBuffer* playback_buffer_;
         bool left_;
         MumbleLib::Channel* channel_;
-        int received_voice_packet_count_;
-        int voice_packet_drop_count_;
         QTime last_audio_frame_time_;
-        int playback_buffer_max_length_ms;
     signals:
         //! Emited when user has left from server
         void Left();
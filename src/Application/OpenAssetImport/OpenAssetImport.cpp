@@ -5,6 +5,7 @@
 #include "OpenAssetImport.h"
 #include "SceneDesc.h"
 #include "LoggingFunctions.h"
+#include "AssetCache.h"
 
 #include <assimp.hpp>      // C++ importer interface
 #include <aiScene.h>       // Output data structure
@@ -14,14 +15,113 @@
 #include <Ogre.h>
 #include <boost/filesystem.hpp>
 
+#include <QFile>
+#include <QCryptographicHash>
+#include <QtConcurrentRun>
+
 #include "MemoryLeakCheck.h"
 
 using namespace Assimp;
 
 namespace AssImp
 {
-    OpenAssetImport::OpenAssetImport() :
+    namespace
+    {
+        /// Version of the cooked mesh cache entries. Increment when the conversion or the importer settings change.
+        const int cCookedMeshVersion = 1;
+
+        /// Vertex and index data of an Assimp mesh, converted to the layout of the Ogre submesh.
+        struct ConvertedMesh
+        {
+            ConvertedMesh() : numVertices(0) {}
+
+            unsigned int numVertices;
+            /// Positions and normals, for vertex buffer 0.
+            std::vector<float> geometry;
+            /// Texture coordinates, tangents and binormals, for vertex buffer 1.
+            std::vector<float> attributes;
+            std::vector<u32> indices;
+            Ogre::Vector3 min;
+            Ogre::Vector3 max;
+        };
+
+        /// Converts an Assimp mesh to vertex and index arrays. Does not touch Ogre's resource or buffer managers, so it can be run in a worker thread.
+        ConvertedMesh ConvertMesh(const aiMesh *mesh)
+        {
+            ConvertedMesh out;
+            out.numVertices = mesh->mNumVertices;
+            out.min = Ogre::Vector3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+            out.max = -out.min;
+
+            out.geometry.reserve(mesh->mNumVertices * 6);
+            for(unsigned int n=0 ; n<mesh->mNumVertices ; ++n)
+            {
+                const aiVector3D &v = mesh->mVertices[n];
+                out.geometry.push_back(v.x);
+                out.geometry.push_back(v.y);
+                out.geometry.push_back(v.z);
+
+                if (mesh->mNormals)
+                {
+                    out.geometry.push_back(mesh->mNormals[n].x);
+                    out.geometry.push_back(mesh->mNormals[n].y);
+                    out.geometry.push_back(mesh->mNormals[n].z);
+                }
+                else
+                {
+                    out.geometry.push_back(0.f);
+                    out.geometry.push_back(0.f);
+                    out.geometry.push_back(1.f);
+                }
+
+                out.min.makeFloor(Ogre::Vector3(v.x, v.y, v.z));
+                out.max.makeCeil(Ogre::Vector3(v.x, v.y, v.z));
+            }
+
+            const bool hasTangents = mesh->HasTangentsAndBitangents();
+            for(unsigned int n=0 ; n<mesh->mNumVertices ; ++n)
+            {
+                for(int tn=0 ; tn<AI_MAX_NUMBER_OF_TEXTURECOORDS ; ++tn)
+                {
+                    if (mesh->mTextureCoords[tn])
+                    {
+                        out.attributes.push_back(mesh->mTextureCoords[tn][n].x);
+                        out.attributes.push_back(mesh->mTextureCoords[tn][n].y);
+                        if (mesh->mNumUVComponents[tn] == 3)
+                            out.attributes.push_back(mesh->mTextureCoords[tn][n].z);
+                    }
+                }
+
+                if (hasTangents)
+                {
+                    out.attributes.push_back(mesh->mTangents[n].x);
+                    out.attributes.push_back(mesh->mTangents[n].y);
+                    out.attributes.push_back(mesh->mTangents[n].z);
+
+                    out.attributes.push_back(mesh->mBitangents[n].x);
+                    out.attributes.push_back(mesh->mBitangents[n].y);
+                    out.attributes.push_back(mesh->mBitangents[n].z);
+                }
+            }
+
+            // support only triangles, so 3 indices per face
+            out.indices.reserve(mesh->mNumFaces * 3);
+            for(unsigned int n=0 ; n<mesh->mNumFaces ; ++n)
+            {
+                const aiFace &face = mesh->mFaces[n];
+                if (face.mNumIndices != 3)
+                    continue;
+                out.indices.push_back(face.mIndices[0]);
+                out.indices.push_back(face.mIndices[1]);
+                out.indices.push_back(face.mIndices[2]);
+            }
+            return out;
+        }
+    }
+
+    OpenAssetImport::OpenAssetImport(AssetCache *cache) :
         importer_(new Importer()),
+        cache_(cache),
 #include "DisableMemoryLeakCheck.h"
         logstream_(new AssImpLogStream()),
 #include "EnableMemoryLeakCheck.h"
@@ -93,7 +193,9 @@ namespace AssImp
 
     void OpenAssetImport::GetMeshData(const QString& file, std::vector<MeshData> &outMeshData) const
     {
-        const aiScene *scene = importer_->ReadFile(file.toStdString(), default_flags_);
+        // Only the node hierarchy is needed, so skip the costly vertex processing steps. The steps that can split or remove
+        // meshes are kept, so that the nodes reported here are the same that Import() creates meshes for.
+        const aiScene *scene = importer_->ReadFile(file.toStdString(), aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_ValidateDataStructure);
 
         if (scene)
         {
@@ -111,12 +213,33 @@ namespace AssImp
 
     void OpenAssetImport::Import(const void *data, size_t length, const QString &name, const char* hint, const QString &nodeName, std::vector<std::string> &outMeshNames)
     {
+        const std::string ogreMeshName = name.toStdString();
+        if (Ogre::MeshManager::getSingleton().resourceExists(ogreMeshName))
+        {
+            outMeshNames.push_back(ogreMeshName);
+            return;
+        }
+
+        QString cookedName;
+        if (cache_)
+        {
+            cookedName = CookedMeshName(data, length, nodeName);
+            QString cookedPath = cache_->FindInCache(cookedName);
+            if (!cookedPath.isEmpty() && LoadCookedMesh(cookedPath, ogreMeshName))
+            {
+                outMeshNames.push_back(ogreMeshName);
+                return;
+            }
+        }
+
         const aiScene *scene = importer_->ReadFileFromMemory(data, length, default_flags_, hint);
 
         if (scene)
         {
             const struct aiNode *rootNode = scene->mRootNode;
             ImportNode(scene, rootNode, name, nodeName, outMeshNames);
+            if (cache_ && std::find(outMeshNames.begin(), outMeshNames.end(), ogreMeshName) != outMeshNames.end())
+                StoreCookedMesh(ogreMeshName, cookedName);
         } else
         {
             // report error
@@ -124,6 +247,78 @@ namespace AssImp
         }
     }
 
+    QString OpenAssetImport::CookedMeshName(const void *data, size_t length, const QString &nodeName) const
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(static_cast<const char *>(data), (int)length);
+        hash.addData(nodeName.toUtf8());
+        // The importer properties affect the result as much as the post-process flags
+        const char *properties[] = { AI_CONFIG_PP_LBW_MAX_WEIGHTS, AI_CONFIG_PP_RVC_FLAGS, AI_CONFIG_PP_SBP_REMOVE };
+        for(size_t i=0 ; i<NUMELEMS(properties) ; ++i)
+            hash.addData(QByteArray::number(importer_->GetPropertyInteger(properties[i])) + ";");
+        return QString("assimp_%1_%2_v%3.mesh").arg(QString(hash.result().toHex())).arg(default_flags_, 8, 16, QChar('0')).arg(cCookedMeshVersion);
+    }
+
+    bool OpenAssetImport::LoadCookedMesh(const QString &path, const std::string &meshName) const
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        QByteArray bytes = file.readAll();
+        file.close();
+        if (bytes.isEmpty())
+            return false;
+
+        Ogre::MeshPtr ogreMesh;
+        try
+        {
+            ogreMesh = Ogre::MeshManager::getSingleton().createManual(meshName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            ogreMesh->setAutoBuildEdgeLists(false);
+#include "DisableMemoryLeakCheck.h"
+            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream(bytes.data(), bytes.size(), false));
+#include "EnableMemoryLeakCheck.h"
+            Ogre::MeshSerializer serializer;
+            serializer.importMesh(stream, ogreMesh.get());
+            ogreMesh->load();
+        } catch(Ogre::Exception &e)
+        {
+            LogWarning("OpenAssetImport::LoadCookedMesh: Discarding invalid cooked mesh " + path + ": " + e.what());
+            if (!ogreMesh.isNull())
+                Ogre::MeshManager::getSingleton().remove(ogreMesh->getHandle());
+            QFile::remove(path);
+            return false;
+        }
+        return true;
+    }
+
+    void OpenAssetImport::StoreCookedMesh(const std::string &meshName, const QString &cookedName) const
+    {
+        Ogre::MeshPtr ogreMesh = Ogre::MeshManager::getSingleton().getByName(meshName);
+        if (ogreMesh.isNull())
+            return;
+
+        // Write to a temporary file first, so that an interrupted write never leaves a truncated mesh in the cache
+        const QString path = cache_->GetCacheDirectory() + cookedName;
+        const QString tempPath = path + ".tmp";
+        try
+        {
+            Ogre::MeshSerializer serializer;
+            serializer.exportMesh(ogreMesh.get(), tempPath.toStdString());
+        } catch(Ogre::Exception &e)
+        {
+            LogWarning("OpenAssetImport::StoreCookedMesh: Could not write cooked mesh " + path + ": " + e.what());
+            QFile::remove(tempPath);
+            return;
+        }
+
+        QFile::remove(path);
+        if (!QFile::rename(tempPath, path))
+        {
+            LogWarning("OpenAssetImport::StoreCookedMesh: Could not write cooked mesh " + path);
+            QFile::remove(tempPath);
+        }
+    }
+
     SceneDesc OpenAssetImport::GetSceneDescription(const QString &filename) const
     {
         ///\todo Implement
@@ -190,9 +385,19 @@ namespace AssImp
                 Ogre::Vector3 vmin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
                 Ogre::Vector3 vmax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
 
+                // Convert the meshes of the node to vertex and index arrays in parallel. Only the hardware buffers
+                // are created in this thread, as Ogre's buffer manager is not thread safe.
+                std::vector<QFuture<ConvertedMesh> > conversions;
+                for(unsigned int i=0 ; i<node->mNumMeshes ; ++i)
+                    conversions.push_back(QtConcurrent::run(ConvertMesh, static_cast<const aiMesh *>(scene->mMeshes[node->mMeshes[i]])));
+                std::vector<ConvertedMesh> convertedMeshes;
+                for(size_t i=0 ; i<conversions.size() ; ++i)
+                    convertedMeshes.push_back(conversions[i].result());
+
                 for(unsigned int i=0 ; i<node->mNumMeshes ; ++i)
                 {
                     const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+                    const ConvertedMesh &converted = convertedMeshes[i];
                     
                     Ogre::SubMesh *ogreSubmesh = ogreMesh->createSubMesh();
                     
@@ -200,7 +405,7 @@ namespace AssImp
 #include "DisableMemoryLeakCheck.h"
                     ogreSubmesh->vertexData = new Ogre::VertexData();
 #include "EnableMemoryLeakCheck.h"
-                    ogreSubmesh->vertexData->vertexCount = mesh->mNumVertices;
+                    ogreSubmesh->vertexData->vertexCount = converted.numVertices;
                     Ogre::VertexData *data = ogreSubmesh->vertexData;
                     
                     // Vertex declarations
@@ -239,76 +444,26 @@ namespace AssImp
                         data->vertexCount,                          // The number of vertices you'll put into this buffer
                         Ogre::HardwareBuffer::HBU_DYNAMIC // Properties
                         );
-                    Ogre::Real *vbData = static_cast<Ogre::Real*>(vbuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-                    
-                    offset = 0;
-                    for(unsigned int n=0 ; n<data->vertexCount ; ++n)
-                    {
-                        vbData[offset++] = mesh->mVertices[n].x;
-                        vbData[offset++] = mesh->mVertices[n].y;
-                        vbData[offset++] = mesh->mVertices[n].z;
-
-                        vbData[offset++] = mesh->mNormals[n].x;
-                        vbData[offset++] = mesh->mNormals[n].y;
-                        vbData[offset++] = mesh->mNormals[n].z;
-
-                        vmin.x = std::min(vmin.x, mesh->mVertices[n].x);
-                        vmin.y = std::min(vmin.y, mesh->mVertices[n].y);
-                        vmin.z = std::min(vmin.z, mesh->mVertices[n].z);
-
-                        vmax.x = std::max(vmax.x, mesh->mVertices[n].x);
-                        vmax.y = std::max(vmax.y, mesh->mVertices[n].y);
-                        vmax.z = std::max(vmax.z, mesh->mVertices[n].z);
-                    }
-                    vbuf->unlock();
+                    if (!converted.geometry.empty())
+                        vbuf->writeData(0, converted.geometry.size() * sizeof(float), &converted.geometry[0], true);
                     data->vertexBufferBinding->setBinding(0, vbuf);
+
+                    vmin.makeFloor(converted.min);
+                    vmax.makeCeil(converted.max);
                     
-                    if (mesh->HasTextureCoords(0))
-                    {
-                    vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
-                        decl->getVertexSize(1),                     // This value is the size of a vertex in memory
-                        data->vertexCount,                          // The number of vertices you'll put into this buffer
-                        Ogre::HardwareBuffer::HBU_DYNAMIC // Properties
-                        );
-                    vbData = static_cast<Ogre::Real*>(vbuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-                    
-                    offset = 0;
-                    for(unsigned int n=0 ; n<data->vertexCount ; ++n)
+                    if (!converted.attributes.empty())
                     {
-                        for(int tn=0 ; tn<AI_MAX_NUMBER_OF_TEXTURECOORDS ; ++tn)
-                        {
-                            if (mesh->mTextureCoords[tn])
-                            {
-                                if (mesh->mNumUVComponents[tn] == 3)
-                                {
-                                    vbData[offset++] = mesh->mTextureCoords[tn][n].x;
-                                    vbData[offset++] = mesh->mTextureCoords[tn][n].y;
-                                    vbData[offset++] = mesh->mTextureCoords[tn][n].z;
-                                } else
-                                {
-                                    vbData[offset++] = mesh->mTextureCoords[tn][n].x;
-                                    vbData[offset++] = mesh->mTextureCoords[tn][n].y;
-                                }
-                            }
-                        }
-
-                        if (mesh->HasTangentsAndBitangents())
-                        {
-                            vbData[offset++] = mesh->mTangents[n].x;
-                            vbData[offset++] = mesh->mTangents[n].y;
-                            vbData[offset++] = mesh->mTangents[n].z;
-
-                            vbData[offset++] = mesh->mBitangents[n].x;
-                            vbData[offset++] = mesh->mBitangents[n].y;
-                            vbData[offset++] = mesh->mBitangents[n].z;
-                        }
-                    }
-                    vbuf->unlock();
-                    data->vertexBufferBinding->setBinding(1, vbuf);
+                        vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                            decl->getVertexSize(1),                     // This value is the size of a vertex in memory
+                            data->vertexCount,                          // The number of vertices you'll put into this buffer
+                            Ogre::HardwareBuffer::HBU_DYNAMIC // Properties
+                            );
+                        vbuf->writeData(0, converted.attributes.size() * sizeof(float), &converted.attributes[0], true);
+                        data->vertexBufferBinding->setBinding(1, vbuf);
                     }
 
                     // indices
-                    size_t numIndices = mesh->mNumFaces * 3;            // support only triangles, so 3 indices per face
+                    size_t numIndices = converted.indices.size();
                     
                     Ogre::HardwareIndexBuffer::IndexType idxType = Ogre::HardwareIndexBuffer::IT_16BIT;
                     if (numIndices > 65535)
@@ -320,28 +475,15 @@ namespace AssImp
                         Ogre::HardwareBuffer::HBU_DYNAMIC     // Properties
                         );
                     
-                    if (idxType == Ogre::HardwareIndexBuffer::IT_16BIT)
+                    if (numIndices > 0)
                     {
-                        u16 *idxData = static_cast<u16*>(ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-                        offset = 0;
-                        for(uint n=0 ; n<mesh->mNumFaces ; ++n)
+                        if (idxType == Ogre::HardwareIndexBuffer::IT_16BIT)
                         {
-                            idxData[offset++] = mesh->mFaces[n].mIndices[0];
-                            idxData[offset++] = mesh->mFaces[n].mIndices[1];
-                            idxData[offset++] = mesh->mFaces[n].mIndices[2];
-                        }
-                    } else
-                    {
-                        u32 *idxData = static_cast<u32*>(ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-                        offset = 0;
-                        for(uint n=0 ; n<mesh->mNumFaces ; ++n)
-                        {
-                            idxData[offset++] = mesh->mFaces[n].mIndices[0];
-                            idxData[offset++] = mesh->mFaces[n].mIndices[1];
-                            idxData[offset++] = mesh->mFaces[n].mIndices[2];
-                        }
+                            std::vector<u16> shortIndices(converted.indices.begin(), converted.indices.end());
+                            ibuf->writeData(0, numIndices * sizeof(u16), &shortIndices[0], true);
+                        } else
+                            ibuf->writeData(0, numIndices * sizeof(u32), &converted.indices[0], true);
                     }
-                    ibuf->unlock();
 
                     ogreSubmesh->indexData->indexBuffer = ibuf;         // The pointer to the index buffer
                     ogreSubmesh->indexData->indexCount = numIndices;    // The number of indices we'll use
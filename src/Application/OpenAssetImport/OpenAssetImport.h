@@ -8,6 +8,7 @@
 #include "Transform.h"
 
 struct SceneDesc;
+class AssetCache;
 
 namespace AssImp
 {
@@ -29,7 +30,10 @@ namespace AssImp
     class OpenAssetImport
     {
     public:
-        OpenAssetImport();
+        /// Constructor.
+        /** @param cache Asset cache where imported meshes are stored as cooked Ogre binary meshes. Later imports of the same
+                   data are then loaded from the cache without running Assimp. If null, every import runs Assimp. */
+        explicit OpenAssetImport(AssetCache *cache = 0);
         ~OpenAssetImport();
 
         /// Helper function for stripping mesh name from asset id
@@ -65,6 +69,10 @@ namespace AssImp
         /** The meshes are generated directly to Ogre::MeshManager and names of the meshes are
             returned. Use GetMeshData() to get hierarchy and transformation data from a model file.
 
+            If an Ogre mesh with the given name already exists, it is returned as is. If an asset cache was given, the generated
+            mesh is stored to it keyed by the hash of the data, the node name and the import flags and properties, and later
+            imports of the same data load the cooked mesh instead.
+
             \param data memory buffer where to import meshes from
             \param length memory buffer length
             \param name file format hint for the importer, looks for extension within the name
@@ -95,7 +103,17 @@ namespace AssImp
         void ImportNode(const struct aiScene *scene, const struct aiNode *node, const QString& file, const QString &nodeName, 
             std::vector<std::string> &outMeshNames);
 
+        /// Returns the asset cache name of the cooked mesh for the given data and node.
+        QString CookedMeshName(const void *data, size_t length, const QString &nodeName) const;
+
+        /// Loads a cooked mesh from the cache as the given Ogre mesh. Removes the cache entry if it is invalid.
+        bool LoadCookedMesh(const QString &path, const std::string &meshName) const;
+
+        /// Stores an imported Ogre mesh to the cache.
+        void StoreCookedMesh(const std::string &meshName, const QString &cookedName) const;
+
         boost::shared_ptr<Assimp::Importer> importer_;
+        AssetCache *cache_;
         AssImpLogStream *logstream_;
 
         const unsigned int loglevels_;     /// Log levels to capture during import
@@ -28,10 +28,17 @@
 #include "CoreStringUtils.h"
 #include "MemoryLeakCheck.h"
 
+namespace
+{
+    /// The number of resolved asset refs AssetAPI::ResolveAssetRef remembers.
+    const int cMaxResolvedAssetRefs = 4096;
+}
+
 AssetAPI::AssetAPI(Framework *fw_, bool isHeadless)
 :fw(fw_), assetCache(0),
 diskSourceChangeWatcher(0),
-isHeadless_(isHeadless)
+isHeadless_(isHeadless),
+resolvedRefs(cMaxResolvedAssetRefs)
 {
     // The Asset API always understands at least this single built-in asset type "Binary".
     // You can use this type to request asset data as binary, without generating any kind of in-memory representation or loading for it.
@@ -469,8 +476,8 @@ void AssetAPI::ForgetAsset(AssetPtr asset, bool removeDiskSource)
     // some object left a dangling strong ref to an asset).
     asset->Unload();
 
-    AssetMap::iterator iter = assets.find(asset->Name());
-    if (iter == assets.end())
+    AssetIdMap::iterator iter = FindAssetIterator(asset->Name());
+    if (iter == assets.end() || iter->second != asset)
     {
         LogError("AssetAPI::ForgetAsset called on asset \"" + asset->Name() + "\", which does not exist in AssetAPI!");
         return;
@@ -610,7 +617,7 @@ AssetUploadTransferPtr AssetAPI::UploadAssetFromFileInMemory(const u8 *data, siz
 
     AssetUploadTransferPtr transfer = provider->UploadAssetFromFileInMemory(data, numBytes, destination, assetName);
     if (transfer)
-        currentUploadTransfers[transfer->destinationStorage.lock()->GetFullAssetURL(assetName)] = transfer;
+        currentUploadTransfers[assetRefs.Intern(transfer->destinationStorage.lock()->GetFullAssetURL(assetName))] = transfer;
 
     return transfer;
 }
@@ -634,9 +641,11 @@ void AssetAPI::Reset()
     assetTypeFactories.clear();
     defaultStorage.reset();
     readyTransfers.clear();
-    assetDependencies.clear();
+    assetDependencies.Clear();
+    resolvedRefs.clear();
     currentUploadTransfers.clear();
     currentTransfers.clear();
+    assetRefs.Clear();
     providers.clear();
 }
 
@@ -652,7 +661,7 @@ std::vector<AssetTransferPtr> AssetAPI::PendingTransfers()
 
 AssetTransferPtr AssetAPI::GetPendingTransfer(QString assetRef)
 {
-    AssetTransferMap::iterator iter = currentTransfers.find(assetRef);
+    AssetTransferMap::iterator iter = FindTransferIterator(assetRef);
     if (iter != currentTransfers.end())
         return iter->second;
     for(size_t i = 0; i < readyTransfers.size(); ++i)
@@ -674,10 +683,13 @@ AssetTransferPtr AssetAPI::RequestAsset(QString assetRef, QString assetType, boo
     QString assetFilename;
     ParseAssetRef(assetRef, 0, 0, 0, 0, 0, 0, &assetFilename, 0, 0, &assetRefWithoutSubAsset);
 
+    // From here on the ref is looked up by its interned id.
+    const AssetRefId assetRefId = assetRefs.Intern(assetRef);
+
     // To optimize, we first check if there is an outstanding request to the given asset. If so, we return that request. In effect, we never
     // have multiple transfers running to the same asset. (Important: This must occur before checking the assets map for whether we already have the asset in memory, since
     // an asset will be stored in the AssetMap when it has been downloaded, but it might not yet have all its dependencies loaded).
-    AssetTransferMap::iterator iter = currentTransfers.find(assetRef);
+    AssetTransferMap::iterator iter = currentTransfers.find(assetRefId);
     if (iter != currentTransfers.end())
     {
         AssetTransferPtr transfer = iter->second;
@@ -702,7 +714,7 @@ AssetTransferPtr AssetAPI::RequestAsset(QString assetRef, QString assetType, boo
 
     // Check if we've already downloaded this asset before and it already is loaded in the system. We never reload an asset we've downloaded before, 
     // unless the client explicitly forces so, or if we get a change notification signal from the source asset provider telling the asset was changed.
-    AssetMap::iterator iter2 = assets.find(assetRef);
+    AssetIdMap::iterator iter2 = assets.find(assetRefId);
     AssetPtr existing;
     if (iter2 != assets.end())
     {
@@ -740,7 +752,7 @@ AssetTransferPtr AssetAPI::RequestAsset(QString assetRef, QString assetType, boo
 
     // See if there is an asset upload that should block this download. If the same asset is being uploaded and downloaded simultaneously, make the download
     // wait until the upload completes.
-    if (currentUploadTransfers.find(assetRef) != currentUploadTransfers.end())
+    if (currentUploadTransfers.find(assetRefId) != currentUploadTransfers.end())
     {
         LogDebug("The download of asset \"" + assetRef + "\" needs to wait, since the same asset is being uploaded at the moment.");
         PendingDownloadRequest pendingRequest;
@@ -748,7 +760,7 @@ AssetTransferPtr AssetAPI::RequestAsset(QString assetRef, QString assetType, boo
         pendingRequest.assetType = assetType;
         pendingRequest.transfer = AssetTransferPtr(new IAssetTransfer);
 
-        pendingDownloadRequests[assetRef] = pendingRequest;
+        pendingDownloadRequests[assetRefId] = pendingRequest;
         return pendingRequest.transfer; ///\bug Problem. When we return this structure, the client will connect to this.
     }
 
@@ -797,8 +809,8 @@ AssetTransferPtr AssetAPI::RequestAsset(QString assetRef, QString assetType, boo
     
     // Store the newly allocated AssetTransfer internally, so that any duplicated requests to this asset will return the same request pointer,
     // so we'll avoid multiple downloads to the exact same asset.
-    assert(currentTransfers.find(assetRef) == currentTransfers.end());
-    currentTransfers[assetRef] = transfer;
+    assert(currentTransfers.find(assetRefId) == currentTransfers.end());
+    currentTransfers[assetRefId] = transfer;
     return transfer;
 }
 
@@ -849,10 +861,17 @@ QString AssetAPI::ResolveAssetRef(QString context, QString assetRef)
     context = context.trimmed();
 
     // First see if we have an exact match for the ref to an existing asset.
-    AssetMap::iterator iter = assets.find(assetRef);
+    AssetIdMap::iterator iter = FindAssetIterator(assetRef);
     if (iter != assets.end())
         return assetRef; // Use the ref as-is, there's an existing asset to map this string to.
 
+    // See if this ref has been resolved in this context before. A ref resolved relative to the default storage is valid
+    // only as long as that storage stays the default.
+    const QPair<QString, QString> cacheKey(context, assetRef);
+    ResolvedAssetRef *resolved = resolvedRefs.object(cacheKey);
+    if (resolved && (!resolved->relativeToDefaultStorage || resolved->defaultStorage.lock() == GetDefaultAssetStorage()))
+        return resolved->ref;
+
     // If the assetRef is by local filename without a reference to a provider or storage, use the default asset storage in the system for this assetRef.
     QString assetPath;
     QString namedStorage;
@@ -864,6 +883,7 @@ QString AssetAPI::ResolveAssetRef(QString context, QString assetRef)
     case AssetRefLocalPath: // Absolute path like "C:\myassets\texture.png".
     case AssetRefLocalUrl: // Local path using "local://", like "local://file.mesh".
     case AssetRefExternalUrl: // External path using an URL specifier, like "http://server.com/file.mesh" or "someProtocol://server.com/asset.dat".
+        CacheResolvedAssetRef(cacheKey, assetRef, AssetStoragePtr());
         return assetRef;
     case AssetRefRelativePath:
         {
@@ -872,7 +892,9 @@ QString AssetAPI::ResolveAssetRef(QString context, QString assetRef)
                 AssetStoragePtr defaultStorage = GetDefaultAssetStorage();
                 if (!defaultStorage)
                     return assetRef; // Failed to find the provider, just use the ref as it was, and hope. (It might still be satisfied by the local storage).
-                return defaultStorage->GetFullAssetURL(assetRef);
+                QString newAssetRef = defaultStorage->GetFullAssetURL(assetRef);
+                CacheResolvedAssetRef(cacheKey, newAssetRef, defaultStorage);
+                return newAssetRef;
             }
             else
             {
@@ -892,6 +914,7 @@ QString AssetAPI::ResolveAssetRef(QString context, QString assetRef)
                 else if (!contextProtocolSpecifier.isEmpty())
                     newAssetRef += contextProtocolSpecifier + "://";
                 newAssetRef += QDir::cleanPath(contextPath + assetPath);
+                CacheResolvedAssetRef(cacheKey, newAssetRef, AssetStoragePtr());
                 return newAssetRef;
             }
         }
@@ -909,6 +932,15 @@ QString AssetAPI::ResolveAssetRef(QString context, QString assetRef)
     return assetRef;
 }
 
+void AssetAPI::CacheResolvedAssetRef(const QPair<QString, QString> &key, const QString &resolvedRef, const AssetStoragePtr &defaultStorage)
+{
+    ResolvedAssetRef *resolved = new ResolvedAssetRef;
+    resolved->ref = resolvedRef;
+    resolved->relativeToDefaultStorage = (defaultStorage.get() != 0);
+    resolved->defaultStorage = defaultStorage;
+    resolvedRefs.insert(key, resolved);
+}
+
 bool AssetAPI::IsAssetTypeFactoryRegistered(const QString &typeName)
 {
     AssetTypeFactoryPtr existingFactory = GetAssetTypeFactory(typeName);
@@ -1022,7 +1054,7 @@ AssetPtr AssetAPI::CreateNewAsset(QString type, QString name, AssetStoragePtr st
     }
     
     // Remember this asset in the global AssetAPI storage.
-    assets[name] = asset;
+    assets[assetRefs.Intern(name)] = asset;
 
     emit AssetCreated(asset);
     
@@ -1041,19 +1073,44 @@ AssetTypeFactoryPtr AssetAPI::GetAssetTypeFactory(QString typeName)
 AssetPtr AssetAPI::GetAsset(QString assetRef)
 {
     // First try to see if the ref has an exact match.
-    AssetMap::iterator iter = assets.find(assetRef);
+    AssetIdMap::iterator iter = FindAssetIterator(assetRef);
     if (iter != assets.end())
         return iter->second;
 
     // If not, normalize and resolve the lookup of the given asset.
     assetRef = ResolveAssetRef("", assetRef);
 
-    iter = assets.find(assetRef);
+    iter = FindAssetIterator(assetRef);
     if (iter != assets.end())
         return iter->second;
     return AssetPtr();
 }
 
+AssetPtr AssetAPI::GetAsset(AssetRefId id) const
+{
+    AssetIdMap::const_iterator iter = assets.find(id);
+    return iter != assets.end() ? iter->second : AssetPtr();
+}
+
+AssetRefId AssetAPI::ResolveAssetRefId(const QString &assetRef)
+{
+    return assetRefs.Intern(ResolveAssetRef("", assetRef));
+}
+
+AssetMap AssetAPI::GetAllAssets() const
+{
+    AssetMap allAssets;
+    for(AssetIdMap::const_iterator iter = assets.begin(); iter != assets.end(); ++iter)
+        allAssets[iter->second->Name()] = iter->second;
+    return allAssets;
+}
+
+AssetAPI::AssetIdMap::iterator AssetAPI::FindAssetIterator(const QString &assetRef)
+{
+    AssetRefId id = assetRefs.Find(assetRef);
+    return id != InvalidAssetRefId ? assets.find(id) : assets.end();
+}
+
 void AssetAPI::Update(f64 frametime)
 {
     PROFILE(AssetAPI_Update);
@@ -1085,9 +1142,10 @@ QString GuaranteeTrailingSlash(const QString &source)
     return s;
 }
 
-AssetAPI::AssetTransferMap::iterator AssetAPI::FindTransferIterator(QString assetRef)
+AssetAPI::AssetTransferMap::iterator AssetAPI::FindTransferIterator(const QString &assetRef)
 {
-    return currentTransfers.find(assetRef);
+    AssetRefId id = assetRefs.Find(assetRef);
+    return id != InvalidAssetRefId ? currentTransfers.find(id) : currentTransfers.end();
 }
 
 AssetAPI::AssetTransferMap::iterator AssetAPI::FindTransferIterator(IAssetTransfer *transfer)
@@ -1095,7 +1153,12 @@ AssetAPI::AssetTransferMap::iterator AssetAPI::FindTransferIterator(IAssetTransf
     if (!transfer)
         return currentTransfers.end();
 
-    for(AssetTransferMap::iterator iter = currentTransfers.begin(); iter != currentTransfers.end(); ++iter)
+    // The transfers are keyed by their source ref, so try the direct lookup first.
+    AssetTransferMap::iterator iter = FindTransferIterator(transfer->source.ref);
+    if (iter != currentTransfers.end() && iter->second.get() == transfer)
+        return iter;
+
+    for(iter = currentTransfers.begin(); iter != currentTransfers.end(); ++iter)
         if (iter->second.get() == transfer)
             return iter;
 
@@ -1117,8 +1180,9 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
     {
         transfer->EmitAssetDownloaded();
         transfer->EmitTransferSucceeded();
-        pendingDownloadRequests.erase(transfer->source.ref);
-        currentTransfers.erase(transfer->source.ref);
+        const AssetRefId sourceRefId = assetRefs.Find(transfer->source.ref);
+        pendingDownloadRequests.erase(sourceRefId);
+        currentTransfers.erase(sourceRefId);
         return;
     }
 
@@ -1190,7 +1254,7 @@ void AssetAPI::AssetTransferFailed(IAssetTransfer *transfer, QString reason)
 
     ///\todo In this function, there is a danger of reaching an infinite recursion. Remember recursion parents and avoid infinite loops. (A -> B -> C -> A)
 
-    AssetTransferMap::iterator iter = currentTransfers.find(transfer->source.ref);
+    AssetTransferMap::iterator iter = FindTransferIterator(transfer->source.ref);
     if (iter == currentTransfers.end())
         LogError("AssetAPI: Asset \"" + transfer->assetType + "\", name \"" + transfer->source.ref + "\" transfer failed, but no corresponding AssetTransferPtr was tracked by AssetAPI!");
 
@@ -1209,7 +1273,7 @@ void AssetAPI::AssetTransferFailed(IAssetTransfer *transfer, QString reason)
         }
     }
 
-    pendingDownloadRequests.erase(transfer->source.ref);
+    pendingDownloadRequests.erase(assetRefs.Find(transfer->source.ref));
     if (iter != currentTransfers.end())
         currentTransfers.erase(iter);
 }
@@ -1218,7 +1282,7 @@ void AssetAPI::AssetLoadCompleted(const QString assetRef)
 {
     AssetPtr asset;
     AssetTransferMap::iterator iter = FindTransferIterator(assetRef);
-    AssetMap::iterator iter2 = assets.find(assetRef);   
+    AssetIdMap::iterator iter2 = FindAssetIterator(assetRef);
     
     // Check for new transfer: not in the assets map yet
     if (iter != currentTransfers.end())
@@ -1256,7 +1320,7 @@ void AssetAPI::AssetLoadCompleted(const QString assetRef)
 void AssetAPI::AssetLoadFailed(const QString assetRef)
 {
     AssetTransferMap::iterator iter = FindTransferIterator(assetRef);
-    AssetMap::iterator iter2 = assets.find(assetRef);   
+    AssetIdMap::iterator iter2 = FindAssetIterator(assetRef);
 
     if (iter != currentTransfers.end())
     {
@@ -1288,8 +1352,9 @@ void AssetAPI::AssetUploadTransferCompleted(IAssetUploadTransfer *uploadTransfer
     if (assetCache)
         assetCache->DeleteAsset(assetRef);
 
-    currentUploadTransfers.erase(assetRef); // Note: this might kill the 'transfer' ptr if we were the last one to hold on to it. Don't dereference transfer below this.
-    PendingDownloadRequestMap::iterator iter = pendingDownloadRequests.find(assetRef);
+    const AssetRefId assetRefId = assetRefs.Find(assetRef);
+    currentUploadTransfers.erase(assetRefId); // Note: this might kill the 'transfer' ptr if we were the last one to hold on to it. Don't dereference transfer below this.
+    PendingDownloadRequestMap::iterator iter = pendingDownloadRequests.find(assetRefId);
     if (iter != pendingDownloadRequests.end())
     {
         PendingDownloadRequest req = iter->second;
@@ -1321,25 +1386,18 @@ void AssetAPI::AssetDependenciesCompleted(AssetTransferPtr transfer)
         return;
     }
     
-    pendingDownloadRequests.erase(transfer->source.ref);
+    pendingDownloadRequests.erase(assetRefs.Find(transfer->source.ref));
 }
 
 void AssetAPI::NotifyAssetDependenciesChanged(AssetPtr asset)
 {
-    /// Delete all old stored asset dependencies for this asset.
-    RemoveAssetDependencies(asset->Name());
+    // Replaces all old stored asset dependencies for this asset. Empty refs are ignored.
+    QStringList refs;
+    std::vector<AssetReference> references = asset->FindReferences();
+    for(size_t i = 0; i < references.size(); ++i)
+        refs << references[i].ref;
 
-    std::vector<AssetReference> refs = asset->FindReferences();
-    for(size_t i = 0; i < refs.size(); ++i)
-    {
-        // Turn named storage (and default storage) specifiers to absolute specifiers.
-        QString ref = refs[i].ref;
-        if (ref.isEmpty())
-            continue;
-
-        // Remember this assetref for future lookup.
-        assetDependencies.push_back(std::make_pair(asset->Name(), ref));
-    }
+    assetDependencies.SetDependencies(asset->Name(), refs);
 }
 
 void AssetAPI::RequestAssetDependencies(AssetPtr asset)
@@ -1365,25 +1423,18 @@ void AssetAPI::RequestAssetDependencies(AssetPtr asset)
 
 void AssetAPI::RemoveAssetDependencies(QString asset)
 {
-    for(size_t i = 0; i < assetDependencies.size(); ++i)
-        if (QString::compare(assetDependencies[i].first, asset, Qt::CaseInsensitive) == 0)
-        {
-            assetDependencies.erase(assetDependencies.begin() + i);
-            --i;
-        }
+    assetDependencies.RemoveDependencies(asset);
 }
 
 std::vector<AssetPtr> AssetAPI::FindDependents(QString dependee)
 {
     std::vector<AssetPtr> dependents;
-    for(size_t i = 0; i < assetDependencies.size(); ++i)
+    QStringList names = assetDependencies.Dependents(dependee);
+    foreach(const QString &name, names)
     {
-        if (QString::compare(assetDependencies[i].second, dependee, Qt::CaseInsensitive) == 0)
-        {
-            AssetMap::iterator iter = assets.find(assetDependencies[i].first);
-            if (iter != assets.end())
-                dependents.push_back(iter->second);
-        }
+        AssetIdMap::iterator iter = FindAssetIterator(name);
+        if (iter != assets.end())
+            dependents.push_back(iter->second);
     }
     return dependents;
 }
@@ -1398,6 +1449,13 @@ bool AssetAPI::ShouldReplicateAssetDiscovery(const QString& assetRef)
 }
 
 int AssetAPI::NumPendingDependencies(AssetPtr asset)
+{
+    QSet<QString> visited;
+    visited.insert(asset->Name().toLower());
+    return NumPendingDependencies(asset, visited);
+}
+
+int AssetAPI::NumPendingDependencies(AssetPtr asset, QSet<QString> &visited)
 {
     int numDependencies = 0;
 
@@ -1408,6 +1466,12 @@ int AssetAPI::NumPendingDependencies(AssetPtr asset)
         if (ref.isEmpty())
             continue;
 
+        // Count each asset only once, also when it is reached through several paths or a cycle.
+        QString key = ref.toLower();
+        if (visited.contains(key))
+            continue;
+        visited.insert(key);
+
         // We silently ignore this dependency if the asset type in question is disabled.
         if (dynamic_cast<NullAssetFactory*>(GetAssetTypeFactory(GetResourceTypeFromAssetRef(refs[i])).get()))
             continue;
@@ -1430,7 +1494,7 @@ int AssetAPI::NumPendingDependencies(AssetPtr asset)
                 // Ask the dependencies of the dependency, we want all of the asset
                 // down the chain to be loaded before we load the base asset
                 // Note: if the dependency is unloaded, it may or may not be able to tell the dependencies correctly
-                numDependencies += NumPendingDependencies(existing);
+                numDependencies += NumPendingDependencies(existing, visited);
             }
         }
     }
@@ -1438,6 +1502,11 @@ int AssetAPI::NumPendingDependencies(AssetPtr asset)
     return numDependencies;
 }
 
+QStringList AssetAPI::DependencyOrder(const QStringList &assetRefs) const
+{
+    return assetDependencies.TopologicalOrder(assetRefs);
+}
+
 void AssetAPI::HandleAssetDiscovery(const QString &assetRef, const QString &assetType)
 {
     HandleAssetDiscovery(assetRef, assetType, AssetStoragePtr());
@@ -1509,7 +1578,7 @@ void AssetAPI::OnAssetLoaded(AssetPtr asset)
         dependent->DependencyLoaded(asset);
 
         // Check if this dependency was the last one of the given asset's dependencies.
-        AssetTransferMap::iterator iter = currentTransfers.find(dependent->Name());
+        AssetTransferMap::iterator iter = FindTransferIterator(dependent->Name());
         if (iter != currentTransfers.end())
         {
             AssetTransferPtr transfer = iter->second;
@@ -1522,7 +1591,7 @@ void AssetAPI::OnAssetLoaded(AssetPtr asset)
 void AssetAPI::OnAssetDiskSourceChanged(const QString &path_)
 {
     QDir path(path_);
-    for(AssetMap::iterator iter = assets.begin(); iter != assets.end(); ++iter)
+    for(AssetIdMap::iterator iter = assets.begin(); iter != assets.end(); ++iter)
     {
         QString assetDiskSource = iter->second->DiskSource();
         if (!assetDiskSource.isEmpty() && QDir(assetDiskSource) == path && QFile::exists(assetDiskSource))
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <QObject>
+#include <QCache>
+#include <QPair>
 #include <vector>
 #include <utility>
 #include <map>
@@ -10,6 +12,8 @@
 #include "CoreTypes.h"
 #include "CoreStringUtils.h"
 #include "AssetFwd.h"
+#include "AssetDependencyGraph.h"
+#include "AssetRefTable.h"
 
 class QFileSystemWatcher;
 
@@ -134,7 +138,8 @@ public:
         QString *outPath_Filename_SubAssetName = 0, QString *outPath_Filename = 0, QString *outPath = 0, QString *outFilename = 0, QString *outSubAssetName = 0,
         QString *outFullRef = 0, QString *outFullRefNoSubAssetName = 0);
 
-    typedef std::map<QString, AssetTransferPtr, QStringLessThanNoCase> AssetTransferMap;
+    /// Maps the interned source refs of the transfers to the transfers. @see AssetRefFromId.
+    typedef std::map<AssetRefId, AssetTransferPtr> AssetTransferMap;
     typedef std::vector<std::pair<QString, QString> > AssetDependenciesMap;
     
     /// Sanitates an assetref so that it can be used as a filename for caching. Characters like : / \\ * will be replaced with $1, $2, $3, $4 .. respectively, in a reversible way.
@@ -153,7 +158,7 @@ public:
 
 public slots:
     /// Returns all assets known to the asset system. AssetMap maps asset names to their AssetPtrs.
-    AssetMap GetAllAssets() { return assets; }
+    AssetMap GetAllAssets() const;
 
     /// Returns the known asset storage instances in the system.
     AssetStorageVector GetAssetStorages() const;
@@ -347,8 +352,13 @@ public slots:
     void RequestAssetDependencies(AssetPtr transfer);
 
     /// An utility function that counts the number of dependencies the given asset has to other assets that have not been loaded in.
+    /** Each asset in the dependency chain is counted at most once, also when several assets depend on it or the dependencies are cyclic. */
     int NumPendingDependencies(AssetPtr asset);
 
+    /// Returns the given assets and all their known dependencies, ordered so that each asset comes after the assets it depends on.
+    /** Only the dependencies of assets that have already been loaded are known. Useful for prefetching. */
+    QStringList DependencyOrder(const QStringList &assetRefs) const;
+
     /// Utility function that checks whether an asset ref's discovery or deletion should be replicated
     bool ShouldReplicateAssetDiscovery(const QString &assetRef);
     
@@ -366,8 +376,8 @@ public slots:
     /// Return current asset transfers
     const AssetTransferMap& GetCurrentTransfers() const { return currentTransfers; }
     
-    /// Return the current asset dependency map (debugging)
-    const AssetDependenciesMap& DebugGetAssetDependencies() const { return assetDependencies; }
+    /// Return the current asset dependencies as (dependent, dependee) pairs (debugging)
+    AssetDependenciesMap DebugGetAssetDependencies() const { return assetDependencies.Pairs(); }
     
     /// Return ready asset transfers (debugging)
     const std::vector<AssetTransferPtr> DebugGetReadyTransfers() const{ return readyTransfers; }
@@ -376,6 +386,20 @@ public:
     /// Explodes the given asset storage description string to key-value pairs.
     static QMap<QString, QString> ParseAssetStorageString(QString storageString);
 
+    /// Resolves an asset ref with an empty context, and returns the interned id of the result.
+    /** Store the id instead of the ref string when the same ref is handled repeatedly. Refs that differ only in case get the same id.
+        The id stays valid until Reset(). */
+    AssetRefId ResolveAssetRefId(const QString &assetRef);
+
+    /// Returns the id of an already resolved asset ref, or InvalidAssetRefId if no asset or transfer has used the ref.
+    AssetRefId FindAssetRefId(const QString &resolvedRef) const { return assetRefs.Find(resolvedRef); }
+
+    /// Returns the resolved asset ref of an id.
+    QString AssetRefFromId(AssetRefId id) const { return assetRefs.Ref(id); }
+
+    /// Returns the asset with the given ref id, or null if it does not exist.
+    AssetPtr GetAsset(AssetRefId id) const;
+
 signals:
     /// Emitted for each new asset that was created and added to the system. When this signal is triggered, the dependencies of an asset
     /// may not yet have been loaded.
@@ -415,23 +439,47 @@ private slots:
 private:
     bool isHeadless_;
 
-    AssetTransferMap::iterator FindTransferIterator(QString assetRef);
+    AssetTransferMap::iterator FindTransferIterator(const QString &assetRef);
     AssetTransferMap::iterator FindTransferIterator(IAssetTransfer *transfer);
 
     /// Stores all the currently ongoing asset transfers.
     AssetTransferMap currentTransfers;
 
-    typedef std::map<QString, AssetUploadTransferPtr, QStringLessThanNoCase> AssetUploadTransferMap;
-    /// Stores all the currently ongoing asset uploads, maps full assetRefs to the asset upload transfer structures.
+    typedef std::map<AssetRefId, AssetUploadTransferPtr> AssetUploadTransferMap;
+    /// Stores all the currently ongoing asset uploads, maps the ids of full assetRefs to the asset upload transfer structures.
     AssetUploadTransferMap currentUploadTransfers;
 
     /// Keeps track of all the dependencies each asset has to each other asset.
-    /// \todo Find a more effective data structure for this. Needs something like boost::bimap but for multi-indices.
-    AssetDependenciesMap assetDependencies;
+    AssetDependencyGraph assetDependencies;
+
+    /// Interned refs of the assets and transfers. The asset and transfer maps are keyed by these ids, and the refs given to
+    /// the API functions are converted to ids once at the API boundary.
+    AssetRefTable assetRefs;
 
-    /// Removes from AssetDependenciesMap all dependencies the given asset has.
+    /// A cached result of ResolveAssetRef.
+    struct ResolvedAssetRef
+    {
+        QString ref;
+        /// True if the ref was resolved relative to the default storage.
+        bool relativeToDefaultStorage;
+        /// The default storage the ref was resolved against.
+        AssetStorageWeakPtr defaultStorage;
+    };
+
+    /// Recently resolved asset refs keyed by the context and the ref, so that the same refs do not have to be parsed again on each request.
+    /** Holds at most cMaxResolvedAssetRefs entries, the least recently used ones are dropped first. Refs to named storages
+        are not cached, as storages can be added to the providers without the Asset API being told. */
+    QCache<QPair<QString, QString>, ResolvedAssetRef> resolvedRefs;
+
+    /// Stores a result of ResolveAssetRef to resolvedRefs. Pass the default storage if the ref was resolved relative to it.
+    void CacheResolvedAssetRef(const QPair<QString, QString> &key, const QString &resolvedRef, const AssetStoragePtr &defaultStorage);
+
+    /// Removes all dependencies the given asset has.
     void RemoveAssetDependencies(QString asset);
 
+    /// Counts the pending dependencies of an asset, skipping the assets that have already been visited.
+    int NumPendingDependencies(AssetPtr asset, QSet<QString> &visited);
+
     /// Handle discovery of a new asset, when the storage is already known. This is used internally for optimization, so that providers don't need to be queried
     void HandleAssetDiscovery(const QString &assetRef, const QString &assetType, AssetStoragePtr storage);
     
@@ -460,11 +508,15 @@ private:
         QString assetType;
         AssetTransferPtr transfer;
     };
-    typedef std::map<QString, PendingDownloadRequest, QStringLessThanNoCase> PendingDownloadRequestMap;
+    typedef std::map<AssetRefId, PendingDownloadRequest> PendingDownloadRequestMap;
     PendingDownloadRequestMap pendingDownloadRequests;
 
-    /// Stores all the already loaded assets in the system.
-    AssetMap assets;
+    typedef std::map<AssetRefId, AssetPtr> AssetIdMap;
+    /// Stores all the already loaded assets in the system, keyed by the ids of their names.
+    AssetIdMap assets;
+
+    /// Returns the iterator of an asset by name, or assets.end().
+    AssetIdMap::iterator FindAssetIterator(const QString &assetRef);
 
     /// Tracks all loaded assets if their DiskSources change, and issues a reload of the assets.
     QFileSystemWatcher *diskSourceChangeWatcher;
@@ -0,0 +1,140 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "DebugOperatorNew.h"
+#include "AssetDependencyGraph.h"
+#include "MemoryLeakCheck.h"
+
+void AssetDependencyGraph::SetDependencies(const QString &dependent, const QStringList &dependees)
+{
+    RemoveDependencies(dependent);
+
+    QString dependentKey = Key(dependent);
+    foreach(const QString &dependee, dependees)
+    {
+        if (dependee.isEmpty())
+            continue;
+
+        QString dependeeKey = Key(dependee);
+        Node &node = nodes_[dependentKey];
+        if (node.name.isEmpty())
+            node.name = dependent;
+        if (node.dependencies.contains(dependeeKey))
+            continue;
+        node.dependencies.insert(dependeeKey);
+
+        Node &dependeeNode = nodes_[dependeeKey];
+        if (dependeeNode.name.isEmpty())
+            dependeeNode.name = dependee;
+        dependeeNode.dependents.insert(dependentKey);
+        ++numDependencies_;
+    }
+}
+
+void AssetDependencyGraph::RemoveDependencies(const QString &dependent)
+{
+    QString dependentKey = Key(dependent);
+    QHash<QString, Node>::iterator iter = nodes_.find(dependentKey);
+    if (iter == nodes_.end())
+        return;
+
+    QSet<QString> dependencies;
+    dependencies.swap(iter->dependencies);
+    foreach(const QString &dependeeKey, dependencies)
+    {
+        QHash<QString, Node>::iterator dependee = nodes_.find(dependeeKey);
+        if (dependee != nodes_.end())
+        {
+            dependee->dependents.remove(dependentKey);
+            if (dependeeKey != dependentKey)
+                RemoveIfUnused(dependeeKey);
+        }
+        --numDependencies_;
+    }
+    RemoveIfUnused(dependentKey);
+}
+
+QStringList AssetDependencyGraph::Dependents(const QString &dependee) const
+{
+    QStringList dependents;
+    QHash<QString, Node>::const_iterator iter = nodes_.find(Key(dependee));
+    if (iter == nodes_.end())
+        return dependents;
+
+    foreach(const QString &dependentKey, iter->dependents)
+        dependents << nodes_.value(dependentKey).name;
+    return dependents;
+}
+
+QStringList AssetDependencyGraph::Dependencies(const QString &dependent) const
+{
+    QStringList dependencies;
+    QHash<QString, Node>::const_iterator iter = nodes_.find(Key(dependent));
+    if (iter == nodes_.end())
+        return dependencies;
+
+    foreach(const QString &dependeeKey, iter->dependencies)
+        dependencies << nodes_.value(dependeeKey).name;
+    return dependencies;
+}
+
+QStringList AssetDependencyGraph::TopologicalOrder(const QStringList &assets) const
+{
+    QStringList order;
+    QSet<QString> visited;
+
+    // Iterative depth-first search, so that long dependency chains do not overflow the stack.
+    // Each stack entry is a node key and the dependencies of it that have not been visited yet.
+    std::vector<std::pair<QString, QStringList> > stack;
+    foreach(const QString &asset, assets)
+    {
+        QString key = Key(asset);
+        if (visited.contains(key))
+            continue;
+        visited.insert(key);
+        QHash<QString, Node>::const_iterator node = nodes_.find(key);
+        stack.push_back(std::make_pair(key, node != nodes_.end() ? node->dependencies.toList() : QStringList()));
+
+        while(!stack.empty())
+        {
+            QStringList &pending = stack.back().second;
+            if (pending.isEmpty())
+            {
+                QHash<QString, Node>::const_iterator done = nodes_.find(stack.back().first);
+                order << (done != nodes_.end() ? done->name : asset);
+                stack.pop_back();
+                continue;
+            }
+
+            QString dependeeKey = pending.takeLast();
+            if (visited.contains(dependeeKey))
+                continue;
+            visited.insert(dependeeKey);
+            stack.push_back(std::make_pair(dependeeKey, nodes_.value(dependeeKey).dependencies.toList()));
+        }
+    }
+
+    return order;
+}
+
+AssetDependencyGraph::DependencyList AssetDependencyGraph::Pairs() const
+{
+    DependencyList pairs;
+    pairs.reserve(numDependencies_);
+    for(QHash<QString, Node>::const_iterator iter = nodes_.begin(); iter != nodes_.end(); ++iter)
+        foreach(const QString &dependeeKey, iter->dependencies)
+            pairs.push_back(std::make_pair(iter->name, nodes_.value(dependeeKey).name));
+    return pairs;
+}
+
+void AssetDependencyGraph::Clear()
+{
+    nodes_.clear();
+    numDependencies_ = 0;
+}
+
+void AssetDependencyGraph::RemoveIfUnused(const QString &key)
+{
+    QHash<QString, Node>::iterator iter = nodes_.find(key);
+    if (iter != nodes_.end() && iter->dependencies.isEmpty() && iter->dependents.isEmpty())
+        nodes_.erase(iter);
+}
@@ -0,0 +1,70 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+#include <vector>
+#include <utility>
+
+/// Bidirectional graph of the dependencies between assets.
+/** Asset refs are compared case-insensitively, as elsewhere in AssetAPI. The nodes are stored in a hash table by their normalized
+    ref, and each node knows both its dependencies and its dependents, so adding, removing and querying the dependencies of an asset
+    take time proportional to the number of its dependencies, instead of the number of dependencies of all assets. */
+class AssetDependencyGraph
+{
+public:
+    typedef std::vector<std::pair<QString, QString> > DependencyList;
+
+    AssetDependencyGraph() : numDependencies_(0) {}
+
+    /// Replaces all dependencies of an asset.
+    /** @param dependent Name of the asset.
+        @param dependees Refs of the assets it depends on. Empty refs are ignored. */
+    void SetDependencies(const QString &dependent, const QStringList &dependees);
+
+    /// Removes all dependencies of an asset.
+    void RemoveDependencies(const QString &dependent);
+
+    /// Returns the names of the assets that depend on the given asset.
+    QStringList Dependents(const QString &dependee) const;
+
+    /// Returns the refs of the assets the given asset depends on.
+    QStringList Dependencies(const QString &dependent) const;
+
+    /// Returns the given assets and all their known dependencies recursively, so that each asset comes after all of its dependencies.
+    /** Useful for prefetching. A cyclic dependency is broken at the asset that is encountered again. */
+    QStringList TopologicalOrder(const QStringList &assets) const;
+
+    /// Returns all dependencies as (dependent, dependee) pairs.
+    DependencyList Pairs() const;
+
+    /// Returns the number of dependencies.
+    size_t NumDependencies() const { return numDependencies_; }
+
+    /// Removes all dependencies.
+    void Clear();
+
+private:
+    struct Node
+    {
+        /// The ref as it was first given.
+        QString name;
+        /// Keys of the dependencies.
+        QSet<QString> dependencies;
+        /// Keys of the dependents.
+        QSet<QString> dependents;
+    };
+
+    /// Returns the normalized key of a ref.
+    static QString Key(const QString &ref) { return ref.toLower(); }
+
+    /// Removes a node which has no dependencies or dependents left.
+    void RemoveIfUnused(const QString &key);
+
+    QHash<QString, Node> nodes_;
+    size_t numDependencies_;
+};
@@ -35,5 +35,10 @@ typedef boost::shared_ptr<IAssetTypeFactory> AssetTypeFactoryPtr;
 class AssetRefListener;
 typedef boost::shared_ptr<AssetRefListener> AssetRefListenerPtr;
 
+class AssetRefTable;
+/// Interned asset ref. @see AssetRefTable.
+typedef unsigned int AssetRefId;
+const AssetRefId InvalidAssetRefId = 0;
+
 class Framework;
 
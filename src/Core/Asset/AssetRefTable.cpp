@@ -0,0 +1,45 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "DebugOperatorNew.h"
+#include "AssetRefTable.h"
+#include "MemoryLeakCheck.h"
+
+AssetRefId AssetRefTable::Intern(const QString &ref)
+{
+    AssetRefId id = Find(ref);
+    if (id != InvalidAssetRefId || ref.isEmpty())
+        return id;
+
+    refs_.push_back(ref);
+    id = (AssetRefId)refs_.size();
+    ids_.insert(Key(ref), id);
+    spellings_.insert(ref, id);
+    return id;
+}
+
+AssetRefId AssetRefTable::Find(const QString &ref) const
+{
+    QHash<QString, AssetRefId>::const_iterator iter = spellings_.find(ref);
+    if (iter != spellings_.end())
+        return iter.value();
+
+    AssetRefId id = ids_.value(Key(ref), InvalidAssetRefId);
+    // Remember the spelling of a known ref, so that the next lookup does not need to fold the case
+    if (id != InvalidAssetRefId)
+        spellings_.insert(ref, id);
+    return id;
+}
+
+QString AssetRefTable::Ref(AssetRefId id) const
+{
+    if (id == InvalidAssetRefId || id > refs_.size())
+        return QString();
+    return refs_[id - 1];
+}
+
+void AssetRefTable::Clear()
+{
+    ids_.clear();
+    spellings_.clear();
+    refs_.clear();
+}
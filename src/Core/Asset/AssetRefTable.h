@@ -0,0 +1,47 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "AssetFwd.h"
+
+#include <QString>
+#include <QHash>
+
+#include <vector>
+
+/// Interns asset refs to small integer ids.
+/** Asset refs are compared case-insensitively, as elsewhere in AssetAPI, so all spellings of a ref that differ only in case
+    get the same id. Each distinct ref gets an id the first time it is interned, and keeps it until the table is cleared, so
+    code that handles the same refs over and over can store and compare ids instead of strings. The spellings already seen
+    are remembered too, so looking up a known spelling costs one hash lookup without folding the case. Refs are interned
+    as-is, so they should be resolved with AssetAPI::ResolveAssetRef first. */
+class AssetRefTable
+{
+public:
+    /// Returns the id of a ref, adding it to the table if it is not there yet.
+    /** @return The id, or InvalidAssetRefId if the ref is empty. */
+    AssetRefId Intern(const QString &ref);
+
+    /// Returns the id of a ref, or InvalidAssetRefId if it has not been interned.
+    AssetRefId Find(const QString &ref) const;
+
+    /// Returns the ref of an id as it was first interned, or an empty string if the id is not known.
+    QString Ref(AssetRefId id) const;
+
+    /// Returns the number of interned refs.
+    size_t Size() const { return refs_.size(); }
+
+    /// Removes all refs. Any ids handed out before are invalidated.
+    void Clear();
+
+private:
+    /// Returns the normalized key of a ref.
+    static QString Key(const QString &ref) { return ref.toLower(); }
+
+    /// Ids by normalized key.
+    QHash<QString, AssetRefId> ids_;
+    /// Ids by the spellings that have been interned or found.
+    mutable QHash<QString, AssetRefId> spellings_;
+    /// The refs as they were first interned, indexed by id - 1.
+    std::vector<QString> refs_;
+};
@@ -43,6 +43,10 @@ namespace Asset
 
         void ConsoleDumpAssetTransfers();
 
+        /// Measures the asset dependency bookkeeping with a synthetic dependency graph, and compares the lookups to a linear scan.
+        /** @param params Number of assets (default 10000) and number of dependencies per asset (default 4). */
+        void BenchmarkAssetDependencies(const QStringList &params);
+
         /// Loads from all the registered local storages all assets that have the given suffix.
         /// Type can also be optionally specified
         /// \todo Will be replaced with AssetStorage's GetAllAssetsRefs / GetAllAssets functionality
@@ -329,11 +329,9 @@ SoundChannelPtr AudioAPI::PlaySoundBuffer(const SoundBuffer &buffer, SoundChanne
         impl->channels.insert(make_pair(newId, channel));
     }
 
-    AudioAssetPtr audioAsset = CreateAudioAssetFromSoundBuffer(buffer);
-
     channel->SetMasterGain(impl->soundMasterGain[type] * impl->masterGain);
     channel->SetPositional(false);
-    channel->AddBuffer(audioAsset);
+    channel->AddBuffer(buffer);
     
     return channel;
 }
@@ -350,12 +348,10 @@ SoundChannelPtr AudioAPI::PlaySoundBuffer3D(const SoundBuffer &buffer, SoundChan
         impl->channels.insert(make_pair(newId, channel));
     }
 
-    AudioAssetPtr audioAsset = CreateAudioAssetFromSoundBuffer(buffer);
-
     channel->SetMasterGain(impl->soundMasterGain[type] * impl->masterGain);
     channel->SetPositional(true);
     channel->SetPosition(position);
-    channel->AddBuffer(audioAsset);
+    channel->AddBuffer(buffer);
     
     return channel;
 }
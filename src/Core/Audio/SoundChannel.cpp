@@ -2,6 +2,7 @@
 
 #include "DebugOperatorNew.h"
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <QList>
 #include "MemoryLeakCheck.h"
 #include "SoundChannel.h"
@@ -42,6 +43,7 @@ SoundChannel::SoundChannel(sound_id_t channelId_, SoundType type) :
 SoundChannel::~SoundChannel()
 {
     DeleteSource();
+    DeleteStreamBuffers();
 }
 
 void SoundChannel::Update(const float3& listener_pos)
@@ -100,6 +102,92 @@ void SoundChannel::AddBuffer(AudioAssetPtr buffer)
     buffered_mode_ = true;
 }
 
+void SoundChannel::AddBuffer(const SoundBuffer &buffer)
+{
+    if (buffer.data.size() == 0)
+        return;
+    if (!CreateStreamBuffers())
+        return;
+
+    ALuint handle = 0;
+    if (free_stream_buffers_.size() > 0)
+    {
+        handle = free_stream_buffers_.back();
+        free_stream_buffers_.pop_back();
+    }
+    else if (pending_stream_buffers_.size() > 0)
+    {
+        // Whole pool in use: discard the oldest data not yet queued to keep the latency bounded
+        handle = pending_stream_buffers_.front();
+        pending_stream_buffers_.pop_front();
+    }
+    else
+        return; // All buffers queued to the source, drop this data
+
+    ALenum openALFormat;
+    if (buffer.stereo && buffer.is16Bit) openALFormat = AL_FORMAT_STEREO16;
+    else if (!buffer.stereo && buffer.is16Bit) openALFormat = AL_FORMAT_MONO16;
+    else if (buffer.stereo && !buffer.is16Bit) openALFormat = AL_FORMAT_STEREO8;
+    else /* (!buffer.stereo && !buffer.is16Bit)*/ openALFormat = AL_FORMAT_MONO8;
+
+    alGetError();
+    alBufferData(handle, openALFormat, &buffer.data[0], buffer.data.size(), buffer.frequency);
+    ALenum error = alGetError();
+    if (error != AL_NONE)
+    {
+        LogError("Could not set OpenAL sound buffer data: OpenAL error number " + QString::number(error));
+        free_stream_buffers_.push_back(handle);
+        return;
+    }
+    pending_stream_buffers_.push_back(handle);
+
+    // Buffered mode should not loop
+    SetLooped(false);
+    
+    // Start actual playback on next update
+    if (state_ == Stopped)
+        state_ = Pending;
+    buffered_mode_ = true;
+}
+
+bool SoundChannel::CreateStreamBuffers()
+{
+    if (stream_buffers_.size() > 0)
+        return true;
+
+    stream_buffers_.resize(STREAM_BUFFER_POOL_SIZE, 0);
+    alGetError();
+    alGenBuffers(STREAM_BUFFER_POOL_SIZE, &stream_buffers_[0]);
+    if (alGetError() != AL_NONE)
+    {
+        LogError("Could not create OpenAL sound buffers for channel " + QString::number(channelId));
+        stream_buffers_.clear();
+        return false;
+    }
+    free_stream_buffers_ = stream_buffers_;
+    return true;
+}
+
+void SoundChannel::DeleteStreamBuffers()
+{
+    if (stream_buffers_.size() > 0)
+        alDeleteBuffers(stream_buffers_.size(), &stream_buffers_[0]);
+    stream_buffers_.clear();
+    free_stream_buffers_.clear();
+    pending_stream_buffers_.clear();
+}
+
+void SoundChannel::ReleaseStreamBuffers()
+{
+    free_stream_buffers_ = stream_buffers_;
+    pending_stream_buffers_.clear();
+}
+
+bool SoundChannel::IsStreamBuffer(ALuint buffer) const
+{
+    return std::find(stream_buffers_.begin(), stream_buffers_.end(), buffer) != stream_buffers_.end();
+}
+
 bool SoundChannel::CreateSource()
 {
     if (!handle_)
@@ -144,6 +232,7 @@ void SoundChannel::Stop()
     
     pending_sounds_.clear();
     playing_sounds_.clear();
+    ReleaseStreamBuffers();
     
     state_ = Stopped;
 }
@@ -285,7 +374,7 @@ void SoundChannel::QueueBuffers()
     // See that we do have waiting sounds and they're ready to play
     AudioAssetPtr pending = pending_sounds_.size() > 0 ? pending_sounds_.front() : AudioAssetPtr();
 
-    if (!pending)
+    if (!pending && pending_stream_buffers_.empty())
         return;
     
     // Create source now if did not exist already
@@ -293,6 +382,7 @@ void SoundChannel::QueueBuffers()
     {
         state_ = Stopped;
         pending_sounds_.clear();
+        ReleaseStreamBuffers();
         return;
     }
     
@@ -310,28 +400,9 @@ void SoundChannel::QueueBuffers()
         ALuint buffer = sound->GetHandle();
         // If no valid handle yet, cannot play this one, break out
         if (!buffer)
-            return;
+            break;
         
-        alGetError();
-        alSourceQueueBuffers(handle_, 1, &buffer);
-        ALenum error = alGetError();
-        
-        if (error != AL_NONE)
-        {
-            // If queuing fails, we may have changed sound format. Stop, flush queue & retry
-            alSourceStop(handle_);
-            alSourcei(handle_, AL_BUFFER, 0);
-            alSourceQueueBuffers(handle_, 1, &buffer);
-            ALenum error = alGetError();
-            if (error != AL_NONE)
-                LogError("Could not queue OpenAL sound buffer: " + QString::number(error));
-            else
-            {
-                playing_sounds_.push_back(sound);
-                queued = true;
-            }
-        }
-        else
+        if (QueueBuffer(buffer))
         {
             playing_sounds_.push_back(sound);
             queued = true;
@@ -340,6 +411,17 @@ void SoundChannel::QueueBuffers()
         pending_sounds_.pop_front();
     }
     
+    // Queue filled buffers of the streaming pool. Failed ones go back to the free pool
+    while(pending_stream_buffers_.size() > 0)
+    {
+        ALuint buffer = pending_stream_buffers_.front();
+        pending_stream_buffers_.pop_front();
+        if (QueueBuffer(buffer))
+            queued = true;
+        else
+            free_stream_buffers_.push_back(buffer);
+    }
+    
     // If at least one sound queued, start playback if not already playing
     if (queued)
     {
@@ -351,6 +433,34 @@ void SoundChannel::QueueBuffers()
     }
 }
 
+bool SoundChannel::QueueBuffer(ALuint buffer)
+{
+    alGetError();
+    alSourceQueueBuffers(handle_, 1, &buffer);
+    ALenum error = alGetError();
+    if (error == AL_NONE)
+        return true;
+    
+    // If queuing fails, we may have changed sound format. Stop, flush queue & retry
+    alSourceStop(handle_);
+    alSourcei(handle_, AL_BUFFER, 0);
+    playing_sounds_.clear();
+    // The flush returned every queued streaming buffer
+    free_stream_buffers_.clear();
+    for(uint i = 0; i < stream_buffers_.size(); ++i)
+        if (stream_buffers_[i] != buffer && std::find(pending_stream_buffers_.begin(), pending_stream_buffers_.end(), stream_buffers_[i]) == pending_stream_buffers_.end())
+            free_stream_buffers_.push_back(stream_buffers_[i]);
+    
+    alSourceQueueBuffers(handle_, 1, &buffer);
+    error = alGetError();
+    if (error != AL_NONE)
+    {
+        LogError("Could not queue OpenAL sound buffer: " + QString::number(error));
+        return false;
+    }
+    return true;
+}
+
 void SoundChannel::UnqueueBuffers()
 {
     if (handle_)
@@ -363,6 +473,12 @@ void SoundChannel::UnqueueBuffers()
             alSourceUnqueueBuffers(handle_, 1, &buffer);
             if (buffer)
             {
+                // Streaming buffers are recycled to the pool
+                if (IsStreamBuffer(buffer))
+                {
+                    free_stream_buffers_.push_back(buffer);
+                    continue;
+                }
                 // See if we find matching buffer from the sounds vector.
                 // If found, erase so that the sound may be freed if not used elsewhere
                 for(uint i = 0; i < playing_sounds_.size(); ++i)
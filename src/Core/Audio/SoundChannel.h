@@ -44,7 +44,12 @@ public:
         more sound data for the moment. This is to ensure that the sound system will not automatically
         dispose of the channel. */ 
     void AddBuffer(AudioAssetPtr buffer);
-//    void AddBuffer(const SoundBuffer &buffer);
+
+    /// Add raw sound data and play.
+    /** The data is copied to an OpenAL buffer taken from a pool of buffers preallocated for this channel,
+        and the buffer is returned to the pool when it has been played. If the whole pool is queued, the
+        oldest not yet played data is discarded. Otherwise behaves like AddBuffer(AudioAssetPtr). */
+    void AddBuffer(const SoundBuffer &buffer);
     
     /// Adjusts positional status of channel
     /** @param id Channel id
@@ -98,6 +103,8 @@ public:
 private:
     /// Queue buffers and start playing
     void QueueBuffers();
+    /// Queue one buffer to the source. If queuing fails, flushes the source queue and retries. Returns true if queued.
+    bool QueueBuffer(ALuint buffer);
     /// Remove processed buffers
     void UnqueueBuffers();
     /// Create OpenAL source if one does not exist yet
@@ -110,6 +117,17 @@ private:
     void SetPositionAndMode();
     /// Set gain, taking attenuation into account
     void SetAttenuatedGain();
+    /// Allocate the streaming buffer pool if not allocated yet
+    bool CreateStreamBuffers();
+    /// Delete the streaming buffer pool
+    void DeleteStreamBuffers();
+    /// Return all streaming buffers to the free pool. Source must not have them queued anymore.
+    void ReleaseStreamBuffers();
+    /// Returns true if buffer belongs to the streaming buffer pool
+    bool IsStreamBuffer(ALuint buffer) const;
+
+    /// Number of OpenAL buffers preallocated for raw sound data per channel
+    static const uint STREAM_BUFFER_POOL_SIZE = 32;
     
     /// Sound type
     SoundType type_;
@@ -119,6 +137,12 @@ private:
     std::list<AudioAssetPtr> pending_sounds_;
     /// Currently playing sound buffers
     std::vector<AudioAssetPtr> playing_sounds_;
+    /// All OpenAL buffers of the streaming buffer pool
+    std::vector<ALuint> stream_buffers_;
+    /// Streaming buffers not in use
+    std::vector<ALuint> free_stream_buffers_;
+    /// Filled streaming buffers pending to be queued to the source
+    std::list<ALuint> pending_stream_buffers_;
     /// Pitch
     float pitch_;
     /// Gain
@@ -640,6 +640,9 @@ void ECBrowser::DynamicComponentChanged()
         LogError("EC_Browser::DynamicComponentChanged: Failed to dynamic cast sender object to EC_DynamicComponent.");
         return;
     }
+    // A committed batch is refreshed once on BatchCommitted
+    if (component->IsCommittingBatch())
+        return;
     ComponentPtr comp_ptr;
     try
     {
@@ -769,6 +772,7 @@ void ECBrowser::AddNewComponentToGroup(ComponentPtr comp)
             EC_DynamicComponent *dc = dynamic_cast<EC_DynamicComponent*>(comp.get());
             connect(dc, SIGNAL(AttributeAdded(IAttribute *)), SLOT(DynamicComponentChanged()), Qt::UniqueConnection);
             connect(dc, SIGNAL(AttributeAboutToBeRemoved(IAttribute *)), SLOT(DynamicComponentChanged()), Qt::UniqueConnection);
+            connect(dc, SIGNAL(BatchCommitted()), SLOT(DynamicComponentChanged()), Qt::UniqueConnection);
             connect(dc, SIGNAL(ComponentNameChanged(const QString&, const QString&)),
                     SLOT(OnComponentNameChanged(const QString&)), Qt::UniqueConnection);
         }
@@ -816,6 +820,7 @@ void ECBrowser::AddNewComponentToGroup(ComponentPtr comp)
         EC_DynamicComponent *dc = dynamic_cast<EC_DynamicComponent*>(comp.get());
         connect(dc, SIGNAL(AttributeAdded(IAttribute *)), SLOT(DynamicComponentChanged()), Qt::UniqueConnection);
         connect(dc, SIGNAL(AttributeAboutToBeRemoved(IAttribute *)), SLOT(DynamicComponentChanged()), Qt::UniqueConnection);
+        connect(dc, SIGNAL(BatchCommitted()), SLOT(DynamicComponentChanged()), Qt::UniqueConnection);
         connect(dc, SIGNAL(ComponentNameChanged(const QString &, const QString &)), SLOT(OnComponentNameChanged(const QString&)), Qt::UniqueConnection);
     }
 
@@ -848,6 +853,7 @@ void ECBrowser::RemoveComponentFromGroup(ComponentPtr comp)
                 assert(dc);
                 disconnect(dc, SIGNAL(AttributeAdded(IAttribute *)), this, SLOT(DynamicComponentChanged()));
                 disconnect(dc, SIGNAL(AttributeAboutToBeRemoved(IAttribute *)), this, SLOT(DynamicComponentChanged()));
+                disconnect(dc, SIGNAL(BatchCommitted()), this, SLOT(DynamicComponentChanged()));
                 disconnect(dc, SIGNAL(ComponentNameChanged(const QString&, const QString &)), this, SLOT(OnComponentNameChanged(const QString&)));
             }
             comp_group->RemoveComponent(comp);
@@ -4,8 +4,8 @@
  *  @file   SceneStructureWindow.h
  *  @brief  Window with tree view showing every entity in a scene.
  *
- *          This class will only handle adding and removing of entities and components and updating
- *          their names. The SceneTreeWidget implements most of the functionality.
+ *          This class will only handle the search, sort and visibility settings. The SceneTreeModel keeps
+ *          the tree up to date with the scene and the SceneTreeWidget implements most of the functionality.
  */
 
 #pragma once
@@ -16,15 +16,19 @@
 #include <QWidget>
 #include <QLineEdit>
 #include <QPushButton>
-#include <QMap>
+#include <QSet>
+#include <QModelIndex>
 
-class QTreeWidgetItem;
 class SceneTreeWidget;
 class Framework;
 
 /// Window with tree view showing every entity in a scene.
-/** This class will only handle adding and removing of entities and components and updating
-    their names. The SceneTreeWidget implements most of the functionality.
+/** This class will only handle the search, sort and visibility settings. The SceneTreeModel keeps the tree up to date
+    with the scene and the SceneTreeWidget implements most of the functionality.
+
+    Only the items of the entities that are shown are created, and the component and asset reference items of an entity
+    when its item is expanded. Changes to the scene are collected during the frame and applied to the tree once per frame,
+    and searching and sorting is done in a worker thread.
 */
 class SceneStructureWindow : public QWidget
 {
@@ -66,24 +70,6 @@ protected:
     void changeEvent(QEvent* e);
 
 private:
-    /// Populates tree widget with all entities.
-    void Populate();
-
-    /// Clears tree widget.
-    void Clear();
-
-    /// Creates asset reference items.
-    void CreateAssetReferences();
-
-    /// Clears i.e. deletes all asset reference items.
-    void ClearAssetReferences();
-
-    /// Create asset reference item to the tree widget.
-    /** @param parentItem Parent item, can be entity or component item.
-        @param attr AssetReference attribute.
-    */
-    void CreateAssetItem(QTreeWidgetItem *parentItem, IAttribute *attr);
-
     Framework *framework; ///< Framework.
     SceneWeakPtr scene; ///< Scene which we are showing the in tree widget currently.
     SceneTreeWidget *treeWidget; ///< Scene tree widget.
@@ -91,65 +77,9 @@ private:
     bool showAssets; ///< Do we show asset references also in the tree view.
     QLineEdit *searchField; ///< Search field line edit.
     QPushButton *expandAndCollapseButton; ///< Expand/collapse all button.
+    QSet<entity_id_t> expandedEntities; ///< Entities whose items have been expanded.
 
 private slots:
-    /// Adds the entity to the tree widget.
-    /** @param entity Entity to be added.
-    */
-    void AddEntity(Entity *entity);
-
-    /// Removes entity from the tree widget.
-    /** @param entity Entity to be removed.
-    */
-    void RemoveEntity(Entity *entity);
-
-    /// Readds entity on server ack.
-    /** @param entity Entity to be readded.
-        @param oldId Old entity id
-    */
-    void AckEntity(Entity *entity, entity_id_t oldId);
-    
-    /// Adds the entity to the tree widget.
-    /** @param entity Altered entity.
-        @param comp Component which was added.
-    */
-    void AddComponent(Entity *entity, IComponent *comp);
-
-    /// Removes entity from the tree widget.
-    /** @param entity Altered entity.
-        @param comp Component which was removed.
-    */
-    void RemoveComponent(Entity *entity, IComponent *comp);
-
-    /// This is an overloaded function.
-    /** This is called only by EC_DynamicComponent when asset ref attribute is added to it.
-        @param attr AssetReference attribute.
-    */
-    void AddAssetReference(IAttribute *attr);
-
-    /// Removes asset reference from the tree widget.
-    /** This is called only by EC_DynamicComponent when asset ref attribute is removed from it.
-        @param attr AssetReference attribute.
-    */
-    void RemoveAssetReference(IAttribute *attr);
-
-    /// When asset reference attribute changes, update UI accordingly.
-    /** @param attr AssetReference attribute.
-    */
-    void UpdateAssetReference(IAttribute *attr);
-
-    /// Updates entity's name in the tree widget if entity's EC_Name component's "name" attribute has changed.
-    /** EC_Name component's AttributeChanged() signal is connected to this slot.
-        @param attr EC_Name's attribute which was changed.
-    */
-    void UpdateEntityName(IAttribute *attr);
-
-    /// Updates component's name in the tree widget if components name has changed.
-    /** @param oldName Old component name.
-        @param newName New component name.
-    */
-    void UpdateComponentName(const QString &oldName, const QString &newName);
-
     /// Sort items in the tree widget. The outstanding sort order is used.
     /** @param criteria Sorting criteria. Currently tr("ID") and tr("Name") are supported.
     */
@@ -161,13 +91,15 @@ private slots:
     */
     void Search(const QString &filter);
 
+    /// Expands the items with matching child items when the search has finished, if the filter is at least 3 characters.
+    void ExpandMatches();
+
+    /// Creates the child items of an item when it is expanded for the first time.
+    void PopulateItem(const QModelIndex &index);
+
     /// Expands or collapses the whole tree view, depending on the previous action.
     void ExpandOrCollapseAll();
 
     /// Checks the expand status to mark it to the expand/collapse button
-    void CheckTreeExpandStatus(QTreeWidgetItem *item);
-    
-    /// Removes entity from the tree widget by ID
-    void RemoveEntityById(entity_id_t id);
+    void CheckTreeExpandStatus(const QModelIndex &index);
 };
-
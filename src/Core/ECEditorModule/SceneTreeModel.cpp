@@ -0,0 +1,767 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   SceneTreeModel.cpp
+ *  @brief  Item model over the entities of a scene, used by SceneTreeWidget.
+ */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneTreeModel.h"
+#include "SceneTreeWidgetItems.h"
+
+#include "Profiler.h"
+#include "Scene.h"
+#include "Entity.h"
+#include "EC_Name.h"
+#include "AssetReference.h"
+#include "EC_DynamicComponent.h"
+#include "LoggingFunctions.h"
+
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+    /// Returns the attribute names and references of the asset reference items of a component.
+    QList<QPair<QString, QString> > AssetRefs(IComponent *comp)
+    {
+        QList<QPair<QString, QString> > refs;
+        foreach(IAttribute *attr, comp->Attributes())
+        {
+            if (!attr)
+                continue;
+
+            if (attr->TypeName() == "assetreference")
+            {
+                Attribute<AssetReference> *assetRef = dynamic_cast<Attribute<AssetReference> *>(attr);
+                if (assetRef)
+                    refs << qMakePair(attr->Name(), assetRef->Get().ref);
+            }
+            else if (attr->TypeName() == "assetreferencelist")
+            {
+                Attribute<AssetReferenceList> *assetRefs = dynamic_cast<Attribute<AssetReferenceList> *>(attr);
+                if (assetRefs)
+                    for(int i = 0; i < assetRefs->Get().Size(); ++i)
+                        refs << qMakePair(attr->Name(), assetRefs->Get()[i].ref);
+            }
+        }
+        return refs;
+    }
+
+    /// Returns whether any of the texts contains the filter.
+    bool AnyMatches(const QStringList &texts, const QString &filter)
+    {
+        foreach(const QString &text, texts)
+            if (text.contains(filter, Qt::CaseInsensitive))
+                return true;
+        return false;
+    }
+
+    /// Compares an entity to the search filter. Returns whether the entity is shown.
+    /** @param childMatch Set to whether any of the child items that would be shown matches the filter. */
+    bool IsShown(const SceneTreeEntry &entry, const SceneTreeOptions &options, bool *childMatch)
+    {
+        *childMatch = false;
+        if (options.filter.isEmpty())
+            return true;
+
+        *childMatch = (options.showComponents && AnyMatches(entry.componentTexts, options.filter)) ||
+            (options.showAssets && AnyMatches(entry.assetTexts, options.filter));
+        bool matched = *childMatch || entry.text.contains(options.filter, Qt::CaseInsensitive);
+        return options.negation ? !matched : matched;
+    }
+
+    /// Orders the shown entities. The same order is used when sorting all entities in the worker thread and when
+    /// inserting single entities or looking up their rows in the main thread. Both entities need to have entries.
+    struct RowLess
+    {
+        RowLess(const SceneTreeIndex &index_, const SceneTreeOptions &options_) : index(index_), options(options_) {}
+
+        bool operator()(entity_id_t lhs, entity_id_t rhs) const
+        {
+            if (options.order == Qt::DescendingOrder)
+                std::swap(lhs, rhs);
+            if (options.sortByName)
+            {
+                const QString &lhsName = index.constFind(lhs)->sortName;
+                const QString &rhsName = index.constFind(rhs)->sortName;
+                if (lhsName != rhsName)
+                    return lhsName < rhsName;
+            }
+            return lhs < rhs;
+        }
+
+        const SceneTreeIndex &index;
+        const SceneTreeOptions &options;
+    };
+
+    /// Filters and sorts the entities. Run in a worker thread.
+    SceneTreeRows ArrangeRows(const SceneTreeIndex &index, const SceneTreeOptions &options)
+    {
+        SceneTreeRows result;
+        result.options = options;
+        result.rows.reserve(index.size());
+        for(SceneTreeIndex::const_iterator i = index.constBegin(); i != index.constEnd(); ++i)
+        {
+            bool childMatch;
+            if (IsShown(i.value(), options, &childMatch))
+            {
+                result.rows.push_back(i.key());
+                if (childMatch && !options.negation)
+                    result.childMatches.insert(i.key());
+            }
+        }
+        std::sort(result.rows.begin(), result.rows.end(), RowLess(index, result.options));
+        return result;
+    }
+}
+
+SceneTreeModel::SceneTreeModel(QObject *parent) :
+    QAbstractItemModel(parent),
+    arrangeWatcher(0),
+    arranging(false),
+    arrangePending(false)
+{
+    arrangeWatcher = new QFutureWatcher<SceneTreeRows>(this);
+    connect(arrangeWatcher, SIGNAL(finished()), SLOT(ArrangeFinished()));
+}
+
+SceneTreeModel::~SceneTreeModel()
+{
+    arrangeWatcher->waitForFinished();
+    qDeleteAll(items);
+}
+
+void SceneTreeModel::SetScene(const ScenePtr &s)
+{
+    if (s && s == scene.lock())
+        return;
+
+    if (!scene.expired())
+        disconnect(scene.lock().get(), 0, this, 0);
+
+    beginResetModel();
+    Clear();
+    scene = s;
+    if (s)
+    {
+        Scene *scenePtr = s.get();
+        connect(scenePtr, SIGNAL(EntityAcked(Entity *, entity_id_t)), SLOT(AckEntity(Entity *, entity_id_t)));
+        connect(scenePtr, SIGNAL(EntityCreated(Entity *, AttributeChange::Type)), SLOT(AddEntity(Entity *)));
+        connect(scenePtr, SIGNAL(EntityRemoved(Entity *, AttributeChange::Type)), SLOT(RemoveEntity(Entity *)));
+        connect(scenePtr, SIGNAL(ComponentAdded(Entity *, IComponent *, AttributeChange::Type)), SLOT(UpdateComponents(Entity *)));
+        connect(scenePtr, SIGNAL(ComponentRemoved(Entity *, IComponent *, AttributeChange::Type)), SLOT(UpdateComponents(Entity *)));
+
+        // The entries are gathered once here, after which only the entries of the changed entities are updated.
+        for(Scene::iterator it = s->begin(); it != s->end(); ++it)
+            entries.insert(it->first, CreateEntry(it->second.get()));
+    }
+    endResetModel();
+
+    StartArrange();
+}
+
+void SceneTreeModel::SetFilter(const QString &filter)
+{
+    QString f = filter.trimmed();
+    requestedOptions.negation = !f.isEmpty() && f[0] == '!';
+    if (requestedOptions.negation)
+        f = f.mid(1);
+    requestedOptions.filter = f;
+    StartArrange();
+}
+
+void SceneTreeModel::SetSortByName(bool sortByName)
+{
+    requestedOptions.sortByName = sortByName;
+    StartArrange();
+}
+
+void SceneTreeModel::SetShowComponents(bool show)
+{
+    requestedOptions.showComponents = show;
+    StartArrange();
+}
+
+void SceneTreeModel::SetShowAssetReferences(bool show)
+{
+    requestedOptions.showAssets = show;
+    StartArrange();
+}
+
+QModelIndex SceneTreeModel::IndexOf(entity_id_t id) const
+{
+    int row = RowOf(id);
+    return row >= 0 ? index(row, 0) : QModelIndex();
+}
+
+SceneTreeItem *SceneTreeModel::Item(const QModelIndex &index)
+{
+    return index.isValid() ? static_cast<SceneTreeItem *>(index.internalPointer()) : 0;
+}
+
+QModelIndex SceneTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent))
+        return QModelIndex();
+
+    if (!parent.isValid())
+        return createIndex(row, column, EntityItemAt(row));
+    else
+        return createIndex(row, column, Item(parent)->children[row]);
+}
+
+QModelIndex SceneTreeModel::parent(const QModelIndex &child) const
+{
+    SceneTreeItem *item = Item(child);
+    if (!item || !item->parent)
+        return QModelIndex();
+
+    SceneTreeItem *parentItem = item->parent;
+    if (!parentItem->parent)
+    {
+        int row = RowOf(static_cast<EntityItem *>(parentItem)->Id());
+        return row >= 0 ? createIndex(row, 0, parentItem) : QModelIndex();
+    }
+    else
+        return createIndex(parentItem->parent->children.indexOf(parentItem), 0, parentItem);
+}
+
+int SceneTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return 0;
+    if (!parent.isValid())
+        return rows.size();
+    return Item(parent)->children.size();
+}
+
+int SceneTreeModel::columnCount(const QModelIndex & /*parent*/) const
+{
+    return 1;
+}
+
+bool SceneTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+    if (!parent.isValid())
+        return !rows.isEmpty();
+
+    SceneTreeItem *item = Item(parent);
+    if (item->parent || static_cast<EntityItem *>(item)->populated)
+        return !item->children.isEmpty();
+
+    // The child items of the entity have not been created yet. When searching, only the matching ones are created.
+    entity_id_t id = static_cast<EntityItem *>(item)->Id();
+    if (!options.filter.isEmpty() && !options.negation)
+        return childMatches.contains(id);
+    SceneTreeIndex::const_iterator entry = entries.constFind(id);
+    return entry != entries.constEnd() && ((options.showComponents && !entry->componentTexts.isEmpty()) ||
+        (options.showAssets && !entry->assetTexts.isEmpty()));
+}
+
+bool SceneTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    SceneTreeItem *item = Item(parent);
+    return item && parent.column() == 0 && !item->parent && !static_cast<EntityItem *>(item)->populated;
+}
+
+void SceneTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (canFetchMore(parent))
+        PopulateEntityItem(static_cast<EntityItem *>(Item(parent)), true);
+}
+
+QVariant SceneTreeModel::data(const QModelIndex &index, int role) const
+{
+    SceneTreeItem *item = Item(index);
+    if (!item)
+        return QVariant();
+
+    if (!item->parent)
+    {
+        SceneTreeIndex::const_iterator entry = entries.constFind(static_cast<EntityItem *>(item)->Id());
+        if (entry == entries.constEnd())
+            return QVariant();
+
+        switch(role)
+        {
+        case Qt::DisplayRole:
+            return entry->text;
+        case Qt::EditRole:
+            // The entity ID and other information is not shown when user is editing entity's name.
+            return entry->name;
+        case Qt::ForegroundRole:
+            return QBrush(entry->textColor);
+        default:
+            return QVariant();
+        }
+    }
+
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        return item->text;
+    case Qt::ForegroundRole:
+        return QBrush(item->textColor);
+    default:
+        return QVariant();
+    }
+}
+
+bool SceneTreeModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    SceneTreeItem *item = Item(index);
+    if (!item || item->parent || role != Qt::EditRole)
+        return false;
+
+    EntityPtr entity = static_cast<EntityItem *>(item)->Entity();
+    if (!entity)
+        return false;
+
+    // We don't need to update the entry here. It's done when the name change is processed at the end of the frame.
+    entity->SetName(value.toString());
+    return true;
+}
+
+Qt::ItemFlags SceneTreeModel::flags(const QModelIndex &index) const
+{
+    SceneTreeItem *item = Item(index);
+    if (!item)
+        return 0;
+    if (!item->parent)
+        return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+QVariant SceneTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (section == 0 && orientation == Qt::Horizontal && role == Qt::DisplayRole)
+        return tr("Scene entities");
+    return QVariant();
+}
+
+void SceneTreeModel::sort(int /*column*/, Qt::SortOrder order)
+{
+    requestedOptions.order = order;
+    StartArrange();
+}
+
+void SceneTreeModel::MarkDirty(entity_id_t id)
+{
+    dirtyEntities.insert(id);
+}
+
+void SceneTreeModel::ProcessPendingChanges()
+{
+    if (dirtyEntities.isEmpty())
+        return;
+
+    PROFILE(SceneTreeModel_ProcessPendingChanges);
+
+    ScenePtr s = scene.lock();
+    if (!s)
+    {
+        dirtyEntities.clear();
+        return;
+    }
+
+    // Only the changed entities are compared to the filter and moved to their sorted positions, the other rows stay as they are.
+    QSet<entity_id_t> dirty = dirtyEntities;
+    dirtyEntities.clear();
+    foreach(entity_id_t id, dirty)
+    {
+        EntityPtr entity = s->GetEntity(id);
+        EntityItem *item = items.value(id);
+        // The row is looked up with the old entry, so the entry is replaced only after the row has been removed.
+        int row = RowOf(id);
+
+        SceneTreeEntry entry;
+        bool childMatch = false;
+        bool shown = false;
+        if (entity)
+        {
+            entry = CreateEntry(entity.get());
+            shown = IsShown(entry, options, &childMatch);
+        }
+
+        // A new entity with the ID of a removed one gets a new item, and a renamed entity moves when sorting by name.
+        bool moved = row >= 0 && ((item && item->Entity() != entity) ||
+            (options.sortByName && entries.constFind(id)->sortName != entry.sortName));
+        if (row >= 0 && (!shown || moved))
+        {
+            beginRemoveRows(QModelIndex(), row, row);
+            rows.remove(row);
+            endRemoveRows();
+            row = -1;
+        }
+        if (row < 0)
+        {
+            // Items are kept only for the shown entities
+            delete items.take(id);
+            item = 0;
+        }
+
+        if (entity)
+            entries.insert(id, entry);
+        else
+            entries.remove(id);
+        if (childMatch && !options.negation)
+            childMatches.insert(id);
+        else
+            childMatches.remove(id);
+        if (arranging)
+            changedDuringArrange.insert(id);
+
+        if (shown && row < 0)
+        {
+            row = InsertionRow(id);
+            beginInsertRows(QModelIndex(), row, row);
+            rows.insert(row, id);
+            endInsertRows();
+        }
+        else if (item)
+        {
+            // The view has the item of the changed entity, so its text and child items need to be updated.
+            if (item->populated)
+            {
+                ClearEntityItem(item, true);
+                PopulateEntityItem(item, true);
+            }
+            QModelIndex index = createIndex(row, 0, item);
+            emit dataChanged(index, index);
+        }
+    }
+}
+
+void SceneTreeModel::ArrangeFinished()
+{
+    arranging = false;
+    if (arrangePending)
+    {
+        StartArrange();
+        return;
+    }
+
+    PROFILE(SceneTreeModel_ArrangeFinished);
+
+    SceneTreeRows result = arrangeWatcher->result();
+
+    // The entities that changed while arranging are placed again with their current entries.
+    if (!changedDuringArrange.isEmpty())
+    {
+        QVector<entity_id_t> unchangedRows;
+        unchangedRows.reserve(result.rows.size());
+        foreach(entity_id_t id, result.rows)
+            if (!changedDuringArrange.contains(id))
+                unchangedRows.push_back(id);
+        result.rows = unchangedRows;
+
+        RowLess less(entries, result.options);
+        foreach(entity_id_t id, changedDuringArrange)
+        {
+            result.childMatches.remove(id);
+            SceneTreeIndex::const_iterator entry = entries.constFind(id);
+            bool childMatch;
+            if (entry != entries.constEnd() && IsShown(entry.value(), result.options, &childMatch))
+            {
+                result.rows.insert(std::lower_bound(result.rows.begin(), result.rows.end(), id, less), id);
+                if (childMatch && !result.options.negation)
+                    result.childMatches.insert(id);
+            }
+        }
+        changedDuringArrange.clear();
+    }
+
+    // The child items need to be recreated if they are filtered differently.
+    bool childrenChanged = result.options.filter != options.filter || result.options.negation != options.negation ||
+        result.options.showComponents != options.showComponents || result.options.showAssets != options.showAssets;
+
+    emit layoutAboutToBeChanged();
+
+    rows = result.rows;
+    childMatches = result.childMatches;
+    options = result.options;
+
+    // Selected and expanded entities keep their items. The child items keep theirs only if they are not recreated.
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    foreach(const QModelIndex &index, from)
+    {
+        SceneTreeItem *item = Item(index);
+        SceneTreeItem *entityItem = item;
+        while(entityItem->parent)
+            entityItem = entityItem->parent;
+        int row = RowOf(static_cast<EntityItem *>(entityItem)->Id());
+
+        if (row < 0 || (item != entityItem && childrenChanged))
+            to << QModelIndex();
+        else if (item == entityItem)
+            to << createIndex(row, index.column(), item);
+        else
+            to << createIndex(index.row(), index.column(), item);
+    }
+    changePersistentIndexList(from, to);
+
+    for(QHash<entity_id_t, EntityItem *>::iterator i = items.begin(); i != items.end();)
+    {
+        if (RowOf(i.key()) < 0)
+        {
+            delete i.value();
+            i = items.erase(i);
+            continue;
+        }
+        if (childrenChanged && i.value()->populated)
+        {
+            ClearEntityItem(i.value(), false);
+            PopulateEntityItem(i.value(), false);
+        }
+        ++i;
+    }
+
+    emit layoutChanged();
+    emit Arranged();
+}
+
+EntityItem *SceneTreeModel::EntityItemAt(int row) const
+{
+    entity_id_t id = rows[row];
+    EntityItem *&item = items[id];
+    if (!item)
+        item = new EntityItem(entries.constFind(id)->entity, id);
+    return item;
+}
+
+int SceneTreeModel::RowOf(entity_id_t id) const
+{
+    if (!entries.contains(id))
+        return -1;
+    QVector<entity_id_t>::const_iterator i = std::lower_bound(rows.constBegin(), rows.constEnd(), id, RowLess(entries, options));
+    return (i != rows.constEnd() && *i == id) ? i - rows.constBegin() : -1;
+}
+
+int SceneTreeModel::InsertionRow(entity_id_t id) const
+{
+    return std::lower_bound(rows.constBegin(), rows.constEnd(), id, RowLess(entries, options)) - rows.constBegin();
+}
+
+SceneTreeEntry SceneTreeModel::CreateEntry(Entity *entity)
+{
+    SceneTreeEntry entry;
+    entry.id = entity->Id();
+    entry.entity = entity->shared_from_this();
+    entry.name = entity->Name();
+    entry.sortName = entry.name.toLower();
+    entry.text = EntityItem::Text(entity);
+    entry.textColor = EntityItem::TextColor(entity);
+
+    const Entity::ComponentMap &components = entity->Components();
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+    {
+        IComponent *comp = i->second.get();
+        // Name changes and dynamic asset references need to be tracked also when the child items do not exist.
+        ConnectToComponent(comp);
+
+        entry.componentTexts << ComponentItem::Text(comp);
+        QList<QPair<QString, QString> > refs = AssetRefs(comp);
+        for(int j = 0; j < refs.size(); ++j)
+            entry.assetTexts << QString("%1: %2").arg(refs[j].first).arg(refs[j].second);
+    }
+    return entry;
+}
+
+QList<SceneTreeItem *> SceneTreeModel::CreateChildItems(EntityItem *item) const
+{
+    QList<SceneTreeItem *> children;
+    EntityPtr entity = item->Entity();
+    if (!entity)
+        return children;
+
+    // When searching, only the matching items and the component items with matching asset reference items are created.
+    const QString &filter = options.filter;
+    const bool filtering = !filter.isEmpty() && !options.negation;
+
+    const Entity::ComponentMap &components = entity->Components();
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+    {
+        // Asset reference items are children of the component items, or of the entity item if components are not shown.
+        ComponentItem *cItem = 0;
+        if (options.showComponents)
+            cItem = new ComponentItem(i->second, item);
+
+        QList<SceneTreeItem *> assetItems;
+        if (options.showAssets)
+        {
+            QList<QPair<QString, QString> > refs = AssetRefs(i->second.get());
+            for(int j = 0; j < refs.size(); ++j)
+            {
+                AssetRefItem *aItem = new AssetRefItem(refs[j].first, refs[j].second, cItem ? static_cast<SceneTreeItem *>(cItem) : item);
+                if (filtering && !aItem->text.contains(filter, Qt::CaseInsensitive))
+                    delete aItem;
+                else
+                    assetItems << aItem;
+            }
+        }
+
+        if (!cItem)
+            children << assetItems;
+        else if (filtering && assetItems.isEmpty() && !cItem->text.contains(filter, Qt::CaseInsensitive))
+            delete cItem;
+        else
+        {
+            cItem->children = assetItems;
+            children << cItem;
+        }
+    }
+    return children;
+}
+
+void SceneTreeModel::PopulateEntityItem(EntityItem *item, bool notify)
+{
+    QList<SceneTreeItem *> children = CreateChildItems(item);
+    item->populated = true;
+    if (children.isEmpty())
+        return;
+
+    int row = notify ? RowOf(item->Id()) : -1;
+    if (row >= 0)
+        beginInsertRows(createIndex(row, 0, item), 0, children.size() - 1);
+    item->children = children;
+    if (row >= 0)
+        endInsertRows();
+}
+
+void SceneTreeModel::ClearEntityItem(EntityItem *item, bool notify)
+{
+    item->populated = false;
+    if (item->children.isEmpty())
+        return;
+
+    int row = notify ? RowOf(item->Id()) : -1;
+    if (row >= 0)
+        beginRemoveRows(createIndex(row, 0, item), 0, item->children.size() - 1);
+    QList<SceneTreeItem *> children = item->children;
+    item->children.clear();
+    if (row >= 0)
+        endRemoveRows();
+    qDeleteAll(children);
+}
+
+void SceneTreeModel::ConnectToComponent(IComponent *comp)
+{
+    connect(comp, SIGNAL(ComponentNameChanged(const QString &, const QString &)), SLOT(UpdateComponentName()), Qt::UniqueConnection);
+
+    // If name component exists, hook up change signal so that the items keep synch with the name.
+    if (comp->TypeName() == EC_Name::TypeNameStatic())
+        connect(comp, SIGNAL(AttributeChanged(IAttribute *, AttributeChange::Type)),
+            SLOT(UpdateEntityName(IAttribute *)), Qt::UniqueConnection);
+
+    // If dynamic component exists, hook up its change signals in case AssetReference attribute is added/removed to it.
+    if (comp->TypeName() == EC_DynamicComponent::TypeNameStatic())
+    {
+        connect(comp, SIGNAL(AttributeAdded(IAttribute *)), SLOT(UpdateDynamicAttribute(IAttribute *)), Qt::UniqueConnection);
+        connect(comp, SIGNAL(AttributeAboutToBeRemoved(IAttribute *)), SLOT(UpdateDynamicAttribute(IAttribute *)), Qt::UniqueConnection);
+        connect(comp, SIGNAL(BatchCommitted()), SLOT(UpdateDynamicComponent()), Qt::UniqueConnection);
+        connect(comp, SIGNAL(AttributeChanged(IAttribute *, AttributeChange::Type)),
+            SLOT(UpdateAssetReference(IAttribute *)), Qt::UniqueConnection);
+    }
+}
+
+void SceneTreeModel::StartArrange()
+{
+    // Only one arrange runs at a time. If the options change meanwhile, arrange again when it finishes.
+    if (arranging)
+    {
+        arrangePending = true;
+        return;
+    }
+
+    arranging = true;
+    arrangePending = false;
+    changedDuringArrange.clear();
+    // The index is implicitly shared, so the worker thread gets a snapshot that the changes made meanwhile do not affect.
+    arrangeWatcher->setFuture(QtConcurrent::run(&ArrangeRows, entries, requestedOptions));
+}
+
+void SceneTreeModel::Clear()
+{
+    qDeleteAll(items);
+    items.clear();
+    entries.clear();
+    rows.clear();
+    childMatches.clear();
+    dirtyEntities.clear();
+    changedDuringArrange.clear();
+    // The result of an ongoing arrange would refer to the cleared entries.
+    if (arranging)
+        arrangePending = true;
+}
+
+void SceneTreeModel::AddEntity(Entity *entity)
+{
+    MarkDirty(entity->Id());
+}
+
+void SceneTreeModel::RemoveEntity(Entity *entity)
+{
+    MarkDirty(entity->Id());
+}
+
+void SceneTreeModel::AckEntity(Entity *entity, entity_id_t oldId)
+{
+    MarkDirty(oldId);
+    MarkDirty(entity->Id());
+}
+
+void SceneTreeModel::UpdateComponents(Entity *entity)
+{
+    MarkDirty(entity->Id());
+}
+
+void SceneTreeModel::UpdateDynamicAttribute(IAttribute *attr)
+{
+    if (!dynamic_cast<Attribute<AssetReference> *>(attr) && !dynamic_cast<Attribute<AssetReferenceList> *>(attr))
+        return;
+
+    EC_DynamicComponent *dc = dynamic_cast<EC_DynamicComponent *>(sender());
+    if (dc && dc->ParentEntity())
+        MarkDirty(dc->ParentEntity()->Id());
+}
+
+void SceneTreeModel::UpdateDynamicComponent()
+{
+    EC_DynamicComponent *dc = dynamic_cast<EC_DynamicComponent *>(sender());
+    if (dc && dc->ParentEntity())
+        MarkDirty(dc->ParentEntity()->Id());
+}
+
+void SceneTreeModel::UpdateAssetReference(IAttribute *attr)
+{
+    Attribute<AssetReference> *assetRef = dynamic_cast<Attribute<AssetReference> *>(attr);
+    if (!assetRef || !assetRef->Owner() || !assetRef->Owner()->ParentEntity())
+        return;
+
+    MarkDirty(assetRef->Owner()->ParentEntity()->Id());
+}
+
+void SceneTreeModel::UpdateEntityName(IAttribute *attr)
+{
+    EC_Name *nameComp = dynamic_cast<EC_Name *>(sender());
+    if (!nameComp || (attr != &nameComp->name) || (nameComp->ParentEntity() == 0))
+        return;
+
+    MarkDirty(nameComp->ParentEntity()->Id());
+}
+
+void SceneTreeModel::UpdateComponentName()
+{
+    IComponent *comp = dynamic_cast<IComponent *>(sender());
+    if (comp && comp->ParentEntity())
+        MarkDirty(comp->ParentEntity()->Id());
+}
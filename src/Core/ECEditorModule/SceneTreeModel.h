@@ -0,0 +1,238 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   SceneTreeModel.h
+ *  @brief  Item model over the entities of a scene, used by SceneTreeWidget.
+ */
+
+#pragma once
+
+#include "SceneFwd.h"
+#include "CoreTypes.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QStringList>
+#include <QColor>
+#include <QFutureWatcher>
+
+class SceneTreeItem;
+class EntityItem;
+
+/// Searchable and sortable information of an entity, gathered in the main thread when the entity changes.
+struct SceneTreeEntry
+{
+    entity_id_t id; ///< Entity ID.
+    EntityWeakPtr entity; ///< The entity.
+    QString name; ///< Name of the entity.
+    QString sortName; ///< Name of the entity in lower case, used when sorting by name.
+    QString text; ///< Text of the entity item.
+    QColor textColor; ///< Text color of the entity item.
+    QStringList componentTexts; ///< Texts of the component items.
+    QStringList assetTexts; ///< Texts of the asset reference items.
+};
+
+/// Entries of all entities in a scene by entity ID.
+typedef QHash<entity_id_t, SceneTreeEntry> SceneTreeIndex;
+
+/// Decides which entities are shown and in which order.
+struct SceneTreeOptions
+{
+    SceneTreeOptions() : negation(false), showComponents(true), showAssets(true), sortByName(false), order(Qt::AscendingOrder) {}
+
+    QString filter; ///< Search filter without the negation prefix, empty if not searching.
+    bool negation; ///< Are the items matching the filter hidden instead of shown.
+    bool showComponents; ///< Are the component items shown.
+    bool showAssets; ///< Are the asset reference items shown.
+    bool sortByName; ///< Are the entities sorted by name instead of ID.
+    Qt::SortOrder order; ///< Sort order.
+};
+
+/// The shown entities in order, arranged in a worker thread.
+struct SceneTreeRows
+{
+    SceneTreeOptions options; ///< Options the rows were arranged with.
+    QVector<entity_id_t> rows; ///< Shown entities in order.
+    QSet<entity_id_t> childMatches; ///< Shown entities that have child items matching the filter.
+};
+
+/// Item model over the entities of a scene.
+/** The model keeps a SceneTreeIndex of the searchable information of every entity in the scene. Changes to the scene are
+    collected during the frame and applied by ProcessPendingChanges: only the entries of the changed entities are updated,
+    and only those entities are compared to the search filter and inserted to or removed from their sorted positions.
+    When the search filter, the sort order or the shown child items change, the whole index is filtered and sorted again
+    in a worker thread.
+
+    The rows are entity IDs. The items of the entities are created when the view asks for their rows, and the component and
+    asset reference items of an entity when its item is expanded (see canFetchMore() and fetchMore()). */
+class SceneTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    /// Constructor.
+    /** @param parent Parent object. */
+    explicit SceneTreeModel(QObject *parent = 0);
+
+    /// Destructor.
+    ~SceneTreeModel();
+
+    /// Sets the scene whose entities are shown.
+    /** If scene is set to 0, the model is cleared and signal connections are disconnected. */
+    void SetScene(const ScenePtr &scene);
+
+    /// Sets the search filter.
+    /** Items containing @c filter (case-insensitive) are shown. If @c filter begins with '!', negation search is performed,
+        i.e. every item containing the filter is hidden instead. If an empty string, all items are shown. */
+    void SetFilter(const QString &filter);
+
+    /// Sets are the entities sorted by name instead of ID.
+    void SetSortByName(bool sortByName);
+
+    /// Sets are the component items shown.
+    void SetShowComponents(bool show);
+
+    /// Sets are the asset reference items shown.
+    void SetShowAssetReferences(bool show);
+
+    /// Returns the options the current rows were arranged with.
+    const SceneTreeOptions &Options() const { return options; }
+
+    /// Returns the number of entities in the scene, also those not shown.
+    int NumEntities() const { return entries.size(); }
+
+    /// Returns the index of an entity item, or an invalid index if the entity is not shown.
+    QModelIndex IndexOf(entity_id_t id) const;
+
+    /// Returns the shown entities that have child items matching the search filter.
+    const QSet<entity_id_t> &ChildMatches() const { return childMatches; }
+
+    /// Returns the item of an index.
+    static SceneTreeItem *Item(const QModelIndex &index);
+
+    /// QAbstractItemModel override.
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+
+    /// QAbstractItemModel override.
+    QModelIndex parent(const QModelIndex &child) const;
+
+    /// QAbstractItemModel override.
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /// QAbstractItemModel override.
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /// QAbstractItemModel override. Tells whether an entity has child items before they are created.
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+
+    /// QAbstractItemModel override. Returns true for entity items whose child items have not been created.
+    bool canFetchMore(const QModelIndex &parent) const;
+
+    /// QAbstractItemModel override. Creates the child items of an entity item.
+    void fetchMore(const QModelIndex &parent);
+
+    /// QAbstractItemModel override.
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    /// QAbstractItemModel override. Renames the entity of an entity item.
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+
+    /// QAbstractItemModel override.
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+
+    /// QAbstractItemModel override.
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    /// QAbstractItemModel override. Sorts the entities in the given order by the criteria set with SetSortByName().
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+public slots:
+    /// Queues the items of an entity to be updated at the end of the frame.
+    void MarkDirty(entity_id_t id);
+
+    /// Updates the items of the entities that have changed during the frame.
+    void ProcessPendingChanges();
+
+signals:
+    /// Emitted when the rows arranged in a worker thread have been taken into use.
+    void Arranged();
+
+private:
+    /// Returns the item of an entity row, creating it if needed.
+    EntityItem *EntityItemAt(int row) const;
+
+    /// Returns the row of a shown entity, or -1.
+    int RowOf(entity_id_t id) const;
+
+    /// Returns the row where a shown entity would be inserted.
+    int InsertionRow(entity_id_t id) const;
+
+    /// Gathers the searchable information of an entity and connects to the signals of its components.
+    SceneTreeEntry CreateEntry(Entity *entity);
+
+    /// Creates the child items of an entity item, without adding them to the item.
+    QList<SceneTreeItem *> CreateChildItems(EntityItem *item) const;
+
+    /// Creates the child items of an entity item and adds them to the item.
+    /** @param notify Whether the rows are inserted with beginInsertRows() and endInsertRows(). */
+    void PopulateEntityItem(EntityItem *item, bool notify);
+
+    /// Deletes the child items of an entity item.
+    /** @param notify Whether the rows are removed with beginRemoveRows() and endRemoveRows(). */
+    void ClearEntityItem(EntityItem *item, bool notify);
+
+    /// Connects to the signals of a component that affect the items of its entity.
+    void ConnectToComponent(IComponent *comp);
+
+    /// Starts filtering and sorting the entities with the requested options in a worker thread.
+    void StartArrange();
+
+    /// Clears the model.
+    void Clear();
+
+    SceneWeakPtr scene; ///< Scene whose entities are shown.
+    SceneTreeIndex entries; ///< Searchable information of every entity in the scene.
+    QVector<entity_id_t> rows; ///< Shown entities in order.
+    QSet<entity_id_t> childMatches; ///< Shown entities that have child items matching the filter.
+    mutable QHash<entity_id_t, EntityItem *> items; ///< Items of the shown entities, created when the view asks for them.
+    SceneTreeOptions options; ///< Options the rows were arranged with.
+    SceneTreeOptions requestedOptions; ///< Options the rows are arranged with next.
+    QSet<entity_id_t> dirtyEntities; ///< Entities whose items are updated at the end of the frame.
+    QSet<entity_id_t> changedDuringArrange; ///< Entities whose entries have changed after the ongoing arrange was started.
+    QFutureWatcher<SceneTreeRows> *arrangeWatcher; ///< Watches the ongoing arrange.
+    bool arranging; ///< Is an arrange ongoing. Stays set until its result has been handled.
+    bool arrangePending; ///< Rows need to be arranged again when the ongoing arrange finishes.
+
+private slots:
+    /// Takes the arranged rows into use.
+    void ArrangeFinished();
+
+    /// Queues the items of a new entity to be updated.
+    void AddEntity(Entity *entity);
+
+    /// Queues the items of a removed entity to be updated.
+    void RemoveEntity(Entity *entity);
+
+    /// Queues the items of an entity whose ID has changed on server ack to be updated.
+    void AckEntity(Entity *entity, entity_id_t oldId);
+
+    /// Queues the items of an entity whose components have changed to be updated.
+    void UpdateComponents(Entity *entity);
+
+    /// Queues the items of an entity to be updated if an asset reference attribute is added to or removed from its dynamic component.
+    void UpdateDynamicAttribute(IAttribute *attr);
+
+    /// Queues the items of an entity to be updated after a batch of attribute changes to its dynamic component.
+    void UpdateDynamicComponent();
+
+    /// Queues the items of an entity to be updated if one of its dynamic asset references has changed.
+    void UpdateAssetReference(IAttribute *attr);
+
+    /// Queues the items of an entity to be updated if its name has changed.
+    void UpdateEntityName(IAttribute *attr);
+
+    /// Queues the items of an entity to be updated if the name of one of its components has changed.
+    void UpdateComponentName();
+};
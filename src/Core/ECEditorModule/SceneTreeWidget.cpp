@@ -10,6 +10,7 @@
 
 #include "SceneTreeWidget.h"
 #include "SceneTreeWidgetItems.h"
+#include "SceneTreeModel.h"
 #include "SceneStructureModule.h"
 #include "SupportedFileTypes.h"
 #include "CoreException.h"
@@ -68,8 +69,9 @@ void Menu::keyReleaseEvent(QKeyEvent *e)
 // SceneTreeWidget
 
 SceneTreeWidget::SceneTreeWidget(Framework *fw, QWidget *parent) :
-    QTreeWidget(parent),
+    QTreeView(parent),
     framework(fw),
+    model(0),
     showComponents(false),
     historyMaxItemCount(100),
     numberOfInvokeItemsVisible(5),
@@ -84,9 +86,13 @@ SceneTreeWidget::SceneTreeWidget(Framework *fw, QWidget *parent) :
     setAllColumnsShowFocus(true);
     //setDefaultDropAction(Qt::MoveAction);
     setDropIndicatorShown(true);
-    setHeaderLabel(tr("Scene entities"));
-    setColumnCount(2);
-    header()->setSectionHidden(1, true);
+    // All rows have the same height, so the view does not need to ask for the items of the rows that are not visible.
+    setUniformRowHeights(true);
+
+    model = new SceneTreeModel(this);
+    setModel(model);
+    header()->setSortIndicator(0, Qt::AscendingOrder);
+    setSortingEnabled(true);
 
     connect(this, SIGNAL(doubleClicked(const QModelIndex &)), SLOT(Edit()));
 
@@ -101,8 +107,6 @@ SceneTreeWidget::SceneTreeWidget(Framework *fw, QWidget *parent) :
     connect(copyShortcut, SIGNAL(activated()), SLOT(Copy()));
     connect(pasteShortcut, SIGNAL(activated()), SLOT(Paste()));
 
-//    disconnect(this, SIGNAL(itemChanged(QTreeWidgetItem *, int)), this, SLOT(OnItemEdited(QTreeWidgetItem *, int)));
-
     LoadInvokeHistory();
 }
 
@@ -124,6 +128,7 @@ SceneTreeWidget::~SceneTreeWidget()
 void SceneTreeWidget::SetScene(const ScenePtr &s)
 {
     scene = s;
+    model->SetScene(s);
 }
 
 void SceneTreeWidget::contextMenuEvent(QContextMenuEvent *e)
@@ -193,7 +198,7 @@ void SceneTreeWidget::dropEvent(QDropEvent *e)
         e->acceptProposedAction();
     }
     else
-        QTreeWidget::dropEvent(e);
+        QTreeView::dropEvent(e);
 }
 
 void SceneTreeWidget::AddAvailableActions(QMenu *menu)
@@ -268,7 +273,7 @@ void SceneTreeWidget::AddAvailableEntityActions(QMenu *menu)
     }
 
     // "Save scene as..." action is possible if we have at least one entity in the scene.
-    bool saveSceneAsPossible = (topLevelItemCount() > 0);
+    bool saveSceneAsPossible = (model->NumEntities() > 0);
     QAction *saveSceneAsAction = 0;
     QAction *exportAllAction = 0;
     if (saveSceneAsPossible)
@@ -445,10 +450,9 @@ void SceneTreeWidget::AddAvailableEntityActions(QMenu *menu)
 Selection SceneTreeWidget::GetSelection() const
 {
     Selection ret;
-    QListIterator<QTreeWidgetItem *> it(selectedItems());
-    while(it.hasNext())
+    foreach(const QModelIndex &index, selectionModel()->selectedIndexes())
     {
-        QTreeWidgetItem *item = it.next();
+        SceneTreeItem *item = SceneTreeModel::Item(index);
         EntityItem *eItem = dynamic_cast<EntityItem *>(item);
         if (eItem)
             ret.entities << eItem;
@@ -649,20 +653,10 @@ void SceneTreeWidget::Rename()
     Selection sel = GetSelection();
     if (sel.entities.size() == 1)
     {
+        // The model gives the entity's name without the entity ID for editing, and sets the new name to the entity.
         EntityItem *eItem = sel.entities[0];
-        EntityPtr entity = eItem->Entity();
-        if (entity)
-        {
-            // Disable sorting when renaming so that the item will not jump around in the list.
-            setSortingEnabled(false);
-            // Remove the entity ID from the text when user is editing entity's name.
-            eItem->setText(0, entity->Name());
-//            openPersistentEditor(eItem);
-//            setCurrentIndex(index);
+        if (eItem->Entity())
             edit(index);
-            connect(this, SIGNAL(itemChanged(QTreeWidgetItem *, int)), SLOT(OnItemEdited(QTreeWidgetItem *, int)), Qt::UniqueConnection);
-//            connect(this, SIGNAL(currentItemChanged(QTreeWidgetItem *, QTreeWidgetItem *)), SLOT(CloseEditor(QTreeWidgetItem *,QTreeWidgetItem *)));
-        }
     }
 /*
     else if (sel.components.size() == 1)
@@ -676,43 +670,6 @@ void SceneTreeWidget::Rename()
 */
 }
 
-void SceneTreeWidget::OnItemEdited(QTreeWidgetItem *item, int column)
-{
-    if (column != 0)
-        return;
-
-    EntityItem *eItem = dynamic_cast<EntityItem *>(item);
-    if (eItem)
-    {
-        EntityPtr entity = eItem->Entity();
-        assert(entity);
-        if (entity)
-        {
-            QString newName = eItem->text(0);
-            disconnect(this, SIGNAL(itemChanged(QTreeWidgetItem *, int)), this, SLOT(OnItemEdited(QTreeWidgetItem *, int)));
-            // We don't need to set item text here. It's done when SceneStructureWindow gets AttributeChanged() signal from Scene.
-            entity->SetName(newName);
-//            closePersistentEditor(item);
-            setSortingEnabled(true);
-            return;
-        }
-    }
-/*
-    ComponentItem *cItem = dynamic_cast<ComponentItem *>(item);
-    EntityItem *parentItem = dynamic_cast<EntityItem *>(cItem->parent());
-    if (cItem && parentItem)
-    {
-        EntityPtr entity = scene->GetEntity(parentItem->id);
-        QString newName = cItem->text(0);
-        disconnect(this, SIGNAL(itemChanged(QTreeWidgetItem *, int)), this, SLOT(OnItemEdited(QTreeWidgetItem *)));
-        ComponentPtr component = entity->GetComponent(cItem->typeName, cItem->name);
-        if (component)
-            component->SetName(newName);
-        //cItem->typeName
-    }
-*/
-}
-
 /*
 void SceneTreeWidget::CloseEditor(QTreeWidgetItem *c, QTreeWidgetItem *p)
 {
@@ -1280,18 +1237,16 @@ void SceneTreeWidget::ExportAllDialogClosed(int result)
     if (!sel.HasEntities())
     {
         // Export all assets
-        for(int i = 0; i < topLevelItemCount(); ++i)
-        {
-            EntityItem *eItem = dynamic_cast<EntityItem *>(topLevelItem(i));
-            if (eItem)
-                assets.unite(GetAssetRefs(eItem));
-        }
+        ScenePtr scn = scene.lock();
+        if (scn)
+            for(Scene::iterator it = scn->begin(); it != scn->end(); ++it)
+                assets.unite(GetAssetRefs(it->second));
     }
     else
     {
         // Export assets for selected entities
         foreach(EntityItem *eItem, sel.entities)
-            assets.unite(GetAssetRefs(eItem));
+            assets.unite(GetAssetRefs(eItem->Entity()));
     }
 
     savedAssets.clear();
@@ -1324,49 +1279,33 @@ void SceneTreeWidget::ExportAllDialogClosed(int result)
     }
 }
 
-QSet<QString> SceneTreeWidget::GetAssetRefs(const EntityItem *eItem) const
+QSet<QString> SceneTreeWidget::GetAssetRefs(const EntityPtr &entity) const
 {
-    assert(scene.lock());
     QSet<QString> assets;
-
-    ///\todo use eItem->Entity()
-    EntityPtr entity = scene.lock()->GetEntity(eItem->Id());
     if (entity)
     {
-        int entityChildCount = eItem->childCount();
-        for(int j = 0; j < entityChildCount; ++j)
-        {
-            ComponentItem *cItem = dynamic_cast<ComponentItem *>(eItem->child(j));
-            if (!cItem)
-                continue;
-
-            ///\todo use cItem->Component()
-            ComponentPtr comp = entity->GetComponent(cItem->typeName, cItem->name);
-            if (!comp)
-                continue;
-
-            const Entity::ComponentMap &components = entity->Components();
-            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
-                foreach(IAttribute *attr, i->second->Attributes())
+        // Go through the components of the entity directly, as the component items are created only when the entity item is expanded.
+        const Entity::ComponentMap &components = entity->Components();
+        for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+            foreach(IAttribute *attr, i->second->Attributes())
+            {
+                if (!attr)
+                    continue;
+                
+                if (attr->TypeName() == "assetreference")
                 {
-                    if (!attr)
-                        continue;
-                    
-                    if (attr->TypeName() == "assetreference")
-                    {
-                        Attribute<AssetReference> *assetRef = dynamic_cast<Attribute<AssetReference> *>(attr);
-                        if (assetRef)
-                            assets.insert(assetRef->Get().ref);
-                    }
-                    else if (attr->TypeName() == "assetreferencelist")
-                    {
-                        Attribute<AssetReferenceList> *assetRefs = dynamic_cast<Attribute<AssetReferenceList> *>(attr);
-                        if (assetRefs)
-                            for(int i = 0; i < assetRefs->Get().Size(); ++i)
-                                assets.insert(assetRefs->Get()[i].ref);
-                    }
+                    Attribute<AssetReference> *assetRef = dynamic_cast<Attribute<AssetReference> *>(attr);
+                    if (assetRef)
+                        assets.insert(assetRef->Get().ref);
                 }
-        }
+                else if (attr->TypeName() == "assetreferencelist")
+                {
+                    Attribute<AssetReferenceList> *assetRefs = dynamic_cast<Attribute<AssetReferenceList> *>(attr);
+                    if (assetRefs)
+                        for(int i = 0; i < assetRefs->Get().Size(); ++i)
+                            assets.insert(assetRefs->Get()[i].ref);
+                }
+            }
     }
 
     return assets;
@@ -1631,6 +1570,6 @@ void SceneTreeWidget::SetAsTemporary(bool temporary)
         if (item->Entity())
         {
             item->Entity()->SetTemporary(temporary);
-            item->SetText(item->Entity().get());
+            model->MarkDirty(item->Id());
         }
 }
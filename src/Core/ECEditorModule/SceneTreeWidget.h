@@ -11,7 +11,7 @@
 #include "SceneFwd.h"
 #include "AssetFwd.h"
 
-#include <QTreeWidget>
+#include <QTreeView>
 #include <QPointer>
 #include <QMenu>
 
@@ -21,7 +21,7 @@ class QFileDialog;
 class ECEditorWindow;
 class IArgumentType;
 class IAssetTransfer;
-class EntityItem;
+class SceneTreeModel;
 
 struct InvokeItem;
 struct Selection;
@@ -46,8 +46,9 @@ private:
     void keyReleaseEvent(QKeyEvent *e);
 };
 
-/// Tree widget showing the scene structure.
-class SceneTreeWidget : public QTreeWidget
+/// Tree view showing the scene structure.
+/** The view shows a SceneTreeModel, which creates the items of the entities only when they are shown. */
+class SceneTreeWidget : public QTreeView
 {
     Q_OBJECT
 
@@ -64,6 +65,9 @@ public:
     /** @param scene Scene which contents we want to modify. */
     void SetScene(const ScenePtr &scene);
 
+    /// Returns the model of the entities in the scene.
+    SceneTreeModel *Model() const { return model; }
+
     /// Do we show components in the tree widget or not.
     bool showComponents;
 
@@ -108,11 +112,12 @@ private:
     /// Return most recently used InvokeItem.
     InvokeItem *FindMruItem();
 
-    /// Returns all asset references for the specified entity item.
-    QSet<QString> GetAssetRefs(const EntityItem *eItem) const;
+    /// Returns all asset references for the specified entity.
+    QSet<QString> GetAssetRefs(const EntityPtr &entity) const;
 
     Framework *framework; ///< Framework pointer.
     SceneWeakPtr scene; ///< Scene which we are showing the in tree widget currently.
+    SceneTreeModel *model; ///< Model of the entities in the scene.
     QList<QPointer<ECEditorWindow> > ecEditors; ///< This EC editors owned by this widget.
     int historyMaxItemCount; ///< Maximum count of invoke history items.
     int numberOfInvokeItemsVisible; ///< Number of visible invoke items in the context-menu.
@@ -140,10 +145,6 @@ private slots:
     /// Renames selected entity.
     void Rename();
 
-    /// Sets new name for item (entity or component) when it's renamed.
-    /** @item The item which was renamed. */
-    void OnItemEdited(QTreeWidgetItem *item, int);
-
 //    void CloseEditor(QTreeWidgetItem *,QTreeWidgetItem *);
 
     /// Creates a new entity.
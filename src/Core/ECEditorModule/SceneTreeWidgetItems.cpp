@@ -2,7 +2,7 @@
  *  For conditions of distribution and use, see copyright notice in license.txt
  *
  *  @file   SceneTreeWidgetItems.h
- *  @brief  Tree widget -related classes used in @c SceneTreeWidget and @c AssetTreeWidget.
+ *  @brief  Item classes used in @c SceneTreeModel and @c AssetTreeWidget.
  */
 
 #include "StableHeaders.h"
@@ -17,45 +17,54 @@
 
 #include "MemoryLeakCheck.h"
 
+// SceneTreeItem
+
+SceneTreeItem::SceneTreeItem(SceneTreeItem *parentItem) :
+    parent(parentItem), textColor(Qt::black)
+{
+}
+
+SceneTreeItem::~SceneTreeItem()
+{
+    qDeleteAll(children);
+}
+
 // EntityItem
 
-EntityItem::EntityItem(const EntityPtr &entity) :
-    ptr(entity), id(entity->Id())
+EntityItem::EntityItem(const EntityWeakPtr &entity, entity_id_t entityId) :
+    populated(false), id(entityId), ptr(entity)
 {
-    SetText(entity.get());
 }
 
-void EntityItem::SetText(::Entity *entity)
+QString EntityItem::Text(::Entity *entity)
 {
     QString name = QString("%1 %2").arg(entity->Id()).arg(entity->Name());
-    setTextColor(0, QColor(Qt::black));
-    
-    bool local = entity->IsLocal();
-    bool temp = entity->IsTemporary();
 
     QString info;
-    if (local)
-    {
-        setTextColor(0, QColor(Qt::blue));
+    if (entity->IsLocal())
         info.append("Local");
-    }
 
-    if (temp)
+    if (entity->IsTemporary())
     {
-        setTextColor(0, QColor(Qt::red));
         if (!info.isEmpty())
             info.append(" ");
         info.append("Temporary");
     }
 
     if (!info.isEmpty())
-    {
-        info.prepend(" (");
-        info.append(")");
-        setText(0, name + info);
-    }
+        return name + " (" + info + ")";
+    else
+        return name;
+}
+
+QColor EntityItem::TextColor(::Entity *entity)
+{
+    if (entity->IsTemporary())
+        return QColor(Qt::red);
+    else if (entity->IsLocal())
+        return QColor(Qt::blue);
     else
-        setText(0, name);
+        return QColor(Qt::black);
 }
 
 EntityPtr EntityItem::Entity() const
@@ -68,50 +77,24 @@ entity_id_t EntityItem::Id() const
     return id;
 }
 
-bool EntityItem::operator <(const QTreeWidgetItem &rhs) const
-{
-    int c = treeWidget()->sortColumn();
-    if (c == 0)
-        return (entity_id_t)text(0).split(" ")[0].toInt() < (entity_id_t)rhs.text(0).split(" ")[0].toInt();
-    else if (c == 1)
-    {
-        QStringList lhsText = text(0).split(" ");
-        QStringList rhsText = rhs.text(0).split(" ");
-        if (lhsText.size() > 1 && rhsText.size() > 1)
-            return lhsText[1].toLower() < rhsText[1].toLower();
-        else
-            return false;
-    }
-    else
-        return QTreeWidgetItem::operator <(rhs);
-}
-
 // ComponentItem
 
 ComponentItem::ComponentItem(const ComponentPtr &comp, EntityItem *parent) :
-    QTreeWidgetItem(parent), parentItem(parent), ptr(comp), typeName(comp->TypeName()), name(comp->Name())
+    SceneTreeItem(parent), ptr(comp), typeName(comp->TypeName()), name(comp->Name())
 {
     SetText(comp.get());
 }
 
-void ComponentItem::SetText(IComponent *comp)
+QString ComponentItem::Text(IComponent *comp)
 {
     QString name = QString("%1 %2").arg(comp->TypeName()).arg(comp->Name());
-    setTextColor(0, QColor(Qt::black));
-    
-    bool sync = comp->IsReplicated();
-    bool temporary = comp->IsTemporary();
-    
+
     QString info;
-    if (!sync)
-    {
-        setTextColor(0, QColor(Qt::blue));
+    if (!comp->IsReplicated())
         info.append("Local");
-    }
 
-    if (temporary)
+    if (comp->IsTemporary())
     {
-        setTextColor(0, QColor(Qt::red));
         if (!info.isEmpty())
             info.append(" ");
         info.append("Temporary");
@@ -132,13 +115,20 @@ void ComponentItem::SetText(IComponent *comp)
     }
 
     if (!info.isEmpty())
-    {
-        info.prepend(" (");
-        info.append(")");
-        setText(0, name + info);
-    }
+        return name + " (" + info + ")";
+    else
+        return name;
+}
+
+void ComponentItem::SetText(IComponent *comp)
+{
+    text = Text(comp);
+    if (comp->IsTemporary())
+        textColor = QColor(Qt::red);
+    else if (!comp->IsReplicated())
+        textColor = QColor(Qt::blue);
     else
-        setText(0, name);
+        textColor = QColor(Qt::black);
 }
 
 ComponentPtr ComponentItem::Component() const
@@ -148,13 +138,13 @@ ComponentPtr ComponentItem::Component() const
 
 EntityItem *ComponentItem::Parent() const
 {
-    return parentItem;
+    return static_cast<EntityItem *>(parent);
 }
 
 // AssetRefItem
 
-AssetRefItem::AssetRefItem(IAttribute *attr, QTreeWidgetItem *parent) :
-    QTreeWidgetItem(parent)
+AssetRefItem::AssetRefItem(IAttribute *attr, SceneTreeItem *parent) :
+    SceneTreeItem(parent)
 {
     Attribute<AssetReference> *assetRef = dynamic_cast<Attribute<AssetReference> *>(attr);
     assert(assetRef);
@@ -163,12 +153,12 @@ AssetRefItem::AssetRefItem(IAttribute *attr, QTreeWidgetItem *parent) :
     SetText(assetRef);
 }
 
-AssetRefItem::AssetRefItem(const QString &name, const QString &ref, QTreeWidgetItem *parent) :
-    QTreeWidgetItem(parent)
+AssetRefItem::AssetRefItem(const QString &name, const QString &ref, SceneTreeItem *parent) :
+    SceneTreeItem(parent)
 {
     this->name = name;
     id = ref;
-    setText(0, QString("%1: %2").arg(name).arg(ref));
+    text = QString("%1: %2").arg(name).arg(ref);
 }
 
 void AssetRefItem::SetText(IAttribute *attr)
@@ -176,7 +166,7 @@ void AssetRefItem::SetText(IAttribute *attr)
     Attribute<AssetReference> *assetRef = dynamic_cast<Attribute<AssetReference> *>(attr);
     assert(assetRef);
     if (assetRef)
-        setText(0, QString("%1: %2").arg(assetRef->Name()).arg(assetRef->Get().ref));
+        text = QString("%1: %2").arg(assetRef->Name()).arg(assetRef->Get().ref);
 }
 
 // Selection
@@ -2,7 +2,7 @@
  *  For conditions of distribution and use, see copyright notice in license.txt
  *
  *  @file   SceneTreeWidgetItems.h
- *  @brief  Tree widget -related classes used in @c SceneTreeWidget and @c AssetTreeWidget.
+ *  @brief  Item classes used in @c SceneTreeModel and @c AssetTreeWidget.
  */
 
 #pragma once
@@ -10,36 +10,55 @@
 #include "SceneFwd.h"
 #include "AssetFwd.h"
 
-/// Tree widget item representing an entity.
-class EntityItem : public QTreeWidgetItem
+/// Item of the scene tree model.
+/** The entity items are created when the view asks for their rows, and the component and asset reference
+    items of an entity when its item is expanded. */
+class SceneTreeItem
 {
 public:
     /// Constructor.
-    /** @param entity Entity which the item represents. */
-    explicit EntityItem(const EntityPtr &entity);
+    /** @param parent Parent item, null for entity items. The item is not added to the children of the parent. */
+    explicit SceneTreeItem(SceneTreeItem *parent = 0);
+
+    /// Deletes the child items.
+    virtual ~SceneTreeItem();
+
+    SceneTreeItem *parent; ///< Parent item, null for entity items.
+    QList<SceneTreeItem *> children; ///< Child items, owned by this item.
+    QString text; ///< Text shown in the view. Entity items take their text from the model instead.
+    QColor textColor; ///< Color of the text.
+};
+
+/// Scene tree item representing an entity.
+class EntityItem : public SceneTreeItem
+{
+public:
+    /// Constructor.
+    /** @param entity Entity which the item represents.
+        @param id ID of the entity, also if it has already been removed. */
+    EntityItem(const EntityWeakPtr &entity, entity_id_t id);
+
+    /// Returns the item text of an entity: its ID, name and whether it is local or temporary.
+    static QString Text(::Entity *entity);
+
+    /// Returns the item text color of an entity.
+    static QColor TextColor(::Entity *entity);
 
-    /// Sets the item text accordingly to the entity information.
-    /** @param entity Entity which the item represents. */
-    void SetText(::Entity *entity);
-    
     /// Returns pointer to the entity this item represents.
     EntityPtr Entity() const;
 
     /// Return Entity ID of the entity associated with this tree widget item.
     entity_id_t Id() const;
 
-    /// QTreeWidgetItem override.
-    /** If treeWidget::sortColumn() is 0, items are sorted by ID,
-        or if it's 1, items are sorted by name (if applicable). */
-    bool operator <(const QTreeWidgetItem &rhs) const;
+    bool populated; ///< Have the child items been created.
 
 private:
     entity_id_t id; ///< Entity ID associated with this tree widget item.
     EntityWeakPtr ptr; ///< Weak pointer to the component this item represents.
 };
 
-/// Tree widget item representing a component.
-class ComponentItem : public QTreeWidgetItem
+/// Scene tree item representing a component.
+class ComponentItem : public SceneTreeItem
 {
 public:
     /// Constructor.
@@ -47,6 +66,9 @@ public:
         @param parent Parent entity item. */
     ComponentItem(const ComponentPtr &comp, EntityItem *parent);
 
+    /// Returns the item text of a component: its type name, name and information about its replication.
+    static QString Text(IComponent *comp);
+
     /// Sets the item text accordingly to the component information.
     /** @param comp Component which the item represents. */
     void SetText(IComponent *comp);
@@ -62,23 +84,22 @@ public:
 
 private:
     ComponentWeakPtr ptr; ///< Weak pointer to the component this item represents.
-    EntityItem *parentItem; ///< Parent entity item.
 };
 
-/// Tree widget item representing an asset reference.
-class AssetRefItem : public QTreeWidgetItem
+/// Scene tree item representing an asset reference.
+class AssetRefItem : public SceneTreeItem
 {
 public:
     /// Constructor.
     /** @param attr Asset reference attribute.
         @param parent Parent item. */
-    AssetRefItem(IAttribute *attr, QTreeWidgetItem *parent = 0);
+    AssetRefItem(IAttribute *attr, SceneTreeItem *parent = 0);
 
     /// Constructor.
     /** @param name Name of the asset.
         @param ref Asset reference.
         @param parent Parent item. */
-    AssetRefItem(const QString &name, const QString &ref, QTreeWidgetItem *parent = 0);
+    AssetRefItem(const QString &name, const QString &ref, SceneTreeItem *parent = 0);
 
     /// Sets the item text accordingly to the attribute information.
     /** @param attr Asset reference attribute. */
@@ -25,7 +25,10 @@
 #include "Profiler.h"
 #include "OgreRenderingModule.h"
 #include "OgreWorld.h"
+#include "EC_Camera.h"
+#include "FrameAPI.h"
 #include <Ogre.h>
+#include <QtConcurrentRun>
 #include <utility>
 
 #include "MemoryLeakCheck.h"
@@ -49,7 +52,10 @@ EC_Terrain::EC_Terrain(Scene* scene) :
     vScale(this, "Tex. V scale"),
     patchWidth(1),
     patchHeight(1),
-    rootNode(0)
+    rootNode(0),
+    chunkWidth(1),
+    chunkHeight(1),
+    chunkGenerationCounter(0)
 {
     if (scene)
         world_ = scene->GetWorld<OgreWorld>();
@@ -59,6 +65,7 @@ EC_Terrain::EC_Terrain(Scene* scene) :
     xPatches.Set(1, AttributeChange::Disconnected);
     yPatches.Set(1, AttributeChange::Disconnected);
     patches.resize(1);
+    chunks.resize(1);
     MakePatchFlat(0, 0, 0.f);
     uScale.Set(0.13f, AttributeChange::Disconnected);
     vScale.Set(0.13f, AttributeChange::Disconnected);
@@ -87,6 +94,8 @@ void EC_Terrain::UpdateSignals()
 
     Entity *parent = ParentEntity();
     CreateRootNode();
+    if (ViewEnabled() && GetFramework())
+        connect(GetFramework()->Frame(), SIGNAL(Updated(float)), this, SLOT(OnFrameUpdated(float)), Qt::UniqueConnection);
     if (parent)
     {    
         connect(parent, SIGNAL(ComponentAdded(IComponent*, AttributeChange::Type)), this, SLOT(AttachTerrainRootNode()), Qt::UniqueConnection);
@@ -113,31 +122,18 @@ void EC_Terrain::ResizeTerrain(int newPatchWidth, int newPatchHeight)
 {
     PROFILE(EC_Terrain_ResizeTerrain);
 
-    const int maxPatchSize = 32;
-    // Do an artificial limit to a preset N patches per side. (This limit is way too large already for the current terrain vertex LOD management.)
+    // Do an artificial limit to a preset N patches per side.
+    const int maxPatchSize = 256;
     newPatchWidth = max(1, min(maxPatchSize, newPatchWidth));
     newPatchHeight = max(1, min(maxPatchSize, newPatchHeight));
 
     if (newPatchWidth == patchWidth && newPatchHeight == patchHeight)
         return;
 
-    // If the width changes, we need to also regenerate the old right-most column to generate the new seams. (If we are shrinking, this is not necessary)
-    if (patchWidth < newPatchWidth)
-        for(int y = 0; y < patchHeight; ++y)
-            GetPatch(patchWidth-1, y).patch_geometry_dirty = true;
-
-    // If the height changes, we need to also regenerate the old top-most row to generate the new seams. (If we are shrinking, this is not necessary)
-    if (patchHeight < newPatchHeight)
-        for(int x = 0; x < patchWidth; ++x)
-            GetPatch(x, patchHeight-1).patch_geometry_dirty = true;
-
-    // First delete all the patches that will not be part of the newly-sized terrain (user shrinked the terrain in one or two dimensions)
-    for(int y = newPatchHeight; y < patchHeight; ++y)
-        for(int x = 0; x < patchWidth; ++x)
-            DestroyPatch(x, y);
-    for(int x = newPatchWidth; x < patchWidth; ++x) // We hav esome overlap here with above, but it's ok since DestroyPatch is benign.
-        for(int y = 0; y < patchHeight; ++y)
-            DestroyPatch(x, y);
+    // The chunks at the terrain edges change shape when the terrain is resized, so all the GPU geometry is regenerated.
+    for(int y = 0; y < chunkHeight; ++y)
+        for(int x = 0; x < chunkWidth; ++x)
+            DestroyChunk(x, y);
 
     // Now create the new terrain patch storage and copy the old height values over.
     std::vector<Patch> newPatches(newPatchWidth * newPatchHeight);
@@ -168,6 +164,9 @@ void EC_Terrain::ResizeTerrain(int newPatchWidth, int newPatchHeight)
             GetPatch(x,y).x = x;
             GetPatch(x,y).y = y;
         }
+
+    ResizeChunks();
+    DirtyAllTerrainPatches();
 }
 
 void EC_Terrain::OnAttributeUpdated(IAttribute *attribute)
@@ -250,10 +249,9 @@ void EC_Terrain::MaterialAssetLoaded(AssetPtr asset_)
 
     currentMaterial = material->getName().c_str();
 
-    // Also, we need to update each geometry patch to use the new material.
-    for(int y = 0; y < patchHeight; ++y)
-        for(int x = 0; x < patchWidth; ++x)
-            UpdateTerrainPatchMaterial(x, y);
+    // Also, we need to update each geometry chunk to use the new material.
+    for(size_t i = 0; i < chunks.size(); ++i)
+        UpdateTerrainChunkMaterial(chunks[i]);
 /*
     // The material of the terrain has changed. Since we specify the textures of that material as attributes,
     // we need to re-apply the textures from the attributes to the new material we set.
@@ -297,6 +295,23 @@ void EC_Terrain::DestroyPatch(int x, int y)
     if (x >= patchWidth || y >= patchHeight || x < 0 || y < 0)
         return;
 
+    DestroyChunk(x / cChunkSize, y / cChunkSize);
+}
+
+void EC_Terrain::DestroyChunk(int chunkX, int chunkY)
+{
+    if (chunkX >= chunkWidth || chunkY >= chunkHeight || chunkX < 0 || chunkY < 0)
+        return;
+
+    EC_Terrain::Chunk &chunk = GetChunk(chunkX, chunkY);
+    chunk.generation = 0; // Discard the geometry that is still being built for this chunk.
+    chunk.lod = 0;
+
+    // The patches of the chunk need new geometry before they are visible again.
+    for(int y = chunkY * cChunkSize; y < min(patchHeight, (chunkY + 1) * cChunkSize); ++y)
+        for(int x = chunkX * cChunkSize; x < min(patchWidth, (chunkX + 1) * cChunkSize); ++x)
+            GetPatch(x, y).patch_geometry_dirty = true;
+
     assert(GetFramework());
     if (!GetFramework())
         return;
@@ -304,39 +319,47 @@ void EC_Terrain::DestroyPatch(int x, int y)
     if (world_.expired()) // Oops! Already destroyed
         return;
     Ogre::SceneManager *sceneMgr = world_.lock()->GetSceneManager();
-    
-    EC_Terrain::Patch &patch = GetPatch(x, y);
 
-    if (patch.node)
+    if (chunk.node)
     {
-        sceneMgr->getRootSceneNode()->removeChild(patch.node);
-        patch.node->detachAllObjects();
-        sceneMgr->destroySceneNode(patch.node);
-        patch.node = 0;
+        if (chunk.node->getParentSceneNode())
+            chunk.node->getParentSceneNode()->removeChild(chunk.node);
+        chunk.node->detachAllObjects();
+        sceneMgr->destroySceneNode(chunk.node);
+        chunk.node = 0;
     }
-    if (patch.entity)
+    if (chunk.entity)
     {
-        sceneMgr->destroyEntity(patch.entity);
-        patch.entity = 0;
+        sceneMgr->destroyEntity(chunk.entity);
+        chunk.entity = 0;
     }
 
-    // If there exists a previously generated GPU Mesh resource, delete it before creating a new one.
-    if (patch.meshGeometryName.length() > 0)
+    if (chunk.meshGeometryName.length() > 0)
     {
         try
         {
-            Ogre::MeshManager::getSingleton().remove(patch.meshGeometryName);
+            Ogre::MeshManager::getSingleton().remove(chunk.meshGeometryName);
         }
         catch(...) {}
-        patch.meshGeometryName = "";
+        chunk.meshGeometryName = "";
     }
 }
 
+void EC_Terrain::ResizeChunks()
+{
+    chunkWidth = (patchWidth + cChunkSize - 1) / cChunkSize;
+    chunkHeight = (patchHeight + cChunkSize - 1) / cChunkSize;
+    chunks.clear();
+    chunks.resize(chunkWidth * chunkHeight);
+}
+
 void EC_Terrain::Destroy()
 {
-    for(int y = 0; y < patchHeight; ++y)
-        for(int x = 0; x < patchWidth; ++x)
-            DestroyPatch(x, y);
+    DiscardPendingChunkGeometry();
+
+    for(int y = 0; y < chunkHeight; ++y)
+        for(int x = 0; x < chunkWidth; ++x)
+            DestroyChunk(x, y);
 
     if (!GetFramework())
         return;
@@ -373,7 +396,9 @@ void EC_Terrain::SetPointHeight(int x, int y, float height)
     if (x < 0 || y < 0 || x >= cPatchSize * patchWidth || y >= cPatchSize * patchHeight)
         return; // Out of bounds signals are silently ignored.
 
-    GetPatch(x / cPatchSize, y / cPatchSize).heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)] = height;
+    EC_Terrain::Patch &patch = GetPatch(x / cPatchSize, y / cPatchSize);
+    patch.heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)] = height;
+    patch.patch_geometry_dirty = true;
 }
 
 namespace
@@ -743,6 +768,8 @@ bool EC_Terrain::LoadFromDataInMemory(const char *data, size_t numBytes)
     patches = newPatches;
     patchWidth = xPatches;
     patchHeight = yPatches;
+    // The xPatches and yPatches changes below do not resize the terrain, as the size already matches, so resize the chunk grid here.
+    ResizeChunks();
 
     // Re-do all the geometry on the GPU.
     RegenerateDirtyTerrainPatches();
@@ -1205,16 +1232,14 @@ void EC_Terrain::SetTerrainMaterialTexture(int index, const char *textureName)
 //        LogWarning("Ogre material " + std::string(terrainMaterialName) + " not found!");
 }
 
-void EC_Terrain::UpdateTerrainPatchMaterial(int patchX, int patchY)
+void EC_Terrain::UpdateTerrainChunkMaterial(Chunk &chunk)
 {
-    Patch &patch = GetPatch(patchX, patchY);
-
-    if (!patch.entity)
+    if (!chunk.entity)
         return;
 
-    for(size_t i = 0; i < patch.entity->getNumSubEntities(); ++i)
+    for(size_t i = 0; i < chunk.entity->getNumSubEntities(); ++i)
     {
-        Ogre::SubEntity *sub = patch.entity->getSubEntity(i);
+        Ogre::SubEntity *sub = chunk.entity->getSubEntity(i);
         if (sub)
             sub->setMaterialName(currentMaterial.toStdString().c_str());
     }
@@ -1264,168 +1289,218 @@ void EC_Terrain::AttachTerrainRootNode()
     }
 }
 
-/// Creates Ogre geometry data for the single given patch, or updates the geometry for an existing
-/// patch if the associated Ogre resources already exist.
-void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
+/// Takes a copy of the height values of the given chunk and starts building its geometry in a worker thread.
+/// The old geometry of the chunk, if any, stays visible until the new geometry is uploaded in UploadFinishedChunks.
+bool EC_Terrain::GenerateTerrainGeometryForChunk(int chunkX, int chunkY)
 {
-    PROFILE(EC_Terrain_GenerateTerrainGeometryForOnePatch);
-
-    EC_Terrain::Patch &patch = GetPatch(patchX, patchY);
+    PROFILE(EC_Terrain_GenerateTerrainGeometryForChunk);
 
     if (!ViewEnabled())
-        return;
+        return false;
+    if (world_.expired())
+        return false;
+
+    EC_Terrain::Chunk &chunk = GetChunk(chunkX, chunkY);
+    if (!chunk.node)
+        CreateOgreTerrainChunkNode(chunk.node, chunkX, chunkY);
+    if (!chunk.node)
+        return false;
+
+    TerrainChunkJob job;
+    job.chunkX = chunkX;
+    job.chunkY = chunkY;
+    job.generation = chunk.generation = ++chunkGenerationCounter;
+    job.vertexX = chunkX * cChunkSize * cPatchSize;
+    job.vertexY = chunkY * cChunkSize * cPatchSize;
+    job.terrainVerticesWidth = VerticesWidth();
+    job.terrainVerticesHeight = VerticesHeight();
+    // Each chunk also contains the first vertex row and column of the next chunk to connect the seams.
+    // The outermost chunks at the terrain edge do not have this, since there is no next chunk.
+    job.quadsX = min(job.vertexX + cChunkSize * cPatchSize, job.terrainVerticesWidth - 1) - job.vertexX;
+    job.quadsY = min(job.vertexY + cChunkSize * cPatchSize, job.terrainVerticesHeight - 1) - job.vertexY;
+    job.uScale = uScale.Get();
+    job.vScale = vScale.Get();
+
+    // Copy the heights with a border of one vertex for computing the normals. GetPoint clamps the coordinates at the terrain edges.
+    job.heights.resize((job.quadsX + 3) * (job.quadsY + 3));
+    float *h = &job.heights[0];
+    for(int y = -1; y <= job.quadsY + 1; ++y)
+        for(int x = -1; x <= job.quadsX + 1; ++x)
+            *h++ = GetPoint(job.vertexX + x, job.vertexY + y);
+
+    pendingChunkGeometry.push_back(QtConcurrent::run(BuildTerrainChunkGeometry, job));
+
+    return true;
+}
+
+void EC_Terrain::UploadChunkGeometry(const TerrainChunkGeometry &geometry)
+{
+    PROFILE(EC_Terrain_UploadChunkGeometry);
+
     if (world_.expired())
         return;
     OgreWorldPtr world = world_.lock();
     Ogre::SceneManager *sceneMgr = world->GetSceneManager();
 
-    Ogre::SceneNode *node = patch.node;
-    bool firstTimeFill = (node == 0);
-    UNREFERENCED_PARAM(firstTimeFill);
-    if (!node)
-    {
-        CreateOgreTerrainPatchNode(node, patch.x, patch.y);
-        patch.node = node;
-    }
-    assert(node);
+    EC_Terrain::Chunk &chunk = GetChunk(geometry.chunkX, geometry.chunkY);
+    if (!chunk.node)
+        return;
 
     Ogre::MaterialPtr terrainMaterial = Ogre::MaterialManager::getSingleton().getByName(currentMaterial.toStdString().c_str());
     if (!terrainMaterial.get()) // If we could not find the material we were supposed to use, just use the default system terrain material.
         terrainMaterial = OgreRenderer::GetOrCreateLitTexturedMaterial("Rex/TerrainPCF");
 
-    Ogre::ManualObject *manual = sceneMgr->createManualObject(world->GetUniqueObjectName("EC_Terrain_manual"));
-    manual->setCastShadows(false);
-
-    manual->clear();
-    manual->estimateVertexCount((cPatchSize+1)*(cPatchSize+1));
-    manual->estimateIndexCount((cPatchSize+1)*(cPatchSize+1)*3*2);
-    manual->begin(terrainMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
-
-    const float vertexSpacingX = 1.f;
-    const float vertexSpacingY = 1.f;
-    const float patchSpacingX = cPatchSize * vertexSpacingX;
-    const float patchSpacingY = cPatchSize * vertexSpacingY;
-    const Ogre::Vector3 patchOrigin(patch.x * patchSpacingX, 0.f, patch.y * patchSpacingY);
-// Opensim:    const Ogre::Vector3 patchOrigin(patch.x * patchSpacingX, patch.y * patchSpacingY, 0.f);
-
-    int curIndex = 0;
-
-    const int cPatchVertexWidth = cPatchSize; // The number of vertices in the patch in horizontal direction. We use the fixed value of cPatchSize==16.
-    const int cPatchVertexHeight = cPatchSize; // The number of vertices in the patch in vertical  direction. We use the fixed value of cPatchSize==16.
-    // If we assume each patch is 16x16 vertices, then all the internal patches will get a 17x17 grid, since we need to connect seams.
-    // But, the outermost patch row and column at the terrain edge will not have this, since they do not need to connect to a next patch.
-    // This is the vertex stride for the terrain.
-    const int stride = (patch.x + 1 >= patchWidth) ? cPatchVertexWidth : (cPatchVertexWidth+1);
-
-    const float uScale = this->uScale.Get();
-    const float vScale = this->vScale.Get();
-
-    for(int y = 0; y <= cPatchVertexHeight; ++y)
-        for(int x = 0; x <= cPatchVertexWidth; ++x)
+    // Release the previous geometry of the chunk.
+    if (chunk.entity)
+    {
+        chunk.node->detachObject(chunk.entity);
+        sceneMgr->destroyEntity(chunk.entity);
+        chunk.entity = 0;
+    }
+    if (chunk.meshGeometryName.length() > 0)
+    {
+        try
         {
-            if ((patch.x + 1 >= patchWidth && x == cPatchVertexWidth) ||
-                (patch.y + 1 >= patchHeight && y == cPatchVertexHeight))
-                continue; // We are at the single corner-most vertex of the whole terrain. That is to be skipped.
-
-            // These coordinates are directly generated to our Ogre coordinate system, i.e. are cycled from OpenSim XYZ -> our YZX.
-            // see OpenSimToOgreCoordinateAxes.
-            Ogre::Vector3 pos;
-            pos.x = vertexSpacingX * x;
-            pos.z = vertexSpacingY * y;
-// Opensim:             pos.x = vertexSpacingX * x;
-// Opensim              pos.y = vertexSpacingY * y;
-
-            EC_Terrain::Patch *thisPatch;
-            int X = x;
-            int Y = y;
-            if (x < cPatchVertexWidth && y < cPatchVertexHeight)
-            {
-                thisPatch = &patch;
-
-                if ((patch.x + 1 < patchWidth || x+1 < cPatchVertexWidth) &&
-                    (patch.y + 1 < patchHeight || y+1 < cPatchVertexHeight))
-                {
-                    // Note: winding needs to be flipped when terrain X axis goes along world X axis and terrain Y axis along world Z
-                    manual->index(curIndex+stride);
-                    manual->index(curIndex+1);
-                    manual->index(curIndex);
-
-                    manual->index(curIndex+stride);
-                    manual->index(curIndex+stride+1);
-                    manual->index(curIndex+1);
-                }
-            }
-            else if (x == cPatchVertexWidth && y == cPatchVertexHeight)
-            {
-                thisPatch = &GetPatch(patch.x + 1, patch.y + 1);
-                X = 0;
-                Y = 0;
-            }
-            else if (x == cPatchVertexWidth)
-            {
-                thisPatch = &GetPatch(patch.x + 1, patch.y);
-                X = 0;
-            }
-            else // (y == patchHeight)
-            {
-                thisPatch = &GetPatch(patch.x, patch.y + 1);
-                Y = 0;
-            }
+            Ogre::MeshManager::getSingleton().remove(chunk.meshGeometryName);
+        }
+        catch(...) {}
+    }
 
-            pos.y = thisPatch->heightData[Y*cPatchVertexWidth+X];
-// Opensim:            pos.z = thisPatch->heightData[Y*cPatchVertexWidth+X];
+    chunk.meshGeometryName = world->GetUniqueObjectName("EC_Terrain_chunkmesh");
+    Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createManual(chunk.meshGeometryName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+
+    Ogre::VertexData *vertexData = new Ogre::VertexData();
+    mesh->sharedVertexData = vertexData;
+    vertexData->vertexCount = geometry.numVertices;
+    Ogre::VertexDeclaration *decl = vertexData->vertexDeclaration;
+    size_t offset = 0;
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION).getSize();
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL).getSize();
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0).getSize();
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 1).getSize();
+    assert(offset == TerrainChunkGeometry::cVertexSize * sizeof(float));
+
+    // Use shadow buffers, since the raycast code reads the geometry back.
+    Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+        offset, geometry.numVertices, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY, true);
+    vbuf->writeData(0, vbuf->getSizeInBytes(), &geometry.vertices[0], true);
+    vertexData->vertexBufferBinding->setBinding(0, vbuf);
+
+    // Each LOD level is a submesh of its own, and only one of them is visible at a time.
+    for(int lod = 0; lod < TerrainChunkGeometry::cNumLodLevels; ++lod)
+    {
+        const std::vector<u16> &indices = geometry.indices[lod];
+        Ogre::SubMesh *subMesh = mesh->createSubMesh();
+        subMesh->useSharedVertices = true;
+        subMesh->setMaterialName(terrainMaterial->getName());
+        Ogre::HardwareIndexBufferSharedPtr ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+            Ogre::HardwareIndexBuffer::IT_16BIT, indices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY, true);
+        ibuf->writeData(0, ibuf->getSizeInBytes(), &indices[0], true);
+        subMesh->indexData->indexBuffer = ibuf;
+        subMesh->indexData->indexStart = 0;
+        subMesh->indexData->indexCount = indices.size();
+    }
 
-            manual->position(pos);
-            manual->normal(CalculateNormal(thisPatch->x, thisPatch->y, X, Y));
+    mesh->_setBounds(Ogre::AxisAlignedBox(0.f, geometry.minHeight, 0.f, (float)geometry.quadsX, geometry.maxHeight, (float)geometry.quadsY));
+    mesh->_setBoundingSphereRadius(Ogre::Vector3((float)geometry.quadsX, max(fabs(geometry.minHeight), fabs(geometry.maxHeight)), (float)geometry.quadsY).length());
+    mesh->load();
 
-            // The UV set 0 contains the diffuse texture UV map. Do a planar mapping with the given specified UV scale.
-            manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.z + pos.z) * vScale);
-// Opensim:             manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.y + pos.y) * vScale);
+    chunk.entity = sceneMgr->createEntity(world->GetUniqueObjectName("EC_Terrain_chunkentity"), chunk.meshGeometryName);
+    chunk.entity->setUserAny(Ogre::Any(parentEntity));
+    chunk.entity->setCastShadows(false);
+    // Set UserAny also on subentities
+    for(uint i = 0; i < chunk.entity->getNumSubEntities(); ++i)
+    {
+        chunk.entity->getSubEntity(i)->setUserAny(chunk.entity->getUserAny());
+        chunk.entity->getSubEntity(i)->setVisible((int)i == chunk.lod);
+    }
+    chunk.node->attachObject(chunk.entity);
+}
 
-            // The UV set 1 contains the terrain blend mask UV map, which stretches once across the whole terrain.
-            manual->textureCoord((float)(patch.x*cPatchSize + x)/(VerticesWidth()-1), (float)(patch.y*cPatchSize + y)/(VerticesHeight()-1)); 
+void EC_Terrain::UploadFinishedChunks()
+{
+    PROFILE(EC_Terrain_UploadFinishedChunks);
 
-            ++curIndex;
+    bool uploaded = false;
+    for(size_t i = 0; i < pendingChunkGeometry.size();)
+    {
+        if (!pendingChunkGeometry[i].isFinished())
+        {
+            ++i;
+            continue;
         }
 
-    manual->end();
+        TerrainChunkGeometry *geometry = pendingChunkGeometry[i].result();
+        pendingChunkGeometry.erase(pendingChunkGeometry.begin() + i);
 
-    // If there exists a previously generated GPU Mesh resource, delete it before creating a new one.
-    if (patch.meshGeometryName.length() > 0)
-    {
-        try
+        // The chunk may have been destroyed or regenerated again while the geometry was being built.
+        if (geometry && geometry->chunkX < chunkWidth && geometry->chunkY < chunkHeight &&
+            GetChunk(geometry->chunkX, geometry->chunkY).generation == geometry->generation)
         {
-            Ogre::MeshManager::getSingleton().remove(patch.meshGeometryName);
+            UploadChunkGeometry(*geometry);
+            uploaded = true;
         }
-        catch(...) {}
+        delete geometry;
     }
 
-    patch.meshGeometryName = world->GetUniqueObjectName("EC_Terrain_patchmesh");
-    Ogre::MeshPtr terrainMesh = manual->convertToMesh(patch.meshGeometryName);
+    // All the new geometry we created will be visible for Ogre by default. If the EC_Placeable's visible attribute is false,
+    // we need to hide all newly created geometry.
+    if (uploaded && ParentEntity())
+        AttachTerrainRootNode();
+}
 
-    // Odd: destroyManualObject seems to leave behind a memory leak if we don't call manualObject->clear first.
-    manual->clear();
-    sceneMgr->destroyManualObject(manual);
+void EC_Terrain::DiscardPendingChunkGeometry()
+{
+    for(size_t i = 0; i < pendingChunkGeometry.size(); ++i)
+        delete pendingChunkGeometry[i].result(); // Blocks until the build has finished.
+    pendingChunkGeometry.clear();
+}
 
-    patch.entity = sceneMgr->createEntity(world->GetUniqueObjectName("EC_Terrain_patchentity"), patch.meshGeometryName);
-    patch.entity->setUserAny(Ogre::Any(parentEntity));
-    patch.entity->setCastShadows(false);
-    // Set UserAny also on subentities
-    for(uint i = 0; i < patch.entity->getNumSubEntities(); ++i)
-        patch.entity->getSubEntity(i)->setUserAny(patch.entity->getUserAny());
+void EC_Terrain::UpdateChunkLods()
+{
+    PROFILE(EC_Terrain_UpdateChunkLods);
+
+    if (world_.expired())
+        return;
+    OgreRenderer::Renderer *renderer = world_.lock()->GetRenderer();
+    EC_Camera *cameraComponent = renderer ? renderer->MainCameraComponent() : 0;
+    if (!cameraComponent || !cameraComponent->GetCamera() || renderer->MainCameraScene() != ParentScene())
+        return;
+
+    const Ogre::Vector3 cameraPos = cameraComponent->GetCamera()->getDerivedPosition();
 
-    // Explicitly destroy all attached MovableObjects previously bound to this terrain node.
-    Ogre::SceneNode::ObjectIterator iter = node->getAttachedObjectIterator();
-    while(iter.hasMoreElements())
+    for(size_t i = 0; i < chunks.size(); ++i)
     {
-        Ogre::MovableObject *obj = iter.getNext();
-        sceneMgr->destroyMovableObject(obj);
+        EC_Terrain::Chunk &chunk = chunks[i];
+        if (!chunk.entity)
+            continue;
+
+        const Ogre::AxisAlignedBox &box = chunk.entity->getWorldBoundingBox(true);
+        Ogre::Vector3 nearest = cameraPos;
+        nearest.makeCeil(box.getMinimum());
+        nearest.makeFloor(box.getMaximum());
+        const float distance = nearest.distance(cameraPos);
+
+        // Each LOD level halves the vertex density, so its distance range is twice the range of the previous level.
+        // The ranges are relative to the world space size of the chunk, so that the terrain scale does not affect the LOD selection.
+        const Ogre::Vector3 size = box.getSize();
+        int lod = 0;
+        for(float lodDistance = max(size.x, size.z); lod + 1 < TerrainChunkGeometry::cNumLodLevels && distance > lodDistance; lodDistance *= 2.f)
+            ++lod;
+
+        if (lod == chunk.lod)
+            continue;
+        chunk.entity->getSubEntity(chunk.lod)->setVisible(false);
+        chunk.entity->getSubEntity(lod)->setVisible(true);
+        chunk.lod = lod;
     }
-    node->detachAllObjects();
-    // Now attach the new built terrain mesh.
-    node->attachObject(patch.entity);
+}
 
-    patch.patch_geometry_dirty = false;
+void EC_Terrain::OnFrameUpdated(float /*frameTime*/)
+{
+    if (!pendingChunkGeometry.empty())
+        UploadFinishedChunks();
+    UpdateChunkLods();
 }
 
 void EC_Terrain::CreateRootNode()
@@ -1447,7 +1522,7 @@ void EC_Terrain::CreateRootNode()
     UpdateRootNodeTransform();
 }
 
-void EC_Terrain::CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, int patchX, int patchY)
+void EC_Terrain::CreateOgreTerrainChunkNode(Ogre::SceneNode *&node, int chunkX, int chunkY)
 {
     if (world_.expired())
         return;
@@ -1460,7 +1535,7 @@ void EC_Terrain::CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, int patchX,
     if (!rootNode)
         CreateRootNode();
 
-    QString name = QString("EC_Terrain_Patch_") + QString::number(patchX) + "_" + QString::number(patchY);
+    QString name = QString("EC_Terrain_Chunk_") + QString::number(chunkX) + "_" + QString::number(chunkY);
     node = sceneMgr->createSceneNode(world->GetUniqueObjectName(name.toStdString()));
     if (!node)
         return;
@@ -1472,11 +1547,11 @@ void EC_Terrain::CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, int patchX,
     
     const float vertexSpacingX = 1.f;
     const float vertexSpacingY = 1.f;
-    const float patchSpacingX = 16 * vertexSpacingX;
-    const float patchSpacingY = 16 * vertexSpacingY;
-    const Ogre::Vector3 patchOrigin(patchX * patchSpacingX, 0.f, patchY * patchSpacingY);
+    const float chunkSpacingX = cChunkSize * cPatchSize * vertexSpacingX;
+    const float chunkSpacingY = cChunkSize * cPatchSize * vertexSpacingY;
+    const Ogre::Vector3 chunkOrigin(chunkX * chunkSpacingX, 0.f, chunkY * chunkSpacingY);
 
-    node->setPosition(patchOrigin);
+    node->setPosition(chunkOrigin);
 }
 
 float EC_Terrain::GetTerrainMinHeight() const
@@ -1517,44 +1592,66 @@ void EC_Terrain::RegenerateDirtyTerrainPatches()
 {
     PROFILE(EC_Terrain_RegenerateDirtyTerrainPatches);
 
+    // Find the rectangle of changed patches for the listeners of PatchesRegenerated.
+    int dirtyFirstX = patchWidth, dirtyFirstY = patchHeight, dirtyLastX = -1, dirtyLastY = -1;
     for(int y = 0; y < patchHeight; ++y)
         for(int x = 0; x < patchWidth; ++x)
         {
-            EC_Terrain::Patch &scenePatch = GetPatch(x, y);
-            if (!scenePatch.patch_geometry_dirty || scenePatch.heightData.size() == 0)
-                continue;
-
-            bool neighborsLoaded = true;
+            const EC_Terrain::Patch &patch = GetPatch(x, y);
+            if (patch.patch_geometry_dirty && patch.heightData.size() > 0)
+            {
+                dirtyFirstX = min(dirtyFirstX, x);
+                dirtyFirstY = min(dirtyFirstY, y);
+                dirtyLastX = max(dirtyLastX, x);
+                dirtyLastY = max(dirtyLastY, y);
+            }
+        }
 
-            const int neighbors[8][2] = 
-            { 
-                { -1, -1 }, { -1, 0 }, { -1, 1 },
-                {  0, -1 },            {  0, 1 },
-                {  1, -1 }, {  1, 0 }, {  1, 1 }
-            };
+    // A chunk also depends on the patches around it: it contains the first vertices of the next patch row and column
+    // for the seams, and the normals on its edges are computed from the neighboring patches.
+    std::vector<bool> chunkBlocked(chunks.size(), false);
+    for(int cy = 0; cy < chunkHeight; ++cy)
+        for(int cx = 0; cx < chunkWidth; ++cx)
+        {
+            const int firstX = max(0, cx * cChunkSize - 1);
+            const int lastX = min(patchWidth - 1, (cx + 1) * cChunkSize);
+            const int firstY = max(0, cy * cChunkSize - 1);
+            const int lastY = min(patchHeight - 1, (cy + 1) * cChunkSize);
 
-            for(int i = 0; i < 8; ++i)
-            {
-                int nX = x + neighbors[i][0];
-                int nY = y + neighbors[i][1];
-                if (nX >= 0 && nX < patchWidth &&
-                    nY >= 0 && nY < patchHeight &&
-                    GetPatch(nX, nY).heightData.size() == 0)
+            bool dirty = false;
+            bool neighborsLoaded = true;
+            for(int y = firstY; y <= lastY; ++y)
+                for(int x = firstX; x <= lastX; ++x)
                 {
-                    neighborsLoaded = false;
-                    break;
+                    const EC_Terrain::Patch &patch = GetPatch(x, y);
+                    dirty = dirty || patch.patch_geometry_dirty;
+                    neighborsLoaded = neighborsLoaded && patch.heightData.size() > 0;
                 }
-            }
 
-            if (neighborsLoaded)
-                GenerateTerrainGeometryForOnePatch(x, y);
+            if (!dirty || !ViewEnabled()) // Without rendering there is no GPU geometry to wait for.
+                continue;
+            if (!neighborsLoaded || !GenerateTerrainGeometryForChunk(cx, cy))
+                chunkBlocked[cy * chunkWidth + cx] = true;
+        }
+
+    // A patch stays dirty until all the chunks depending on it have been regenerated.
+    for(int y = 0; y < patchHeight; ++y)
+        for(int x = 0; x < patchWidth; ++x)
+        {
+            EC_Terrain::Patch &patch = GetPatch(x, y);
+            if (!patch.patch_geometry_dirty)
+                continue;
+            bool blocked = false;
+            for(int cy = max(0, (y - 1) / cChunkSize); cy <= min(chunkHeight - 1, (y + 1) / cChunkSize); ++cy)
+                for(int cx = max(0, (x - 1) / cChunkSize); cx <= min(chunkWidth - 1, (x + 1) / cChunkSize); ++cx)
+                    blocked = blocked || chunkBlocked[cy * chunkWidth + cx];
+            if (!blocked)
+                patch.patch_geometry_dirty = false;
         }
-    
-    // All the new geometry we created will be visible for Ogre by default. If the EC_Placeable's visible attribute is false,
-    // we need to hide all newly created geometry.
-    AttachTerrainRootNode();
 
     ///\todo If this terrain only exists for physics heightfield purposes, don't create GPU resources for it at all.
 
+    if (dirtyLastX >= 0)
+        emit PatchesRegenerated(dirtyFirstX, dirtyFirstY, dirtyLastX, dirtyLastY);
     emit TerrainRegenerated();
 }
@@ -10,6 +10,9 @@
 #include "AssetFwd.h"
 #include "AssetRefListener.h"
 #include "OgreModuleFwd.h"
+#include "TerrainChunkGeometry.h"
+
+#include <QFuture>
 
 namespace Ogre { class Matrix4; }
 
@@ -21,7 +24,8 @@ namespace Ogre { class Matrix4; }
 <td>
 <h2>Terrain</h2>
 Adds a heightmap-based terrain to the scene. A Terrain is composed of a rectangular grid of adjacent "patches".
-Each patch is a fixed-size 16x16 height map.
+Each patch is a fixed-size 16x16 height map. For rendering, the patches are grouped into chunks of 4x4 patches,
+and each chunk is drawn with a level of detail chosen by the distance to the camera.
 
 Registered by Environment::EnvironmentModule.
 
@@ -109,15 +113,19 @@ public:
     /// Each patch is a square containing this many vertices per side.
     static const int cPatchSize = 16;
 
+    /// The patches are rendered in square chunks containing this many patches per side.
+    static const int cChunkSize = 4;
+
     /// Describes a single patch that is present in the scene.
     /** A patch can be in one of the following three states:
-        - not loaded. The height data nor the GPU data is present, but the Patch struct itself is initialized. heightData.size() == 0, node == entity == 0. meshGeometryName == "".
+        - not loaded. The height data nor the GPU data is present, but the Patch struct itself is initialized. heightData.size() == 0.
         - heightmap data loaded. The heightData vector contains the heightmap data, but the visible GPU vertex data itself has not been generated yet, due to the neighbors
-          of this patch not being present yet. node == entity == 0, meshGeometryName == "". patch_geometry_dirty == true.
-        - fully loaded. The GPU data is also loaded and the node, entity and meshGeometryName fields specify the used GPU resources. */
+          of this patch not being present yet. patch_geometry_dirty == true.
+        - fully loaded. The GPU data is also loaded.
+        The GPU resources are owned by the render chunk the patch belongs to, see NumChunks and GetChunkEntity. */
     struct Patch
     {
-        Patch():x(0),y(0), node(0), entity(0), patch_geometry_dirty(true) {}
+        Patch():x(0),y(0), patch_geometry_dirty(true) {}
 
         /// X-coordinate on the grid of patches. In the range [0, EC_Terrain::PatchWidth()].
         int x;
@@ -129,15 +137,6 @@ public:
         /// If the length is zero, this patch hasn't been loaded in yet.
         std::vector<float> heightData;
 
-        /// Ogre -specific: Store a reference to the actual render hierarchy node.
-        Ogre::SceneNode *node;
-
-        /// Ogre -specific: Store a reference to the entity that is attached to the above SceneNode.
-        Ogre::Entity *entity;
-
-        /// The name of the Ogre Mesh resource that contains the GPU geometry data for this patch.
-        std::string meshGeometryName;
-
         /// If true, the CPU-side heightmap data has changed, but we haven't yet updated
         /// the GPU-side geometry resources since the neighboring patches haven't been loaded
         /// in yet.
@@ -259,6 +258,7 @@ public slots:
     void Destroy();
 
     /// Releases all GPU resources used for the given patch.
+    /** The GPU resources are shared by all the patches of the same chunk, so this releases and dirties the whole chunk. */
     void DestroyPatch(int patchX, int patchY);
 
     /// Makes all the vertices of the given patch flat with the given height value.
@@ -288,6 +288,13 @@ public slots:
     /// This value is understood in the similar way as above.
     int PatchHeight() const { return patchHeight; }
 
+    /// Returns the number of render chunks the terrain is drawn in. Each chunk covers cChunkSize x cChunkSize patches.
+    int NumChunks() const { return (int)chunks.size(); }
+
+    /// Returns the Ogre entity of a render chunk, or null if the geometry of the chunk has not been created yet.
+    /** @param chunkIndex Index of the chunk, in the range [0, NumChunks()[. */
+    Ogre::Entity *GetChunkEntity(int chunkIndex) const { return chunks[chunkIndex].entity; }
+
     /// Returns the number of vertices in the whole terrain in the local X-direction.
     int VerticesWidth() const { return PatchWidth() * cPatchSize; }
 
@@ -350,6 +357,9 @@ public slots:
     /// Marks all terrain patches dirty.
     void DirtyAllTerrainPatches();
 
+    /// Regenerates the GPU geometry of the chunks that contain dirty patches.
+    /** The vertex data is built in worker threads and copied to the GPU in the main thread during a later frame update.
+        The chunks keep showing their old geometry until then. */
     void RegenerateDirtyTerrainPatches();
 
     /// Returns the minimum height value in the whole terrain.
@@ -364,6 +374,10 @@ signals:
     /// Emitted when the terrain data is regenerated.
     void TerrainRegenerated();
 
+    /// Emitted by RegenerateDirtyTerrainPatches before TerrainRegenerated, with the bounding rectangle of the patches whose height data has changed.
+    /** The patch coordinates are inclusive. Not emitted if no patch was dirty. If the terrain has been resized, all the patches are reported as changed. */
+    void PatchesRegenerated(int firstPatchX, int firstPatchY, int lastPatchX, int lastPatchY);
+
 private slots:
     /// Emitted when the parrent entity has been set.
     void UpdateSignals();
@@ -375,6 +389,9 @@ private slots:
     void TextureAssetLoaded(AssetPtr asset);
     void TerrainAssetLoaded(AssetPtr asset);
 
+    /// Uploads the finished chunk geometry to the GPU and updates the chunk LOD levels.
+    void OnFrameUpdated(float frameTime);
+
     /// (Re)checks whether this entity has EC_Placeable (or if it was just added or removed), and reparents the rootNode of this component to it or the scene root.
     /** Additionally re-applies the visibility of each terrain patch that is currently attached to the terrain node. */
     void AttachTerrainRootNode();
@@ -384,10 +401,33 @@ private:
     /** After this function returns, the 'root' member node will exist, unless Ogre rendering subsystem fails. */
     void CreateRootNode();
 
-    void CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, int patchX, int patchY);
+    /// A render chunk of cChunkSize x cChunkSize patches.
+    struct Chunk
+    {
+        Chunk() : node(0), entity(0), lod(0), generation(0) {}
 
-    /// Sets the given patch to use the currently set material and textures.
-    void UpdateTerrainPatchMaterial(int patchX, int patchY);
+        Ogre::SceneNode *node;
+        Ogre::Entity *entity;
+        /// The name of the Ogre Mesh resource. The mesh has one submesh per LOD level, all sharing the same vertices.
+        std::string meshGeometryName;
+        /// The LOD level that is currently visible.
+        int lod;
+        /// Identifies the latest geometry requested for the chunk, so that finished but out of date geometry can be discarded. 0 if none.
+        unsigned int generation;
+    };
+
+    Chunk &GetChunk(int chunkX, int chunkY) { return chunks[chunkY * chunkWidth + chunkX]; }
+
+    /// Releases the GPU resources of the given chunk. A pending geometry build of the chunk will be discarded when it finishes.
+    void DestroyChunk(int chunkX, int chunkY);
+
+    /// Reallocates the chunk grid to cover the current patch grid. All chunks must have been destroyed before calling this.
+    void ResizeChunks();
+
+    void CreateOgreTerrainChunkNode(Ogre::SceneNode *&node, int chunkX, int chunkY);
+
+    /// Sets the given chunk to use the currently set material and textures.
+    void UpdateTerrainChunkMaterial(Chunk &chunk);
 
     /// Updates the root node transform from the current attribute values, if the root node exists.
     void UpdateRootNodeTransform();
@@ -402,7 +442,22 @@ private:
     /// @param textureName The Ogre texture resource name to set.
     void SetTerrainMaterialTexture(int index, const char *textureName);
 
-    void GenerateTerrainGeometryForOnePatch(int patchX, int patchY);
+    /// Starts building the geometry for the given chunk in a worker thread.
+    /** A copy of the height values is taken for the worker, so the terrain can be modified while the build is in progress.
+        @return False if the geometry could not be requested, e.g. because the rendering is disabled. */
+    bool GenerateTerrainGeometryForChunk(int chunkX, int chunkY);
+
+    /// Copies the finished geometry of a chunk to the GPU, and creates the entity showing it.
+    void UploadChunkGeometry(const TerrainChunkGeometry &geometry);
+
+    /// Uploads all the chunk geometry that has been finished in the worker threads.
+    void UploadFinishedChunks();
+
+    /// Waits for all the pending geometry builds to finish and throws away the results.
+    void DiscardPendingChunkGeometry();
+
+    /// Selects the LOD level of each chunk based on its distance to the main camera.
+    void UpdateChunkLods();
 
     boost::shared_ptr<AssetRefListener> heightMapAsset;
 
@@ -422,6 +477,17 @@ private:
 
     /// Stores the actual height patches.
     std::vector<Patch> patches;
+
+    /// The render chunks, chunkWidth x chunkHeight of them.
+    std::vector<Chunk> chunks;
+    int chunkWidth;
+    int chunkHeight;
+
+    /// The chunk geometry builds running in worker threads.
+    std::vector<QFuture<TerrainChunkGeometry*> > pendingChunkGeometry;
+
+    /// The last generation number given to a chunk geometry request.
+    unsigned int chunkGenerationCounter;
     
     /// Ogre world for referring to the Ogre scene manager
     OgreWorldWeakPtr world_;
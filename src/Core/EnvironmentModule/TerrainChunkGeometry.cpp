@@ -0,0 +1,192 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "TerrainChunkGeometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+
+/// Returns true if the vertex at coordinate c is used on the LOD level with the given vertex step, when the edge has q quads.
+/** The last vertex is always used, so the last quad of a LOD level can be narrower than the others. */
+bool IsSampled(int c, int q, int step)
+{
+    return c == q || c % step == 0;
+}
+
+/// A vertex on the chunk edge, in the order the edges are walked.
+struct PerimeterVertex
+{
+    int x;
+    int y;
+    int edge; ///< 0: y == 0, 1: x == quadsX, 2: y == quadsY, 3: x == 0.
+};
+
+}
+
+TerrainChunkGeometry *BuildTerrainChunkGeometry(TerrainChunkJob job)
+{
+    TerrainChunkGeometry *geometry = new TerrainChunkGeometry;
+    geometry->chunkX = job.chunkX;
+    geometry->chunkY = job.chunkY;
+    geometry->generation = job.generation;
+    geometry->quadsX = job.quadsX;
+    geometry->quadsY = job.quadsY;
+
+    const int qx = job.quadsX;
+    const int qy = job.quadsY;
+    const int stride = qx + 1;
+    const size_t numGridVertices = (size_t)(qx + 1) * (qy + 1);
+
+    // Walk the chunk edges so that the outside of the chunk is always on the same side. This gives the skirts a consistent winding.
+    std::vector<PerimeterVertex> perimeter;
+    perimeter.reserve(2*qx + 2*qy);
+    for(int x = 0; x < qx; ++x) { PerimeterVertex v = { x, 0, 0 }; perimeter.push_back(v); }
+    for(int y = 0; y < qy; ++y) { PerimeterVertex v = { qx, y, 1 }; perimeter.push_back(v); }
+    for(int x = qx; x > 0; --x) { PerimeterVertex v = { x, qy, 2 }; perimeter.push_back(v); }
+    for(int y = qy; y > 0; --y) { PerimeterVertex v = { 0, y, 3 }; perimeter.push_back(v); }
+
+    // Skirts are only needed between chunks, not on the outer edges of the terrain.
+    const bool skirtOnEdge[4] =
+    {
+        job.vertexY > 0,
+        job.vertexX + qx < job.terrainVerticesWidth - 1,
+        job.vertexY + qy < job.terrainVerticesHeight - 1,
+        job.vertexX > 0
+    };
+
+    float minHeight = job.Height(0, 0);
+    float maxHeight = minHeight;
+    for(int y = 0; y <= qy; ++y)
+        for(int x = 0; x <= qx; ++x)
+        {
+            minHeight = std::min(minHeight, job.Height(x, y));
+            maxHeight = std::max(maxHeight, job.Height(x, y));
+        }
+    // A coarser LOD level can not deviate from the full resolution surface more than the height range of the chunk.
+    const float skirtDepth = std::max(1.f, maxHeight - minHeight);
+
+    geometry->numVertices = numGridVertices + perimeter.size();
+    geometry->vertices.resize(geometry->numVertices * TerrainChunkGeometry::cVertexSize);
+    float *v = &geometry->vertices[0];
+
+    const float uvMaskScaleX = 1.f / (job.terrainVerticesWidth - 1);
+    const float uvMaskScaleY = 1.f / (job.terrainVerticesHeight - 1);
+
+    for(int y = 0; y <= qy; ++y)
+        for(int x = 0; x <= qx; ++x)
+        {
+            const int px = job.vertexX + x;
+            const int py = job.vertexY + y;
+
+            // Same normal as EC_Terrain::CalculateNormal gives.
+            float xSlope = job.Height(x-1, y) - job.Height(x+1, y);
+            if (px <= 0)
+                xSlope *= 2;
+            float ySlope = job.Height(x, y-1) - job.Height(x, y+1);
+            if (py <= 0)
+                ySlope *= 2;
+            const float invLength = 1.f / sqrtf(xSlope*xSlope + 4.f + ySlope*ySlope);
+
+            // Note: heightmap X & Y correspond to X & Z world axes, while height is world Y
+            *v++ = (float)x;
+            *v++ = job.Height(x, y);
+            *v++ = (float)y;
+            *v++ = xSlope * invLength;
+            *v++ = 2.f * invLength;
+            *v++ = ySlope * invLength;
+            // The UV set 0 contains the diffuse texture UV map. Do a planar mapping with the given specified UV scale.
+            *v++ = px * job.uScale;
+            *v++ = py * job.vScale;
+            // The UV set 1 contains the terrain blend mask UV map, which stretches once across the whole terrain.
+            *v++ = px * uvMaskScaleX;
+            *v++ = py * uvMaskScaleY;
+        }
+
+    // The skirt vertices are copies of the edge vertices, moved down.
+    for(size_t i = 0; i < perimeter.size(); ++i)
+    {
+        const float *src = &geometry->vertices[(perimeter[i].y * stride + perimeter[i].x) * TerrainChunkGeometry::cVertexSize];
+        std::copy(src, src + TerrainChunkGeometry::cVertexSize, v);
+        v[1] -= skirtDepth;
+        v += TerrainChunkGeometry::cVertexSize;
+    }
+
+    geometry->minHeight = minHeight - skirtDepth;
+    geometry->maxHeight = maxHeight;
+
+    std::vector<int> columns;
+    std::vector<int> rows;
+    std::vector<size_t> sampledPerimeter;
+    for(int lod = 0; lod < TerrainChunkGeometry::cNumLodLevels; ++lod)
+    {
+        const int step = 1 << lod;
+        std::vector<u16> &indices = geometry->indices[lod];
+
+        columns.clear();
+        rows.clear();
+        for(int x = 0; x <= qx; ++x)
+            if (IsSampled(x, qx, step))
+                columns.push_back(x);
+        for(int y = 0; y <= qy; ++y)
+            if (IsSampled(y, qy, step))
+                rows.push_back(y);
+
+        indices.reserve((columns.size()-1) * (rows.size()-1) * 6 + perimeter.size() * 6 / step);
+        for(size_t j = 0; j + 1 < rows.size(); ++j)
+            for(size_t i = 0; i + 1 < columns.size(); ++i)
+            {
+                const u16 i00 = (u16)(rows[j] * stride + columns[i]);
+                const u16 i10 = (u16)(rows[j] * stride + columns[i+1]);
+                const u16 i01 = (u16)(rows[j+1] * stride + columns[i]);
+                const u16 i11 = (u16)(rows[j+1] * stride + columns[i+1]);
+
+                // Note: winding needs to be flipped when terrain X axis goes along world X axis and terrain Y axis along world Z
+                indices.push_back(i01);
+                indices.push_back(i10);
+                indices.push_back(i00);
+
+                indices.push_back(i01);
+                indices.push_back(i11);
+                indices.push_back(i10);
+            }
+
+        sampledPerimeter.clear();
+        for(size_t i = 0; i < perimeter.size(); ++i)
+        {
+            const PerimeterVertex &p = perimeter[i];
+            const bool alongX = (p.edge == 0 || p.edge == 2);
+            if (IsSampled(alongX ? p.x : p.y, alongX ? qx : qy, step))
+                sampledPerimeter.push_back(i);
+        }
+
+        for(size_t k = 0; k < sampledPerimeter.size(); ++k)
+        {
+            const size_t a = sampledPerimeter[k];
+            const size_t b = sampledPerimeter[(k + 1) % sampledPerimeter.size()];
+            if (!skirtOnEdge[perimeter[a].edge])
+                continue;
+
+            const u16 top0 = (u16)(perimeter[a].y * stride + perimeter[a].x);
+            const u16 top1 = (u16)(perimeter[b].y * stride + perimeter[b].x);
+            const u16 bottom0 = (u16)(numGridVertices + a);
+            const u16 bottom1 = (u16)(numGridVertices + b);
+
+            indices.push_back(top0);
+            indices.push_back(top1);
+            indices.push_back(bottom0);
+
+            indices.push_back(top1);
+            indices.push_back(bottom1);
+            indices.push_back(bottom0);
+        }
+    }
+
+    return geometry;
+}
@@ -0,0 +1,77 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+/// Input for building the render geometry of one EC_Terrain chunk.
+/** The job carries its own copy of the height values the chunk needs, so that the geometry can be built
+    in a worker thread while the main thread keeps modifying the terrain. */
+struct TerrainChunkJob
+{
+    TerrainChunkJob() : chunkX(0), chunkY(0), generation(0), vertexX(0), vertexY(0), quadsX(0), quadsY(0),
+        terrainVerticesWidth(0), terrainVerticesHeight(0), uScale(1.f), vScale(1.f) {}
+
+    /// Chunk coordinates on the grid of chunks.
+    int chunkX;
+    int chunkY;
+    /// Generation of the chunk at the time the job was created. Used to discard results that are out of date.
+    unsigned int generation;
+
+    /// The terrain vertex at the chunk origin.
+    int vertexX;
+    int vertexY;
+    /// Number of quads the chunk covers in the x and y directions.
+    int quadsX;
+    int quadsY;
+
+    /// Size of the whole terrain in vertices.
+    int terrainVerticesWidth;
+    int terrainVerticesHeight;
+
+    float uScale;
+    float vScale;
+
+    /// Height values of the chunk with a one vertex border for the normal calculation, (quadsX+3)*(quadsY+3) values.
+    /// The border values are clamped to the terrain edges in the same way as EC_Terrain::GetPoint does.
+    std::vector<float> heights;
+
+    /// Returns the height of the chunk vertex (x,y), where x and y can also be -1 or one past the last vertex.
+    float Height(int x, int y) const { return heights[(y+1)*(quadsX+3) + x+1]; }
+};
+
+/// CPU-side render geometry of one EC_Terrain chunk, ready to be copied to the GPU.
+/** All LOD levels share the same vertex buffer, which contains the chunk at full resolution followed by the skirt vertices.
+    Each LOD level has its own index list. The LOD level n samples every 2^n:th vertex. Cracks between chunks of different
+    LOD levels are hidden by skirts, i.e. vertical strips hanging down from the chunk edges. No skirts are generated
+    on the outer edges of the whole terrain. */
+struct TerrainChunkGeometry
+{
+    /// Number of LOD levels generated for each chunk.
+    static const int cNumLodLevels = 4;
+
+    /// Number of floats per vertex: position, normal, diffuse UV and blend mask UV.
+    static const int cVertexSize = 10;
+
+    TerrainChunkGeometry() : chunkX(0), chunkY(0), generation(0), quadsX(0), quadsY(0), numVertices(0), minHeight(0.f), maxHeight(0.f) {}
+
+    int chunkX;
+    int chunkY;
+    unsigned int generation;
+    int quadsX;
+    int quadsY;
+
+    size_t numVertices;
+    std::vector<float> vertices;
+    std::vector<u16> indices[cNumLodLevels];
+
+    /// Height range of the geometry, including the skirts.
+    float minHeight;
+    float maxHeight;
+};
+
+/// Builds the geometry for the given chunk. Thread-safe, does not access anything but the job.
+/** The caller takes ownership of the returned object. */
+TerrainChunkGeometry *BuildTerrainChunkGeometry(TerrainChunkJob job);
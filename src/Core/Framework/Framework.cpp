@@ -136,9 +136,11 @@ Framework::Framework(int argc, char** argv) :
     cmdLineDescs.commands["--connect"] = "Connects to a Tundra server automatically. Syntax: '--connect serverIp;port;protocol;name;password'. Password is optional.";
     cmdLineDescs.commands["--login"] = "Automatically login to server using provided data. Url syntax: {tundra|http|https}://host[:port]/?username=x[&password=y&avatarurl=z&protocol={udp|tcp}]. Minimum information needed to try a connection in the url are host and username";
     cmdLineDescs.commands["--netrate"] = "Specifies the number of network updates per second. Default: 30."; // TundraLogicModule
+    cmdLineDescs.commands["--nonetcompression"] = "Do not compress the scene sync messages sent to clients."; // TundraLogicModule
     cmdLineDescs.commands["--noassetcache"] = "Disable asset cache.";
     cmdLineDescs.commands["--assetcachedir"] = "Specify asset cache directory to use.";
     cmdLineDescs.commands["--clear-asset-cache"] = "At the start of Tundra, remove all data and metadata files from asset cache.";
+    cmdLineDescs.commands["--threadedphysics"] = "Step physics simulation in a worker thread, in parallel with the rest of the frame. Physics results lag one frame behind."; // PhysicsModule
 
     if (HasCommandLineParameter("--help"))
     {
@@ -11,6 +11,7 @@
 #include "EC_Placeable.h"
 #include "EC_Mesh.h"
 #include "OgreConversionUtils.h"
+#include "MeshInstanceBatcher.h"
 #include "OgreSkeletonAsset.h"
 #include "OgreMeshAsset.h"
 #include "OgreMaterialAsset.h"
@@ -35,7 +36,9 @@ EC_Mesh::EC_Mesh(Scene* scene) :
     meshMaterial(this, "Mesh materials", AssetReferenceList("OgreMaterial")),
     drawDistance(this, "Draw distance", 0.0f),
     castShadows(this, "Cast shadows", false),
+    useInstancing(this, "Use instancing", false),
     entity_(0),
+    instanceId_(0),
     attached_(false)
 {
     if (scene)
@@ -401,6 +404,7 @@ void EC_Mesh::RemoveMesh()
         emit MeshAboutToBeDestroyed();
         
         RemoveAllAttachments();
+        RemoveInstance();
         DetachEntity();
         
         Ogre::SceneManager* sceneMgr = world->GetSceneManager();
@@ -610,6 +614,8 @@ bool EC_Mesh::SetMaterial(uint index, const std::string& material_name)
     try
     {
         entity_->getSubEntity(index)->setMaterialName(AssetAPI::SanitateAssetRef(material_name));
+        if (instanceId_)
+            UpdateInstancing();
         emit MaterialChanged(index, QString(material_name.c_str()));
     }
     catch(Ogre::Exception& e)
@@ -771,6 +777,8 @@ void EC_Mesh::DetachEntity()
     if ((!attached_) || (!entity_) || (!placeable_))
         return;
     
+    RemoveInstance();
+
     EC_Placeable* placeable = checked_static_cast<EC_Placeable*>(placeable_.get());
     Ogre::SceneNode* node = placeable->GetSceneNode();
     adjustment_node_->detachObject(entity_);
@@ -792,6 +800,32 @@ void EC_Mesh::AttachEntity()
     adjustment_node_->setVisible(placeable->visible.Get());
 
     attached_ = true;
+
+    UpdateInstancing();
+}
+
+void EC_Mesh::UpdateInstancing()
+{
+    RemoveInstance();
+    if (!useInstancing.Get() || !entity_ || !attached_)
+        return;
+
+    OgreWorldPtr world = world_.lock();
+    if (!world || !world->GetInstanceBatcher())
+        return;
+    if (MeshInstanceBatcher::CanInstance(entity_))
+        instanceId_ = world->GetInstanceBatcher()->AddInstance(entity_);
+}
+
+void EC_Mesh::RemoveInstance()
+{
+    if (!instanceId_)
+        return;
+
+    OgreWorldPtr world = world_.lock();
+    if (world && world->GetInstanceBatcher())
+        world->GetInstanceBatcher()->RemoveInstance(instanceId_);
+    instanceId_ = 0;
 }
 
 Ogre::Mesh* EC_Mesh::PrepareMesh(const std::string& mesh_name, bool clone)
@@ -882,8 +916,14 @@ void EC_Mesh::OnAttributeUpdated(IAttribute *attribute)
                 if (attachment_entities_[i])
                     attachment_entities_[i]->setCastShadows(castShadows.Get());
             }
+            if (instanceId_)
+                UpdateInstancing();
         }
     }
+    else if (attribute == &useInstancing)
+    {
+        UpdateInstancing();
+    }
     else if (attribute == &nodeTransformation)
     {
         Transform newTransform = nodeTransformation.Get();
@@ -45,6 +45,8 @@ Registered by OgreRenderer::OgreRenderingModule.
 <div>Distance where the mesh is shown from the camera, 0.0 = draw always (default).</div> 
 <li>bool: castShadows
 <div>Will the mesh cast shadows.</div> 
+<li>bool: useInstancing
+<div>Will the mesh be drawn in a batch together with other meshes using the same mesh and materials.</div> 
 </ul>
 
 <b>Exposes the following scriptable functions:</b>
@@ -170,6 +172,12 @@ public:
     Q_PROPERTY(bool castShadows READ getcastShadows WRITE setcastShadows);
     DEFINE_QPROPERTY_ATTRIBUTE(bool, castShadows);
 
+    /// Will the mesh be drawn in a batch together with other meshes using the same mesh and materials.
+    /** Reduces the draw calls of scenes with many copies of the same static mesh. Meshes with a skeleton or vertex animation
+        are always drawn individually. The draw distance is not applied to instanced meshes. */
+    Q_PROPERTY(bool useInstancing READ getuseInstancing WRITE setuseInstancing);
+    DEFINE_QPROPERTY_ATTRIBUTE(bool, useInstancing);
+
 public slots:
     /// Automatically finds the placeable from the parent entity and sets it.
     void AutoSetPlaceable();
@@ -451,6 +459,13 @@ private:
     /// detaches entity from placeable
     void DetachEntity();
 
+    /// Adds the entity to the instance batches of the world, or removes it, according to the useInstancing attribute
+    /** The entity is re-added, as the batch it belongs to depends on the mesh, materials and shadow casting. */
+    void UpdateInstancing();
+
+    /// Removes the entity from the instance batches of the world, if it is instanced
+    void RemoveInstance();
+
     bool HasMaterialsChanged() const;
 
     /// placeable component 
@@ -462,6 +477,9 @@ private:
     /// Ogre mesh entity
     Ogre::Entity* entity_;
 
+    /// Id of the entity in the instance batcher of the world, or 0 if not instanced
+    uint instanceId_;
+
     /// Attachment entities
     std::vector<Ogre::Entity*> attachment_entities_;
     /// Attachment nodes
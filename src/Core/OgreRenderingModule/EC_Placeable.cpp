@@ -206,6 +206,7 @@ EC_Placeable::EC_Placeable(Scene* scene) :
             SLOT(HandleAttributeChanged(IAttribute*, AttributeChange::Type)));
 
         connect(this, SIGNAL(ParentEntitySet()), SLOT(RegisterActions()));
+        connect(this, SIGNAL(ParentEntityDetached()), SLOT(CancelPendingParent()));
     
         AttachNode();
     }
@@ -213,6 +214,8 @@ EC_Placeable::EC_Placeable(Scene* scene) :
 
 EC_Placeable::~EC_Placeable()
 {
+    CancelPendingParent();
+    
     if (world_.expired())
     {
         if (sceneNode_)
@@ -263,9 +266,9 @@ void EC_Placeable::AttachNode()
         // 1) attach to scene root node
         // 2) attach to another EC_Placeable's scene node
         // 3) attach to a bone on a skeletal mesh
-        // Disconnect from the EntityCreated & ParentMeshChanged signals, as responding to them might not be needed anymore.
+        // Stop waiting for the parent entity & disconnect from the ParentMeshChanged signals, as responding to them might not be needed anymore.
         // We will reconnect signals as necessary
-        disconnect(this, SLOT(CheckParentEntityCreated(Entity*, AttributeChange::Type)));
+        CancelPendingParent();
         disconnect(this, SLOT(OnParentMeshChanged()));
         disconnect(this, SLOT(OnComponentAdded(IComponent*, AttributeChange::Type)));
         
@@ -281,7 +284,8 @@ void EC_Placeable::AttachNode()
             if (!scene)
                 return;
 
-            Entity* parentEntity = parent.Lookup(scene).get();
+            // If the parent entity is not found, wait for it to be created into the scene
+            Entity* parentEntity = parent.Lookup(scene, &EC_Placeable::ParentEntityCreated, this).get();
             if (parentEntity == ownEntity)
             {
                 // If we refer to self, attach to the root
@@ -354,8 +358,8 @@ void EC_Placeable::AttachNode()
             }
             else
             {
-                // Could not find parent entity. Check for it later, when new entities are created into the scene
-                connect(scene, SIGNAL(EntityCreated(Entity*, AttributeChange::Type)), this, SLOT(CheckParentEntityCreated(Entity*, AttributeChange::Type)), Qt::UniqueConnection);
+                // Could not find parent entity. The scene calls us back when it is created
+                pendingParentScene_ = scene->shared_from_this();
                 return;
             }
         }
@@ -711,12 +715,30 @@ void EC_Placeable::CheckParentEntityCreated(Entity* entity, AttributeChange::Typ
 {
     if ((!attached_) && (entity))
     {
-        // Check if the entity is the one we should use as parent
-        if (entity == parentRef.Get().Lookup(entity->ParentScene()).get())
+        // The scene dropped the waiter, so if the parent ref still does not resolve, wait again
+        Scene* scene = entity->ParentScene();
+        if (parentRef.Get().Lookup(scene, &EC_Placeable::ParentEntityCreated, this))
             AttachNode();
+        else if (scene)
+            pendingParentScene_ = scene->shared_from_this();
     }
 }
 
+void EC_Placeable::ParentEntityCreated(void *userData, Entity *entity)
+{
+    EC_Placeable *placeable = static_cast<EC_Placeable*>(userData);
+    placeable->pendingParentScene_.reset();
+    placeable->CheckParentEntityCreated(entity, AttributeChange::Default);
+}
+
+void EC_Placeable::CancelPendingParent()
+{
+    ScenePtr scene = pendingParentScene_.lock();
+    if (scene)
+        scene->RemovePendingEntityReferences(this);
+    pendingParentScene_.reset();
+}
+
 void EC_Placeable::OnParentMeshChanged()
 {
     if (!attached_)
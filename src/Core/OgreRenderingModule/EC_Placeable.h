@@ -289,6 +289,9 @@ private slots:
     /// Handle a component being added to the parent entity, in case it is the missing component we need
     void OnComponentAdded(IComponent* component, AttributeChange::Type change);
 
+    /// Stop waiting for the parent entity to be created
+    void CancelPendingParent();
+
 private:
     /// attaches scenenode to parent
     void AttachNode();
@@ -296,6 +299,9 @@ private:
     /// detaches scenenode from parent
     void DetachNode();
     
+    /// Scene pending entity reference handler, forwards to CheckParentEntityCreated
+    static void ParentEntityCreated(void *userData, Entity *entity);
+    
     /// Ogre world ptr
     OgreWorldWeakPtr world_;
     
@@ -316,6 +322,9 @@ private:
 
     /// attached to scene hierarchy-flag
     bool attached_;
+    
+    /// Scene in which we wait for the parent entity to be created, if any
+    SceneWeakPtr pendingParentScene_;
 
     friend class BoneAttachmentListener;
     friend class CustomTagPoint;
@@ -0,0 +1,631 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "MeshInstanceBatcher.h"
+#include "Math/float3x4.h"
+#include "Math/float3.h"
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include <Ogre.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#include "MemoryLeakCheck.h"
+
+/// Draws one submesh of the instances of a MeshInstanceBatcher batch.
+/** The vertex buffer has room for the full capacity of the batch, and the index buffer is filled with the index pattern
+    of every slot in advance, so changing the number of instances only changes the index count. */
+class InstanceBatchRenderable : public Ogre::SimpleRenderable
+{
+public:
+    InstanceBatchRenderable(const InstanceBatchSource &source, Ogre::VertexDeclaration *declaration, uint capacity) :
+        verticesPerInstance_(source.numVertices),
+        indicesPerInstance_((uint)source.indices.size()),
+        vertexBytes_(source.vertexSize * sizeof(float))
+    {
+        Ogre::HardwareBufferManager &bufferMgr = Ogre::HardwareBufferManager::getSingleton();
+
+        mRenderOp.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+        mRenderOp.useIndexes = true;
+
+        mRenderOp.vertexData = new Ogre::VertexData();
+        bufferMgr.destroyVertexDeclaration(mRenderOp.vertexData->vertexDeclaration);
+        mRenderOp.vertexData->vertexDeclaration = declaration->clone();
+        vertexBuffer_ = bufferMgr.createVertexBuffer(vertexBytes_, capacity * verticesPerInstance_, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY);
+        mRenderOp.vertexData->vertexBufferBinding->setBinding(0, vertexBuffer_);
+        mRenderOp.vertexData->vertexStart = 0;
+        mRenderOp.vertexData->vertexCount = 0;
+
+        std::vector<u16> indices(capacity * indicesPerInstance_);
+        for(uint i = 0; i < capacity; ++i)
+            for(uint j = 0; j < indicesPerInstance_; ++j)
+                indices[i * indicesPerInstance_ + j] = (u16)(i * verticesPerInstance_ + source.indices[j]);
+
+        mRenderOp.indexData = new Ogre::IndexData();
+        mRenderOp.indexData->indexBuffer = bufferMgr.createIndexBuffer(Ogre::HardwareIndexBuffer::IT_16BIT, indices.size(),
+            Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        mRenderOp.indexData->indexBuffer->writeData(0, indices.size() * sizeof(u16), &indices[0], true);
+        mRenderOp.indexData->indexStart = 0;
+        mRenderOp.indexData->indexCount = 0;
+
+        mBox.setNull();
+    }
+
+    ~InstanceBatchRenderable()
+    {
+        delete mRenderOp.vertexData;
+        delete mRenderOp.indexData;
+    }
+
+    /// Uploads the vertices of the instance in the given slot.
+    void WriteInstance(uint slot, const float *vertices)
+    {
+        const size_t bytes = verticesPerInstance_ * vertexBytes_;
+        vertexBuffer_->writeData(slot * bytes, bytes, vertices);
+    }
+
+    /// Sets the number of instances to draw from the start of the buffers.
+    void SetNumInstances(uint numInstances)
+    {
+        mRenderOp.vertexData->vertexCount = numInstances * verticesPerInstance_;
+        mRenderOp.indexData->indexCount = numInstances * indicesPerInstance_;
+    }
+
+    void SetBounds(const Ogre::AxisAlignedBox &bounds)
+    {
+        mBox = bounds;
+    }
+
+    virtual Ogre::Real getSquaredViewDepth(const Ogre::Camera *camera) const
+    {
+        if (mBox.isNull())
+            return 0.f;
+        return (camera->getDerivedPosition() - mBox.getCenter()).squaredLength();
+    }
+
+    virtual Ogre::Real getBoundingRadius() const
+    {
+        if (mBox.isNull())
+            return 0.f;
+        return mBox.getHalfSize().length();
+    }
+
+private:
+    Ogre::HardwareVertexBufferSharedPtr vertexBuffer_;
+    uint verticesPerInstance_;
+    uint indicesPerInstance_;
+    uint vertexBytes_;
+};
+
+namespace
+{
+    /// Transforms a direction by a 3x3 matrix and normalizes it.
+    inline void TransformDirection(const float m[3][3], float *d)
+    {
+        const float x = d[0], y = d[1], z = d[2];
+        float tx = m[0][0] * x + m[0][1] * y + m[0][2] * z;
+        float ty = m[1][0] * x + m[1][1] * y + m[1][2] * z;
+        float tz = m[2][0] * x + m[2][1] * y + m[2][2] * z;
+        const float lengthSq = tx * tx + ty * ty + tz * tz;
+        if (lengthSq > 0.f)
+        {
+            const float invLength = 1.f / std::sqrt(lengthSq);
+            tx *= invLength;
+            ty *= invLength;
+            tz *= invLength;
+        }
+        d[0] = tx;
+        d[1] = ty;
+        d[2] = tz;
+    }
+
+    bool IsDirectionType(Ogre::VertexElementType type)
+    {
+        return type == Ogre::VET_FLOAT3 || type == Ogre::VET_FLOAT4;
+    }
+
+    /// Reads the geometry of a submesh, compacted to the vertices its indices use.
+    /** @param declaration Receives the vertex declaration of the compacted vertices, which the caller must destroy.
+        @return False if the submesh can not be instanced. */
+    bool ReadSubMeshGeometry(Ogre::Mesh *mesh, Ogre::SubMesh *submesh, InstanceBatchSource &source, Ogre::VertexDeclaration *&declaration)
+    {
+        declaration = 0;
+        if (submesh->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST)
+            return false;
+        Ogre::VertexData *vertexData = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+        Ogre::IndexData *indexData = submesh->indexData;
+        if (!vertexData || !indexData || indexData->indexBuffer.isNull() || !indexData->indexCount)
+            return false;
+
+        // Renumber the vertices in the order the indices first use them, so that vertices shared with other submeshes are left out.
+        std::vector<int> remap(vertexData->vertexCount, -1);
+        std::vector<size_t> usedVertices;
+        source.indices.clear();
+        source.indices.reserve(indexData->indexCount);
+
+        Ogre::HardwareIndexBufferSharedPtr ibuf = indexData->indexBuffer;
+        const bool use32BitIndices = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
+        const void *indexPtr = ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY);
+        bool ok = true;
+        for(size_t i = indexData->indexStart; i < indexData->indexStart + indexData->indexCount; ++i)
+        {
+            const size_t index = use32BitIndices ? static_cast<const u32 *>(indexPtr)[i] : static_cast<const u16 *>(indexPtr)[i];
+            if (index >= remap.size())
+            {
+                ok = false;
+                break;
+            }
+            if (remap[index] < 0)
+            {
+                if (usedVertices.size() >= 65535)
+                {
+                    ok = false;
+                    break;
+                }
+                remap[index] = (int)usedVertices.size();
+                usedVertices.push_back(index);
+            }
+            source.indices.push_back((u16)remap[index]);
+        }
+        ibuf->unlock();
+        if (!ok)
+            return false;
+
+        // Pack the vertex elements to one buffer. Blend weights and indices are left out, as animated meshes are not instanced.
+        const Ogre::VertexDeclaration::VertexElementList &elements = vertexData->vertexDeclaration->getElements();
+        std::vector<const Ogre::VertexElement *> copiedElements;
+        declaration = Ogre::HardwareBufferManager::getSingleton().createVertexDeclaration();
+        size_t offset = 0;
+        bool hasPosition = false;
+        source.normalOffsets.clear();
+        source.tangentOffsets.clear();
+        for(Ogre::VertexDeclaration::VertexElementList::const_iterator iter = elements.begin(); iter != elements.end(); ++iter)
+        {
+            const Ogre::VertexElementSemantic semantic = iter->getSemantic();
+            const Ogre::VertexElementType type = iter->getType();
+            if (semantic == Ogre::VES_BLEND_WEIGHTS || semantic == Ogre::VES_BLEND_INDICES)
+                continue;
+            if (iter->getSize() % sizeof(float) != 0)
+            {
+                ok = false;
+                break;
+            }
+
+            if (semantic == Ogre::VES_POSITION && !hasPosition)
+            {
+                if (!IsDirectionType(type))
+                {
+                    ok = false;
+                    break;
+                }
+                source.positionOffset = (uint)(offset / sizeof(float));
+                hasPosition = true;
+            }
+            else if (semantic == Ogre::VES_NORMAL || semantic == Ogre::VES_TANGENT || semantic == Ogre::VES_BINORMAL)
+            {
+                if (!IsDirectionType(type))
+                {
+                    ok = false;
+                    break;
+                }
+                if (semantic == Ogre::VES_NORMAL)
+                    source.normalOffsets.push_back((uint)(offset / sizeof(float)));
+                else
+                    source.tangentOffsets.push_back((uint)(offset / sizeof(float)));
+            }
+
+            declaration->addElement(0, offset, type, semantic, iter->getIndex());
+            copiedElements.push_back(&*iter);
+            offset += iter->getSize();
+        }
+        if (!ok || !hasPosition)
+        {
+            Ogre::HardwareBufferManager::getSingleton().destroyVertexDeclaration(declaration);
+            declaration = 0;
+            return false;
+        }
+
+        source.vertexSize = (uint)(offset / sizeof(float));
+        source.numVertices = (uint)usedVertices.size();
+        source.vertices.resize(source.numVertices * source.vertexSize);
+
+        Ogre::VertexBufferBinding *binding = vertexData->vertexBufferBinding;
+        std::map<unsigned short, const u8 *> bufferData;
+        for(size_t i = 0; i < copiedElements.size(); ++i)
+        {
+            const unsigned short bufferIndex = copiedElements[i]->getSource();
+            if (bufferData.find(bufferIndex) == bufferData.end())
+                bufferData[bufferIndex] = static_cast<const u8 *>(binding->getBuffer(bufferIndex)->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+        }
+
+        for(uint v = 0; v < source.numVertices; ++v)
+        {
+            u8 *dest = reinterpret_cast<u8 *>(&source.vertices[v * source.vertexSize]);
+            const size_t vertexIndex = vertexData->vertexStart + usedVertices[v];
+            for(size_t i = 0; i < copiedElements.size(); ++i)
+            {
+                const Ogre::VertexElement *element = copiedElements[i];
+                const size_t stride = binding->getBuffer(element->getSource())->getVertexSize();
+                const u8 *src = bufferData[element->getSource()] + vertexIndex * stride + element->getOffset();
+                memcpy(dest, src, element->getSize());
+                dest += element->getSize();
+            }
+        }
+
+        for(std::map<unsigned short, const u8 *>::const_iterator iter = bufferData.begin(); iter != bufferData.end(); ++iter)
+            binding->getBuffer(iter->first)->unlock();
+
+        return true;
+    }
+}
+
+void InstanceBatchSource::TransformInstance(const float3x4 &transform, float *dest) const
+{
+    if (!numVertices)
+        return;
+    memcpy(dest, &vertices[0], numVertices * vertexSize * sizeof(float));
+
+    const float (*m)[4] = transform.v;
+    float linear[3][3];
+    for(int r = 0; r < 3; ++r)
+        for(int c = 0; c < 3; ++c)
+            linear[r][c] = m[r][c];
+
+    // Normals are transformed by the inverse transpose of the linear part, which is its cofactor matrix divided by the determinant.
+    // The division is replaced by normalizing, but the sign of the determinant is kept so that mirrored instances stay lit correctly.
+    float normalMatrix[3][3];
+    normalMatrix[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    normalMatrix[0][1] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    normalMatrix[0][2] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    normalMatrix[1][0] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    normalMatrix[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    normalMatrix[1][2] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    normalMatrix[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    normalMatrix[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    normalMatrix[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    const float determinant = m[0][0] * normalMatrix[0][0] + m[0][1] * normalMatrix[0][1] + m[0][2] * normalMatrix[0][2];
+    if (determinant < 0.f)
+        for(int r = 0; r < 3; ++r)
+            for(int c = 0; c < 3; ++c)
+                normalMatrix[r][c] = -normalMatrix[r][c];
+
+    for(uint i = 0; i < numVertices; ++i)
+    {
+        float *vertex = dest + i * vertexSize;
+
+        float *p = vertex + positionOffset;
+        const float x = p[0], y = p[1], z = p[2];
+        p[0] = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+        p[1] = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+        p[2] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+
+        for(size_t j = 0; j < normalOffsets.size(); ++j)
+            TransformDirection(normalMatrix, vertex + normalOffsets[j]);
+        for(size_t j = 0; j < tangentOffsets.size(); ++j)
+            TransformDirection(linear, vertex + tangentOffsets[j]);
+    }
+}
+
+void InstanceBatchSource::CollapseInstance(const float3 &point, float *dest) const
+{
+    if (!numVertices)
+        return;
+    memcpy(dest, &vertices[0], numVertices * vertexSize * sizeof(float));
+    for(uint i = 0; i < numVertices; ++i)
+    {
+        float *p = dest + i * vertexSize + positionOffset;
+        p[0] = point.x;
+        p[1] = point.y;
+        p[2] = point.z;
+    }
+}
+
+MeshInstanceBatcher::MeshInstanceBatcher(Ogre::SceneManager *sceneManager) :
+    sceneManager_(sceneManager),
+    nextInstanceId_(1)
+{
+}
+
+MeshInstanceBatcher::~MeshInstanceBatcher()
+{
+    for(std::map<std::string, Group *>::iterator iter = groups_.begin(); iter != groups_.end(); ++iter)
+        DestroyGroup(iter->second);
+    groups_.clear();
+    instances_.clear();
+}
+
+bool MeshInstanceBatcher::CanInstance(Ogre::Entity *entity)
+{
+    if (!entity || entity->getMesh().isNull())
+        return false;
+    Ogre::Mesh *mesh = entity->getMesh().get();
+    if (entity->hasSkeleton() || mesh->hasVertexAnimation() || !mesh->getNumSubMeshes())
+        return false;
+    for(unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+        if (mesh->getSubMesh(i)->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST)
+            return false;
+    return true;
+}
+
+uint MeshInstanceBatcher::AddInstance(Ogre::Entity *entity)
+{
+    if (!CanInstance(entity) || !entity->getParentSceneNode())
+        return 0;
+
+    // The group copies the mesh geometry, so key it also by the mesh object and its load state. After a mesh reload
+    // the instances start a new group, and the stale group goes away when its last instance is removed.
+    Ogre::Mesh *mesh = entity->getMesh().get();
+    std::ostringstream keyStream;
+    keyStream << mesh->getName() << "|" << mesh << "|" << mesh->getStateCount();
+    std::string key = keyStream.str();
+    for(uint i = 0; i < entity->getNumSubEntities(); ++i)
+        key += "|" + entity->getSubEntity(i)->getMaterialName();
+    key += entity->getCastShadows() ? "|shadows" : "|noshadows";
+
+    Group *group = 0;
+    std::map<std::string, Group *>::iterator groupIter = groups_.find(key);
+    if (groupIter != groups_.end())
+        group = groupIter->second;
+    else
+    {
+        group = CreateGroup(entity, key);
+        if (!group)
+            return 0;
+        groups_[key] = group;
+    }
+
+    Instance instance;
+    instance.entity = entity;
+    instance.visibilityFlags = entity->getVisibilityFlags();
+    ReadInstanceState(instance);
+
+    Batch *batch = ChooseBatch(group, instance.worldBounds);
+    instance.batch = batch;
+    instance.slot = (uint)batch->instances.size();
+
+    const uint id = nextInstanceId_++;
+    batch->instances.push_back(id);
+    for(size_t i = 0; i < batch->renderables.size(); ++i)
+        batch->renderables[i]->SetNumInstances((uint)batch->instances.size());
+    batch->boundsDirty = true;
+    WriteInstance(instance);
+
+    // Keep the entity in the scene for raycasts and visibility queries, but do not render it
+    entity->setVisibilityFlags(0);
+
+    instances_[id] = instance;
+    return id;
+}
+
+void MeshInstanceBatcher::RemoveInstance(uint id)
+{
+    std::map<uint, Instance>::iterator iter = instances_.find(id);
+    if (iter == instances_.end())
+        return;
+
+    Instance &instance = iter->second;
+    instance.entity->setVisibilityFlags(instance.visibilityFlags);
+
+    // Move the last instance of the batch to the freed slot
+    Batch *batch = instance.batch;
+    const uint lastId = batch->instances.back();
+    if (lastId != id)
+    {
+        Instance &last = instances_[lastId];
+        last.slot = instance.slot;
+        batch->instances[instance.slot] = lastId;
+        WriteInstance(last);
+    }
+    batch->instances.pop_back();
+    for(size_t i = 0; i < batch->renderables.size(); ++i)
+        batch->renderables[i]->SetNumInstances((uint)batch->instances.size());
+    batch->boundsDirty = true;
+    instances_.erase(iter);
+
+    if (batch->instances.empty())
+    {
+        Group *group = batch->group;
+        group->batches.erase(std::find(group->batches.begin(), group->batches.end(), batch));
+        DestroyBatch(batch);
+        if (group->batches.empty())
+        {
+            groups_.erase(group->key);
+            DestroyGroup(group);
+        }
+    }
+}
+
+void MeshInstanceBatcher::Update()
+{
+    PROFILE(MeshInstanceBatcher_Update);
+
+    for(std::map<uint, Instance>::iterator iter = instances_.begin(); iter != instances_.end(); ++iter)
+    {
+        Instance &instance = iter->second;
+        const Ogre::Matrix4 oldTransform = instance.transform;
+        const bool wasVisible = instance.visible;
+        ReadInstanceState(instance);
+        if (instance.visible != wasVisible || (instance.visible && instance.transform != oldTransform))
+        {
+            WriteInstance(instance);
+            instance.batch->boundsDirty = true;
+        }
+    }
+
+    for(std::map<std::string, Group *>::iterator groupIter = groups_.begin(); groupIter != groups_.end(); ++groupIter)
+    {
+        std::vector<Batch *> &batches = groupIter->second->batches;
+        for(size_t i = 0; i < batches.size(); ++i)
+        {
+            Batch *batch = batches[i];
+            if (!batch->boundsDirty)
+                continue;
+
+            batch->bounds.setNull();
+            for(size_t j = 0; j < batch->instances.size(); ++j)
+            {
+                const Instance &instance = instances_[batch->instances[j]];
+                if (instance.visible)
+                    batch->bounds.merge(instance.worldBounds);
+            }
+            for(size_t j = 0; j < batch->renderables.size(); ++j)
+                batch->renderables[j]->SetBounds(batch->bounds);
+            // The scene node recomputes its bounds from the renderables only when it is updated
+            batch->node->needUpdate();
+            batch->boundsDirty = false;
+        }
+    }
+}
+
+uint MeshInstanceBatcher::NumBatches() const
+{
+    uint numBatches = 0;
+    for(std::map<std::string, Group *>::const_iterator iter = groups_.begin(); iter != groups_.end(); ++iter)
+        numBatches += (uint)iter->second->batches.size();
+    return numBatches;
+}
+
+MeshInstanceBatcher::Group *MeshInstanceBatcher::CreateGroup(Ogre::Entity *entity, const std::string &key)
+{
+    PROFILE(MeshInstanceBatcher_CreateGroup);
+
+    Ogre::Mesh *mesh = entity->getMesh().get();
+    Group *group = new Group();
+    group->key = key;
+    group->mesh = entity->getMesh();
+    group->castShadows = entity->getCastShadows();
+    group->localBounds = mesh->getBounds();
+
+    uint maxVertices = 1;
+    bool ok = true;
+    for(unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+    {
+        InstanceBatchSource source;
+        Ogre::VertexDeclaration *declaration = 0;
+        try
+        {
+            ok = ReadSubMeshGeometry(mesh, mesh->getSubMesh(i), source, declaration);
+        }
+        catch(Ogre::Exception &e)
+        {
+            LogError("MeshInstanceBatcher::CreateGroup: Could not read geometry of mesh " + mesh->getName() + ": " + std::string(e.what()));
+            ok = false;
+        }
+        if (!ok)
+            break;
+
+        maxVertices = std::max(maxVertices, source.numVertices);
+        group->sources.push_back(source);
+        group->declarations.push_back(declaration);
+        group->materials.push_back(entity->getSubEntity(i)->getMaterialName());
+    }
+
+    if (!ok)
+    {
+        DestroyGroup(group);
+        return 0;
+    }
+
+    group->instancesPerBatch = std::max(1u, std::min(cMaxInstancesPerBatch, 65535u / maxVertices));
+    return group;
+}
+
+void MeshInstanceBatcher::DestroyGroup(Group *group)
+{
+    for(size_t i = 0; i < group->batches.size(); ++i)
+        DestroyBatch(group->batches[i]);
+    for(size_t i = 0; i < group->declarations.size(); ++i)
+        Ogre::HardwareBufferManager::getSingleton().destroyVertexDeclaration(group->declarations[i]);
+    delete group;
+}
+
+MeshInstanceBatcher::Batch *MeshInstanceBatcher::ChooseBatch(Group *group, const Ogre::AxisAlignedBox &bounds)
+{
+    // Prefer the batch that grows the least, so that batches stay spatially coherent and are culled effectively
+    Batch *best = 0;
+    float bestGrowth = 0.f;
+    for(size_t i = 0; i < group->batches.size(); ++i)
+    {
+        Batch *batch = group->batches[i];
+        if (batch->instances.size() >= group->instancesPerBatch)
+            continue;
+        Ogre::AxisAlignedBox merged = batch->bounds;
+        merged.merge(bounds);
+        const float growth = merged.volume() - batch->bounds.volume();
+        if (!best || growth < bestGrowth)
+        {
+            best = batch;
+            bestGrowth = growth;
+        }
+    }
+    if (best)
+    {
+        best->bounds.merge(bounds);
+        return best;
+    }
+
+    Batch *batch = new Batch();
+    batch->group = group;
+    batch->bounds = bounds;
+    batch->boundsDirty = true;
+    batch->node = sceneManager_->getRootSceneNode()->createChildSceneNode();
+    for(size_t i = 0; i < group->sources.size(); ++i)
+    {
+#include "DisableMemoryLeakCheck.h"
+        InstanceBatchRenderable *renderable = new InstanceBatchRenderable(group->sources[i], group->declarations[i], group->instancesPerBatch);
+#include "EnableMemoryLeakCheck.h"
+        renderable->setMaterial(group->materials[i]);
+        renderable->setCastShadows(group->castShadows);
+        batch->node->attachObject(renderable);
+        batch->renderables.push_back(renderable);
+    }
+    group->batches.push_back(batch);
+    return batch;
+}
+
+void MeshInstanceBatcher::DestroyBatch(Batch *batch)
+{
+    batch->node->detachAllObjects();
+    for(size_t i = 0; i < batch->renderables.size(); ++i)
+        delete batch->renderables[i];
+    sceneManager_->destroySceneNode(batch->node);
+    delete batch;
+}
+
+void MeshInstanceBatcher::ReadInstanceState(Instance &instance) const
+{
+    Ogre::SceneNode *node = instance.entity->getParentSceneNode();
+    instance.visible = node && node->isInSceneGraph() && instance.entity->getVisible();
+    if (!node)
+        return;
+    instance.transform = node->_getFullTransform();
+    instance.worldBounds = instance.entity->getMesh()->getBounds();
+    instance.worldBounds.transformAffine(instance.transform);
+}
+
+void MeshInstanceBatcher::WriteInstance(const Instance &instance)
+{
+    const Ogre::Matrix4 &t = instance.transform;
+    const float3x4 transform(t[0][0], t[0][1], t[0][2], t[0][3],
+                             t[1][0], t[1][1], t[1][2], t[1][3],
+                             t[2][0], t[2][1], t[2][2], t[2][3]);
+
+    Batch *batch = instance.batch;
+    const std::vector<InstanceBatchSource> &sources = batch->group->sources;
+    for(size_t i = 0; i < sources.size(); ++i)
+    {
+        const InstanceBatchSource &source = sources[i];
+        vertices_.resize(source.numVertices * source.vertexSize);
+        if (instance.visible)
+            source.TransformInstance(transform, &vertices_[0]);
+        else
+            source.CollapseInstance(transform.TranslatePart(), &vertices_[0]);
+        batch->renderables[i]->WriteInstance(instance.slot, &vertices_[0]);
+    }
+}
@@ -0,0 +1,156 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "OgreModuleApi.h"
+#include "CoreTypes.h"
+#include "Math/MathFwd.h"
+
+#include <OgreAxisAlignedBox.h>
+#include <OgreMatrix4.h>
+#include <OgreMesh.h>
+
+#include <map>
+#include <vector>
+
+namespace Ogre
+{
+    class Entity;
+    class SceneManager;
+    class SceneNode;
+    class VertexDeclaration;
+}
+
+class InstanceBatchRenderable;
+
+/// Geometry of one submesh, prepared for copying to an instance batch.
+/** The vertices are interleaved and consist of 32-bit words. When an instance is written, positions are transformed
+    as points, normals by the inverse transpose, and tangents and binormals by the linear part of the transform.
+    Other vertex elements are copied as is. */
+struct OGRE_MODULE_API InstanceBatchSource
+{
+    InstanceBatchSource() : vertexSize(0), numVertices(0), positionOffset(0) {}
+
+    /// Vertex data of one instance.
+    std::vector<float> vertices;
+    /// Size of a vertex in 32-bit words.
+    uint vertexSize;
+    uint numVertices;
+    /// Offset of the position in a vertex, in 32-bit words.
+    uint positionOffset;
+    /// Offsets of the normals in a vertex, in 32-bit words.
+    std::vector<uint> normalOffsets;
+    /// Offsets of the tangents and binormals in a vertex, in 32-bit words.
+    std::vector<uint> tangentOffsets;
+    /// Triangle list indices, relative to the first vertex of the instance.
+    std::vector<u16> indices;
+
+    /// Writes the vertices of one instance with the given world transform. dest must have room for numVertices * vertexSize words.
+    void TransformInstance(const float3x4 &transform, float *dest) const;
+
+    /// Writes the vertices of a hidden instance, with all triangles collapsed to the given point.
+    void CollapseInstance(const float3 &point, float *dest) const;
+};
+
+/// Draws EC_Mesh entities that share the mesh and materials in batches, instead of one draw call per entity.
+/** For each submesh of a batch, the vertices of all its instances are stored transformed to world space in one vertex buffer.
+    The Ogre entity of an instance stays in the scene graph with its visibility flags cleared, so it is not rendered,
+    but raycasts, visibility queries and bounding boxes keep working on it as before.
+
+    Instance transforms and visibility are polled from the entities' scene nodes in Update(), which the Renderer calls
+    before rendering, and only the instances that have changed are rewritten.
+
+    Meshes with skeletal or vertex animation, non-triangle list submeshes, or more than 65535 vertices in a submesh can not be instanced. */
+class OGRE_MODULE_API MeshInstanceBatcher
+{
+public:
+    explicit MeshInstanceBatcher(Ogre::SceneManager *sceneManager);
+    ~MeshInstanceBatcher();
+
+    /// Returns true if the entity's mesh can be drawn as an instance.
+    static bool CanInstance(Ogre::Entity *entity);
+
+    /// Starts drawing an entity as an instance. The entity must be attached to a scene node.
+    /** @return Id of the instance, or 0 if the entity can not be instanced. */
+    uint AddInstance(Ogre::Entity *entity);
+
+    /// Stops drawing an instance, and restores the visibility flags of its entity. Must be called before the entity is destroyed.
+    void RemoveInstance(uint id);
+
+    /// Rewrites the instances whose transform or visibility has changed, and updates the batch bounds.
+    void Update();
+
+    /// Returns the number of instances.
+    uint NumInstances() const { return (uint)instances_.size(); }
+
+    /// Returns the number of batches, i.e. the number of draw calls per submesh.
+    uint NumBatches() const;
+
+    /// Maximum number of instances in one batch.
+    static const uint cMaxInstancesPerBatch = 256;
+
+private:
+    struct Batch;
+
+    /// Instances of one mesh with the same materials and shadow casting.
+    struct Group
+    {
+        std::string key;
+        /// The mesh the geometry was read from. Keeps the mesh alive, so that a reloaded mesh can not get its address in the key.
+        Ogre::MeshPtr mesh;
+        /// Source geometry and vertex declaration per submesh.
+        std::vector<InstanceBatchSource> sources;
+        std::vector<Ogre::VertexDeclaration *> declarations;
+        std::vector<std::string> materials;
+        bool castShadows;
+        Ogre::AxisAlignedBox localBounds;
+        uint instancesPerBatch;
+        std::vector<Batch *> batches;
+    };
+
+    struct Batch
+    {
+        Group *group;
+        Ogre::SceneNode *node;
+        /// One renderable per submesh.
+        std::vector<InstanceBatchRenderable *> renderables;
+        /// Instance ids by slot.
+        std::vector<uint> instances;
+        Ogre::AxisAlignedBox bounds;
+        bool boundsDirty;
+    };
+
+    struct Instance
+    {
+        Ogre::Entity *entity;
+        Batch *batch;
+        uint slot;
+        Ogre::Matrix4 transform;
+        bool visible;
+        Ogre::AxisAlignedBox worldBounds;
+        /// Visibility flags of the entity before it was instanced.
+        uint visibilityFlags;
+    };
+
+    /// Creates the group for an entity. Returns null if the mesh geometry can not be read.
+    Group *CreateGroup(Ogre::Entity *entity, const std::string &key);
+    void DestroyGroup(Group *group);
+
+    /// Returns the batch of the group that grows the least when the given bounds are added to it, creating a new batch if all are full.
+    Batch *ChooseBatch(Group *group, const Ogre::AxisAlignedBox &bounds);
+    void DestroyBatch(Batch *batch);
+
+    /// Reads the current transform, visibility and world bounds of an instance from its entity.
+    void ReadInstanceState(Instance &instance) const;
+
+    /// Writes the vertices of an instance to its slot.
+    void WriteInstance(const Instance &instance);
+
+    Ogre::SceneManager *sceneManager_;
+    std::map<std::string, Group *> groups_;
+    std::map<uint, Instance> instances_;
+    uint nextInstanceId_;
+
+    /// Vertex scratch buffer, kept to avoid reallocation.
+    std::vector<float> vertices_;
+};
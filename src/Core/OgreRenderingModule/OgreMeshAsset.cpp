@@ -9,6 +9,10 @@
 #include "AssetCache.h"
 #include "Profiler.h"
 
+#ifdef ASSIMP_ENABLED
+#include <OpenAssetImport.h>
+#endif
+
 #include <QFile>
 #include <QFileInfo>
 #include <Ogre.h>
@@ -31,6 +35,36 @@ bool OgreMeshAsset::DeserializeFromData(const u8 *data_, size_t numBytes, const
     /// Force an unload of this data first.
     Unload();
 
+#ifdef ASSIMP_ENABLED
+    // Model formats other than Ogre .mesh are converted with Open Asset Import. A ref of the form file.dae/nodename
+    // imports only the given node. The converted meshes are cooked to the asset cache, so that a later load of the
+    // same data does not run the importer again. Constructing the importer is costly, so Ogre .mesh refs skip it.
+    if (QFileInfo(Name()).suffix().toLower() != "mesh")
+    {
+        AssImp::OpenAssetImport importer(assetAPI->GetAssetCache());
+        QString file = Name();
+        QString nodeName;
+        if (!importer.IsSupportedExtension(file))
+            AssImp::OpenAssetImport::StripMeshnameFromAssetId(Name(), file, nodeName);
+        if (importer.IsSupportedExtension(file))
+        {
+            const QString ogreMeshName = AssetAPI::SanitateAssetRef(Name());
+            const std::string hint = ("." + QFileInfo(file).suffix()).toStdString();
+            std::vector<std::string> meshNames;
+            importer.Import(data_, numBytes, ogreMeshName, hint.c_str(), nodeName, meshNames);
+            ogreMesh = Ogre::MeshManager::getSingleton().getByName(ogreMeshName.toStdString());
+            if (ogreMesh.isNull())
+            {
+                LogError("OgreMeshAsset::DeserializeFromData: Open Asset Import failed to create mesh " + Name());
+                return false;
+            }
+            SetDefaultMaterial();
+            assetAPI->AssetLoadCompleted(Name());
+            return true;
+        }
+    }
+#endif
+
     // Asynchronous loading
     // 1. AssetAPI allows a asynch load. This is false when called from LoadFromFile(), LoadFromCache() etc.
     // 2. We have a rendering window for Ogre as Ogre::ResourceBackgroundQueue does not work otherwise. Its not properly initialized without a rendering window.
@@ -26,6 +26,7 @@
 #include "OgreSkeletonAsset.h"
 #include "OgreMaterialAsset.h"
 #include "TextureAsset.h"
+#include "MeshInstanceBatcher.h"
 
 #include "AssetAPI.h"
 #include "AssetCache.h"
@@ -36,6 +37,10 @@
 #include "SceneAPI.h"
 #include "IComponentFactory.h"
 #include "Profiler.h"
+#include "HighPerfClock.h"
+#include "Math/float3x4.h"
+#include "Math/float3.h"
+#include "Math/Quat.h"
 #include "UiAPI.h"
 #include "UiMainWindow.h"
 
@@ -144,6 +149,8 @@ void OgreRenderingModule::Initialize()
         this, SLOT(ConsoleStats()));
     framework_->Console()->RegisterCommand("SetMaterialAttribute", "Sets an attribute on a material asset",
         this, SLOT(SetMaterialAttribute(const StringVector &)));
+    framework_->Console()->RegisterCommand("BenchmarkInstanceBatching", "Measures writing mesh instance batches. Usage: BenchmarkInstanceBatching(instances,vertices)",
+        this, SLOT(BenchmarkInstanceBatching(const StringVector &)));
 }
 
 void OgreRenderingModule::Uninitialize()
@@ -252,6 +259,47 @@ void OgreRenderingModule::SetMaterialAttribute(const QStringList &params)
     matAsset->SetAttribute(params[1], params[2]);
 }
 
+void OgreRenderingModule::BenchmarkInstanceBatching(const QStringList &params)
+{
+    const uint numInstances = params.size() > 0 ? std::max(1, params[0].toInt()) : 10000;
+    const uint numVertices = params.size() > 1 ? std::max(1, std::min(65535, params[1].toInt())) : 500;
+
+    // Position, normal, tangent and texture coordinates, as in a typical normal mapped static mesh
+    InstanceBatchSource source;
+    source.vertexSize = 3 + 3 + 4 + 2;
+    source.numVertices = numVertices;
+    source.positionOffset = 0;
+    source.normalOffsets.push_back(3);
+    source.tangentOffsets.push_back(6);
+    source.vertices.resize(source.numVertices * source.vertexSize);
+    for(uint i = 0; i < numVertices; ++i)
+    {
+        float *v = &source.vertices[i * source.vertexSize];
+        const float angle = (float)i / numVertices * 6.2831853f;
+        v[0] = cos(angle); v[1] = sin(angle); v[2] = (float)i / numVertices;
+        v[3] = cos(angle); v[4] = sin(angle); v[5] = 0.f;
+        v[6] = -sin(angle); v[7] = cos(angle); v[8] = 0.f; v[9] = 1.f;
+        v[10] = angle; v[11] = v[2];
+    }
+
+    std::vector<float3x4> transforms(numInstances);
+    for(uint i = 0; i < numInstances; ++i)
+        transforms[i] = float3x4::FromTRS(float3((float)(i % 100), 0.f, (float)(i / 100)), Quat::RotateY(i * 0.1f), float3::FromScalar(1.f + (i % 3) * 0.5f));
+
+    const uint instancesPerBatch = std::max(1u, std::min(MeshInstanceBatcher::cMaxInstancesPerBatch, 65535u / numVertices));
+    std::vector<float> batch(instancesPerBatch * source.numVertices * source.vertexSize);
+
+    const tick_t start = GetCurrentClockTime();
+    for(uint i = 0; i < numInstances; ++i)
+        source.TransformInstance(transforms[i], &batch[(i % instancesPerBatch) * source.numVertices * source.vertexSize]);
+    const double seconds = (double)(GetCurrentClockTime() - start) / GetCurrentClockFreq();
+
+    ConsoleAPI *c = framework_->Console();
+    c->Print("Instances: " + QString::number(numInstances) + ", vertices per instance: " + QString::number(numVertices));
+    c->Print("Batches: " + QString::number((numInstances + instancesPerBatch - 1) / instancesPerBatch) + " (" + QString::number(instancesPerBatch) + " instances per batch)");
+    c->Print("Write time: " + QString::number(seconds * 1000.0) + " ms, " + QString::number(seconds * 1e9 / ((double)numInstances * numVertices)) + " ns per vertex");
+}
+
 } // ~namespace OgreRenderer
 
 using namespace OgreRenderer;
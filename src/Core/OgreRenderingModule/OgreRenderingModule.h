@@ -49,6 +49,10 @@ namespace OgreRenderer
         /// Sets attribute value for material.
         void SetMaterialAttribute(const QStringList &params);
 
+        /// Measures the CPU cost of writing instance batches. Does not need a renderer, so it can be run headless.
+        /** @param params Number of instances and number of vertices per instance, optional. */
+        void BenchmarkInstanceBatching(const QStringList &params);
+
     private slots:
         /// New scene has been created
         void OnSceneAdded(const QString &name);
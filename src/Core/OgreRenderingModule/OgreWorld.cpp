@@ -24,6 +24,7 @@
 #include "Math/Sphere.h"
 #include "OgreShadowCameraSetupFocusedPSSM.h"
 #include "OgreBulletCollisionsDebugLines.h"
+#include "MeshInstanceBatcher.h"
 
 #include <Ogre.h>
 
@@ -34,7 +35,8 @@ OgreWorld::OgreWorld(OgreRenderer::Renderer* renderer, ScenePtr scene) :
     sceneManager_(0),
     rayQuery_(0),
     debugLines_(0),
-    debugLinesNoDepth_(0)
+    debugLinesNoDepth_(0),
+    instanceBatcher_(0)
 {
     assert(renderer_->IsInitialized());
     
@@ -60,6 +62,8 @@ OgreWorld::OgreWorld(OgreRenderer::Renderer* renderer, ScenePtr scene) :
         sceneManager_->getRootSceneNode()->attachObject(debugLines_);
         sceneManager_->getRootSceneNode()->attachObject(debugLinesNoDepth_);
         debugLinesNoDepth_->setRenderQueueGroup(Ogre::RENDER_QUEUE_OVERLAY);
+
+        instanceBatcher_ = new MeshInstanceBatcher(sceneManager_);
     }
     
     connect(framework_->Frame(), SIGNAL(Updated(float)), this, SLOT(OnUpdated(float)));
@@ -80,6 +84,7 @@ OgreWorld::~OgreWorld()
         sceneManager_->getRootSceneNode()->detachObject(debugLinesNoDepth_);
         SAFE_DELETE(debugLinesNoDepth_);
     }
+    SAFE_DELETE(instanceBatcher_);
     
     // Remove all compositors.
     /// \todo This does not work with a proper multiscene approach
@@ -159,9 +164,10 @@ void GetMeshInformation(
             vertex_count += submesh->vertexData->vertexCount;
         }
 
-        // Add the indices
+        // Add the indices. Hidden submeshes, e.g. the inactive LOD levels of a terrain chunk, are left out.
         submeshstartindex[i] = index_count;
-        index_count += submesh->indexData->indexCount;
+        if (entity->getSubEntity(i)->isVisible())
+            index_count += submesh->indexData->indexCount;
     }
 
     // Allocate space for the vertices and indices
@@ -231,23 +237,26 @@ void GetMeshInformation(
             next_offset += vertex_data->vertexCount;
         }
 
-        Ogre::IndexData* index_data = submesh->indexData;
-        size_t numTris = index_data->indexCount / 3;
-        Ogre::HardwareIndexBufferSharedPtr ibuf = index_data->indexBuffer;
-
-        unsigned long*  pLong = static_cast<unsigned long*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
-        unsigned short* pShort = reinterpret_cast<unsigned short*>(pLong);
-        size_t offset = (submesh->useSharedVertices)? shared_offset : current_offset;
-
-        bool use32bitindexes = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
-        if (use32bitindexes)
-            for(size_t k = 0; k < numTris*3; ++k)
-                indices[index_offset++] = pLong[k] + static_cast<uint>(offset);
-        else
-            for(size_t k = 0; k < numTris*3; ++k)
-                indices[index_offset++] = static_cast<uint>(pShort[k]) + static_cast<unsigned long>(offset);
-
-        ibuf->unlock();
+        if (entity->getSubEntity(i)->isVisible())
+        {
+            Ogre::IndexData* index_data = submesh->indexData;
+            size_t numTris = index_data->indexCount / 3;
+            Ogre::HardwareIndexBufferSharedPtr ibuf = index_data->indexBuffer;
+
+            unsigned long*  pLong = static_cast<unsigned long*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+            unsigned short* pShort = reinterpret_cast<unsigned short*>(pLong);
+            size_t offset = (submesh->useSharedVertices)? shared_offset : current_offset;
+
+            bool use32bitindexes = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
+            if (use32bitindexes)
+                for(size_t k = 0; k < numTris*3; ++k)
+                    indices[index_offset++] = pLong[k] + static_cast<uint>(offset);
+            else
+                for(size_t k = 0; k < numTris*3; ++k)
+                    indices[index_offset++] = static_cast<uint>(pShort[k]) + static_cast<unsigned long>(offset);
+
+            ibuf->unlock();
+        }
         current_offset = next_offset;
     }
 }
@@ -901,3 +910,9 @@ void OgreWorld::FlushDebugGeometry()
     if (debugLinesNoDepth_)
         debugLinesNoDepth_->draw();
 }
+
+void OgreWorld::UpdateInstanceBatches()
+{
+    if (instanceBatcher_)
+        instanceBatcher_->Update();
+}
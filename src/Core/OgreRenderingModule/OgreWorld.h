@@ -18,6 +18,7 @@
 
 class Framework;
 class DebugLines;
+class MeshInstanceBatcher;
 class Transform;
 
 /// Contains the Ogre representation of a scene, ie. the Ogre Scene
@@ -40,6 +41,12 @@ public:
     
     /// Dump the debug geometry drawn this frame to the debug geometry vertex buffer. Called by Renderer before rendering.
     void FlushDebugGeometry();
+
+    /// Update the instance batches from the transforms of the instanced meshes. Called by Renderer before rendering.
+    void UpdateInstanceBatches();
+
+    /// Return the batcher of instanced meshes, or null if running headless
+    MeshInstanceBatcher* GetInstanceBatcher() const { return instanceBatcher_; }
     
 public slots:
     /// Do raycast into the world from viewport coordinates, using all selection layers
@@ -172,5 +179,8 @@ private:
     DebugLines* debugLines_;
     /// Debug geometry object, no depth testing
     DebugLines* debugLinesNoDepth_;
+
+    /// Batcher of instanced meshes
+    MeshInstanceBatcher* instanceBatcher_;
 };
 
@@ -702,6 +702,11 @@ namespace OgreRenderer
             PROFILE(Renderer_Render_UpdateDebugGeometry)
             world->FlushDebugGeometry();
         }
+        if (world)
+        {
+            PROFILE(Renderer_Render_UpdateInstanceBatches)
+            world->UpdateInstanceBatches();
+        }
         
         try
         {
@@ -29,6 +29,8 @@
 
 #include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
 #include <set>
+#include <limits>
+#include <cstring>
 
 #include <OgreSceneNode.h>
 
@@ -37,6 +39,8 @@ using namespace Physics;
 static const float cForceThreshold = 0.0005f;
 static const float cImpulseThreshold = 0.0005f;
 static const float cTorqueThreshold = 0.0005f;
+/// Maximum time in seconds a moving body's transform changes can be skipped for being below the error thresholds
+static const float cSettleInterval = 1.0f;
 
 EC_RigidBody::EC_RigidBody(Scene* scene) :
     IComponent(scene),
@@ -57,14 +61,24 @@ EC_RigidBody::EC_RigidBody(Scene* scene) :
     drawDebug(this, "Draw Debug", false),
     collisionLayer(this, "Collision Layer", -1),
     collisionMask(this, "Collision Mask", -1),
+    positionErrorThreshold(this, "Position error threshold", 0.005f),
+    rotationErrorThreshold(this, "Rotation error threshold", 0.25f),
     body_(0),
     world_(0),
     shape_(0),
     childShape_(0),
     heightField_(0),
+    heightFieldWidth_(0),
+    heightFieldHeight_(0),
+    heightFieldMinY_(0.f),
+    heightFieldMaxY_(0.f),
     disconnected_(false),
     cachedShapeType_(-1),
-    cachedSize_(float3::zero)
+    cachedSize_(float3::zero),
+    lastPosition_(float3::zero),
+    lastOrientation_(Quat::identity),
+    settlePending_(false),
+    settleTime_(0.0f)
 {
     owner_ = framework->GetModule<PhysicsModule>();
     
@@ -89,6 +103,8 @@ EC_RigidBody::EC_RigidBody(Scene* scene) :
 
 EC_RigidBody::~EC_RigidBody()
 {
+    if (world_)
+        world_->DiscardPendingResults(this, true);
     RemoveBody();
     RemoveCollisionShape();
     if (world_)
@@ -137,6 +153,7 @@ void EC_RigidBody::ApplyForce(const float3& force, const float3& position)
     if (force.Length() < cForceThreshold) ///\todo Use force.LengthSq() instead for optimization.
         return;
     
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     if (body_)
@@ -159,6 +176,7 @@ void EC_RigidBody::ApplyTorque(const float3& torque)
     if (torque.Length() < cTorqueThreshold)  ///\todo Use torque.LengthSq() instead for optimization.
         return;
         
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     if (body_)
@@ -178,6 +196,7 @@ void EC_RigidBody::ApplyImpulse(const float3& impulse, const float3& position)
     if (impulse.Length() < cImpulseThreshold)  ///\todo Use impulse.LengthSq() instead for optimization.
         return;
     
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     if (body_)
@@ -200,6 +219,7 @@ void EC_RigidBody::ApplyTorqueImpulse(const float3& torqueImpulse)
     if (torqueImpulse.Length() < cTorqueThreshold)  ///\todo Use torqueImpulse.LengthSq() instead for optimization.
         return;
         
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     if (body_)
@@ -215,6 +235,7 @@ void EC_RigidBody::Activate()
     if (!HasAuthority())
         return;
     
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     if (body_)
@@ -223,12 +244,14 @@ void EC_RigidBody::Activate()
 
 void EC_RigidBody::KeepActive()
 {
+    WaitForSimulation();
     if (body_)
         body_->activate(true);
 }
 
 bool EC_RigidBody::IsActive()
 {
+    WaitForSimulation();
     if (body_)
         return body_->isActive();
     else
@@ -241,6 +264,7 @@ void EC_RigidBody::ResetForces()
     if (!HasAuthority())
         return;
     
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     if (body_)
@@ -258,7 +282,7 @@ void EC_RigidBody::UpdateSignals()
     Scene* scene = parent->ParentScene();
     world_ = scene->GetWorld<PhysicsWorld>().get();
     if (world_)
-        connect(world_, SIGNAL(AboutToUpdate(float)), this, SLOT(OnAboutToUpdate()));
+        connect(world_, SIGNAL(AboutToUpdate(float)), this, SLOT(OnAboutToUpdate(float)));
 }
 
 void EC_RigidBody::CheckForPlaceableAndTerrain()
@@ -282,7 +306,7 @@ void EC_RigidBody::CheckForPlaceableAndTerrain()
         if (terrain)
         {
             terrain_ = terrain;
-            connect(terrain.get(), SIGNAL(TerrainRegenerated()), this, SLOT(OnTerrainRegenerated()));
+            connect(terrain.get(), SIGNAL(PatchesRegenerated(int, int, int, int)), this, SLOT(OnTerrainRegenerated(int, int, int, int)));
             connect(terrain.get(), SIGNAL(AttributeChanged(IAttribute*, AttributeChange::Type)), this, SLOT(TerrainUpdated(IAttribute*)));
         }
     }
@@ -340,6 +364,7 @@ void EC_RigidBody::CreateCollisionShape()
 
 void EC_RigidBody::RemoveCollisionShape()
 {
+    WaitForSimulation();
     if (shape_)
     {
         if (body_)
@@ -406,6 +431,7 @@ void EC_RigidBody::ReaddBody()
 
 void EC_RigidBody::RemoveBody()
 {
+    WaitForSimulation();
     if ((body_) && (world_))
     {
         world_->GetWorld()->removeRigidBody(body_);
@@ -416,6 +442,14 @@ void EC_RigidBody::RemoveBody()
 
 void EC_RigidBody::getWorldTransform(btTransform &worldTrans) const
 {
+    // Bullet reads kinematic bodies' transforms during the step. The placeable must not be accessed from the worker thread,
+    // but the body transform is kept in sync with it by UpdatePosRotFromPlaceable()
+    if (world_ && world_->IsSteppingInWorker() && body_)
+    {
+        worldTrans = body_->getWorldTransform();
+        return;
+    }
+    
     EC_Placeable* placeable = placeable_.lock().get();
     if (!placeable)
         return;
@@ -428,15 +462,55 @@ void EC_RigidBody::getWorldTransform(btTransform &worldTrans) const
 }
 
 void EC_RigidBody::setWorldTransform(const btTransform &worldTrans)
+{
+    // When stepping in the worker thread, the transform is applied in the main thread after the step
+    if (world_ && world_->IsSteppingInWorker())
+    {
+        world_->QueueBodyTransform(this, worldTrans);
+        return;
+    }
+    
+    ApplyWorldTransform(worldTrans);
+}
+
+void EC_RigidBody::ApplyWorldTransform(const btTransform &worldTrans)
 {
     // Cannot modify server-authoritative physics object, rather get the transform changes through placeable attributes
     if (!HasAuthority())
         return;
     
+    // Every placeable change is replicated, so skip imperceptible motion while the body is moving.
+    // The exact transform is written by SettleTransform() once the body falls asleep, or after cSettleInterval
+    if (body_ && body_->isActive())
+    {
+        float positionThreshold = positionErrorThreshold.Get();
+        float rotationThreshold = rotationErrorThreshold.Get() * DEGTORAD;
+        if (lastPosition_.DistanceSq(worldTrans.getOrigin()) <= positionThreshold * positionThreshold &&
+            lastOrientation_.AngleBetween(worldTrans.getRotation()) <= rotationThreshold &&
+            (positionThreshold > 0.0f || rotationThreshold > 0.0f))
+        {
+            if (!settlePending_)
+            {
+                settlePending_ = true;
+                settleTime_ = 0.0f;
+            }
+            return;
+        }
+    }
+    
+    WriteWorldTransform(worldTrans);
+}
+
+void EC_RigidBody::WriteWorldTransform(const btTransform &worldTrans)
+{
     EC_Placeable* placeable = placeable_.lock().get();
     if (!placeable)
         return;
     
+    lastPosition_ = worldTrans.getOrigin();
+    lastOrientation_ = worldTrans.getRotation();
+    settlePending_ = false;
+    
     // Important: disconnect our own response to attribute changes to not create an endless loop!
     disconnected_ = true;
     
@@ -477,10 +551,34 @@ void EC_RigidBody::setWorldTransform(const btTransform &worldTrans)
     disconnected_ = false;
 }
 
-void EC_RigidBody::OnTerrainRegenerated()
+void EC_RigidBody::OnTerrainRegenerated(int firstPatchX, int firstPatchY, int lastPatchX, int lastPatchY)
 {
-    if (shapeType.Get() == Shape_HeightField)
+    if (shapeType.Get() != Shape_HeightField)
+        return;
+
+    EC_Terrain* terrain = terrain_.lock().get();
+    if (!terrain || !heightField_ || terrain->VerticesWidth() != heightFieldWidth_ || terrain->VerticesHeight() != heightFieldHeight_)
+    {
+        // No heightfield yet, or the terrain has been resized: create from scratch
         CreateCollisionShape();
+        return;
+    }
+
+    PROFILE(EC_RigidBody_UpdateHeightField);
+
+    // Bullet reads the height values in place
+    WaitForSimulation();
+
+    float minY, maxY;
+    CopyTerrainHeights(terrain, firstPatchX, firstPatchY, lastPatchX, lastPatchY, minY, maxY);
+
+    // The height range of btHeightfieldTerrainShape is fixed on creation. If the edit went outside it, create a new shape over the same values.
+    if (minY < heightFieldMinY_ || maxY > heightFieldMaxY_)
+    {
+        heightFieldMinY_ = std::min(minY, heightFieldMinY_);
+        heightFieldMaxY_ = std::max(maxY, heightFieldMaxY_);
+        CreateHeightFieldShape(terrain);
+    }
 }
 
 void EC_RigidBody::OnCollisionMeshAssetLoaded(AssetPtr asset)
@@ -516,6 +614,7 @@ void EC_RigidBody::OnAttributeUpdated(IAttribute* attribute)
         return;
     
     // Create body now if does not exist yet
+    WaitForSimulation();
     if (!body_)
         CreateBody();
     // If body was not created (we do not actually have a physics world), exit
@@ -612,6 +711,7 @@ void EC_RigidBody::PlaceableUpdated(IAttribute* attribute)
     if (!placeable)
         return;
         
+    WaitForSimulation();
     if (attribute == &placeable->transform)
     {
         // Important: when changing both transform and parent, always set parentref first, then transform
@@ -622,8 +722,11 @@ void EC_RigidBody::PlaceableUpdated(IAttribute* attribute)
     }
 }
 
-void EC_RigidBody::OnAboutToUpdate()
+void EC_RigidBody::OnAboutToUpdate(float frametime)
 {
+    if (settlePending_)
+        SettleTransform(frametime);
+    
     // If the placeable is parented, we forcibly update world transform from it before each simulation step
     // However, we do not update scale, as that is expensive
     EC_Placeable* placeable = placeable_.lock().get();
@@ -631,6 +734,20 @@ void EC_RigidBody::OnAboutToUpdate()
         UpdatePosRotFromPlaceable();
 }
 
+void EC_RigidBody::SettleTransform(float frametime)
+{
+    settleTime_ += frametime;
+    if (!body_ || !HasAuthority())
+    {
+        settlePending_ = false;
+        return;
+    }
+    
+    // Bullet stops reporting the transforms of a body once it is deactivated, so the final resting transform is written from here
+    if (!body_->isActive() || settleTime_ >= cSettleInterval)
+        WriteWorldTransform(body_->getWorldTransform());
+}
+
 void EC_RigidBody::SetRotation(const float3& rotation)
 {
     // Cannot modify server-authoritative physics object
@@ -646,6 +763,7 @@ void EC_RigidBody::SetRotation(const float3& rotation)
         trans.rot = rotation;
         placeable->transform.Set(trans, AttributeChange::Default);
         
+        WaitForSimulation();
         if (body_)
         {
             btTransform& worldTrans = body_->getWorldTransform();
@@ -674,6 +792,7 @@ void EC_RigidBody::Rotate(const float3& rotation)
         trans.rot += rotation;
         placeable->transform.Set(trans, AttributeChange::Default);
         
+        WaitForSimulation();
         if (body_)
         {
             btTransform& worldTrans = body_->getWorldTransform();
@@ -689,6 +808,7 @@ void EC_RigidBody::Rotate(const float3& rotation)
 
 float3 EC_RigidBody::GetLinearVelocity()
 {
+    WaitForSimulation();
     if (body_)
         return body_->getLinearVelocity();
     else 
@@ -697,6 +817,7 @@ float3 EC_RigidBody::GetLinearVelocity()
 
 float3 EC_RigidBody::GetAngularVelocity()
 {
+    WaitForSimulation();
     if (body_)
         return body_->getAngularVelocity() * RADTODEG;
     else
@@ -705,6 +826,7 @@ float3 EC_RigidBody::GetAngularVelocity()
 
 void EC_RigidBody::GetAabbox(float3 &outAabbMin, float3 &outAabbMax)
 {
+    WaitForSimulation();
     btVector3 aabbMin, aabbMax;
     body_->getAabb(aabbMin, aabbMax);
     outAabbMin.Set(aabbMin.x(), aabbMin.y(), aabbMin.z());
@@ -724,9 +846,15 @@ void EC_RigidBody::TerrainUpdated(IAttribute* attribute)
     EC_Terrain* terrain = terrain_.lock().get();
     if (!terrain)
         return;
-    /// \todo It is suboptimal to regenerate the whole heightfield when just the terrain's transform changes
     if ((attribute == &terrain->nodeTransformation) && (shapeType.Get() == Shape_HeightField))
-        CreateCollisionShape();
+    {
+        WaitForSimulation();
+        // The height values do not change, so only the shape needs to be recreated with the new transform
+        if (heightField_)
+            CreateHeightFieldShape(terrain);
+        else
+            CreateCollisionShape();
+    }
 }
 
 void EC_RigidBody::RequestMesh()
@@ -766,6 +894,7 @@ void EC_RigidBody::UpdateScale()
     EC_Placeable* placeable = placeable_.lock().get();
     if ((placeable) && (shape_))
     {
+        WaitForSimulation();
         // Note: for now, world scale is purposefully NOT used, because it would be problematic to change the scale when a parenting change occurs
         const float3& scale = placeable->transform.Get().scale;
         // Trianglemesh or convexhull does not have scaling of its own in the shape, so multiply with the size
@@ -784,49 +913,92 @@ void EC_RigidBody::CreateHeightFieldFromTerrain()
     if (!terrain)
         return;
     
-    int width = terrain->PatchWidth() * EC_Terrain::cPatchSize;
-    int height = terrain->PatchHeight() * EC_Terrain::cPatchSize;
+    int width = terrain->VerticesWidth();
+    int height = terrain->VerticesHeight();
     
     if ((!width) || (!height))
         return;
     
-    heightValues_.resize(width * height);
-    
+    heightValues_.clear();
+    heightValues_.resize(width * height, 0.f);
+    heightFieldWidth_ = width;
+    heightFieldHeight_ = height;
+
+    CopyTerrainHeights(terrain, 0, 0, terrain->PatchWidth() - 1, terrain->PatchHeight() - 1, heightFieldMinY_, heightFieldMaxY_);
+    if (heightFieldMinY_ > heightFieldMaxY_) // No patches loaded yet
+        heightFieldMinY_ = heightFieldMaxY_ = 0.f;
+
+    CreateHeightFieldShape(terrain);
+}
+
+void EC_RigidBody::CreateHeightFieldShape(EC_Terrain *terrain)
+{
     float xzSpacing = 1.0f;
     float ySpacing = 1.0f;
-    float minY = 1000000000;
-    float maxY = -1000000000;
-    for(uint z = 0; z < (uint)height; ++z)
-        for(uint x = 0; x < (uint)width; ++x)
-        {
-            float value = terrain->GetPoint(x, z);
-            if (value < minY)
-                minY = value;
-            if (value > maxY)
-                maxY = value;
-            heightValues_[z * width + x] = value;
-        }
 
     float3 scale = terrain->nodeTransformation.Get().scale;
-    float3 bbMin(0, minY, 0);
-    float3 bbMax(xzSpacing * (width - 1), maxY, xzSpacing * (height - 1));
+    float3 bbMin(0, heightFieldMinY_, 0);
+    float3 bbMax(xzSpacing * (heightFieldWidth_ - 1), heightFieldMaxY_, xzSpacing * (heightFieldHeight_ - 1));
     float3 bbCenter = scale.Mul((bbMin + bbMax) * 0.5f);
     
-    heightField_ = new btHeightfieldTerrainShape(width, height, &heightValues_[0], ySpacing, minY, maxY, 1, PHY_FLOAT, false);
+    btHeightfieldTerrainShape *oldHeightField = heightField_;
+    heightField_ = new btHeightfieldTerrainShape(heightFieldWidth_, heightFieldHeight_, &heightValues_[0], ySpacing, heightFieldMinY_, heightFieldMaxY_, 1, PHY_FLOAT, false);
     
     /** \todo EC_Terrain uses its own transform that is independent of the placeable. It is not nice to support, since rest of EC_RigidBody assumes
         the transform is in the placeable. Right now, we only support position & scaling. Here, we also counteract Bullet's nasty habit to center 
         the heightfield on its own. Also, Bullet's collisionshapes generally do not support arbitrary transforms, so we must construct a "compound shape"
         and add the heightfield as its child, to be able to specify the transform.
      */
-    heightField_->setLocalScaling(scale);
-    
     float3 positionAdjust = terrain->nodeTransformation.Get().pos;
     positionAdjust += bbCenter;
     
-    btCompoundShape* compound = new btCompoundShape();
-    shape_ = compound;
-    compound->addChildShape(btTransform(btQuaternion(0,0,0,1), positionAdjust), heightField_);
+    if (!shape_)
+        shape_ = new btCompoundShape();
+    btCompoundShape* compound = static_cast<btCompoundShape*>(shape_);
+    if (oldHeightField)
+        compound->removeChildShape(oldHeightField);
+    delete oldHeightField;
+
+    // If the compound has already been scaled from the placeable, the scaling has to be applied to the new child by hand.
+    const btVector3 &compoundScale = compound->getLocalScaling();
+    heightField_->setLocalScaling(btVector3(scale.x, scale.y, scale.z) * compoundScale);
+    compound->addChildShape(btTransform(btQuaternion(0,0,0,1), btVector3(positionAdjust.x, positionAdjust.y, positionAdjust.z) * compoundScale), heightField_);
+
+    if (body_ && world_)
+        world_->GetWorld()->updateSingleAabb(body_);
+}
+
+void EC_RigidBody::CopyTerrainHeights(EC_Terrain *terrain, int firstPatchX, int firstPatchY, int lastPatchX, int lastPatchY, float &minY, float &maxY)
+{
+    minY = std::numeric_limits<float>::max();
+    maxY = -std::numeric_limits<float>::max();
+
+    firstPatchX = std::max(0, firstPatchX);
+    firstPatchY = std::max(0, firstPatchY);
+    lastPatchX = std::min(terrain->PatchWidth() - 1, lastPatchX);
+    lastPatchY = std::min(terrain->PatchHeight() - 1, lastPatchY);
+
+    const int patchSize = EC_Terrain::cPatchSize;
+    for(int py = firstPatchY; py <= lastPatchY; ++py)
+        for(int px = firstPatchX; px <= lastPatchX; ++px)
+        {
+            const EC_Terrain::Patch &patch = terrain->GetPatch(px, py);
+            if (patch.heightData.size() < (size_t)(patchSize * patchSize))
+                continue; // Not loaded yet
+
+            // Copy one patch row at a time straight from the patch storage
+            const float *src = &patch.heightData[0];
+            for(int z = 0; z < patchSize; ++z, src += patchSize)
+            {
+                float *dest = &heightValues_[(py * patchSize + z) * heightFieldWidth_ + px * patchSize];
+                memcpy(dest, src, patchSize * sizeof(float));
+                for(int x = 0; x < patchSize; ++x)
+                {
+                    minY = std::min(minY, src[x]);
+                    maxY = std::max(maxY, src[x]);
+                }
+            }
+        }
 }
 
 void EC_RigidBody::CreateConvexHullSetShape()
@@ -886,8 +1058,15 @@ void EC_RigidBody::UpdatePosRotFromPlaceable()
     if (!placeable || !body_)
         return;
     
+    // The transform set from the placeable overrides the one from a step still running in the worker thread
+    if (world_)
+        world_->DiscardPendingResults(this, false);
+    
     float3 position = placeable->WorldPosition();
     Quat orientation = placeable->WorldOrientation();
+    lastPosition_ = position;
+    lastOrientation_ = orientation;
+    settlePending_ = false;
 
     btTransform& worldTrans = body_->getWorldTransform();
     worldTrans.setOrigin(position);
@@ -902,6 +1081,12 @@ void EC_RigidBody::UpdatePosRotFromPlaceable()
     KeepActive();
 }
 
+void EC_RigidBody::WaitForSimulation() const
+{
+    if (world_)
+        world_->WaitForSimulation();
+}
+
 void EC_RigidBody::EmitPhysicsCollision(Entity* otherEntity, const float3& position, const float3& normal, float distance, float impulse, bool newCollision)
 {
     PROFILE(EC_RigidBody_EmitPhysicsCollision);
@@ -9,6 +9,7 @@
 #include "AssetFwd.h"
 
 #include "Math/float3.h"
+#include "Math/Quat.h"
 #include "PhysicsModuleApi.h"
 
 #include <QVector>
@@ -71,6 +72,10 @@ Set to 0,0,0 to make for example an avatar capsule that does not tip over by its
 <div>The collision layer bitmask of this rigidbody. Several bits can be set. 0 is default (all bits set)</div>
 <li>int: collisionMask
 <div>Tells with which collision layers this rigidbody collides with (a bitmask). 0 is default (all bits set)</div>
+<li>float: positionErrorThreshold
+<div>Simulated motion smaller than this distance is not written to the Placeable while the body is moving. 0 writes every change.</div>
+<li>float: rotationErrorThreshold
+<div>Simulated rotation smaller than this angle, in degrees, is not written to the Placeable while the body is moving. 0 writes every change.</div>
 </ul>
 
 <b>Exposes the following scriptable functions:</b>
@@ -209,6 +214,14 @@ public:
     Q_PROPERTY(int collisionMask READ getcollisionMask WRITE setcollisionMask)
     DEFINE_QPROPERTY_ATTRIBUTE(int, collisionMask)
     
+    /// Position error threshold. Simulated motion below it is not written to the placeable until the body settles
+    Q_PROPERTY(float positionErrorThreshold READ getpositionErrorThreshold WRITE setpositionErrorThreshold)
+    DEFINE_QPROPERTY_ATTRIBUTE(float, positionErrorThreshold)
+    
+    /// Rotation error threshold in degrees. Simulated rotation below it is not written to the placeable until the body settles
+    Q_PROPERTY(float rotationErrorThreshold READ getrotationErrorThreshold WRITE setrotationErrorThreshold)
+    DEFINE_QPROPERTY_ATTRIBUTE(float, rotationErrorThreshold)
+    
     /// btMotionState override. Called when Bullet wants us to tell the body's initial transform
     virtual void getWorldTransform(btTransform &worldTrans) const;
 
@@ -310,7 +323,8 @@ public slots:
     */
     void GetAabbox(float3 &outAabbMin, float3 &outAabbMax);
 
-    btRigidBody* GetRigidBody() const { return body_; }
+    /// Return the Bullet body. Waits for a simulation step running in the worker thread to finish first
+    btRigidBody* GetRigidBody() const { WaitForSimulation(); return body_; }
     
     /// Return whether have authority. On the client, returns false for non-local objects.
     bool HasAuthority() const;
@@ -320,7 +334,7 @@ private slots:
     void UpdateSignals();
     
     /// Called when the simulation is about to be stepped
-    void OnAboutToUpdate();
+    void OnAboutToUpdate(float frametime);
     
     /// Called when some of the attributes has been changed.
     void OnAttributeUpdated(IAttribute *attribute);
@@ -334,8 +348,8 @@ private slots:
     /// Check for placeable & terrain components and connect to their signals
     void CheckForPlaceableAndTerrain();
     
-    /// Called when EC_Terrain has been regenerated
-    void OnTerrainRegenerated();
+    /// Called when EC_Terrain has been regenerated. Updates the heightfield from the changed rectangle of patches.
+    void OnTerrainRegenerated(int firstPatchX, int firstPatchY, int lastPatchX, int lastPatchY);
 
     /// Called when collision mesh has been downloaded.
     void OnCollisionMeshAssetLoaded(AssetPtr asset);
@@ -349,6 +363,12 @@ private:
     
     /// Create a heightfield collisionshape from EC_Terrain
     void CreateHeightFieldFromTerrain();
+
+    /// (Re)create the heightfield shape over the current height values and put it inside the compound shape. Creates the compound shape if it does not exist.
+    void CreateHeightFieldShape(EC_Terrain *terrain);
+
+    /// Copy the height values of the given rectangle of terrain patches (inclusive) to the heightfield values, and return the height range of the copied values.
+    void CopyTerrainHeights(EC_Terrain *terrain, int firstPatchX, int firstPatchY, int lastPatchX, int lastPatchY, float &minY, float &maxY);
     
     /// Create a convex hull set collisionshape
     void CreateConvexHullSetShape();
@@ -376,6 +396,19 @@ private:
     /// Calculate mass, shape & static/dynamic-classification dependant properties
     void GetProperties(btVector3& localInertia, float& m, int& collisionFlags);
     
+    /// Apply a transform from Bullet to the placeable and the velocity attributes. Called from setWorldTransform, or from PhysicsWorld after a threaded step
+    /** Changes below the error thresholds are skipped while the body is active, and written later by SettleTransform(). */
+    void ApplyWorldTransform(const btTransform &worldTrans);
+    
+    /// Write the transform and velocities to the attributes
+    void WriteWorldTransform(const btTransform &worldTrans);
+    
+    /// Write the current body transform, if changes have been skipped and the body has fallen asleep or the settle interval has passed
+    void SettleTransform(float frametime);
+    
+    /// Wait for a simulation step running in the worker thread to finish, before accessing the Bullet body or shape
+    void WaitForSimulation() const;
+    
     /// Emit a physics collision. Called from PhysicsWorld
     void EmitPhysicsCollision(Entity* otherEntity, const float3& position, const float3& normal, float distance, float impulse, bool newCollision);
     
@@ -407,6 +440,16 @@ private:
 
     /// Cached shapesize (last created)
     float3 cachedSize_;
+    
+    /// World position and orientation last written to the placeable, or set from it
+    float3 lastPosition_;
+    Quat lastOrientation_;
+    
+    /// True if changes below the error thresholds have been skipped since the last write
+    bool settlePending_;
+    
+    /// Time since the first skipped change
+    float settleTime_;
 
     /// Bullet triangle mesh
     boost::shared_ptr<btTriangleMesh> triangleMesh_;
@@ -417,8 +460,16 @@ private:
     /// Bullet heightfield shape. Note: this is always put inside a compound shape (shape_)
     btHeightfieldTerrainShape* heightField_;
     
-    /// Heightfield values, for the case the shape is a heightfield.
+    /// Heightfield values, for the case the shape is a heightfield. Bullet reads the values from here directly, so they can be updated in place.
     std::vector<float> heightValues_;
+
+    /// Heightfield size in vertices.
+    int heightFieldWidth_;
+    int heightFieldHeight_;
+
+    /// Height range the heightfield shape was created with. The range only grows when the terrain is edited.
+    float heightFieldMinY_;
+    float heightFieldMaxY_;
 };
 
 
@@ -73,6 +73,9 @@ void PhysicsModule::Initialize()
     framework_->Console()->RegisterCommand("autocollisionmesh",
         "Auto-assigns static rigid bodies with collision mesh to all visible meshes.",
         this, SLOT(AutoCollisionMesh()));
+    framework_->Console()->RegisterCommand("threadedphysics",
+        "Toggles stepping physics simulation in a worker thread, in parallel with the rest of the frame.",
+        this, SLOT(ToggleThreadedPhysics()));
 }
 
 void PhysicsModule::Uninitialize()
@@ -88,6 +91,15 @@ void PhysicsModule::ToggleDebugGeometry()
     }
 }
 
+void PhysicsModule::ToggleThreadedPhysics()
+{
+    for (PhysicsWorldMap::iterator i = physicsWorlds_.begin(); i != physicsWorlds_.end(); ++i)
+    {
+        i->second->SetThreadedSimulation(!i->second->IsThreadedSimulation());
+        LogInfo(QString("Threaded physics simulation ") + (i->second->IsThreadedSimulation() ? "enabled." : "disabled."));
+    }
+}
+
 void PhysicsModule::StopPhysics()
 {
     SetRunPhysics(false);
@@ -148,6 +160,8 @@ void PhysicsModule::OnSceneAdded(const QString& name)
     
     boost::shared_ptr<PhysicsWorld> newWorld(new PhysicsWorld(scene, !scene->IsAuthority()));
     newWorld->SetGravity(scene->UpVector() * -9.81f);
+    if (framework_->HasCommandLineParameter("--threadedphysics"))
+        newWorld->SetThreadedSimulation(true);
     physicsWorlds_[scene.get()] = newWorld;
     scene->setProperty(PhysicsWorld::PropertyName(), QVariant::fromValue<QObject*>(newWorld.get()));
 }
@@ -68,6 +68,9 @@ public slots:
     /// Enable/disable physics simulation from all physics worlds
     void SetRunPhysics(bool enable);
     
+    /// Toggles stepping all physics worlds in a worker thread
+    void ToggleThreadedPhysics();
+    
     /// Initialize physics datatypes for a script engine
     void OnScriptEngineCreated(QScriptEngine* engine);
 
@@ -13,8 +13,14 @@
 #include "EC_RigidBody.h"
 #include "LoggingFunctions.h"
 #include "Math/LineSegment.h"
+#include "Math/Ray.h"
 
 #include <Ogre.h>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include "MemoryLeakCheck.h"
 
 namespace Physics
@@ -28,6 +34,226 @@ void TickCallback(btDynamicsWorld *world, btScalar timeStep)
     static_cast<Physics::PhysicsWorld*>(world->getWorldUserInfo())->ProcessPostTick(timeStep);
 }
 
+namespace
+{
+    /// Smallest batch that is split across threads.
+    const size_t cMinRaysPerThread = 64;
+    
+    /// Collects the hits of one ray, either all of them or only the closest.
+    struct BatchRayResultCallback : public btCollisionWorld::RayResultCallback
+    {
+        struct Hit
+        {
+            btCollisionObject* object;
+            btScalar fraction;
+            btVector3 normal;
+            
+            bool operator <(const Hit &rhs) const { return fraction < rhs.fraction; }
+        };
+        
+        explicit BatchRayResultCallback(bool allHits_) : allHits(allHits_) {}
+        
+        virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult, bool normalInWorldSpace)
+        {
+            Hit hit;
+            hit.object = rayResult.m_collisionObject;
+            hit.fraction = rayResult.m_hitFraction;
+            hit.normal = normalInWorldSpace ? rayResult.m_hitNormalLocal : hit.object->getWorldTransform().getBasis() * rayResult.m_hitNormalLocal;
+            m_collisionObject = hit.object;
+            
+            if (allHits)
+            {
+                hits.push_back(hit);
+                return m_closestHitFraction;
+            }
+            
+            if (hits.empty())
+                hits.push_back(hit);
+            else
+                hits[0] = hit;
+            m_closestHitFraction = hit.fraction;
+            return hit.fraction;
+        }
+        
+        bool allHits;
+        std::vector<Hit> hits;
+    };
+    
+    /// Tests a ray against the objects in the leaves of the broadphase tree it passes through.
+    /** btDbvt::rayTest keeps its traversal stack on the stack, unlike btCollisionWorld::rayTest, so rays can be cast from several threads at once. */
+    struct BatchRayTester : public btDbvt::ICollide
+    {
+        BatchRayTester(const btTransform& from_, const btTransform& to_, btCollisionWorld::RayResultCallback& callback_) :
+            from(from_), to(to_), callback(callback_)
+        {
+        }
+        
+        void Process(const btDbvtNode* leaf)
+        {
+            btBroadphaseProxy* proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+            btCollisionObject* object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+            if (callback.needsCollision(proxy))
+                btCollisionWorld::rayTestSingle(from, to, object, object->getCollisionShape(), object->getWorldTransform(), callback);
+        }
+        
+        const btTransform& from;
+        const btTransform& to;
+        btCollisionWorld::RayResultCallback& callback;
+    };
+    
+    /// A range of rays of a batch, cast in one thread.
+    struct RaycastJob
+    {
+        btDbvtBroadphase* broadphase;
+        const std::vector<Ray>* rays;
+        size_t begin;
+        size_t end;
+        float maxDistance;
+        bool allHits;
+        int collisionGroup;
+        int collisionMask;
+    };
+    
+    std::vector<PhysicsQueryHit> RunRaycastJob(RaycastJob job)
+    {
+        std::vector<PhysicsQueryHit> hits;
+        btTransform from = btTransform::getIdentity();
+        btTransform to = btTransform::getIdentity();
+        
+        for(size_t i = job.begin; i < job.end; ++i)
+        {
+            const Ray& ray = (*job.rays)[i];
+            float3 direction = ray.dir.Normalized();
+            from.setOrigin(ray.pos);
+            to.setOrigin(ray.pos + job.maxDistance * direction);
+            
+            BatchRayResultCallback callback(job.allHits);
+            callback.m_collisionFilterGroup = (short)job.collisionGroup;
+            callback.m_collisionFilterMask = (short)job.collisionMask;
+            BatchRayTester tester(from, to, callback);
+            // Dynamic and static objects are in separate trees
+            btDbvt::rayTest(job.broadphase->m_sets[0].m_root, from.getOrigin(), to.getOrigin(), tester);
+            btDbvt::rayTest(job.broadphase->m_sets[1].m_root, from.getOrigin(), to.getOrigin(), tester);
+            
+            if (job.allHits)
+                std::sort(callback.hits.begin(), callback.hits.end());
+            
+            for(size_t j = 0; j < callback.hits.size(); ++j)
+            {
+                const BatchRayResultCallback::Hit& hit = callback.hits[j];
+                PhysicsQueryHit result;
+                result.query = (uint)i;
+                result.body = static_cast<EC_RigidBody*>(hit.object->getUserPointer());
+                result.entity = result.body ? result.body->ParentEntity() : 0;
+                result.distance = hit.fraction * job.maxDistance;
+                result.pos = ray.pos + result.distance * direction;
+                result.normal = hit.normal.normalized();
+                hits.push_back(result);
+            }
+        }
+        
+        return hits;
+    }
+    
+    /// Collects the objects touching a query object.
+    struct OverlapResultCallback : public btCollisionWorld::ContactResultCallback
+    {
+        explicit OverlapResultCallback(const btCollisionObject* self_) : self(self_) {}
+        
+        virtual btScalar addSingleResult(btManifoldPoint& cp, const btCollisionObject* colObj0, int partId0, int index0,
+            const btCollisionObject* colObj1, int partId1, int index1)
+        {
+            // Contacts are also generated for objects within the collision margin, so require actual penetration
+            if (cp.getDistance() > 0.0f)
+                return 0.0f;
+            const btCollisionObject* other = (colObj0 == self) ? colObj1 : colObj0;
+            if (std::find(objects.begin(), objects.end(), other) == objects.end())
+                objects.push_back(other);
+            return 0.0f;
+        }
+        
+        const btCollisionObject* self;
+        std::vector<const btCollisionObject*> objects;
+    };
+}
+
+/// Worker thread that runs the simulation steps started by the main thread, one at a time.
+struct PhysicsWorld::SimulationThread
+{
+    explicit SimulationThread(PhysicsWorld *owner) :
+        world(owner),
+        frametime(0.0f),
+        maxSubSteps(0),
+        stepRequested(false),
+        stepRunning(false),
+        stop(false)
+    {
+        thread = boost::thread(boost::bind(&SimulationThread::ThreadMain, this));
+    }
+    
+    /// Finishes the running step, if any, and stops the thread.
+    ~SimulationThread()
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stop = true;
+            condition.notify_all();
+        }
+        thread.join();
+    }
+    
+    /// Starts a step. The previous step must have been waited for.
+    void Start(float stepFrametime, int stepMaxSubSteps)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        frametime = stepFrametime;
+        maxSubSteps = stepMaxSubSteps;
+        stepRequested = true;
+        stepRunning = true;
+        condition.notify_all();
+    }
+    
+    /// Waits until the running step has finished.
+    void Wait()
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        while(stepRunning)
+            condition.wait(lock);
+    }
+    
+    void ThreadMain()
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        for(;;)
+        {
+            while(!stepRequested && !stop)
+                condition.wait(lock);
+            if (stop)
+                return;
+            stepRequested = false;
+            float stepFrametime = frametime;
+            int stepMaxSubSteps = maxSubSteps;
+            
+            lock.unlock();
+            world->StepSimulation(stepFrametime, stepMaxSubSteps);
+            lock.lock();
+            
+            stepRunning = false;
+            condition.notify_all();
+        }
+    }
+    
+    PhysicsWorld *world;
+    float frametime;
+    int maxSubSteps;
+    bool stepRequested;
+    bool stepRunning;
+    bool stop;
+    boost::mutex mutex;
+    boost::condition_variable condition;
+    boost::thread thread;
+};
+
 PhysicsWorld::PhysicsWorld(ScenePtr scene, bool isClient) :
     scene_(scene),
     collisionConfiguration_(0),
@@ -41,7 +267,10 @@ PhysicsWorld::PhysicsWorld(ScenePtr scene, bool isClient) :
     drawDebugGeometry_(false),
     drawDebugManuallySet_(false),
     debugDrawMode_(0),
-    cachedOgreWorld_(0)
+    cachedOgreWorld_(0),
+    threadedSimulation_(false),
+    steppingInWorker_(false),
+    simulationThread_(0)
 {
     collisionConfiguration_ = new btDefaultCollisionConfiguration();
     collisionDispatcher_ = new btCollisionDispatcher(collisionConfiguration_);
@@ -54,6 +283,8 @@ PhysicsWorld::PhysicsWorld(ScenePtr scene, bool isClient) :
 
 PhysicsWorld::~PhysicsWorld()
 {
+    SAFE_DELETE(simulationThread_);
+    
     delete world_;
     world_ = 0;
     
@@ -75,56 +306,170 @@ void PhysicsWorld::SetPhysicsUpdatePeriod(float updatePeriod)
     // Allow max.1000 fps
     if (updatePeriod <= 0.001f)
         updatePeriod = 0.001f;
+    WaitForSimulation();
     physicsUpdatePeriod_ = updatePeriod;
 }
 
 void PhysicsWorld::SetGravity(const float3& gravity)
 {
+    WaitForSimulation();
     world_->setGravity(gravity);
 }
 
 float3 PhysicsWorld::GetGravity() const
 {
+    WaitForSimulation();
     return world_->getGravity();
 }
 
 btDiscreteDynamicsWorld* PhysicsWorld::GetWorld() const
 {
+    WaitForSimulation();
     return world_;
 }
 
+void PhysicsWorld::SetThreadedSimulation(bool enable)
+{
+    if (enable == threadedSimulation_)
+        return;
+    
+    threadedSimulation_ = enable;
+    // The results of a step still running are published on the next Simulate() as usual
+    if (!enable)
+    {
+        WaitForSimulation();
+        SAFE_DELETE(simulationThread_);
+    }
+}
+
+void PhysicsWorld::WaitForSimulation() const
+{
+    if (steppingInWorker_ && simulationThread_)
+    {
+        PROFILE(PhysicsWorld_WaitForSimulation);
+        simulationThread_->Wait();
+    }
+}
+
 void PhysicsWorld::Simulate(f64 frametime)
 {
-    if (!runPhysics_)
+    if (!runPhysics_ && !steppingInWorker_)
         return;
     
     PROFILE(PhysicsWorld_Simulate);
     
+    // Apply the results of the step started on the previous frame
+    if (steppingInWorker_)
+    {
+        WaitForSimulation();
+        PublishSimulationResults();
+        if (!runPhysics_)
+            return;
+    }
+    
     emit AboutToUpdate((float)frametime);
     
     int maxSubSteps = (int)((1.0f / physicsUpdatePeriod_) / cMinFps);
+    if (threadedSimulation_)
+    {
+        // Debug geometry is drawn from the world state before the step, as the worker thread owns the world during the step
+        DrawDebugGeometry();
+        
+        if (!simulationThread_)
+            simulationThread_ = new SimulationThread(this);
+        steppingInWorker_ = true;
+        simulationThread_->Start((float)frametime, maxSubSteps);
+    }
+    else
+    {
+        {
+            PROFILE(Bullet_stepSimulation); ///\note Do not delete or rename this PROFILE() block. The DebugStats profiler uses this string as a label to know where to inject the Bullet internal profiling data.
+            StepSimulation((float)frametime, maxSubSteps);
+        }
+        DrawDebugGeometry();
+    }
+}
+
+void PhysicsWorld::StepSimulation(float frametime, int maxSubSteps)
+{
+    // No profiling here or in the tick callback, as this is also run in the simulation thread and neither our profiler nor
+    // reading the Bullet profiling data is thread safe. Without the Bullet_stepSimulation block the DebugStats profiler
+    // also leaves the Bullet data alone while the worker writes it.
+    world_->stepSimulation(frametime, maxSubSteps, physicsUpdatePeriod_);
+}
+
+void PhysicsWorld::PublishSimulationResults()
+{
+    PROFILE(PhysicsWorld_PublishSimulationResults);
+    
+    steppingInWorker_ = false;
+    
+    // Signal handlers may delete rigidbodies, which removes their remaining results through DiscardPendingResults(),
+    // so take the transforms out one at a time and check the collision bodies just before use
+    while(!pendingTransforms_.empty())
     {
-        PROFILE(Bullet_stepSimulation); ///\note Do not delete or rename this PROFILE() block. The DebugStats profiler uses this string as a label to know where to inject the Bullet internal profiling data.
-        world_->stepSimulation((float)frametime, maxSubSteps, physicsUpdatePeriod_);
+        std::map<EC_RigidBody*, btTransform>::iterator i = pendingTransforms_.begin();
+        EC_RigidBody* body = i->first;
+        btTransform worldTrans = i->second;
+        pendingTransforms_.erase(i);
+        body->ApplyWorldTransform(worldTrans);
     }
     
-    // Automatically enable debug geometry if at least one debug-enabled rigidbody. Automatically disable if no debug-enabled rigidbodies
-    // However, do not do this if user has used the physicsdebug console command
-    if (!drawDebugManuallySet_)
+    size_t collisionIndex = 0;
+    for(size_t i = 0; i < pendingSubsteps_.size(); ++i)
     {
-        if ((!drawDebugGeometry_) && (!debugRigidBodies_.empty()))
-            SetDrawDebugGeometry(true);
-        if ((drawDebugGeometry_) && (debugRigidBodies_.empty()))
-            SetDrawDebugGeometry(false);
+        for(; collisionIndex < pendingSubsteps_[i].first && collisionIndex < pendingCollisions_.size(); ++collisionIndex)
+        {
+            const PendingCollision collision = pendingCollisions_[collisionIndex];
+            if (!collision.bodyA || !collision.bodyB)
+                continue;
+            Entity* entityA = collision.bodyA->ParentEntity();
+            Entity* entityB = collision.bodyB->ParentEntity();
+            if (!entityA || !entityB)
+                continue;
+            
+            {
+                PROFILE(PhysicsWorld_emit_PhysicsCollision);
+                emit PhysicsCollision(entityA, entityB, collision.position, collision.normal, collision.distance, collision.impulse, collision.newCollision);
+            }
+            collision.bodyA->EmitPhysicsCollision(entityB, collision.position, collision.normal, collision.distance, collision.impulse, collision.newCollision);
+            collision.bodyB->EmitPhysicsCollision(entityA, collision.position, collision.normal, collision.distance, collision.impulse, collision.newCollision);
+        }
+        
+        {
+            PROFILE(PhysicsWorld_ProcessPostTick_Updated);
+            emit Updated(pendingSubsteps_[i].second);
+        }
     }
     
-    if (drawDebugGeometry_)
-        DrawDebugGeometry();
+    pendingCollisions_.clear();
+    pendingSubsteps_.clear();
+}
+
+void PhysicsWorld::QueueBodyTransform(EC_RigidBody* body, const btTransform& worldTrans)
+{
+    pendingTransforms_[body] = worldTrans;
+}
+
+void PhysicsWorld::DiscardPendingResults(EC_RigidBody* body, bool collisions)
+{
+    WaitForSimulation();
+    pendingTransforms_.erase(body);
+    if (collisions)
+    {
+        for(size_t i = 0; i < pendingCollisions_.size(); ++i)
+        {
+            if (pendingCollisions_[i].bodyA == body || pendingCollisions_[i].bodyB == body)
+            {
+                pendingCollisions_[i].bodyA = 0;
+                pendingCollisions_[i].bodyB = 0;
+            }
+        }
+    }
 }
 
 void PhysicsWorld::ProcessPostTick(float substeptime)
 {
-    PROFILE(PhysicsWorld_ProcessPostTick);
     // Check contacts and send collision signals for them
     int numManifolds = collisionDispatcher_->getNumManifolds();
     
@@ -132,8 +477,6 @@ void PhysicsWorld::ProcessPostTick(float substeptime)
     
     if (numManifolds > 0)
     {
-        PROFILE(PhysicsWorld_SendCollisions);
-        
         for(int i = 0; i < numManifolds; ++i)
         {
             btPersistentManifold* contactManifold = collisionDispatcher_->getManifoldByIndexInternal(i);
@@ -152,10 +495,12 @@ void PhysicsWorld::ProcessPostTick(float substeptime)
             EC_RigidBody* bodyA = static_cast<EC_RigidBody*>(objectA->getUserPointer());
             EC_RigidBody* bodyB = static_cast<EC_RigidBody*>(objectB->getUserPointer());
             
-            // We are only interested in collisions where both EC_RigidBody components are known
+            // We are only interested in collisions where both EC_RigidBody components are known.
+            // Logging is not safe in the worker thread, so the errors are reported only when stepping in the main thread
             if (!bodyA || !bodyB)
             {
-                LogError("Inconsistent Bullet physics scene state! An object exists in the physics scene which does not have an associated EC_RigidBody!");
+                if (!steppingInWorker_)
+                    LogError("Inconsistent Bullet physics scene state! An object exists in the physics scene which does not have an associated EC_RigidBody!");
                 continue;
             }
             // Also, both bodies should have valid parent entities
@@ -163,7 +508,8 @@ void PhysicsWorld::ProcessPostTick(float substeptime)
             Entity* entityB = bodyB->ParentEntity();
             if (!entityA || !entityB)
             {
-                LogError("Inconsistent Bullet physics scene state! A parentless EC_RigidBody exists in the physics scene!");
+                if (!steppingInWorker_)
+                    LogError("Inconsistent Bullet physics scene state! A parentless EC_RigidBody exists in the physics scene!");
                 continue;
             }
             // Check that at least one of the bodies is active
@@ -181,12 +527,21 @@ void PhysicsWorld::ProcessPostTick(float substeptime)
                 float distance = point.m_distance1;
                 float impulse = point.m_appliedImpulse;
                 
+                if (steppingInWorker_)
                 {
-                    PROFILE(PhysicsWorld_emit_PhysicsCollision);
-                    emit PhysicsCollision(entityA, entityB, position, normal, distance, impulse, newCollision);
+                    // Signals are emitted in the main thread when the step is published
+                    PendingCollision collision = { bodyA, bodyB, position, normal, distance, impulse, newCollision };
+                    pendingCollisions_.push_back(collision);
+                }
+                else
+                {
+                    {
+                        PROFILE(PhysicsWorld_emit_PhysicsCollision);
+                        emit PhysicsCollision(entityA, entityB, position, normal, distance, impulse, newCollision);
+                    }
+                    bodyA->EmitPhysicsCollision(entityB, position, normal, distance, impulse, newCollision);
+                    bodyB->EmitPhysicsCollision(entityA, position, normal, distance, impulse, newCollision);
                 }
-                bodyA->EmitPhysicsCollision(entityB, position, normal, distance, impulse, newCollision);
-                bodyB->EmitPhysicsCollision(entityA, position, normal, distance, impulse, newCollision);
                 
                 // Report newCollision = true only for the first contact, in case there are several contacts, and application does some logic depending on it
                 // (for example play a sound -> avoid multiple sounds being played)
@@ -199,6 +554,9 @@ void PhysicsWorld::ProcessPostTick(float substeptime)
     
     previousCollisions_ = currentCollisions;
     
+    if (steppingInWorker_)
+        pendingSubsteps_.push_back(std::make_pair(pendingCollisions_.size(), substeptime));
+    else
     {
         PROFILE(PhysicsWorld_ProcessPostTick_Updated);
         emit Updated(substeptime);
@@ -209,6 +567,8 @@ PhysicsRaycastResult* PhysicsWorld::Raycast(const float3& origin, const float3&
 {
     PROFILE(PhysicsWorld_Raycast);
     
+    WaitForSimulation();
+    
     static PhysicsRaycastResult result;
     
     float3 normalizedDir = direction.Normalized();
@@ -238,6 +598,133 @@ PhysicsRaycastResult* PhysicsWorld::Raycast(const float3& origin, const float3&
     return &result;
 }
 
+void PhysicsWorld::RaycastBatch(const std::vector<Ray> &rays, float maxDistance, std::vector<PhysicsQueryHit> &hits, bool allHits,
+    bool multithreaded, int collisionGroup, int collisionMask)
+{
+    PROFILE(PhysicsWorld_RaycastBatch);
+    
+    WaitForSimulation();
+    
+    RaycastJob job;
+    job.broadphase = static_cast<btDbvtBroadphase*>(broadphase_);
+    job.rays = &rays;
+    job.begin = 0;
+    job.end = rays.size();
+    job.maxDistance = maxDistance;
+    job.allHits = allHits;
+    job.collisionGroup = collisionGroup;
+    job.collisionMask = collisionMask;
+    
+    size_t numThreads = 1;
+    if (multithreaded)
+        numThreads = std::min((size_t)std::max(QThread::idealThreadCount(), 1), rays.size() / cMinRaysPerThread);
+    if (numThreads <= 1)
+    {
+        std::vector<PhysicsQueryHit> batchHits = RunRaycastJob(job);
+        hits.insert(hits.end(), batchHits.begin(), batchHits.end());
+        return;
+    }
+    
+    // The world is only read during the queries, so the ranges can be cast in parallel
+    std::vector<QFuture<std::vector<PhysicsQueryHit> > > jobs;
+    size_t raysPerThread = (rays.size() + numThreads - 1) / numThreads;
+    for(size_t begin = 0; begin < rays.size(); begin += raysPerThread)
+    {
+        job.begin = begin;
+        job.end = std::min(begin + raysPerThread, rays.size());
+        jobs.push_back(QtConcurrent::run(RunRaycastJob, job));
+    }
+    for(size_t i = 0; i < jobs.size(); ++i)
+    {
+        std::vector<PhysicsQueryHit> jobHits = jobs[i].result();
+        hits.insert(hits.end(), jobHits.begin(), jobHits.end());
+    }
+}
+
+bool PhysicsWorld::ConvexSweep(const btConvexShape* shape, const btTransform& from, const btTransform& to, PhysicsQueryHit& hit,
+    int collisionGroup, int collisionMask)
+{
+    PROFILE(PhysicsWorld_ConvexSweep);
+    
+    if (!shape)
+        return false;
+    
+    WaitForSimulation();
+    
+    btCollisionWorld::ClosestConvexResultCallback callback(from.getOrigin(), to.getOrigin());
+    callback.m_collisionFilterGroup = (short)collisionGroup;
+    callback.m_collisionFilterMask = (short)collisionMask;
+    world_->convexSweepTest(shape, from, to, callback);
+    if (!callback.hasHit())
+        return false;
+    
+    hit.query = 0;
+    hit.body = callback.m_hitCollisionObject ? static_cast<EC_RigidBody*>(callback.m_hitCollisionObject->getUserPointer()) : 0;
+    hit.entity = hit.body ? hit.body->ParentEntity() : 0;
+    hit.pos = callback.m_hitPointWorld;
+    hit.normal = callback.m_hitNormalWorld;
+    hit.distance = callback.m_closestHitFraction * (to.getOrigin() - from.getOrigin()).length();
+    return true;
+}
+
+QList<Entity*> PhysicsWorld::ShapeOverlap(btCollisionShape* shape, const btTransform& transform, int collisionGroup, int collisionMask)
+{
+    PROFILE(PhysicsWorld_ShapeOverlap);
+    
+    QList<Entity*> entities;
+    if (!shape)
+        return entities;
+    
+    WaitForSimulation();
+    
+    btCollisionObject object;
+    object.setCollisionShape(shape);
+    object.setWorldTransform(transform);
+    
+    OverlapResultCallback callback(&object);
+    callback.m_collisionFilterGroup = (short)collisionGroup;
+    callback.m_collisionFilterMask = (short)collisionMask;
+    world_->contactTest(&object, callback);
+    
+    for(size_t i = 0; i < callback.objects.size(); ++i)
+    {
+        EC_RigidBody* body = static_cast<EC_RigidBody*>(callback.objects[i]->getUserPointer());
+        Entity* entity = body ? body->ParentEntity() : 0;
+        if (entity && !entities.contains(entity))
+            entities.push_back(entity);
+    }
+    
+    return entities;
+}
+
+PhysicsRaycastResult* PhysicsWorld::SphereSweep(const float3& from, const float3& to, float radius, int collisiongroup, int collisionmask)
+{
+    static PhysicsRaycastResult result;
+    
+    result.entity = 0;
+    result.distance = 0;
+    
+    btSphereShape sphere(radius);
+    btTransform fromTrans(btQuaternion::getIdentity(), from);
+    btTransform toTrans(btQuaternion::getIdentity(), to);
+    PhysicsQueryHit hit;
+    if (ConvexSweep(&sphere, fromTrans, toTrans, hit, collisiongroup, collisionmask))
+    {
+        result.entity = hit.entity;
+        result.pos = hit.pos;
+        result.normal = hit.normal;
+        result.distance = hit.distance;
+    }
+    
+    return &result;
+}
+
+QList<Entity*> PhysicsWorld::SphereOverlap(const float3& center, float radius, int collisiongroup, int collisionmask)
+{
+    btSphereShape sphere(radius);
+    return ShapeOverlap(&sphere, btTransform(btQuaternion::getIdentity(), center), collisiongroup, collisionmask);
+}
+
 void PhysicsWorld::SetDrawDebugGeometry(bool enable)
 {
     if (scene_.expired() || !scene_.lock()->ViewEnabled() || drawDebugGeometry_ == enable)
@@ -252,6 +739,16 @@ void PhysicsWorld::SetDrawDebugGeometry(bool enable)
 
 void PhysicsWorld::DrawDebugGeometry()
 {
+    // Automatically enable debug geometry if at least one debug-enabled rigidbody. Automatically disable if no debug-enabled rigidbodies
+    // However, do not do this if user has used the physicsdebug console command
+    if (!drawDebugManuallySet_)
+    {
+        if ((!drawDebugGeometry_) && (!debugRigidBodies_.empty()))
+            SetDrawDebugGeometry(true);
+        if ((drawDebugGeometry_) && (debugRigidBodies_.empty()))
+            SetDrawDebugGeometry(false);
+    }
+    
     if (!drawDebugGeometry_)
         return;
 
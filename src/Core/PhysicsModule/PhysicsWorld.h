@@ -9,10 +9,14 @@
 #include "Math/MathFwd.h"
 
 #include <LinearMath/btIDebugDraw.h>
+#include <LinearMath/btTransform.h>
 
 #include <set>
+#include <map>
+#include <vector>
 #include <QObject>
 #include <QVector>
+#include <QList>
 
 #include <boost/enable_shared_from_this.hpp>
 
@@ -22,6 +26,8 @@ class btConstraintSolver;
 class btDiscreteDynamicsWorld;
 class btDispatcher;
 class btCollisionObject;
+class btCollisionShape;
+class btConvexShape;
 class EC_RigidBody;
 class Transform;
 class OgreWorld;
@@ -47,12 +53,33 @@ public:
     float distance;
 };
 
+/// A hit of a batched or sweep query. A plain struct, so that large batches do not allocate a QObject per hit.
+struct PhysicsQueryHit
+{
+    PhysicsQueryHit() : query(0), entity(0), body(0), distance(0.0f) {}
+    
+    /// Index of the query in the batch the hit belongs to
+    uint query;
+    /// Entity that was hit. Null if the hit object has no associated EC_RigidBody
+    Entity* entity;
+    EC_RigidBody* body;
+    float3 pos;
+    float3 normal;
+    /// Distance from the query origin
+    float distance;
+};
+
 namespace Physics
 {
 
 class PhysicsModule;
 
 /// A physics world that encapsulates a Bullet physics world
+/** By default the world is stepped synchronously in Simulate(). With SetThreadedSimulation(true) the step is run in a worker thread
+    in parallel with the rest of the frame: Simulate() publishes the results of the step started on the previous frame, i.e. applies
+    the rigid body transforms and emits the collision and Updated signals in the main thread, and then starts the next step.
+    The results are therefore one frame behind. Main thread access to the Bullet world through GetWorld() or EC_RigidBody
+    waits for the running step to finish first. */
 class PHYSICS_MODULE_API PhysicsWorld : public QObject, public btIDebugDraw, public boost::enable_shared_from_this<PhysicsWorld>
 {
     Q_OBJECT
@@ -70,6 +97,28 @@ public:
     /// Process collision from an internal sub-step (Bullet post-tick callback)
     void ProcessPostTick(float substeptime);
     
+    /// Wait until the simulation step running in the worker thread, if any, has finished. Returns immediately if no step is running.
+    void WaitForSimulation() const;
+    
+    /// Raycast a batch of rays to the world.
+    /** The hits are appended to a flat buffer, grouped by ray in the order of the rays, and each hit records the index of its ray.
+        @param rays Rays to cast. The directions will be normalized automatically
+        @param maxDistance Length of each ray
+        @param hits Buffer the hits are appended to
+        @param allHits If true, all hits of each ray are returned sorted by distance, otherwise only the closest hit
+        @param multithreaded If true, large batches are split across worker threads
+        @param collisionGroup Collision layer. Default has all bits set.
+        @param collisionMask Collision mask. Default has all bits set. */
+    void RaycastBatch(const std::vector<Ray> &rays, float maxDistance, std::vector<PhysicsQueryHit> &hits, bool allHits = false,
+        bool multithreaded = false, int collisionGroup = -1, int collisionMask = -1);
+    
+    /// Sweep a convex shape from one transform to another. Returns true and the closest hit if the shape hits something.
+    bool ConvexSweep(const btConvexShape* shape, const btTransform& from, const btTransform& to, PhysicsQueryHit& hit,
+        int collisionGroup = -1, int collisionMask = -1);
+    
+    /// Return the entities whose collision shapes overlap with the given shape.
+    QList<Entity*> ShapeOverlap(btCollisionShape* shape, const btTransform& transform, int collisionGroup = -1, int collisionMask = -1);
+    
     /// Dynamic scene property name
     static const char* PropertyName() { return "physics"; }
     
@@ -116,6 +165,18 @@ public slots:
         @return result PhysicsRaycastResult structure */
     PhysicsRaycastResult* Raycast(const float3& origin, const float3& direction, float maxdistance, int collisiongroup = -1, int collisionmask = -1);
     
+    /// Sweep a sphere to the world. Returns only a single (the closest) result.
+    /** @param from World position the sphere center starts from
+        @param to World position the sphere center moves to
+        @param radius Radius of the sphere
+        @param collisiongroup Collision layer. Default has all bits set.
+        @param collisionmask Collision mask. Default has all bits set.
+        @return result PhysicsRaycastResult structure. The entity is null if nothing was hit. */
+    PhysicsRaycastResult* SphereSweep(const float3& from, const float3& to, float radius, int collisiongroup = -1, int collisionmask = -1);
+    
+    /// Return the entities whose collision shapes overlap with a sphere.
+    QList<Entity*> SphereOverlap(const float3& center, float radius, int collisiongroup = -1, int collisionmask = -1);
+    
     /// Return gravity
     float3 GetGravity() const;
     
@@ -137,6 +198,12 @@ public slots:
     /// Return whether simulation is on
     bool GetRunPhysics() const { return runPhysics_; }
     
+    /// Enable/disable stepping the simulation in a worker thread, decoupled from the frame. Default false
+    void SetThreadedSimulation(bool enable);
+    
+    /// Return whether the simulation is stepped in a worker thread
+    bool IsThreadedSimulation() const { return threadedSimulation_; }
+    
 signals:
     /// A physics collision has happened between two entities. 
     /** Note: both rigidbodies participating in the collision will also emit a signal separately. 
@@ -160,6 +227,35 @@ signals:
     void Updated(float frametime);
     
 private:
+    struct SimulationThread;
+    
+    /// Collision contact recorded in the worker thread, to be signalled in the main thread
+    struct PendingCollision
+    {
+        EC_RigidBody* bodyA;
+        EC_RigidBody* bodyB;
+        float3 position;
+        float3 normal;
+        float distance;
+        float impulse;
+        bool newCollision;
+    };
+    
+    /// Run Bullet stepSimulation. Called either in the main thread or in the worker thread, so it must not use the profiler
+    void StepSimulation(float frametime, int maxSubSteps);
+    
+    /// Apply the body transforms and emit the signals recorded by the previous threaded step
+    void PublishSimulationResults();
+    
+    /// Buffer a body transform from the worker thread. Called by EC_RigidBody::setWorldTransform
+    void QueueBodyTransform(EC_RigidBody* body, const btTransform& worldTrans);
+    
+    /// Forget the buffered transform of a body, and also its collisions if the body is being destroyed
+    void DiscardPendingResults(EC_RigidBody* body, bool collisions);
+    
+    /// Return whether the current step runs in the worker thread, i.e. results should be buffered
+    bool IsSteppingInWorker() const { return steppingInWorker_; }
+    
     /// Bullet collision config
     btCollisionConfiguration* collisionConfiguration_;
     /// Bullet collision dispatcher
@@ -203,5 +299,23 @@ private:
     
     /// Debug draw-enabled rigidbodies. Note: these pointers are never dereferenced, it is just used for counting
     std::set<EC_RigidBody*> debugRigidBodies_;
+    
+    /// Threaded simulation flag
+    bool threadedSimulation_;
+    
+    /// True from starting a step in the worker thread until its results have been published
+    bool steppingInWorker_;
+    
+    /// Worker thread, created on demand
+    SimulationThread* simulationThread_;
+    
+    /// Body transforms from the worker thread step. Only the latest transform of each body is kept
+    std::map<EC_RigidBody*, btTransform> pendingTransforms_;
+    
+    /// Collisions from the worker thread step, in the order they occurred
+    std::vector<PendingCollision> pendingCollisions_;
+    
+    /// Number of collisions recorded by each substep of the worker thread step, and the substep lengths
+    std::vector<std::pair<size_t, float> > pendingSubsteps_;
 };
 }
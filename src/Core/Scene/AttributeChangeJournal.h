@@ -0,0 +1,32 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "CoreTypes.h"
+
+class Scene;
+
+/// One entry of the per-scene attribute change journal.
+/** The attribute is identified by entity id, component id and attribute index instead of pointers,
+    so that the entries are safe to read even if the component has been removed before the journal is drained.
+    @see Scene::AddAttributeChangeListener */
+struct AttributeChangeRecord
+{
+    /// Kind of the change.
+    enum Kind
+    {
+        Changed = 0,
+        Added,
+        Removed
+    };
+
+    entity_id_t entityId;
+    component_id_t componentId;
+    u8 attributeIndex;
+    u8 kind; ///< Kind
+    u8 change; ///< AttributeChange::Type, never Default or Disconnected.
+    bool interpolated; ///< True if the change was made by the attribute interpolation of the scene.
+};
+
+/// Receives a batch of attribute change journal entries, in the order the changes happened.
+typedef void (*AttributeChangeListener)(void *userData, Scene *scene, const AttributeChangeRecord *records, size_t count);
@@ -53,8 +53,12 @@ bool CmpAttributeDataByName(const DeserializeData &a, const DeserializeData &b)
 }
 
 EC_DynamicComponent::EC_DynamicComponent(Scene* scene):
-    IComponent(scene)
+    IComponent(scene),
+    batchDepth_(0),
+    committingBatch_(false)
 {
+    connect(this, SIGNAL(AttributeAdded(IAttribute *)), SLOT(OnAttributeAdded(IAttribute *)));
+    connect(this, SIGNAL(AttributeAboutToBeRemoved(IAttribute *)), SLOT(OnAttributeAboutToBeRemoved(IAttribute *)));
 }
 
 EC_DynamicComponent::~EC_DynamicComponent()
@@ -68,7 +72,7 @@ void EC_DynamicComponent::SerializeTo(QDomDocument& doc, QDomElement& base_eleme
     AttributeVector::const_iterator iter = attributes.begin();
     while(iter != attributes.end())
     {
-        if (*iter)
+        if (*iter && !IsRemovedInBatch(*iter))
             WriteAttribute(doc, comp_element, (*iter)->Name(), (*iter)->ToString().c_str(), (*iter)->TypeName());
         ++iter;
     }
@@ -97,6 +101,8 @@ void EC_DynamicComponent::DeserializeFrom(QDomElement& element, AttributeChange:
 
 void EC_DynamicComponent::DeserializeCommon(std::vector<DeserializeData>& deserializedAttributes, AttributeChange::Type change)
 {
+    BeginBatch();
+
     // Sort both lists in alphabetical order.
     AttributeVector oldAttributes = NonEmptyAttributes();
     std::stable_sort(oldAttributes.begin(), oldAttributes.end(), &CmpAttributeByName);
@@ -128,10 +134,7 @@ void EC_DynamicComponent::DeserializeCommon(std::vector<DeserializeData>& deseri
         // Attribute has already created and we only need to update it's value.
         if((*iter1)->Name() == (*iter2).name_)
         {
-            //SetAttribute(QString::fromStdString(iter2->name_), QString::fromStdString(iter2->value_), change);
-            for(AttributeVector::const_iterator attr_iter = attributes.begin(); attr_iter != attributes.end(); ++attr_iter)
-                if((*attr_iter)->Name() == iter2->name_)
-                    (*attr_iter)->FromString(iter2->value_.toStdString(), change);
+            (*iter1)->FromString(iter2->value_.toStdString(), change);
 
             ++iter2;
             ++iter1;
@@ -153,23 +156,28 @@ void EC_DynamicComponent::DeserializeCommon(std::vector<DeserializeData>& deseri
     while(!addAttributes.empty())
     {
         DeserializeData attributeData = addAttributes.back();
-        IAttribute *attribute = CreateAttribute(attributeData.type_, attributeData.name_);
+        size_t numCreated = batchCreated_.size();
+        IAttribute *attribute = CreateAttribute(attributeData.type_, attributeData.name_, change);
+        // The value of an attribute created in the batch is signalled at commit, together with its addition
         if (attribute)
-            attribute->FromString(attributeData.value_.toStdString(), change);
+            attribute->FromString(attributeData.value_.toStdString(), batchCreated_.size() > numCreated ? AttributeChange::Disconnected : change);
         addAttributes.pop_back();
     }
     while(!remAttributes.empty())
     {
         DeserializeData attributeData = remAttributes.back();
-        RemoveAttribute(attributeData.name_);
+        RemoveAttribute(attributeData.name_, change);
         remAttributes.pop_back();
     }
+
+    CommitBatch();
 }
 
 IAttribute *EC_DynamicComponent::CreateAttribute(const QString &typeName, const QString &name, AttributeChange::Type change)
 {
-    if(ContainsAttribute(name))
-        return IComponent::GetAttribute(name);
+    IAttribute *existing = FindAttribute(name);
+    if (existing)
+        return existing;
 
     IAttribute *attribute = SceneAPI::CreateAttribute(typeName, name);
     if(!attribute)
@@ -179,6 +187,14 @@ IAttribute *EC_DynamicComponent::CreateAttribute(const QString &typeName, const
     }
     
     IComponent::AddAttribute(attribute);
+    IndexAttribute(attribute);
+    
+    // Signalled on commit
+    if (batchDepth_ > 0)
+    {
+        batchCreated_.push_back(std::make_pair(attribute, change));
+        return attribute;
+    }
     
     // Trigger scenemanager signal
     Scene* scene = ParentScene();
@@ -193,44 +209,154 @@ IAttribute *EC_DynamicComponent::CreateAttribute(const QString &typeName, const
 
 void EC_DynamicComponent::RemoveAttribute(const QString &name, AttributeChange::Type change)
 {
-    for(AttributeVector::iterator iter = attributes.begin(); iter != attributes.end(); iter++)
+    IAttribute *attr = FindAttribute(name);
+    if (attr)
+        RemoveAttribute(attr, change);
+}
+
+void EC_DynamicComponent::RemoveAttribute(IAttribute *attr, AttributeChange::Type change)
+{
+    if (batchDepth_ > 0)
     {
-        if((*iter) && (*iter)->Name() == name)
-        {
-            // Trigger scenemanager signal
-            Scene* scene = ParentScene();
-            if (scene)
-                scene->EmitAttributeRemoved(this, *iter, change);
-            
-            // Trigger internal signal(s)
-            emit AttributeAboutToBeRemoved(*iter);
-            // Leave a hole in the array, which will be filled when new attributes are created
-            SAFE_DELETE(*iter);
-            break;
-        }
+        UnindexAttribute(attr);
+        // An attribute created in the same batch has not been signalled yet, so it can be deleted right away
+        for(size_t i = 0; i < batchCreated_.size(); ++i)
+            if (batchCreated_[i].first == attr)
+            {
+                batchCreated_.erase(batchCreated_.begin() + i);
+                SAFE_DELETE(attributes[attr->Index()]);
+                ++changeVersion;
+                return;
+            }
+        batchRemoved_.push_back(std::make_pair(attr, change));
+        return;
     }
+
+    DeleteAttribute(attr, change);
 }
 
 void EC_DynamicComponent::RemoveAllAttributes(AttributeChange::Type change)
 {
-    for(unsigned i = attributes.size() - 1; i < attributes.size(); --i)
+    BeginBatch();
+    AttributeVector attrs = NonEmptyAttributes();
+    for(size_t i = 0; i < attrs.size(); ++i)
+        if (!IsRemovedInBatch(attrs[i]))
+            RemoveAttribute(attrs[i], change);
+    CommitBatch();
+}
+
+bool EC_DynamicComponent::IsRemovedInBatch(const IAttribute *attr) const
+{
+    for(size_t i = 0; i < batchRemoved_.size(); ++i)
+        if (batchRemoved_[i].first == attr)
+            return true;
+    return false;
+}
+
+void EC_DynamicComponent::DeleteAttribute(IAttribute *attr, AttributeChange::Type change)
+{
+    UnindexAttribute(attr);
+
+    // Trigger scenemanager signal
+    Scene* scene = ParentScene();
+    if (scene)
+        scene->EmitAttributeRemoved(this, attr, change);
+    
+    // Trigger internal signal(s)
+    emit AttributeAboutToBeRemoved(attr);
+    // Leave a hole in the array, which will be filled when new attributes are created
+    SAFE_DELETE(attributes[attr->Index()]);
+    ++changeVersion;
+}
+
+void EC_DynamicComponent::BeginBatch()
+{
+    ++batchDepth_;
+}
+
+void EC_DynamicComponent::CommitBatch()
+{
+    if (batchDepth_ <= 0)
     {
-        if (attributes[i])
-        {
-            // Trigger scenemanager signal
-            Scene* scene = ParentScene();
-            if (scene)
-                scene->EmitAttributeRemoved(this, attributes[i], change);
+        LogWarning("EC_DynamicComponent::CommitBatch: no batch has been begun in dynamic component " + Name());
+        return;
+    }
+    if (--batchDepth_ > 0)
+        return;
 
-            QString name(attributes[i]->Name());
+    // Take the lists first, the signal receivers may begin a new batch
+    std::vector<std::pair<IAttribute *, AttributeChange::Type> > removed;
+    std::vector<std::pair<IAttribute *, AttributeChange::Type> > created;
+    removed.swap(batchRemoved_);
+    created.swap(batchCreated_);
+    if (removed.empty() && created.empty())
+        return;
 
-            // Trigger internal signal(s)
-            emit AttributeAboutToBeRemoved(attributes[i]);
-            SAFE_DELETE(attributes[i]);
-            attributes[i] = 0;
-        }
-        attributes.clear();
+    // The scene records the structural changes in its journal, from which scene sync replicates them together.
+    // The per-attribute signals are emitted as for unbatched changes, listeners that only need to react to the
+    // whole batch can skip them while IsCommittingBatch() is true and wait for BatchCommitted
+    committingBatch_ = true;
+    Scene* scene = ParentScene();
+    for(size_t i = 0; i < removed.size(); ++i)
+    {
+        IAttribute *attribute = removed[i].first;
+        if (scene)
+            scene->EmitAttributeRemoved(this, attribute, removed[i].second);
+        emit AttributeAboutToBeRemoved(attribute);
+        SAFE_DELETE(attributes[attribute->Index()]);
+        ++changeVersion;
+    }
+    for(size_t i = 0; i < created.size(); ++i)
+    {
+        if (created[i].second == AttributeChange::Default)
+            created[i].second = UpdateMode();
+        if (scene)
+            scene->EmitAttributeAdded(this, created[i].first, created[i].second);
+        emit AttributeAdded(created[i].first);
     }
+    committingBatch_ = false;
+
+    emit BatchCommitted();
+
+    // The values of the created attributes, set without signalling during the batch
+    for(size_t i = 0; i < created.size(); ++i)
+        if (created[i].second != AttributeChange::Disconnected)
+            emit AttributeChanged(created[i].first, created[i].second);
+}
+
+IAttribute *EC_DynamicComponent::FindAttribute(const QString &name) const
+{
+    QHash<QString, int>::const_iterator iter = attributeIndices_.find(name);
+    if (iter == attributeIndices_.end())
+        return 0;
+    int index = iter.value();
+    if (index < (int)attributes.size() && attributes[index] && attributes[index]->Name() == name)
+        return attributes[index];
+    return 0;
+}
+
+void EC_DynamicComponent::IndexAttribute(IAttribute *attr)
+{
+    attributeIndices_[attr->Name()] = attr->Index();
+}
+
+void EC_DynamicComponent::UnindexAttribute(IAttribute *attr)
+{
+    QHash<QString, int>::iterator iter = attributeIndices_.find(attr->Name());
+    if (iter != attributeIndices_.end() && iter.value() == attr->Index())
+        attributeIndices_.erase(iter);
+}
+
+void EC_DynamicComponent::OnAttributeAdded(IAttribute *attr)
+{
+    if (attr && !FindAttribute(attr->Name()))
+        IndexAttribute(attr);
+}
+
+void EC_DynamicComponent::OnAttributeAboutToBeRemoved(IAttribute *attr)
+{
+    if (attr)
+        UnindexAttribute(attr);
 }
 
 int EC_DynamicComponent::GetInternalAttributeIndex(int index) const
@@ -253,11 +379,7 @@ void EC_DynamicComponent::AddQVariantAttribute(const QString &name, AttributeCha
 {
     //Check if the attribute has already been created.
     if(!ContainsAttribute(name))
-    {
-        Attribute<QVariant> *attribute = new Attribute<QVariant>(this, name.toStdString().c_str());
-        EmitAttributeChanged(attribute, change);
-        emit AttributeAdded(attribute);
-    }
+        CreateAttribute("qvariant", name, change);
     else
         LogWarning("Failed to add a new QVariant in name of " + name + ", cause there already is an attribute in that name.");
 }
@@ -273,7 +395,8 @@ QVariant EC_DynamicComponent::GetAttribute(int index) const
 
 QVariant EC_DynamicComponent::GetAttribute(const QString &name) const
 {
-    return IComponent::GetAttributeQVariant(name);
+    IAttribute *attr = FindAttribute(name);
+    return attr ? attr->ToQVariant() : QVariant();
 }
 
 void EC_DynamicComponent::SetAttribute(int index, const QVariant &value, AttributeChange::Type change)
@@ -290,22 +413,16 @@ void EC_DynamicComponent::SetAttribute(int index, const QVariant &value, Attribu
 
 void EC_DynamicComponent::SetAttributeQScript(const QString &name, const QScriptValue &value, AttributeChange::Type change)
 {
-    for(AttributeVector::const_iterator iter = attributes.begin(); iter != attributes.end(); ++iter)
-        if((*iter) && (*iter)->Name() == name)
-        {
-            (*iter)->FromScriptValue(value, change);
-            break; 
-        }
+    IAttribute *attr = FindAttribute(name);
+    if (attr)
+        attr->FromScriptValue(value, change);
 }
 
 void EC_DynamicComponent::SetAttribute(const QString &name, const QVariant &value, AttributeChange::Type change)
 {
-    for(AttributeVector::const_iterator iter = attributes.begin(); iter != attributes.end(); ++iter)
-        if((*iter) && (*iter)->Name() == name)
-        {
-            (*iter)->FromQVariant(value, change);
-            break;
-        }
+    IAttribute *attr = FindAttribute(name);
+    if (attr)
+        attr->FromQVariant(value, change);
 }
 
 QString EC_DynamicComponent::GetAttributeName(int index) const
@@ -372,25 +489,22 @@ bool EC_DynamicComponent::ContainSameAttributes(const EC_DynamicComponent &comp)
 
 bool EC_DynamicComponent::ContainsAttribute(const QString &name) const
 {
-    AttributeVector::const_iterator iter = attributes.begin();
-    while(iter != attributes.end())
-    {
-        if((*iter) && (*iter)->Name() == name)
-            return true;
-        ++iter;
-    }
-
-    return false;
+    return FindAttribute(name) != 0;
 }
 
 void EC_DynamicComponent::SerializeToBinary(kNet::DataSerializer& dest) const
 {
-    dest.Add<u8>(attributes.size());
+    // Count only the attributes that are written, skipping holes and the attributes removed in the current batch
+    u8 numAttributes = 0;
+    for(AttributeVector::const_iterator iter = attributes.begin(); iter != attributes.end(); ++iter)
+        if (*iter && !IsRemovedInBatch(*iter))
+            ++numAttributes;
+    dest.Add<u8>(numAttributes);
     // For now, transmit all values as strings
     AttributeVector::const_iterator iter = attributes.begin();
     while(iter != attributes.end())
     {
-        if (*iter)
+        if (*iter && !IsRemovedInBatch(*iter))
         {
             dest.AddString((*iter)->Name().toStdString());
             dest.AddString((*iter)->TypeName().toStdString());
@@ -12,6 +12,7 @@ namespace kNet
 }
 
 #include <QVariant>
+#include <QHash>
 
 struct DeserializeData;
 
@@ -31,6 +32,9 @@ If you want to create a new attribute you can use either AddQVariantAttribute or
 AddQVariantAttribute will create empty QVariant type of attribute and user need to set attribute value
 after the attribute is added to component by using a SetAttribute method.
 
+When creating or removing many attributes at once, wrap the calls between BeginBatch and CommitBatch.
+The structural changes are then signalled together at commit, and replicated in one message.
+
 All component's changes should be forwarded to all clients and therefore they should be on sync.
 When component is deserialized it will compare old and a new attribute values and will get difference
 between those two and use that information to remove attributes that are not in the new list and add those
@@ -55,6 +59,8 @@ Registered by TundraLogicModule.
 <li>"RemoveAttribute": Remove attribute from the component.
 <li>"ContainAttribute": Check if component is holding attribute by that name.
     @param name Name of attribute that we are looking for.
+<li>"BeginBatch": Begins a batch of attribute additions and removals.
+<li>"CommitBatch": Signals the attribute additions and removals made since BeginBatch.
 </ul>
 
 <b>Reacts on the following actions:</b>
@@ -96,9 +102,9 @@ public:
         // Check if attribute has already created.
         if (!ContainsAttribute(name))
         {
-            IAttribute *attribute = new Attribute<T>(this, name.toStdString().c_str());
-            EmitAttributeChanged(attribute, change);
-            emit AttributeAdded(attribute);
+            // Create by type name, so that the attribute is dynamic and takes part in the current batch
+            Attribute<T> prototype(0, "");
+            CreateAttribute(prototype.TypeName(), name, change);
         }
     }
 
@@ -175,8 +181,66 @@ public slots:
 
     /// Removes all attributes from the component
     void RemoveAllAttributes(AttributeChange::Type change = AttributeChange::Default);
-    
+
+    /// Begins a batch of attribute additions and removals.
+    /** Until the matching CommitBatch, attributes created with CreateAttribute exist and can be set, but their addition
+        is not signalled, and attributes removed with RemoveAttribute are only detached by name, left out of serialization
+        and deleted at commit. Set the values of the created attributes with AttributeChange::Disconnected, their values are
+        signalled at commit. Batches can be nested, only the outermost CommitBatch signals the changes.
+        @note Commit the batch within the same frame, as the changes are not replicated before it. */
+    void BeginBatch();
+
+    /// Signals all attribute additions and removals made since BeginBatch together.
+    /** All removals are recorded to the scene first, then all additions, so that scene sync sends them in one
+        RemoveAttributes and one CreateAttributes message. AttributeAboutToBeRemoved and AttributeAdded are emitted for
+        each attribute while IsCommittingBatch() is true, then BatchCommitted once, and finally AttributeChanged for each
+        created attribute. No separate attribute change is signalled to the scene for the created attributes, as their values are
+        replicated in the create message. */
+    void CommitBatch();
+
+    /// Returns true if a batch has been begun but not committed.
+    bool IsInBatch() const { return batchDepth_ > 0; }
+
+    /// Returns true while CommitBatch is signalling the additions and removals of a batch one attribute at a time.
+    bool IsCommittingBatch() const { return committingBatch_; }
+
+signals:
+    /// Emitted once when a batch of attribute additions and removals has been committed.
+    /** Emitted after AttributeAboutToBeRemoved and AttributeAdded have been emitted for each attribute of the batch. */
+    void BatchCommitted();
+
+private slots:
+    /// Keeps the name index in sync when attributes are created by network sync.
+    void OnAttributeAdded(IAttribute *attr);
+
+    /// Keeps the name index in sync when attributes are removed by network sync.
+    void OnAttributeAboutToBeRemoved(IAttribute *attr);
+
 private:
     /// Convert attribute index without holes (used by client) into actual attribute index. Returns below zero if not found. Requires a linear search.
     int GetInternalAttributeIndex(int index) const;
+
+    /// Returns attribute by name using the name index, or null if not found.
+    IAttribute *FindAttribute(const QString &name) const;
+
+    /// Adds attribute to the name index.
+    void IndexAttribute(IAttribute *attr);
+
+    /// Removes attribute from the name index.
+    void UnindexAttribute(IAttribute *attr);
+
+    /// Removes an attribute, or defers its removal to the commit if in a batch.
+    void RemoveAttribute(IAttribute *attr, AttributeChange::Type change);
+
+    /// Returns true if the attribute has been removed in the current batch, but not deleted yet.
+    bool IsRemovedInBatch(const IAttribute *attr) const;
+
+    /// Signals removal of an attribute and deletes it.
+    void DeleteAttribute(IAttribute *attr, AttributeChange::Type change);
+
+    QHash<QString, int> attributeIndices_; ///< Attribute indices by name.
+    int batchDepth_; ///< Nesting depth of BeginBatch calls.
+    bool committingBatch_; ///< Is CommitBatch signalling the attributes of a batch.
+    std::vector<std::pair<IAttribute *, AttributeChange::Type> > batchCreated_; ///< Attributes created in the current batch.
+    std::vector<std::pair<IAttribute *, AttributeChange::Type> > batchRemoved_; ///< Attributes removed in the current batch, not yet deleted.
 };
@@ -544,11 +544,19 @@ QString Entity::Description() const
         return QString();
 }
 
-EntityAction *Entity::Action(const QString &name)
+EntityAction *Entity::FindAction(const QString &name) const
 {
     foreach(EntityAction *action, actions_)
         if (action->Name().compare(name, Qt::CaseInsensitive) == 0)
             return action;
+    return 0;
+}
+
+EntityAction *Entity::Action(const QString &name)
+{
+    EntityAction *existing = FindAction(name);
+    if (existing)
+        return existing;
 
     EntityAction *action = new EntityAction(name);
     actions_.insert(name, action);
@@ -588,22 +596,109 @@ void Entity::Exec(EntityAction::ExecTypeField type, const QString &action, const
 
     if ((type & EntityAction::Local) != 0)
     {
-        if (params.size() == 0)
-            act->Trigger();
-        else if (params.size() == 1)
-            act->Trigger(params[0]);
-        else if (params.size() == 2)
-            act->Trigger(params[0], params[1]);
-        else if (params.size() == 3)
-            act->Trigger(params[0], params[1], params[2]);
-        else if (params.size() >= 4)
-            act->Trigger(params[0], params[1], params[2], params.mid(3));
+        TriggerAction(act, params);
+
+        // Fast path handlers registered to the id of this action get the parameters as strings
+        if (!actionHandlers_.empty())
+        {
+            entity_action_id_t id = framework_->Scene()->GetEntityActionId(action);
+            if (id)
+            {
+                EntityActionArgs args = EntityActionArgs::FromStringList(params);
+                if (args.IsValid())
+                    TriggerActionHandlers(id, args, EntityAction::Local);
+            }
+        }
     }
 
     if (ParentScene())
         ParentScene()->EmitActionTriggered(this, action, params, type);
 }
 
+void Entity::TriggerAction(EntityAction *action, const QStringList &params)
+{
+    if (params.size() == 0)
+        action->Trigger();
+    else if (params.size() == 1)
+        action->Trigger(params[0]);
+    else if (params.size() == 2)
+        action->Trigger(params[0], params[1]);
+    else if (params.size() == 3)
+        action->Trigger(params[0], params[1], params[2]);
+    else if (params.size() >= 4)
+        action->Trigger(params[0], params[1], params[2], params.mid(3));
+}
+
+void Entity::ConnectAction(entity_action_id_t id, EntityActionHandler handler, void *userData)
+{
+    if (!id || !handler)
+    {
+        LogError("Entity::ConnectAction: null action id or handler given");
+        return;
+    }
+    if (id > cMaxEntityActionId)
+    {
+        LogError("Entity::ConnectAction: action id " + QString::number(id) + " is larger than the maximum " + QString::number(cMaxEntityActionId));
+        return;
+    }
+    if (id >= actionHandlers_.size())
+        actionHandlers_.resize(id + 1);
+
+    ActionHandlerList &handlers = actionHandlers_[id];
+    for(size_t i = 0; i < handlers.size(); ++i)
+        if (handlers[i].handler == handler && handlers[i].userData == userData)
+            return; // Already connected
+
+    ActionHandler h = { handler, userData };
+    handlers.push_back(h);
+}
+
+void Entity::DisconnectAction(entity_action_id_t id, EntityActionHandler handler, void *userData)
+{
+    if (id >= actionHandlers_.size())
+        return;
+
+    ActionHandlerList &handlers = actionHandlers_[id];
+    for(size_t i = 0; i < handlers.size(); ++i)
+        if (handlers[i].handler == handler && handlers[i].userData == userData)
+        {
+            handlers.erase(handlers.begin() + i);
+            return;
+        }
+}
+
+void Entity::Exec(EntityAction::ExecTypeField type, entity_action_id_t id, const EntityActionArgs &args)
+{
+    if ((type & EntityAction::Local) != 0)
+    {
+        TriggerActionHandlers(id, args, EntityAction::Local);
+
+        // String API receivers of the same action, if the id has been given a name
+        if (!actions_.isEmpty())
+        {
+            QString name = framework_->Scene()->GetEntityActionName(id);
+            EntityAction *act = name.isEmpty() ? 0 : FindAction(name);
+            if (act)
+                TriggerAction(act, args.ToStringList());
+        }
+    }
+
+    if (ParentScene())
+        ParentScene()->EmitActionTriggered(this, id, args, type);
+}
+
+void Entity::TriggerActionHandlers(entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type)
+{
+    if (id >= actionHandlers_.size())
+        return;
+    // Index-based loop and bounds check each round, as handlers may disconnect themselves
+    for(size_t i = 0; i < actionHandlers_[id].size(); ++i)
+    {
+        const ActionHandler &h = actionHandlers_[id][i];
+        h.handler(h.userData, this, id, args, type);
+    }
+}
+
 void Entity::Exec(EntityAction::ExecTypeField type, const QString &action, const QVariantList &params)
 {
     QStringList stringParams;
@@ -124,6 +124,28 @@ public:
     /** @param typeId Unique type ID of the component.
         @param name name of the component */
     ComponentPtr CreateComponentWithId(component_id_t compId, u32 typeId, const QString &name, AttributeChange::Type change = AttributeChange::Default);
+
+    /// Connects a handler function to the action with integer id.
+    /** Fast path counterpart of ConnectAction(const QString &, const QObject *, const char *). The handler is called
+        directly, without Qt signals or string conversions, when the action is executed locally on this entity.
+        The handler must be disconnected before userData becomes invalid.
+        @param id Action id, see SceneAPI::RegisterEntityAction.
+        @param handler Handler function.
+        @param userData Pointer passed to the handler. */
+    void ConnectAction(entity_action_id_t id, EntityActionHandler handler, void *userData = 0);
+
+    /// Disconnects a handler connected with ConnectAction(entity_action_id_t, EntityActionHandler, void *).
+    void DisconnectAction(entity_action_id_t id, EntityActionHandler handler, void *userData = 0);
+
+    /// Executes an action by integer id with typed binary parameters.
+    /** Fast path counterpart of the string-based Exec. Local handlers are called directly. Receivers connected
+        through the string API to the action name registered for the id get the parameters converted to strings.
+        Server and peer execution is replicated with a compact binary message. If the id has a registered name,
+        Scene::ActionTriggered is emitted with it, as for actions executed by name.
+        @param type Execution type(s), i.e. where the actions is executed.
+        @param id Action id, see SceneAPI::RegisterEntityAction.
+        @param args Parameters for the action. */
+    void Exec(EntityAction::ExecTypeField type, entity_action_id_t id, const EntityActionArgs &args);
     
 public slots:
     /// Returns a component by ID. This is the fastest way to query, as the components are stored in a map by id.
@@ -389,6 +411,23 @@ private:
     /** @param action Action to be validated. */
     bool HasReceivers(EntityAction *action);
 
+    /// Returns an existing action by name, or null if no such action has been created.
+    EntityAction *FindAction(const QString &name) const;
+
+    /// Triggers a string-based action with a parameter list.
+    void TriggerAction(EntityAction *action, const QStringList &params);
+
+    /// Calls the fast path handlers of an action.
+    void TriggerActionHandlers(entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type);
+
+    /// Fast path action handler.
+    struct ActionHandler
+    {
+        EntityActionHandler handler;
+        void *userData;
+    };
+    typedef std::vector<ActionHandler> ActionHandlerList;
+
     /// Emit a entity deletion signal. Called from Scene
     void EmitEntityRemoved(AttributeChange::Type change);
 
@@ -398,6 +437,7 @@ private:
     Framework* framework_; ///< Pointer to framework
     Scene* scene_; ///< Pointer to scene
     ActionMap actions_; ///< Map of registered entity actions.
+    std::vector<ActionHandlerList> actionHandlers_; ///< Fast path action dispatch table, indexed by action id.
     bool temporary_; ///< Temporary-flag
 };
 
@@ -8,11 +8,20 @@
 #pragma once
 
 #include "CoreTypes.h"
+#include "EntityActionArgs.h"
 
 #include <QObject>
 
 class Entity;
 
+/// Integer id of an entity action executed through the fast path. Zero is not a valid id.
+/** The ids index a dispatch table in each entity they are used in, so use small ids, at most cMaxEntityActionId.
+    @see SceneAPI::RegisterEntityAction */
+typedef u32 entity_action_id_t;
+
+/// Largest valid entity action id. Bounds the dispatch tables, as action ids also arrive from the network.
+const entity_action_id_t cMaxEntityActionId = 1023;
+
 /// Represents an executable command on an Entity.
 /** Components (and other instances) can register to these actions by using Entity::ConnectAction().
     Actions allow more complicated in-world logic to be built in slightly more data-driven fashion.
@@ -70,3 +79,11 @@ private:
 
     QString name; ///< Name of the action.
 };
+
+/// Fast path entity action handler function.
+/** @param userData User data pointer given when the handler was connected.
+    @param entity Entity the action was executed on.
+    @param id Action id.
+    @param args Action parameters.
+    @param type Execution type(s) the action was executed with. */
+typedef void (*EntityActionHandler)(void *userData, Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type);
@@ -0,0 +1,308 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "EntityActionArgs.h"
+#include "LoggingFunctions.h"
+
+#include <cstring>
+
+#include "MemoryLeakCheck.h"
+
+EntityActionArgs::EntityActionArgs() :
+    size_(0),
+    count_(0),
+    overflow_(false)
+{
+}
+
+EntityActionArgs &EntityActionArgs::AddBool(bool value)
+{
+    u8 v = value ? 1 : 0;
+    return Append(BoolType, &v, sizeof(v));
+}
+
+EntityActionArgs &EntityActionArgs::AddInt(s32 value)
+{
+    return Append(IntType, &value, sizeof(value));
+}
+
+EntityActionArgs &EntityActionArgs::AddUInt(u32 value)
+{
+    return Append(UIntType, &value, sizeof(value));
+}
+
+EntityActionArgs &EntityActionArgs::AddFloat(float value)
+{
+    return Append(FloatType, &value, sizeof(value));
+}
+
+EntityActionArgs &EntityActionArgs::AddFloat3(const float3 &value)
+{
+    float v[3] = { value.x, value.y, value.z };
+    return Append(Float3Type, v, sizeof(v));
+}
+
+EntityActionArgs &EntityActionArgs::AddQuat(const Quat &value)
+{
+    float v[4] = { value.x, value.y, value.z, value.w };
+    return Append(QuatType, v, sizeof(v));
+}
+
+EntityActionArgs &EntityActionArgs::AddString(const QString &value)
+{
+    QByteArray utf8 = value.toUtf8();
+    if (utf8.size() > 255)
+    {
+        // Cut before the character that crosses the limit, so that no multibyte sequence is split
+        int length = 255;
+        while(length > 0 && (utf8[length] & 0xC0) == 0x80)
+            --length;
+        utf8.truncate(length);
+    }
+    // Strings are stored as length byte followed by the characters
+    u8 buffer[256];
+    buffer[0] = (u8)utf8.size();
+    memcpy(&buffer[1], utf8.constData(), utf8.size());
+    return Append(StringType, buffer, utf8.size() + 1);
+}
+
+void EntityActionArgs::Clear()
+{
+    size_ = 0;
+    count_ = 0;
+    overflow_ = false;
+}
+
+EntityActionArgs::ParamType EntityActionArgs::Type(uint index) const
+{
+    if (index >= count_)
+        return InvalidType;
+    return (ParamType)data_[offsets_[index]];
+}
+
+bool EntityActionArgs::ToBool(uint index) const
+{
+    switch(Type(index))
+    {
+    case BoolType:
+        return *Value(index) != 0;
+    case StringType:
+    {
+        QString str = ToString(index);
+        return str.compare("true", Qt::CaseInsensitive) == 0 || str.toInt() != 0;
+    }
+    case InvalidType:
+        return false;
+    default:
+        return ToFloat(index) != 0.f;
+    }
+}
+
+s32 EntityActionArgs::ToInt(uint index) const
+{
+    switch(Type(index))
+    {
+    case IntType:
+    {
+        s32 v;
+        memcpy(&v, Value(index), sizeof(v));
+        return v;
+    }
+    case UIntType:
+        return (s32)ToUInt(index);
+    case StringType:
+        return ToString(index).toInt();
+    default:
+        return (s32)ToFloat(index);
+    }
+}
+
+u32 EntityActionArgs::ToUInt(uint index) const
+{
+    switch(Type(index))
+    {
+    case UIntType:
+    {
+        u32 v;
+        memcpy(&v, Value(index), sizeof(v));
+        return v;
+    }
+    case IntType:
+        return (u32)ToInt(index);
+    case StringType:
+        return ToString(index).toUInt();
+    default:
+        return (u32)ToFloat(index);
+    }
+}
+
+float EntityActionArgs::ToFloat(uint index) const
+{
+    switch(Type(index))
+    {
+    case BoolType:
+        return *Value(index) ? 1.f : 0.f;
+    case IntType:
+        return (float)ToInt(index);
+    case UIntType:
+        return (float)ToUInt(index);
+    case FloatType:
+    {
+        float v;
+        memcpy(&v, Value(index), sizeof(v));
+        return v;
+    }
+    case StringType:
+        return ToString(index).toFloat();
+    default:
+        return 0.f;
+    }
+}
+
+float3 EntityActionArgs::ToFloat3(uint index) const
+{
+    switch(Type(index))
+    {
+    case Float3Type:
+    {
+        float v[3];
+        memcpy(v, Value(index), sizeof(v));
+        return float3(v[0], v[1], v[2]);
+    }
+    case StringType:
+        return float3::FromString(ToString(index));
+    default:
+        return float3::zero;
+    }
+}
+
+Quat EntityActionArgs::ToQuat(uint index) const
+{
+    switch(Type(index))
+    {
+    case QuatType:
+    {
+        float v[4];
+        memcpy(v, Value(index), sizeof(v));
+        return Quat(v[0], v[1], v[2], v[3]);
+    }
+    case StringType:
+        return Quat::FromString(ToString(index));
+    default:
+        return Quat::identity;
+    }
+}
+
+QString EntityActionArgs::ToString(uint index) const
+{
+    switch(Type(index))
+    {
+    case BoolType:
+        return ToBool(index) ? "true" : "false";
+    case IntType:
+        return QString::number(ToInt(index));
+    case UIntType:
+        return QString::number(ToUInt(index));
+    case FloatType:
+        return QString::number(ToFloat(index));
+    case Float3Type:
+        return ToFloat3(index).SerializeToString().c_str();
+    case QuatType:
+        return ToQuat(index).SerializeToString().c_str();
+    case StringType:
+    {
+        const u8 *value = Value(index);
+        return QString::fromUtf8((const char *)value + 1, value[0]);
+    }
+    default:
+        return QString();
+    }
+}
+
+QStringList EntityActionArgs::ToStringList() const
+{
+    QStringList params;
+    for(uint i = 0; i < count_; ++i)
+        params << ToString(i);
+    return params;
+}
+
+EntityActionArgs EntityActionArgs::FromStringList(const QStringList &params)
+{
+    EntityActionArgs args;
+    foreach(const QString &param, params)
+        args.AddString(param);
+    if (!args.IsValid())
+        LogWarning("EntityActionArgs::FromStringList: " + QString::number(params.size()) + " parameters do not fit into the parameter buffer, the list is incomplete.");
+    return args;
+}
+
+bool EntityActionArgs::SetData(const u8 *data, uint numBytes)
+{
+    Clear();
+    if (numBytes > cMaxDataSize)
+        return false;
+
+    uint pos = 0;
+    while(pos < numBytes)
+    {
+        if (count_ >= cMaxParams)
+        {
+            Clear();
+            return false;
+        }
+        ParamType type = (ParamType)data[pos];
+        uint valueSize = FixedValueSize(type);
+        if (type == StringType && pos + 1 < numBytes)
+            valueSize = data[pos + 1] + 1;
+        if (valueSize == 0 || pos + 1 + valueSize > numBytes)
+        {
+            Clear();
+            return false;
+        }
+        offsets_[count_++] = (u8)pos;
+        pos += 1 + valueSize;
+    }
+
+    memcpy(data_, data, numBytes);
+    size_ = (u8)numBytes;
+    return true;
+}
+
+EntityActionArgs &EntityActionArgs::Append(ParamType type, const void *value, uint numBytes)
+{
+    if (count_ >= cMaxParams || size_ + 1 + numBytes > cMaxDataSize)
+    {
+        overflow_ = true;
+        return *this;
+    }
+
+    offsets_[count_++] = size_;
+    data_[size_] = (u8)type;
+    memcpy(&data_[size_ + 1], value, numBytes);
+    size_ += (u8)(1 + numBytes);
+    return *this;
+}
+
+const u8 *EntityActionArgs::Value(uint index) const
+{
+    if (index >= count_)
+        return 0;
+    return &data_[offsets_[index] + 1];
+}
+
+uint EntityActionArgs::FixedValueSize(ParamType type)
+{
+    switch(type)
+    {
+    case BoolType: return 1;
+    case IntType: return 4;
+    case UIntType: return 4;
+    case FloatType: return 4;
+    case Float3Type: return 12;
+    case QuatType: return 16;
+    default: return 0;
+    }
+}
@@ -0,0 +1,101 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Math/float3.h"
+#include "Math/Quat.h"
+
+#include <QString>
+#include <QStringList>
+
+/// Typed binary parameter list for entity actions executed by integer id.
+/** The parameters are stored as (type, value) pairs in a fixed size inline buffer, so building and passing
+    the list does not allocate memory. The same bytes are sent as is in the binary entity action network message.
+    The conversion functions convert between the parameter types, including the string type, which is used
+    when the action is executed through the string-based Entity::Exec API.
+    @see Entity::Exec(EntityAction::ExecTypeField, entity_action_id_t, const EntityActionArgs &) */
+class EntityActionArgs
+{
+public:
+    /// Parameter types.
+    enum ParamType
+    {
+        InvalidType = 0,
+        BoolType,
+        IntType,
+        UIntType,
+        FloatType,
+        Float3Type,
+        QuatType,
+        StringType ///< UTF-8, max. 255 bytes. Longer strings are cut at the last whole character that fits.
+    };
+
+    /// Maximum size of the serialized parameters in bytes, including the type tags.
+    static const uint cMaxDataSize = 128;
+    /// Maximum number of parameters.
+    static const uint cMaxParams = 16;
+
+    EntityActionArgs();
+
+    /// Appends a parameter. If the parameter does not fit, it is not added and IsValid() will return false.
+    EntityActionArgs &AddBool(bool value);
+    EntityActionArgs &AddInt(s32 value);
+    EntityActionArgs &AddUInt(u32 value);
+    EntityActionArgs &AddFloat(float value);
+    EntityActionArgs &AddFloat3(const float3 &value);
+    EntityActionArgs &AddQuat(const Quat &value);
+    EntityActionArgs &AddString(const QString &value);
+
+    /// Removes all parameters.
+    void Clear();
+
+    /// Returns number of parameters.
+    uint Count() const { return count_; }
+
+    /// Returns false if a parameter has been dropped because it did not fit.
+    bool IsValid() const { return !overflow_; }
+
+    /// Returns type of a parameter, or InvalidType if index is out of range.
+    ParamType Type(uint index) const;
+
+    /// Returns a parameter converted to the requested type, or default value if index is out of range.
+    bool ToBool(uint index) const;
+    s32 ToInt(uint index) const;
+    u32 ToUInt(uint index) const;
+    float ToFloat(uint index) const;
+    float3 ToFloat3(uint index) const;
+    Quat ToQuat(uint index) const;
+    QString ToString(uint index) const;
+
+    /// Returns all parameters converted to strings, for the string-based action API.
+    QStringList ToStringList() const;
+
+    /// Creates a parameter list of string parameters.
+    /** If the parameters do not all fit, a warning is logged and IsValid() of the returned list is false. */
+    static EntityActionArgs FromStringList(const QStringList &params);
+
+    /// Returns the serialized parameters.
+    const u8 *Data() const { return data_; }
+
+    /// Returns size of the serialized parameters in bytes.
+    uint DataSize() const { return size_; }
+
+    /// Sets the parameters from serialized data, e.g. received from network.
+    /** @return True if the data was well-formed. On failure the list is left empty. */
+    bool SetData(const u8 *data, uint numBytes);
+
+private:
+    /// Appends type tag and value bytes.
+    EntityActionArgs &Append(ParamType type, const void *value, uint numBytes);
+    /// Returns pointer to the value bytes of a parameter, or null if index is out of range.
+    const u8 *Value(uint index) const;
+    /// Returns size of a value of a fixed size type, or 0 for a variable sized/invalid type.
+    static uint FixedValueSize(ParamType type);
+
+    u8 data_[cMaxDataSize];
+    u8 offsets_[cMaxParams]; ///< Offset of the type tag of each parameter.
+    u8 size_;
+    u8 count_;
+    bool overflow_;
+};
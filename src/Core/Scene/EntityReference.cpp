@@ -72,3 +72,11 @@ EntityPtr EntityReference::Lookup(Scene* scene) const
     // Then get by name
     return scene->GetEntityByName(ref.trimmed());
 }
+
+EntityPtr EntityReference::Lookup(Scene* scene, EntityReferenceHandler handler, void *userData) const
+{
+    EntityPtr entity = Lookup(scene);
+    if (!entity && scene && !IsEmpty())
+        scene->AddPendingEntityReference(*this, handler, userData);
+    return entity;
+}
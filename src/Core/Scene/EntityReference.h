@@ -8,6 +8,10 @@
 #include <QString>
 #include <QMetaType>
 
+/// Called when an entity matching a pending entity reference appears into the scene.
+/** @see Scene::AddPendingEntityReference */
+typedef void (*EntityReferenceHandler)(void *userData, Entity *entity);
+
 /// Represents a reference to an entity, either by name or ID.
 /** This structure can be used as a parameter type to an EC attribute. */
 struct EntityReference
@@ -25,6 +29,11 @@ struct EntityReference
     /// Lookup an entity from the scene according to the ref. Return null pointer if not found
     EntityPtr Lookup(Scene* scene) const;
     
+    /// Lookup an entity from the scene according to the ref. If not found, waits for the entity to appear.
+    /** When a matching entity is created into the scene, handler is called once with userData.
+        @see Scene::AddPendingEntityReference */
+    EntityPtr Lookup(Scene* scene, EntityReferenceHandler handler, void *userData) const;
+    
     /// Return whether the ref does not refer to an entity
     bool IsEmpty() const;
 
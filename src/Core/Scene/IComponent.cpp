@@ -30,7 +30,8 @@ IComponent::IComponent(Scene* scene) :
     updateMode(AttributeChange::Replicate),
     replicated(true),
     temporary(false),
-    id(0)
+    id(0),
+    changeVersion(0)
 {
 }
 
@@ -208,6 +209,7 @@ void IComponent::RemoveAttribute(u8 index, AttributeChange::Type change)
         // Trigger internal signal(s)
         emit AttributeAboutToBeRemoved(attr);
         SAFE_DELETE(attributes[index]);
+        ++changeVersion;
     }
     else
         LogError("Can not remove nonexisting attribute at index " + QString::number(index));
@@ -217,6 +219,7 @@ void IComponent::AddAttribute(IAttribute* attr)
 {
     if (!attr)
         return;
+    ++changeVersion;
     // If attribute is static (member variable attributes), we can just push_back it.
     if (!attr->IsDynamic())
     {
@@ -275,6 +278,7 @@ bool IComponent::AddAttribute(IAttribute* attr, u8 index)
     attr->index = index;
     attr->owner = this;
     attributes[index] = attr;
+    ++changeVersion;
     return true;
 }
 
@@ -353,6 +357,7 @@ QString IComponent::ReadAttributeType(QDomElement& comp_element, const QString &
 
 void IComponent::EmitAttributeChanged(IAttribute* attribute, AttributeChange::Type change)
 {
+    ++changeVersion;
     if (change == AttributeChange::Default)
         change = updateMode;
     if (change == AttributeChange::Disconnected)
@@ -212,6 +212,10 @@ public slots:
 
     /// Returns component id, which is unique within the parent entity
     component_id_t Id() const { return id; }
+
+    /// Returns a counter that changes whenever an attribute of this component is changed, added or removed.
+    /** Unlike the change signals, this also counts AttributeChange::Disconnected changes. Use to tell whether data derived from the attributes is out of date. */
+    unsigned ChangeVersion() const { return changeVersion; }
     
     /// Returns the total number of attributes in this component. Does not count holes in the attribute vector
     int NumAttributes() const;
@@ -349,6 +353,9 @@ protected:
     /// Temporary-flag
     bool temporary;
 
+    /// Attribute change counter, see ChangeVersion()
+    unsigned changeVersion;
+
 private:
     friend class ::IAttribute;
     friend class Entity;
@@ -31,6 +31,7 @@
 #include <boost/regex.hpp>
 
 #include <utility>
+#include <algorithm>
 #include "MemoryLeakCheck.h"
 
 using namespace kNet;
@@ -39,7 +40,10 @@ Scene::Scene(const QString &name, Framework *framework, bool viewEnabled, bool a
     name_(name),
     framework_(framework),
     interpolating_(false),
-    authority_(authority)
+    authority_(authority),
+    flushingAttributeChanges_(false),
+    attributeSignalsEnabled_(false),
+    emittingActionById_(false)
 {
     // In headless mode only view disabled-scenes can be created
     viewEnabled_ = framework->IsHeadless() ? false : viewEnabled_ = viewEnabled;
@@ -253,6 +257,7 @@ void Scene::EmitComponentAdded(Entity* entity, IComponent* comp, AttributeChange
 {
     if (change == AttributeChange::Disconnected)
         return;
+    FlushAttributeChanges();
     if (change == AttributeChange::Default)
         change = comp->UpdateMode();
     emit ComponentAdded(entity, comp, change);
@@ -262,6 +267,7 @@ void Scene::EmitComponentRemoved(Entity* entity, IComponent* comp, AttributeChan
 {
     if (change == AttributeChange::Disconnected)
         return;
+    FlushAttributeChanges();
     if (change == AttributeChange::Default)
         change = comp->UpdateMode();
     emit ComponentRemoved(entity, comp, change);
@@ -273,7 +279,9 @@ void Scene::EmitAttributeChanged(IComponent* comp, IAttribute* attribute, Attrib
         return;
     if (change == AttributeChange::Default)
         change = comp->UpdateMode();
-    emit AttributeChanged(comp, attribute, change);
+    RecordAttributeChange(comp, attribute, AttributeChangeRecord::Changed, change);
+    if (attributeSignalsEnabled_)
+        emit AttributeChanged(comp, attribute, change);
 }
 
 void Scene::EmitAttributeAdded(IComponent* comp, IAttribute* attribute, AttributeChange::Type change)
@@ -283,7 +291,9 @@ void Scene::EmitAttributeAdded(IComponent* comp, IAttribute* attribute, Attribut
         return;
     if (change == AttributeChange::Default)
         change = comp->UpdateMode();
-    emit AttributeAdded(comp, attribute, change);
+    RecordAttributeChange(comp, attribute, AttributeChangeRecord::Added, change);
+    if (attributeSignalsEnabled_)
+        emit AttributeAdded(comp, attribute, change);
 }
 
 void Scene::EmitAttributeRemoved(IComponent* comp, IAttribute* attribute, AttributeChange::Type change)
@@ -293,7 +303,9 @@ void Scene::EmitAttributeRemoved(IComponent* comp, IAttribute* attribute, Attrib
         return;
     if (change == AttributeChange::Default)
         change = comp->UpdateMode();
-    emit AttributeRemoved(comp, attribute, change);
+    RecordAttributeChange(comp, attribute, AttributeChangeRecord::Removed, change);
+    if (attributeSignalsEnabled_)
+        emit AttributeRemoved(comp, attribute, change);
 }
 
 void Scene::EmitEntityCreated(Entity *entity, AttributeChange::Type change)
@@ -308,10 +320,13 @@ void Scene::EmitEntityCreated(Entity *entity, AttributeChange::Type change)
         }
     }
     
+    ResolvePendingEntityReferences(entity);
+    
     if (change == AttributeChange::Disconnected)
         return;
     if (change == AttributeChange::Default)
         change = AttributeChange::Replicate;
+    FlushAttributeChanges();
     ///@note This is not enough, it might be that entity is deleted after this call so we have dangling pointer in queue. 
     if (entity)
         emit EntityCreated(entity, change);
@@ -328,6 +343,7 @@ void Scene::EmitEntityRemoved(Entity* entity, AttributeChange::Type change)
 {
     if (change == AttributeChange::Disconnected)
         return;
+    FlushAttributeChanges();
     if (change == AttributeChange::Default)
         change = AttributeChange::Replicate;
     emit EntityRemoved(entity, change);
@@ -336,7 +352,200 @@ void Scene::EmitEntityRemoved(Entity* entity, AttributeChange::Type change)
 
 void Scene::EmitActionTriggered(Entity *entity, const QString &action, const QStringList &params, EntityAction::ExecTypeField type)
 {
+    // A receiver may execute another action by name while an action executed by id is signalled
+    const bool byId = emittingActionById_;
+    emittingActionById_ = false;
     emit ActionTriggered(entity, action, params, type);
+    emittingActionById_ = byId;
+}
+
+void Scene::AddAttributeChangeListener(AttributeChangeListener listener, void *userData)
+{
+    std::pair<AttributeChangeListener, void *> entry(listener, userData);
+    if (std::find(attributeChangeListeners_.begin(), attributeChangeListeners_.end(), entry) == attributeChangeListeners_.end())
+        attributeChangeListeners_.push_back(entry);
+}
+
+void Scene::RemoveAttributeChangeListener(AttributeChangeListener listener, void *userData)
+{
+    std::vector<std::pair<AttributeChangeListener, void *> >::iterator iter =
+        std::find(attributeChangeListeners_.begin(), attributeChangeListeners_.end(), std::make_pair(listener, userData));
+    if (iter != attributeChangeListeners_.end())
+        attributeChangeListeners_.erase(iter);
+    if (attributeChangeListeners_.empty())
+        attributeChanges_.clear();
+}
+
+void Scene::RecordAttributeChange(IComponent *comp, IAttribute *attribute, AttributeChangeRecord::Kind kind, AttributeChange::Type change)
+{
+    if (attributeChangeListeners_.empty() || change == AttributeChange::Disconnected)
+        return;
+    Entity *entity = comp->ParentEntity();
+    if (!entity)
+        return;
+
+    AttributeChangeRecord record;
+    record.entityId = entity->Id();
+    record.componentId = comp->Id();
+    record.attributeIndex = attribute->Index();
+    record.kind = (u8)kind;
+    record.change = (u8)change;
+    record.interpolated = interpolating_;
+    attributeChanges_.push_back(record);
+}
+
+void Scene::connectNotify(const char *signal)
+{
+    if (signal && QByteArray(signal).startsWith("2Attribute"))
+        UpdateAttributeSignalsEnabled();
+}
+
+void Scene::disconnectNotify(const char *signal)
+{
+    // A null signal means that all signals were disconnected
+    if (!signal || QByteArray(signal).startsWith("2Attribute"))
+        UpdateAttributeSignalsEnabled();
+}
+
+void Scene::UpdateAttributeSignalsEnabled()
+{
+    attributeSignalsEnabled_ = receivers(SIGNAL(AttributeChanged(IComponent*, IAttribute*, AttributeChange::Type))) > 0 ||
+        receivers(SIGNAL(AttributeAdded(IComponent*, IAttribute*, AttributeChange::Type))) > 0 ||
+        receivers(SIGNAL(AttributeRemoved(IComponent*, IAttribute*, AttributeChange::Type))) > 0;
+}
+
+void Scene::FlushAttributeChanges()
+{
+    // Changes made by the listeners are appended to the journal and drained on the next round.
+    // Nested flushes from inside a listener are no-ops.
+    if (flushingAttributeChanges_)
+        return;
+    flushingAttributeChanges_ = true;
+    while(!attributeChanges_.empty())
+    {
+        drainedAttributeChanges_.swap(attributeChanges_);
+        for(size_t i = 0; i < attributeChangeListeners_.size(); ++i)
+            attributeChangeListeners_[i].first(attributeChangeListeners_[i].second, this, &drainedAttributeChanges_[0], drainedAttributeChanges_.size());
+        drainedAttributeChanges_.clear();
+    }
+    flushingAttributeChanges_ = false;
+}
+
+void Scene::AddPendingEntityReference(const EntityReference &ref, EntityReferenceHandler handler, void *userData)
+{
+    if (ref.IsEmpty() || !handler)
+        return;
+
+    PendingEntityReference waiter = { handler, userData };
+    // Same rules as in EntityReference::Lookup: an id-like ref can also match by name
+    QString name = ref.ref.trimmed();
+    bool ok = false;
+    entity_id_t id = name.toInt(&ok);
+    if (ok && !pendingRefIds_.contains(userData, id))
+    {
+        pendingRefsById_[id].push_back(waiter);
+        pendingRefIds_.insert(userData, id);
+    }
+    if (!pendingRefNames_.contains(userData, name))
+    {
+        pendingRefsByName_[name].push_back(waiter);
+        pendingRefNames_.insert(userData, name);
+    }
+}
+
+void Scene::RemovePendingEntityReferences(void *userData)
+{
+    foreach(entity_id_t id, pendingRefIds_.values(userData))
+    {
+        QHash<entity_id_t, PendingEntityReferenceList>::iterator iter = pendingRefsById_.find(id);
+        if (iter == pendingRefsById_.end())
+            continue;
+        PendingEntityReferenceList &waiters = iter.value();
+        for(size_t i = 0; i < waiters.size(); ++i)
+            if (waiters[i].userData == userData)
+            {
+                waiters.erase(waiters.begin() + i);
+                break;
+            }
+        if (waiters.empty())
+            pendingRefsById_.erase(iter);
+    }
+    pendingRefIds_.remove(userData);
+
+    foreach(const QString &name, pendingRefNames_.values(userData))
+    {
+        QHash<QString, PendingEntityReferenceList>::iterator iter = pendingRefsByName_.find(name);
+        if (iter == pendingRefsByName_.end())
+            continue;
+        PendingEntityReferenceList &waiters = iter.value();
+        for(size_t i = 0; i < waiters.size(); ++i)
+            if (waiters[i].userData == userData)
+            {
+                waiters.erase(waiters.begin() + i);
+                break;
+            }
+        if (waiters.empty())
+            pendingRefsByName_.erase(iter);
+    }
+    pendingRefNames_.remove(userData);
+}
+
+void Scene::ResolvePendingEntityReferences(Entity *entity)
+{
+    if (!entity || (pendingRefsById_.isEmpty() && pendingRefsByName_.isEmpty()))
+        return;
+
+    PendingEntityReferenceList resolved;
+    QHash<entity_id_t, PendingEntityReferenceList>::iterator idIter = pendingRefsById_.find(entity->Id());
+    if (idIter != pendingRefsById_.end())
+        resolved = idIter.value();
+    if (!pendingRefsByName_.isEmpty())
+    {
+        QString name = entity->Name();
+        QHash<QString, PendingEntityReferenceList>::const_iterator nameIter = name.isEmpty() ? pendingRefsByName_.end() : pendingRefsByName_.find(name);
+        if (nameIter != pendingRefsByName_.end())
+            resolved.insert(resolved.end(), nameIter.value().begin(), nameIter.value().end());
+    }
+
+    for(size_t i = 0; i < resolved.size(); ++i)
+    {
+        // Skip waiters that were already called, or removed by the previous handlers
+        void *userData = resolved[i].userData;
+        if (!pendingRefIds_.contains(userData) && !pendingRefNames_.contains(userData))
+            continue;
+        RemovePendingEntityReferences(userData);
+        resolved[i].handler(userData, entity);
+    }
+}
+
+void Scene::AddActionListener(EntityActionHandler handler, void *userData)
+{
+    std::pair<EntityActionHandler, void *> listener(handler, userData);
+    if (std::find(actionListeners_.begin(), actionListeners_.end(), listener) == actionListeners_.end())
+        actionListeners_.push_back(listener);
+}
+
+void Scene::RemoveActionListener(EntityActionHandler handler, void *userData)
+{
+    std::vector<std::pair<EntityActionHandler, void *> >::iterator iter =
+        std::find(actionListeners_.begin(), actionListeners_.end(), std::make_pair(handler, userData));
+    if (iter != actionListeners_.end())
+        actionListeners_.erase(iter);
+}
+
+void Scene::EmitActionTriggered(Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type)
+{
+    for(size_t i = 0; i < actionListeners_.size(); ++i)
+        actionListeners_[i].first(actionListeners_[i].second, entity, id, args, type);
+
+    // Signal also the receivers of the string-based ActionTriggered, if the id has been given a name
+    QString action = framework_->Scene()->GetEntityActionName(id);
+    if (action.isEmpty())
+        return;
+    const bool byId = emittingActionById_;
+    emittingActionById_ = true;
+    emit ActionTriggered(entity, action, args.ToStringList(), type);
+    emittingActionById_ = byId;
 }
 
 //before-the-fact counterparts for the modification signals above, for permission checks
@@ -1323,6 +1532,8 @@ void Scene::UpdateAttributeInterpolations(float frametime)
 
 void Scene::OnUpdated(float frameTime)
 {
+    FlushAttributeChanges();
+
     // Signal queued entity creations now
     for (unsigned i = 0; i < entitiesCreatedThisFrame_.size(); ++i)
     {
@@ -1330,6 +1541,8 @@ void Scene::OnUpdated(float frameTime)
         if (!entity)
             continue;
         
+        ResolvePendingEntityReferences(entity);
+        
         AttributeChange::Type change = entitiesCreatedThisFrame_[i].second;
         if (change == AttributeChange::Disconnected)
             continue;
@@ -10,9 +10,12 @@
 #include "UniqueIdGenerator.h"
 #include "Math/float3.h"
 #include "ChangeRequest.h"
+#include "AttributeChangeJournal.h"
+#include "EntityReference.h"
 
 #include <QObject>
 #include <QVariant>
+#include <QHash>
 
 #include <boost/enable_shared_from_this.hpp>
 
@@ -94,6 +97,57 @@ public:
         @param old_id Old id of the existing entity
         @param new_id New id to set */
     void ChangeEntityId(entity_id_t old_id, entity_id_t new_id);
+
+    /// Adds a listener that is called whenever an action is executed by integer id on any entity of this scene.
+    /** Fast path counterpart of the ActionTriggered signal, used e.g. by scene sync to replicate the action.
+        @param handler Handler function.
+        @param userData Pointer passed to the handler. */
+    void AddActionListener(EntityActionHandler handler, void *userData);
+
+    /// Removes a listener added with AddActionListener.
+    void RemoveActionListener(EntityActionHandler handler, void *userData);
+
+    /// Notifies the action listeners of an entity action executed by integer id.
+    /** If the id has a registered name, the ActionTriggered signal is emitted too, see IsEmittingActionById.
+        @param entity Entity pointer
+        @param id Id of the action
+        @param args Parameters
+        @param type Execution type. */
+    void EmitActionTriggered(Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type);
+
+    /// Returns whether the ActionTriggered signal being emitted is for an action executed by integer id.
+    /** The action listeners have already been notified of such an action, so a receiver of both must not handle it twice. */
+    bool IsEmittingActionById() const { return emittingActionById_; }
+
+    /// Adds a listener to the attribute change journal of this scene.
+    /** While the scene has journal listeners, every attribute change, addition and removal signalled to the scene
+        is appended to the journal, and the listeners receive the entries in batches when the journal is drained:
+        once per frame, before any entity or component is added or removed, and whenever FlushAttributeChanges is called.
+        This is much cheaper than the per-change AttributeChanged, AttributeAdded and AttributeRemoved signals,
+        which are emitted only while they have receivers.
+        @param listener Listener function.
+        @param userData Pointer passed to the listener. */
+    void AddAttributeChangeListener(AttributeChangeListener listener, void *userData);
+
+    /// Removes a listener added with AddAttributeChangeListener.
+    void RemoveAttributeChangeListener(AttributeChangeListener listener, void *userData);
+
+    /// Drains the attribute change journal to the listeners now.
+    void FlushAttributeChanges();
+
+    /// Waits for an entity referred to by an unresolved entity reference to appear into the scene.
+    /** The waiter is indexed by the id and name of the reference, so that creating entities into the scene
+        only costs a hash lookup, no matter how many references are pending. When a matching entity is created,
+        all pending references of the waiter are removed and the handler is called once; the handler can add
+        the reference again if it still needs to wait.
+        @note The waiter must call RemovePendingEntityReferences before userData becomes invalid.
+        @param ref Entity reference, looked up the same way as EntityReference::Lookup does.
+        @param handler Handler function.
+        @param userData Identifies the waiter and is passed to the handler. */
+    void AddPendingEntityReference(const EntityReference &ref, EntityReferenceHandler handler, void *userData);
+
+    /// Removes all pending entity references of a waiter.
+    void RemovePendingEntityReferences(void *userData);
     
 public slots:
     /// Creates new entity that contains the specified components.
@@ -399,15 +453,16 @@ public slots:
 
 signals:
     /// Signal when an attribute of a component has changed
-    /** Network synchronization managers should connect to this. */
+    /** Emitted for each change, but only while the signal has receivers. Prefer AddAttributeChangeListener,
+        or the AttributeChanged signal of the component, over connecting to this. */
     void AttributeChanged(IComponent* comp, IAttribute* attribute, AttributeChange::Type change);
 
     /// Signal when an attribute of a component has been added (dynamic structure components only)
-    /** Network synchronization managers should connect to this. */
+    /** Emitted only while the signal has receivers. Prefer AddAttributeChangeListener over connecting to this. */
     void AttributeAdded(IComponent* comp, IAttribute* attribute, AttributeChange::Type change);
 
-    /// Signal when an attribute of a component has been added (dynamic structure components only)
-    /** Network synchronization managers should connect to this. */
+    /// Signal when an attribute of a component has been removed (dynamic structure components only)
+    /** Emitted only while the signal has receivers. Prefer AddAttributeChangeListener over connecting to this. */
     void AttributeRemoved(IComponent* comp, IAttribute* attribute, AttributeChange::Type change);
 
     /// Signal when a component is added to an entity and should possibly be replicated (if the change originates from local)
@@ -452,8 +507,33 @@ signals:
 private slots:
     /// Handle frame update. Signal this frame's entity creations.
     void OnUpdated(float frameTime);
-    
+
+protected:
+    /// Enables the per-change attribute signals when they get their first receiver.
+    void connectNotify(const char *signal);
+
+    /// Disables the per-change attribute signals when their last receiver disconnects.
+    void disconnectNotify(const char *signal);
+
 private:
+    /// Sets whether the per-change attribute signals are emitted, based on whether they have receivers.
+    /** Receivers that are deleted without disconnecting leave the signals enabled until the next connect or disconnect. */
+    void UpdateAttributeSignalsEnabled();
+
+    /// Appends an entry to the attribute change journal, if it has listeners.
+    void RecordAttributeChange(IComponent *comp, IAttribute *attribute, AttributeChangeRecord::Kind kind, AttributeChange::Type change);
+
+    /// Calls the waiters of pending entity references matching a newly created entity.
+    void ResolvePendingEntityReferences(Entity *entity);
+
+    /// Waiter of a pending entity reference.
+    struct PendingEntityReference
+    {
+        EntityReferenceHandler handler;
+        void *userData;
+    };
+    typedef std::vector<PendingEntityReference> PendingEntityReferenceList;
+
     Q_DISABLE_COPY(Scene);
     friend class ::SceneAPI;
     
@@ -473,4 +553,15 @@ private:
     bool authority_; ///< Authority -flag
     std::vector<AttributeInterpolation> interpolations_; ///< Running attribute interpolations.
     std::vector<std::pair<EntityWeakPtr, AttributeChange::Type> > entitiesCreatedThisFrame_; ///< Entities to signal for creation at frame end.
+    std::vector<std::pair<EntityActionHandler, void *> > actionListeners_; ///< Listeners of actions executed by integer id.
+    std::vector<std::pair<AttributeChangeListener, void *> > attributeChangeListeners_; ///< Attribute change journal listeners.
+    std::vector<AttributeChangeRecord> attributeChanges_; ///< Attribute change journal, undrained entries.
+    std::vector<AttributeChangeRecord> drainedAttributeChanges_; ///< Entries being passed to the listeners.
+    bool flushingAttributeChanges_; ///< Currently draining the attribute change journal -flag.
+    bool attributeSignalsEnabled_; ///< Whether the AttributeChanged, AttributeAdded and AttributeRemoved signals have receivers.
+    bool emittingActionById_; ///< Whether ActionTriggered is being emitted for an action executed by integer id.
+    QHash<entity_id_t, PendingEntityReferenceList> pendingRefsById_; ///< Pending entity reference waiters by entity id.
+    QHash<QString, PendingEntityReferenceList> pendingRefsByName_; ///< Pending entity reference waiters by entity name.
+    QMultiHash<void *, entity_id_t> pendingRefIds_; ///< Pending entity ids by waiter.
+    QMultiHash<void *, QString> pendingRefNames_; ///< Pending entity names by waiter.
 };
@@ -187,6 +187,48 @@ u32 SceneAPI::GetComponentTypeId(const QString &componentTypename)
         return 0;
 }
 
+bool SceneAPI::RegisterEntityAction(entity_action_id_t id, const QString &name)
+{
+    if (!id || name.isEmpty())
+    {
+        LogError("SceneAPI::RegisterEntityAction: zero action id or empty name given");
+        return false;
+    }
+    if (id > cMaxEntityActionId)
+    {
+        LogError("SceneAPI::RegisterEntityAction: action id " + QString::number(id) + " of \"" + name + "\" is larger than the maximum " +
+            QString::number(cMaxEntityActionId));
+        return false;
+    }
+
+    EntityActionNameMap::const_iterator byId = entityActionNames.find(id);
+    EntityActionIdMap::const_iterator byName = entityActionIds.find(name);
+    if (byId != entityActionNames.end() || byName != entityActionIds.end())
+    {
+        if (byId != entityActionNames.end() && byName != entityActionIds.end() && byName->second == id)
+            return true; // Same registration again
+        LogError("SceneAPI::RegisterEntityAction: cannot register action \"" + name + "\" with id " + QString::number(id) +
+            ", the id or the name is already registered.");
+        return false;
+    }
+
+    entityActionIds[name] = id;
+    entityActionNames[id] = name;
+    return true;
+}
+
+entity_action_id_t SceneAPI::GetEntityActionId(const QString &actionName) const
+{
+    EntityActionIdMap::const_iterator iter = entityActionIds.find(actionName);
+    return iter != entityActionIds.end() ? iter->second : 0;
+}
+
+QString SceneAPI::GetEntityActionName(entity_action_id_t id) const
+{
+    EntityActionNameMap::const_iterator iter = entityActionNames.find(id);
+    return iter != entityActionNames.end() ? iter->second : QString();
+}
+
 QString SceneAPI::GetAttributeTypeName(u32 attributeTypeid)
 {
     attributeTypeid--; // Skip 0 which is illegal
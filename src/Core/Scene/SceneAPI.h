@@ -5,6 +5,7 @@
 #include "SceneFwd.h"
 #include "CoreTypes.h"
 #include "CoreStringUtils.h"
+#include "EntityAction.h"
 
 #include <QObject>
 #include <QString>
@@ -98,6 +99,19 @@ public slots:
     /// Looks up the given type name and returns the type id for that component type.
     u32 GetComponentTypeId(const QString &componentTypename);
     
+    /// Registers a name for an integer entity action id.
+    /** Actions executed by id are dispatched without string lookups. The name links the id to the string-based
+        action API, so that Entity::Exec calls by name reach the handlers connected by id and vice versa.
+        The same ids must be registered on both the server and the clients.
+        @return False if the id is zero or larger than cMaxEntityActionId, or the id or name is already registered to another name or id. */
+    bool RegisterEntityAction(entity_action_id_t id, const QString &name);
+
+    /// Looks up the given action name and returns the action id registered for it, or zero if not found.
+    entity_action_id_t GetEntityActionId(const QString &actionName) const;
+
+    /// Looks up the given action id and returns the action name registered for it, or empty string if not found.
+    QString GetEntityActionName(entity_action_id_t id) const;
+
     /// Looks up the attribute type name for an attribute type id
     static QString GetAttributeTypeName(u32 attributeTypeid);
     
@@ -153,8 +167,13 @@ private:
     typedef std::map<QString, ComponentFactoryPtr, QStringLessThanNoCase> ComponentFactoryMap;
     typedef std::map<u32, boost::weak_ptr<IComponentFactory> > ComponentFactoryWeakMap;
 
+    typedef std::map<QString, entity_action_id_t, QStringLessThanNoCase> EntityActionIdMap;
+    typedef std::map<entity_action_id_t, QString> EntityActionNameMap;
+
     ComponentFactoryMap componentFactories;
     ComponentFactoryWeakMap componentFactoriesByTypeid;
+    EntityActionIdMap entityActionIds; ///< Registered entity action ids by name.
+    EntityActionNameMap entityActionNames; ///< Registered entity action names by id.
     Framework *framework_; ///< Framework.
     SceneMap scenes_; ///< All currently created scenes.
     SceneInteract *sceneInteract; ///< Scene interact. \todo Remove this - move to its own plugin - should not have hardcoded application logic running on each scene. -jj.
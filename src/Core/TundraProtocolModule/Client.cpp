@@ -129,6 +129,12 @@ void Client::Login(const QString& address, unsigned short port, kNet::SocketTran
         SetLoginProperty("protocol", p);
         SetLoginProperty("port", QString::number(port));
     }
+    
+    // Tell the server we can receive batched and compressed scene sync messages, unless the application has decided otherwise
+    if (GetLoginProperty("syncbatch").isEmpty())
+        SetLoginProperty("syncbatch", "1");
+    if (GetLoginProperty("compression").isEmpty())
+        SetLoginProperty("compression", "zlib");
 
     KristalliProtocol::KristalliProtocolModule *kristalli = framework_->GetModule<KristalliProtocol::KristalliProtocolModule>();
     connect(kristalli, SIGNAL(NetworkMessageReceived(kNet::MessageConnection *, kNet::message_id_t, const char *, size_t)), 
@@ -101,7 +101,8 @@ KristalliProtocolModule::KristalliProtocolModule() :
     server(0),
     reconnectAttempts(0),
     connectionPending(false),
-    serverPort(0)
+    serverPort(0),
+    nextConnectionID(1)
 {
 }
 
@@ -287,6 +288,8 @@ void KristalliProtocolModule::StopServer()
     {
         network.StopServer();
         connections.clear();
+        connectionsBySource.clear();
+        connectionsById.clear();
         ::LogInfo("Server stopped");
         server = 0;
     }
@@ -307,6 +310,8 @@ void KristalliProtocolModule::NewConnectionEstablished(kNet::MessageConnection *
     connection->userID = AllocateNewConnectionID();
     connection->connection = source;
     connections.push_back(connection);
+    connectionsBySource.insert(source, connection.get());
+    connectionsById.insert(connection->userID, connection.get());
 
     // For TCP mode sockets, set the TCP_NODELAY option to improve latency for the messages we send.
     if (source->GetSocket() && source->GetSocket()->TransportLayer() == kNet::SocketOverTCP)
@@ -320,17 +325,24 @@ void KristalliProtocolModule::NewConnectionEstablished(kNet::MessageConnection *
 void KristalliProtocolModule::ClientDisconnected(MessageConnection *source)
 {
     // Delete from connection list if it was a known user
+    UserConnection* user = GetUserConnection(source);
+    if (!user)
+    {
+        ::LogInfo("Unknown user disconnected");
+        return;
+    }
+    
+    emit ClientDisconnectedEvent(user);
+    
+    ::LogInfo("User disconnected, connection ID " + ToString(user->userID));
+    connectionsBySource.remove(source);
+    connectionsById.remove(user->userID);
     for(UserConnectionList::iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        if ((*iter)->connection == source)
+        if (iter->get() == user)
         {
-            emit ClientDisconnectedEvent(iter->get());
-            
-            ::LogInfo("User disconnected, connection ID " + ToString((int)(*iter)->userID));
             connections.erase(iter);
-            return;
+            break;
         }
-
-        ::LogInfo("Unknown user disconnected");
 }
 
 void KristalliProtocolModule::HandleMessage(MessageConnection *source, message_id_t id, const char *data, size_t numBytes)
@@ -348,31 +360,12 @@ void KristalliProtocolModule::HandleMessage(MessageConnection *source, message_i
     }
 }
 
-u8 KristalliProtocolModule::AllocateNewConnectionID() const
+u32 KristalliProtocolModule::AllocateNewConnectionID()
 {
-    u8 newID = 1;
-    for(UserConnectionList::const_iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        newID = std::max((int)newID, (int)((*iter)->userID+1));
-    
-    return newID;
-}
-
-UserConnection* KristalliProtocolModule::GetUserConnection(MessageConnection* source)
-{
-    for(UserConnectionList::iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        if ((*iter)->connection == source)
-            return iter->get();
-
-    return 0;
-}
-
-UserConnection* KristalliProtocolModule::GetUserConnection(u8 id)
-{
-    for(UserConnectionList::iterator iter = connections.begin(); iter != connections.end(); ++iter)
-        if ((*iter)->userID == id)
-            return iter->get();
-
-    return 0;
+    // Zero is not a valid ID
+    while(nextConnectionID == 0 || connectionsById.contains(nextConnectionID))
+        ++nextConnectionID;
+    return nextConnectionID++;
 }
 
 } // ~KristalliProtocolModule namespace
@@ -9,6 +9,7 @@
 #include "kNet.h"
 
 #include <QObject>
+#include <QHash>
 
 namespace KristalliProtocol
 {
@@ -67,9 +68,9 @@ namespace KristalliProtocol
         UserConnectionList& GetUserConnections() { return connections; }
         
         /// Gets user by message connection. Returns null if no such connection
-        UserConnection* GetUserConnection(kNet::MessageConnection* source);
+        UserConnection* GetUserConnection(kNet::MessageConnection* source) const { return connectionsBySource.value(source, 0); }
         /// Gets user by connection ID. Returns null if no such connection
-        UserConnection* GetUserConnection(u8 id);
+        UserConnection* GetUserConnection(u32 id) const { return connectionsById.value(id, 0); }
 
         /// What trasport layer to use. Read on startup from --protocol udp/tcp. Defaults to TCP if no start param was given.
         kNet::SocketTransportLayer defaultTransport;
@@ -101,8 +102,9 @@ public slots:
 
         void PerformConnection();
 
-        /// Allocate a  connection ID for new connection
-        u8 AllocateNewConnectionID() const;
+        /// Allocate a connection ID for new connection
+        /** IDs are handed out in increasing order, skipping the ones in use, so that a recently disconnected user's ID is not reused right away. */
+        u32 AllocateNewConnectionID();
         
         /// If true, the connection attempt we've started has not yet been established, but is waiting
         /// for a transition to OK state. When this happens, the MsgLogin message is sent.
@@ -122,6 +124,12 @@ public slots:
         
         /// Users that are connected to server
         UserConnectionList connections;
+        /// Users by their message connection, for lookups per received message
+        QHash<kNet::MessageConnection*, UserConnection*> connectionsBySource;
+        /// Users by their connection ID
+        QHash<u32, UserConnection*> connectionsById;
+        /// The connection ID to try next when allocating one
+        u32 nextConnectionID;
     };
 }
 
@@ -0,0 +1,206 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "LoadTest.h"
+#include "LoadTestBot.h"
+#include "TundraLogicModule.h"
+#include "Server.h"
+#include "UserConnection.h"
+#include "KristalliProtocolModule.h"
+#include "HighPerfClock.h"
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace TundraLogic
+{
+
+LoadTest::LoadTest(TundraLogicModule* owner) :
+    owner_(owner),
+    reportInterval_(5.0f),
+    reportElapsed_(0.0),
+    numFrames_(0),
+    frameTimeSum_(0.0),
+    frameTimeMax_(0.0),
+    botTime_(0.0)
+{
+}
+
+LoadTest::~LoadTest()
+{
+    StopBots();
+}
+
+void LoadTest::StartBots(const QStringList &params)
+{
+    if (params.isEmpty())
+    {
+        LogError("Usage: startbots(count,address=127.0.0.1,port=2345,protocol=tcp,movesPerSecond=1,actionsPerSecond=1)");
+        return;
+    }
+
+    bool ok;
+    int count = params[0].toInt(&ok);
+    if (!ok || count <= 0)
+    {
+        LogError("startbots: Invalid bot count " + params[0]);
+        return;
+    }
+    QString address = params.size() > 1 ? params[1] : "127.0.0.1";
+    unsigned short port = params.size() > 2 ? params[2].toUShort() : 2345;
+    QString protocol = params.size() > 3 ? params[3].trimmed().toLower() : "tcp";
+    float moveRate = params.size() > 4 ? params[4].toFloat() : 1.0f;
+    float actionRate = params.size() > 5 ? params[5].toFloat() : 1.0f;
+
+    kNet::SocketTransportLayer transport = kNet::InvalidTransportLayer;
+    if (protocol == "tcp")
+        transport = kNet::SocketOverTCP;
+    else if (protocol == "udp")
+        transport = kNet::SocketOverUDP;
+    if (transport == kNet::InvalidTransportLayer || !port)
+    {
+        LogError("startbots: Invalid port or protocol " + params.mid(2, 2).join(","));
+        return;
+    }
+
+    kNet::Network* network = owner_->GetKristalliModule()->GetNetwork();
+    const std::string addressStr = address.toStdString();
+    int numStarted = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        LoadTestBot* bot = new LoadTestBot(network, "Bot" + QString::number(bots_.size() + 1), addressStr, port, transport);
+        if (!bot->GetConnection())
+        {
+            delete bot;
+            break;
+        }
+        bot->SetRates(moveRate, actionRate);
+        bots_.push_back(bot);
+        ++numStarted;
+    }
+
+    LogInfo("Started " + QString::number(numStarted) + " bots to " + address + ":" + QString::number(port) + ", " +
+        QString::number(bots_.size()) + " running");
+}
+
+void LoadTest::StopBots()
+{
+    if (bots_.empty())
+        return;
+
+    for(size_t i = 0; i < bots_.size(); ++i)
+        delete bots_[i];
+    LogInfo("Stopped " + QString::number(bots_.size()) + " bots");
+    bots_.clear();
+}
+
+void LoadTest::Update(f64 frametime)
+{
+    if (bots_.empty())
+        return;
+
+    PROFILE(LoadTest_Update);
+
+    tick_t start = GetCurrentClockTime();
+    for(size_t i = 0; i < bots_.size(); ++i)
+        bots_[i]->Update(frametime);
+    botTime_ += (double)(GetCurrentClockTime() - start) / GetCurrentClockFreq();
+
+    // The frame time is that of this process: the server's own when the bots run in the server process
+    ++numFrames_;
+    frameTimeSum_ += frametime;
+    frameTimeMax_ = std::max(frameTimeMax_, (double)frametime);
+    reportElapsed_ += frametime;
+    if (reportInterval_ > 0.0f && reportElapsed_ >= reportInterval_)
+        Report();
+}
+
+void LoadTest::Report()
+{
+    const double elapsed = reportElapsed_;
+    if (elapsed <= 0.0)
+    {
+        LogInfo("botreport: Nothing measured yet");
+        return;
+    }
+
+    unsigned numConnected = 0;
+    unsigned numLoggedIn = 0;
+    unsigned numAvatars = 0;
+    double rateSum = 0.0;
+    double rateMin = 0.0;
+    double rateMax = 0.0;
+    double latencySum = 0.0;
+    double latencyMax = 0.0;
+    unsigned latencySamples = 0;
+    for(size_t i = 0; i < bots_.size(); ++i)
+    {
+        LoadTestBot* bot = bots_[i];
+        if (bot->IsConnected())
+            ++numConnected;
+        if (bot->IsLoggedIn())
+            ++numLoggedIn;
+        if (bot->HasAvatar())
+            ++numAvatars;
+
+        LoadTestBot::Stats stats = bot->TakeStats();
+        double rate = stats.bytesIn / 1024.0 / elapsed;
+        rateSum += rate;
+        rateMin = i ? std::min(rateMin, rate) : rate;
+        rateMax = std::max(rateMax, rate);
+        latencySum += stats.latencySum;
+        latencyMax = std::max(latencyMax, stats.latencyMax);
+        latencySamples += stats.latencySamples;
+    }
+
+    LogInfo("Load test: " + QString::number(bots_.size()) + " bots, " + QString::number(numConnected) + " connected, " +
+        QString::number(numLoggedIn) + " logged in, " + QString::number(numAvatars) + " with avatar");
+    if (numFrames_)
+        LogInfo("  Frame time avg " + QString::number(frameTimeSum_ * 1000.0 / numFrames_, 'f', 2) + " ms, max " +
+            QString::number(frameTimeMax_ * 1000.0, 'f', 2) + " ms, of which bots " +
+            QString::number(botTime_ * 1000.0 / numFrames_, 'f', 2) + " ms/frame");
+    if (!bots_.empty())
+        LogInfo("  Received per bot avg " + QString::number(rateSum / bots_.size(), 'f', 2) + " kB/s, min " +
+            QString::number(rateMin, 'f', 2) + " kB/s, max " + QString::number(rateMax, 'f', 2) + " kB/s");
+    if (latencySamples)
+        LogInfo("  Move latency avg " + QString::number(latencySum * 1000.0 / latencySamples, 'f', 1) + " ms, max " +
+            QString::number(latencyMax * 1000.0, 'f', 1) + " ms, " + QString::number(latencySamples) + " samples");
+
+    if (owner_->IsServer() && owner_->GetServer())
+    {
+        UserConnectionList& users = owner_->GetServer()->GetUserConnections();
+        double outSum = 0.0;
+        double outMax = 0.0;
+        u64 uncompressedBytes = 0;
+        u64 compressedBytes = 0;
+        unsigned numUsers = 0;
+        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
+        {
+            if (!(*i)->connection)
+                continue;
+            double out = (*i)->connection->BytesOutPerSec() / 1024.0;
+            outSum += out;
+            outMax = std::max(outMax, out);
+            uncompressedBytes += (*i)->uncompressedBytes;
+            compressedBytes += (*i)->compressedBytes;
+            ++numUsers;
+        }
+        if (numUsers)
+            LogInfo("  Server out per user avg " + QString::number(outSum / numUsers, 'f', 2) + " kB/s, max " +
+                QString::number(outMax, 'f', 2) + " kB/s, scene sync compressed to " +
+                QString::number(uncompressedBytes ? 100.0 * compressedBytes / uncompressedBytes : 100.0, 'f', 1) + "%");
+    }
+
+    reportElapsed_ = 0.0;
+    numFrames_ = 0;
+    frameTimeSum_ = 0.0;
+    frameTimeMax_ = 0.0;
+    botTime_ = 0.0;
+}
+
+}
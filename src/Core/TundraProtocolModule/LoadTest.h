@@ -0,0 +1,66 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <QObject>
+#include <QStringList>
+
+#include <vector>
+
+namespace TundraLogic
+{
+
+class TundraLogicModule;
+class LoadTestBot;
+
+/// Runs headless bots against a server and reports how the scene replication scales, for benchmarking the server.
+/** The bots are driven from the main loop of this process. When the server runs in the same process, the report includes its
+    frame time and the bandwidth it sends to each user; the time spent in the bots themselves is reported separately. */
+class LoadTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// Constructor
+    /** @param owner Owner module. */
+    explicit LoadTest(TundraLogicModule* owner);
+
+    /// Stops all bots
+    ~LoadTest();
+
+    /// Updates the bots and prints the report when it is time.
+    void Update(f64 frametime);
+
+public slots:
+    /// Starts bots. Usage: startbots(count,address=127.0.0.1,port=2345,protocol=tcp,movesPerSecond=1,actionsPerSecond=1)
+    void StartBots(const QStringList &params);
+
+    /// Stops all bots.
+    void StopBots();
+
+    /// Prints the statistics since the previous report.
+    void Report();
+
+    /// Sets the seconds between the reports printed automatically while bots are running. Zero disables them.
+    void SetReportInterval(float interval) { reportInterval_ = interval; }
+
+private:
+    /// Owning module
+    TundraLogicModule* owner_;
+    /// The running bots
+    std::vector<LoadTestBot*> bots_;
+    /// Seconds between the automatic reports, default 5
+    float reportInterval_;
+    /// Seconds since the previous report
+    double reportElapsed_;
+    /// Frames, and the sum and maximum of their times, since the previous report
+    unsigned numFrames_;
+    double frameTimeSum_;
+    double frameTimeMax_;
+    /// Seconds spent updating the bots since the previous report
+    double botTime_;
+};
+
+}
@@ -0,0 +1,320 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "LoadTestBot.h"
+#include "TundraMessages.h"
+#include "MsgLogin.h"
+#include "MsgLoginReply.h"
+#include "MsgEntityAction.h"
+#include "EC_Name.h"
+#include "CoreStringUtils.h"
+#include "LoggingFunctions.h"
+
+#include <kNet/UDPMessageConnection.h>
+
+#include <QDomDocument>
+#include <QDomElement>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "MemoryLeakCheck.h"
+
+namespace TundraLogic
+{
+
+namespace
+{
+    const char* const cDirections[] = { "forward", "back", "left", "right" };
+    const int cNumDirections = 4;
+    /// A move is timed only if the avatar has not changed for this long, so that the change that arrives is caused by the move
+    const double cIdleBeforeTimedMove = 0.5;
+    /// Execution type of the entity actions sent, EntityAction::Server
+    const u8 cExecuteOnServer = 2;
+}
+
+LoadTestBot::LoadTestBot(kNet::Network* network, const QString& name, const std::string& address, unsigned short port, kNet::SocketTransportLayer transport) :
+    name_(name),
+    loginSent_(false),
+    loggedIn_(false),
+    userId_(0),
+    avatarId_(0),
+    moveRate_(1.0f),
+    actionRate_(1.0f),
+    moveAcc_(0.0f),
+    actionAcc_(0.0f),
+    direction_(-1),
+    moveSentTime_(0),
+    lastAvatarChangeTime_(0)
+{
+    connection_ = network->Connect(address.c_str(), port, transport, this);
+    if (!connection_)
+    {
+        LogError("LoadTestBot: " + name_ + " unable to connect to " + QString::fromStdString(address) + ":" + QString::number(port));
+        return;
+    }
+
+    if (transport == kNet::SocketOverUDP)
+        dynamic_cast<kNet::UDPMessageConnection*>(connection_.ptr())->SetDatagramSendRate(500);
+    if (connection_->GetSocket() && connection_->GetSocket()->TransportLayer() == kNet::SocketOverTCP)
+        connection_->GetSocket()->SetNaglesAlgorithmEnabled(false);
+}
+
+LoadTestBot::~LoadTestBot()
+{
+    if (connection_)
+    {
+        connection_->Disconnect(0);
+        connection_ = 0;
+    }
+}
+
+void LoadTestBot::SetRates(float moveRate, float actionRate)
+{
+    moveRate_ = moveRate;
+    actionRate_ = actionRate;
+}
+
+bool LoadTestBot::IsConnected() const
+{
+    return connection_ && connection_->GetConnectionState() == kNet::ConnectionOK;
+}
+
+LoadTestBot::Stats LoadTestBot::TakeStats()
+{
+    Stats stats = stats_;
+    stats_ = Stats();
+    return stats;
+}
+
+void LoadTestBot::Update(f64 frametime)
+{
+    if (!connection_)
+        return;
+
+    connection_->Process();
+    if (!IsConnected())
+        return;
+
+    if (!loginSent_)
+    {
+        SendLogin();
+        loginSent_ = true;
+    }
+    if (!avatarId_)
+        return;
+
+    if (moveRate_ > 0.0f)
+    {
+        moveAcc_ += (float)frametime;
+        if (moveAcc_ >= 1.0f / moveRate_)
+        {
+            moveAcc_ = 0.0f;
+            // Alternate between standing and moving to a random direction
+            if (direction_ >= 0)
+            {
+                SendAction("Stop", cDirections[direction_]);
+                direction_ = -1;
+            }
+            else
+            {
+                direction_ = rand() % cNumDirections;
+                tick_t now = GetCurrentClockTime();
+                if (!moveSentTime_ && (double)(now - lastAvatarChangeTime_) / GetCurrentClockFreq() >= cIdleBeforeTimedMove)
+                    moveSentTime_ = now;
+                SendAction("Move", cDirections[direction_]);
+            }
+        }
+    }
+
+    if (actionRate_ > 0.0f)
+    {
+        actionAcc_ += (float)frametime;
+        if (actionAcc_ >= 1.0f / actionRate_)
+        {
+            actionAcc_ = 0.0f;
+            SendAction("SetRotation", QString::number(rand() % 360).toStdString());
+        }
+    }
+}
+
+void LoadTestBot::SendLogin()
+{
+    QDomDocument xml;
+    QDomElement rootElem = xml.createElement("login");
+    QDomElement elem = xml.createElement("username");
+    elem.setAttribute("value", name_);
+    rootElem.appendChild(elem);
+    elem = xml.createElement("syncbatch");
+    elem.setAttribute("value", "1");
+    rootElem.appendChild(elem);
+    elem = xml.createElement("compression");
+    elem.setAttribute("value", "zlib");
+    rootElem.appendChild(elem);
+    xml.appendChild(rootElem);
+
+    MsgLogin msg;
+    msg.loginData = StringToBuffer(xml.toString().toStdString());
+    connection_->Send(msg);
+}
+
+void LoadTestBot::SendAction(const std::string& action, const std::string& param)
+{
+    MsgEntityAction msg;
+    msg.entityId = avatarId_;
+    msg.executionType = cExecuteOnServer;
+    msg.name = StringToBuffer(action);
+    MsgEntityAction::S_parameters p = { StringToBuffer(param) };
+    msg.parameters.push_back(p);
+    connection_->Send(msg);
+}
+
+void LoadTestBot::HandleMessage(kNet::MessageConnection* source, kNet::message_id_t id, const char* data, size_t numBytes)
+{
+    stats_.bytesIn += numBytes;
+
+    try
+    {
+        switch (id)
+        {
+        case cLoginReplyMessage:
+            {
+                ++stats_.messagesIn;
+                MsgLoginReply msg(data, numBytes);
+                if (msg.success)
+                {
+                    loggedIn_ = true;
+                    userId_ = msg.userID;
+                }
+                else
+                    LogWarning("LoadTestBot: " + name_ + " was denied access");
+            }
+            break;
+        case cSyncBatchMessage:
+            HandleSyncBatch(data, numBytes);
+            break;
+        default:
+            HandleSceneMessage(id, data, numBytes);
+            break;
+        }
+    }
+    catch (kNet::NetException& e)
+    {
+        LogError("LoadTestBot: Exception while handling message " + QString::number(id) + ": " + QString(e.what()));
+    }
+}
+
+void LoadTestBot::HandleSyncBatch(const char* data, size_t numBytes)
+{
+    QByteArray messages;
+    QString error;
+    if (!DecompressSyncBatch(data, numBytes, messages, error))
+    {
+        LogError("LoadTestBot: " + error + ", ignoring");
+        return;
+    }
+    const char* payload = messages.constData();
+    size_t payloadBytes = messages.size();
+
+    kNet::DataDeserializer dd(payload, payloadBytes);
+    while (dd.BytesLeft() > 0)
+    {
+        kNet::message_id_t id = dd.ReadVLE<kNet::VLE8_16_32>();
+        size_t msgBytes = dd.ReadVLE<kNet::VLE8_16_32>();
+        if (msgBytes > dd.BytesLeft())
+            return;
+        const char* msgData = payload + dd.BytePos();
+        dd.SkipBytes(msgBytes);
+        HandleSceneMessage(id, msgData, msgBytes);
+    }
+}
+
+void LoadTestBot::HandleSceneMessage(kNet::message_id_t id, const char* data, size_t numBytes)
+{
+    ++stats_.messagesIn;
+
+    switch (id)
+    {
+    case cCreateEntityMessage:
+        HandleCreateEntity(data, numBytes);
+        break;
+    case cCreateComponentsMessage:
+    case cCreateAttributesMessage:
+    case cEditAttributesMessage:
+    case cRemoveAttributesMessage:
+    case cRemoveComponentsMessage:
+        {
+            kNet::DataDeserializer dd(data, numBytes);
+            dd.ReadVLE<kNet::VLE8_16_32>(); // Scene ID
+            u32 entityId = dd.ReadVLE<kNet::VLE8_16_32>();
+            if (!avatarId_ || entityId != avatarId_)
+                break;
+
+            tick_t now = GetCurrentClockTime();
+            lastAvatarChangeTime_ = now;
+            if (moveSentTime_)
+            {
+                double latency = (double)(now - moveSentTime_) / GetCurrentClockFreq();
+                stats_.latencySum += latency;
+                stats_.latencyMax = std::max(stats_.latencyMax, latency);
+                ++stats_.latencySamples;
+                moveSentTime_ = 0;
+            }
+        }
+        break;
+    case cRemoveEntityMessage:
+        {
+            kNet::DataDeserializer dd(data, numBytes);
+            dd.ReadVLE<kNet::VLE8_16_32>(); // Scene ID
+            if (dd.ReadVLE<kNet::VLE8_16_32>() == avatarId_)
+            {
+                avatarId_ = 0;
+                direction_ = -1;
+                moveSentTime_ = 0;
+            }
+        }
+        break;
+    }
+}
+
+void LoadTestBot::HandleCreateEntity(const char* data, size_t numBytes)
+{
+    if (!loggedIn_ || avatarId_)
+        return;
+
+    // The avatar application names the avatar of each user by the connection ID
+    const std::string avatarName = ("Avatar" + QString::number(userId_)).toUtf8().constData();
+
+    kNet::DataDeserializer dd(data, numBytes);
+    dd.ReadVLE<kNet::VLE8_16_32>(); // Scene ID
+    u32 entityId = dd.ReadVLE<kNet::VLE8_16_32>();
+    dd.Read<u8>(); // Temporary flag
+    unsigned numComponents = dd.ReadVLE<kNet::VLE8_16_32>();
+    for(unsigned i = 0; i < numComponents; ++i)
+    {
+        dd.ReadVLE<kNet::VLE8_16_32>(); // Component ID
+        u32 typeId = dd.ReadVLE<kNet::VLE8_16_32>();
+        dd.ReadString(); // Component name
+        unsigned attrDataSize = dd.ReadVLE<kNet::VLE8_16_32>();
+        if (attrDataSize > dd.BytesLeft())
+            return;
+
+        // The name is the first attribute of EC_Name
+        if (typeId == EC_Name::TypeIdStatic() && attrDataSize >= 2)
+        {
+            kNet::DataDeserializer attrDs(data + dd.BytePos(), attrDataSize);
+            u16 length = attrDs.Read<u16>();
+            if (length <= attrDs.BytesLeft() && std::string(data + dd.BytePos() + 2, length) == avatarName)
+            {
+                avatarId_ = entityId;
+                lastAvatarChangeTime_ = GetCurrentClockTime();
+                return;
+            }
+        }
+        dd.SkipBytes(attrDataSize);
+    }
+}
+
+}
@@ -0,0 +1,112 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "HighPerfClock.h"
+
+#include <kNet.h>
+
+#include <QString>
+
+#include <string>
+
+namespace TundraLogic
+{
+
+/// Headless client for load testing a server. Does not create a scene.
+/** Logs in and finds its avatar among the entities the server sends. It then moves the avatar around and triggers entity actions
+    on it at the given rates, using the same actions as the avatar application. Received scene sync messages are only inspected
+    for the statistics, never applied, so hundreds of bots can run in one process. */
+class LoadTestBot : public kNet::IMessageHandler
+{
+public:
+    /// Statistics of a bot, collected between calls to TakeStats
+    struct Stats
+    {
+        Stats() : bytesIn(0), messagesIn(0), latencySum(0.0), latencyMax(0.0), latencySamples(0) {}
+
+        /// Received bytes, as the server sent them
+        u64 bytesIn;
+        /// Received messages, counting the messages in batches one by one
+        u64 messagesIn;
+        /// Sum and maximum of the seconds from sending a move until the first change to the avatar arrives
+        double latencySum;
+        double latencyMax;
+        /// Number of latency samples
+        unsigned latencySamples;
+    };
+
+    /// Starts connecting to the server.
+    /** @param network The kNet network to connect with.
+        @param name The username to log in with.
+        @param address Address of the server.
+        @param port Port of the server.
+        @param transport Transport layer to use. */
+    LoadTestBot(kNet::Network* network, const QString& name, const std::string& address, unsigned short port, kNet::SocketTransportLayer transport);
+
+    /// Disconnects.
+    ~LoadTestBot();
+
+    /// Processes the received messages, logs in once connected, and moves the avatar and triggers actions when it is time.
+    void Update(f64 frametime);
+
+    /// Invoked by kNet for each received message.
+    void HandleMessage(kNet::MessageConnection* source, kNet::message_id_t id, const char* data, size_t numBytes);
+
+    /// Sets how many times per second to change the direction of movement, and to trigger an entity action. Zero disables either.
+    void SetRates(float moveRate, float actionRate);
+
+    /// Returns whether the connection to the server is open.
+    bool IsConnected() const;
+
+    /// Returns whether the server has accepted the login.
+    bool IsLoggedIn() const { return loggedIn_; }
+
+    /// Returns whether the avatar of the bot has been found.
+    bool HasAvatar() const { return avatarId_ != 0; }
+
+    /// Returns the connection to the server, or null if connecting failed.
+    kNet::MessageConnection* GetConnection() const { return connection_.ptr(); }
+
+    /// Returns the statistics collected since the previous call, and resets them.
+    Stats TakeStats();
+
+private:
+    /// Sends the login message, telling that batched and compressed scene sync messages are understood.
+    void SendLogin();
+
+    /// Sends an entity action to be executed on the server for the avatar.
+    void SendAction(const std::string& action, const std::string& param);
+
+    /// Inspects a scene sync message.
+    void HandleSceneMessage(kNet::message_id_t id, const char* data, size_t numBytes);
+
+    /// Looks for the avatar of the bot in a create entity message.
+    void HandleCreateEntity(const char* data, size_t numBytes);
+
+    /// Inspects each message in a sync batch message.
+    void HandleSyncBatch(const char* data, size_t numBytes);
+
+    Ptr(kNet::MessageConnection) connection_;
+    QString name_;
+    bool loginSent_;
+    bool loggedIn_;
+    /// Connection ID from the login reply
+    u32 userId_;
+    /// Entity ID of the avatar, or zero if not known yet
+    u32 avatarId_;
+    float moveRate_;
+    float actionRate_;
+    float moveAcc_;
+    float actionAcc_;
+    /// Index of the direction the bot is moving to, or -1 if it is standing
+    int direction_;
+    /// When the move being timed was sent, or zero if none is
+    tick_t moveSentTime_;
+    /// When the latest change to the avatar arrived
+    tick_t lastAvatarChangeTime_;
+    Stats stats_;
+};
+
+}
@@ -35,21 +35,26 @@ struct MsgClientJoined
 	bool inOrder;
 	u32 priority;
 
-	u8 userID;
+	/// Connection ID. Sent as u8 for old clients, 0 if it does not fit, and then in full as a trailing VLE, which old clients ignore
+	u32 userID;
 
 	inline size_t Size() const
 	{
-		return 1;
+		return 1 + kNet::VLE8_16_32::GetEncodedBitLength(userID) / 8;
 	}
 
 	inline void SerializeTo(kNet::DataSerializer &dst) const
 	{
-		dst.Add<u8>(userID);
+		dst.Add<u8>(userID <= 255 ? (u8)userID : 0);
+		dst.AddVLE<kNet::VLE8_16_32>(userID);
 	}
 
 	inline void DeserializeFrom(kNet::DataDeserializer &src)
 	{
 		userID = src.Read<u8>();
+		// Servers of old versions send only the u8
+		if (src.BytesLeft() > 0)
+			userID = src.ReadVLE<kNet::VLE8_16_32>();
 	}
 
 };
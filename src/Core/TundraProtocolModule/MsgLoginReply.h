@@ -36,21 +36,23 @@ struct MsgLoginReply
 	u32 priority;
 
 	u8 success;
-	u8 userID;
+	/// Connection ID. Sent as u8 for old clients, 0 if it does not fit, and then in full as a trailing VLE, which old clients ignore
+	u32 userID;
 	std::vector<s8> loginReplyData;
 
 	inline size_t Size() const
 	{
-		return 1 + 1 + 2 + loginReplyData.size()*1;
+		return 1 + 1 + 2 + loginReplyData.size()*1 + kNet::VLE8_16_32::GetEncodedBitLength(userID) / 8;
 	}
 
 	inline void SerializeTo(kNet::DataSerializer &dst) const
 	{
 		dst.Add<u8>(success);
-		dst.Add<u8>(userID);
+		dst.Add<u8>(userID <= 255 ? (u8)userID : 0);
 		dst.Add<u16>(loginReplyData.size());
 		if (loginReplyData.size() > 0)
 			dst.AddArray<s8>(&loginReplyData[0], loginReplyData.size());
+		dst.AddVLE<kNet::VLE8_16_32>(userID);
 	}
 
 	inline void DeserializeFrom(kNet::DataDeserializer &src)
@@ -60,6 +62,9 @@ struct MsgLoginReply
 		loginReplyData.resize(src.Read<u16>());
 		if (loginReplyData.size() > 0)
 			src.ReadArray<s8>(&loginReplyData[0], loginReplyData.size());
+		// Servers of old versions send only the u8
+		if (src.BytesLeft() > 0)
+			userID = src.ReadVLE<kNet::VLE8_16_32>();
 	}
 
 };
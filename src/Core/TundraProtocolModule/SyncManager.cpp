@@ -18,33 +18,160 @@
 #include "AttributeMetadata.h"
 #include "LoggingFunctions.h"
 #include "Profiler.h"
+#include "HighPerfClock.h"
 
 #include "SceneAPI.h"
 
 #include <kNet.h>
 
+#include <QRunnable>
+#include <QThread>
+
 #include <cstring>
+#include <algorithm>
 
 #include "MemoryLeakCheck.h"
 
 // This variable is used for the interpolation stop check
 kNet::MessageConnection* currentSender = 0;
 
+// When this many received messages are queued, they are all applied regardless of the budget, so that the queue does not grow without bounds
+static const size_t cMaxIncomingMessages = 4096;
+// Maximum number of message buffers kept for reuse
+static const size_t cMaxFreeMessageBuffers = 256;
+// When a compressed outgoing batch grows to this size, it is sent without waiting for the end of the frame.
+// Must not exceed cMaxSyncBatchBytes, the largest batch the receivers accept
+static const size_t cMaxBatchBytes = 64 * 1024;
+// Maximum size of an uncompressed outgoing batch, so that it fits into one UDP datagram with the kNet headers.
+// A single message larger than this is sent on its own
+static const size_t cMaxUncompressedBatchBytes = 1200;
+// Batches smaller than this are not worth compressing
+static const size_t cMinCompressBytes = 128;
+// zlib compression level for the batches. The fastest level, as the batches are compressed for each user separately every frame
+static const int cCompressionLevel = 1;
+
 namespace TundraLogic
 {
 
 void SyncManager::QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds)
 {
-    //std::cout << "Queuing message " << id << " size " << ds.BytesFilled() << std::endl;
-    kNet::NetworkMessage* msg = connection->StartNewMessage(id, ds.BytesFilled());
-    memcpy(msg->data, ds.GetData(), ds.BytesFilled());
+    QueueMessage(connection, id, reliable, inOrder, ds.GetData(), ds.BytesFilled());
+}
+
+void SyncManager::QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, const char* data, size_t numBytes)
+{
+    // Only messages that are delivered in order can be batched without changing the order the receiver sees them in
+    OutgoingBatch* batch = reliable && inOrder ? GetOutgoingBatch(connection) : 0;
+    if (!batch)
+    {
+        QueueUnbatchedMessage(connection, id, reliable, inOrder, data, numBytes);
+        return;
+    }
+    
+    char header[16];
+    kNet::DataSerializer headerDs(header, sizeof(header));
+    headerDs.AddVLE<kNet::VLE8_16_32>(id);
+    headerDs.AddVLE<kNet::VLE8_16_32>(numBytes);
+    
+    size_t maxBytes = batch->compressed ? cMaxBatchBytes : cMaxUncompressedBatchBytes;
+    if (!batch->data.empty() && batch->data.size() + headerDs.BytesFilled() + numBytes > maxBytes)
+        FlushOutgoingBatch(*batch);
+    
+    batch->data.insert(batch->data.end(), header, header + headerDs.BytesFilled());
+    batch->data.insert(batch->data.end(), data, data + numBytes);
+    ++batch->numMessages;
+    
+    if (batch->data.size() >= maxBytes)
+        FlushOutgoingBatch(*batch);
+}
+
+void SyncManager::QueueUnbatchedMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, const char* data, size_t numBytes)
+{
+    //std::cout << "Queuing message " << id << " size " << numBytes << std::endl;
+    kNet::NetworkMessage* msg = connection->StartNewMessage(id, numBytes);
+    memcpy(msg->data, data, numBytes);
     msg->reliable = reliable;
     msg->inOrder = inOrder;
     msg->priority = 100; // Fixed priority as in those defined with xml
     connection->EndAndQueueMessage(msg);
 }
 
-void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp)
+SyncManager::OutgoingBatch* SyncManager::GetOutgoingBatch(kNet::MessageConnection* connection)
+{
+    // Also called from the worker threads, so use only the const lookup
+    return outgoingBatches_.value(connection).get();
+}
+
+void SyncManager::FlushOutgoingBatch(OutgoingBatch& batch)
+{
+    if (batch.data.empty())
+        return;
+    
+    // No profiling here, as this is also called from the worker threads and the profiler is not thread-safe
+    
+    kNet::MessageConnection* connection = batch.connection.ptr();
+    UserConnection* user = owner_->GetKristalliModule()->GetUserConnection(connection);
+    size_t numBytes = batch.data.size();
+    size_t sentBytes = numBytes;
+    
+    if (batch.numMessages == 1 && (!batch.compressed || numBytes < cMinCompressBytes))
+    {
+        // A single message that would not be compressed is sent as is, the batch would only add to its size
+        kNet::DataDeserializer dd(&batch.data[0], numBytes);
+        kNet::message_id_t id = dd.ReadVLE<kNet::VLE8_16_32>();
+        size_t msgBytes = dd.ReadVLE<kNet::VLE8_16_32>();
+        QueueUnbatchedMessage(connection, id, true, true, &batch.data[dd.BytePos()], msgBytes);
+        numBytes = sentBytes = msgBytes;
+    }
+    else
+    {
+        QByteArray compressed;
+        if (batch.compressed && numBytes >= cMinCompressBytes)
+            compressed = qCompress((const uchar*)&batch.data[0], (int)numBytes, cCompressionLevel);
+        // Send uncompressed if compression did not help
+        bool useCompressed = !compressed.isEmpty() && (size_t)compressed.size() < numBytes;
+        const char* payload = useCompressed ? compressed.constData() : &batch.data[0];
+        size_t payloadBytes = useCompressed ? compressed.size() : numBytes;
+        
+        kNet::NetworkMessage* msg = connection->StartNewMessage(cSyncBatchMessage, payloadBytes + 1);
+        msg->data[0] = useCompressed ? 1 : 0;
+        memcpy(msg->data + 1, payload, payloadBytes);
+        msg->reliable = true;
+        msg->inOrder = true;
+        msg->priority = 100;
+        connection->EndAndQueueMessage(msg);
+        sentBytes = payloadBytes + 1;
+    }
+    
+    if (user)
+    {
+        user->uncompressedBytes += numBytes;
+        user->compressedBytes += sentBytes;
+    }
+    
+    batch.data.clear();
+    batch.numMessages = 0;
+}
+
+void SyncManager::FlushOutgoingBatches()
+{
+    PROFILE(SyncManager_FlushOutgoingBatches);
+    
+    KristalliProtocol::KristalliProtocolModule* kristalli = owner_->GetKristalliModule();
+    for(OutgoingBatchMap::iterator i = outgoingBatches_.begin(); i != outgoingBatches_.end();)
+    {
+        // Forget the batches of users that have disconnected
+        if (!kristalli->GetUserConnection(i.key()))
+        {
+            i = outgoingBatches_.erase(i);
+            continue;
+        }
+        FlushOutgoingBatch(*i.value());
+        ++i;
+    }
+}
+
+void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp, SyncWorkspace& ws)
 {
     //std::cout << "Writing component fullupdate id " << comp->Id() << " typeid " << comp->TypeId() << std::endl;
     // Component identification
@@ -53,7 +180,7 @@ void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPt
     ds.AddString(comp->Name().toStdString());
     
     // Create a nested dataserializer for the attributes, so we can survive unknown or incompatible components
-    kNet::DataSerializer attrDs(attrDataBuffer_, 16 * 1024);
+    kNet::DataSerializer attrDs(ws.attrDataBuffer, 16 * 1024);
     
     // Static-structured attributes
     unsigned numStaticAttrs = comp->NumStaticAttributes();
@@ -75,15 +202,131 @@ void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPt
     
     // Add the attribute array to the main serializer
     ds.AddVLE<kNet::VLE8_16_32>(attrDs.BytesFilled());
-    ds.AddArray<u8>((unsigned char*)attrDataBuffer_, attrDs.BytesFilled());
+    ds.AddArray<u8>((unsigned char*)ws.attrDataBuffer, attrDs.BytesFilled());
 }
 
+void SyncManager::WriteEntityFullUpdate(kNet::DataSerializer& ds, unsigned sceneId, Entity* entity, SyncWorkspace& ws)
+{
+    // Entity identification and temporary flag
+    ds.AddVLE<kNet::VLE8_16_32>(sceneId);
+    ds.AddVLE<kNet::VLE8_16_32>(entity->Id() & UniqueIdGenerator::LAST_REPLICATED_ID);
+    // Do not write the temporary flag as a bit to not desync the byte alignment at this point, as a lot of data potentially follows
+    ds.Add<u8>(entity->IsTemporary() ? 1 : 0);
+    
+    const Entity::ComponentMap& components = entity->Components();
+    // Count the amount of replicated components
+    uint numReplicatedComponents = 0;
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+        if (i->second->IsReplicated()) ++numReplicatedComponents;
+    ds.AddVLE<kNet::VLE8_16_32>(numReplicatedComponents);
+    
+    // Serialize each replicated component
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+        if (i->second->IsReplicated())
+            WriteComponentFullUpdate(ds, i->second, ws);
+}
+
+/// Returns true if a user is synced with a scene
+static bool IsUserInScene(const UserConnection* user, unsigned sceneId)
+{
+    return user->syncState && user->sceneId == sceneId;
+}
+
+/// Returns true if the entity has not changed since the snapshot was serialized
+static bool IsSnapshotCurrent(const EntitySnapshot& snapshot, Entity* entity)
+{
+    // The temporary flag is not signalled when it changes, so check it here
+    if (snapshot.data.empty() || snapshot.temporary != entity->IsTemporary())
+        return false;
+    
+    // Attribute changes that are not signalled change the component versions
+    size_t index = 0;
+    const Entity::ComponentMap& components = entity->Components();
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+    {
+        if (!i->second->IsReplicated())
+            continue;
+        if (index >= snapshot.componentVersions.size() || snapshot.componentVersions[index].first != i->second->Id() ||
+            snapshot.componentVersions[index].second != i->second->ChangeVersion())
+            return false;
+        ++index;
+    }
+    return index == snapshot.componentVersions.size();
+}
+
+const EntitySnapshot& SyncManager::GetEntitySnapshot(SyncedScene& scene, Entity* entity, SyncWorkspace& ws)
+{
+    // The snapshot is only invalidated by the main thread while no sync states are being processed, and a current
+    // entry is never replaced, so the returned data stays valid after unlocking
+    {
+        QMutexLocker lock(&snapshotMutex_);
+        std::map<entity_id_t, EntitySnapshot>::const_iterator i = scene.snapshot.entities.find(entity->Id());
+        if (i != scene.snapshot.entities.end() && IsSnapshotCurrent(i->second, entity))
+            return i->second;
+    }
+    
+    // Serialize without holding the lock, so that the other threads are not blocked
+    EntitySnapshot serialized;
+    kNet::DataSerializer ds(ws.createEntityBuffer, 64 * 1024);
+    WriteEntityFullUpdate(ds, scene.id, entity, ws);
+    serialized.data.assign(ws.createEntityBuffer, ws.createEntityBuffer + ds.BytesFilled());
+    serialized.temporary = entity->IsTemporary();
+    const Entity::ComponentMap& components = entity->Components();
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+        if (i->second->IsReplicated())
+            serialized.componentVersions.push_back(std::make_pair(i->second->Id(), i->second->ChangeVersion()));
+    
+    // Another thread may have serialized the same entity meanwhile, in which case its entry may already be in use
+    QMutexLocker lock(&snapshotMutex_);
+    EntitySnapshot& snapshot = scene.snapshot.entities[entity->Id()];
+    if (!IsSnapshotCurrent(snapshot, entity))
+    {
+        snapshot.data.swap(serialized.data);
+        snapshot.temporary = serialized.temporary;
+        snapshot.componentVersions.swap(serialized.componentVersions);
+    }
+    return snapshot;
+}
+
+/// Processes the sync states of a range of users in the sync thread pool.
+class SyncManager::UserSyncJob : public QRunnable
+{
+public:
+    UserSyncJob(SyncManager* manager, const std::vector<UserConnection*>* users, size_t begin, size_t end, SyncWorkspace* ws) :
+        manager_(manager),
+        users_(users),
+        begin_(begin),
+        end_(end),
+        ws_(ws)
+    {
+    }
+    
+    void run()
+    {
+        manager_->ProcessUserSyncStates(users_, begin_, end_, ws_);
+    }
+    
+private:
+    SyncManager* manager_;
+    const std::vector<UserConnection*>* users_;
+    size_t begin_;
+    size_t end_;
+    SyncWorkspace* ws_;
+};
+
 SyncManager::SyncManager(TundraLogicModule* owner) :
     owner_(owner),
     framework_(owner->GetFramework()),
     updatePeriod_(1.0f / 30.0f),
-    updateAcc_(0.0)
+    updateAcc_(0.0),
+    applyBudget_(0.005f),
+    applyTimeUsed_(0.0),
+    compressionEnabled_(true),
+    nextSceneId_(0)
 {
+    workspaces_.push_back(new SyncWorkspace());
+    // The main thread processes one range of users itself
+    syncThreadPool_.setMaxThreadCount(std::max(QThread::idealThreadCount() - 1, 1));
     KristalliProtocol::KristalliProtocolModule *kristalli = framework_->GetModule<KristalliProtocol::KristalliProtocolModule>();
     connect(kristalli, SIGNAL(NetworkMessageReceived(kNet::MessageConnection *, kNet::message_id_t, const char *, size_t)), 
         this, SLOT(HandleKristalliMessage(kNet::MessageConnection*, kNet::message_id_t, const char*, size_t)));
@@ -91,6 +334,18 @@ SyncManager::SyncManager(TundraLogicModule* owner) :
 
 SyncManager::~SyncManager()
 {
+    for(size_t i = 0; i < workspaces_.size(); ++i)
+        delete workspaces_[i];
+
+    for(SyncedSceneMap::iterator i = scenes_.begin(); i != scenes_.end(); ++i)
+    {
+        ScenePtr scene = i->second.scene.lock();
+        if (scene)
+        {
+            scene->RemoveActionListener(&SyncManager::EntityActionListener, this);
+            scene->RemoveAttributeChangeListener(&SyncManager::AttributeChangeListener, this);
+        }
+    }
 }
 
 void SyncManager::SetUpdatePeriod(float period)
@@ -101,17 +356,27 @@ void SyncManager::SetUpdatePeriod(float period)
     updatePeriod_ = period;
 }
 
+void SyncManager::SetApplyBudget(float budget)
+{
+    applyBudget_ = budget;
+    // Without a budget, nothing is left waiting
+    if (applyBudget_ <= 0.0f)
+        ApplyIncomingMessages(true);
+}
+
 void SyncManager::RegisterToScene(ScenePtr scene)
 {
-    // Disconnect from previous scene if not expired
-    ScenePtr previous = scene_.lock();
-    if (previous)
+    // Disconnect from previous scenes if not expired
+    for(SyncedSceneMap::iterator i = scenes_.begin(); i != scenes_.end(); ++i)
     {
-        disconnect(previous.get(), 0, this, 0);
-        server_syncstate_.Clear();
+        ScenePtr previous = i->second.scene.lock();
+        if (previous)
+            DisconnectFromScene(previous.get());
     }
-    
-    scene_.reset();
+    scenes_.clear();
+    nextSceneId_ = 0;
+    server_syncstate_.Clear();
+    incomingMessages_.clear();
     
     if (!scene)
     {
@@ -119,15 +384,47 @@ void SyncManager::RegisterToScene(ScenePtr scene)
         return;
     }
     
-    scene_ = scene;
-    Scene* sceneptr = scene.get();
+    AddScene(scene);
+}
+
+int SyncManager::AddScene(ScenePtr scene)
+{
+    if (!scene)
+    {
+        LogError("Null scene, cannot replicate");
+        return -1;
+    }
+    if (FindSyncedScene(scene.get()))
+    {
+        LogWarning("SyncManager::AddScene: Scene \"" + scene->Name() + "\" is already synced");
+        return -1;
+    }
+    if (!scenes_.empty() && !owner_->IsServer())
+    {
+        LogError("SyncManager::AddScene: A client syncs only one scene");
+        return -1;
+    }
+    
+    SyncedScene& synced = scenes_[nextSceneId_];
+    synced.id = nextSceneId_++;
+    synced.scene = scene;
+    ConnectToScene(scene.get());
+    return (int)synced.id;
+}
+
+void SyncManager::RemoveScene(ScenePtr scene)
+{
+    SyncedScene* synced = scene ? FindSyncedScene(scene.get()) : 0;
+    if (!synced)
+        return;
     
-    connect(sceneptr, SIGNAL( AttributeChanged(IComponent*, IAttribute*, AttributeChange::Type) ),
-        SLOT( OnAttributeChanged(IComponent*, IAttribute*, AttributeChange::Type) ));
-    connect(sceneptr, SIGNAL( AttributeAdded(IComponent*, IAttribute*, AttributeChange::Type) ),
-        SLOT( OnAttributeAdded(IComponent*, IAttribute*, AttributeChange::Type) ));
-    connect(sceneptr, SIGNAL( AttributeRemoved(IComponent*, IAttribute*, AttributeChange::Type) ),
-        SLOT( OnAttributeRemoved(IComponent*, IAttribute*, AttributeChange::Type) ));
+    DisconnectFromScene(scene.get());
+    scenes_.erase(synced->id);
+}
+
+void SyncManager::ConnectToScene(Scene* sceneptr)
+{
+    sceneptr->AddAttributeChangeListener(&SyncManager::AttributeChangeListener, this);
     connect(sceneptr, SIGNAL( ComponentAdded(Entity*, IComponent*, AttributeChange::Type) ),
         SLOT( OnComponentAdded(Entity*, IComponent*, AttributeChange::Type) ));
     connect(sceneptr, SIGNAL( ComponentRemoved(Entity*, IComponent*, AttributeChange::Type) ),
@@ -138,9 +435,180 @@ void SyncManager::RegisterToScene(ScenePtr scene)
         SLOT( OnEntityRemoved(Entity*, AttributeChange::Type) ));
     connect(sceneptr, SIGNAL( ActionTriggered(Entity *, const QString &, const QStringList &, EntityAction::ExecTypeField) ),
         SLOT( OnActionTriggered(Entity *, const QString &, const QStringList &, EntityAction::ExecTypeField)));
+    sceneptr->AddActionListener(&SyncManager::EntityActionListener, this);
+}
+
+void SyncManager::DisconnectFromScene(Scene* sceneptr)
+{
+    disconnect(sceneptr, 0, this, 0);
+    sceneptr->RemoveActionListener(&SyncManager::EntityActionListener, this);
+    sceneptr->RemoveAttributeChangeListener(&SyncManager::AttributeChangeListener, this);
+}
+
+SyncManager::SyncedScene* SyncManager::FindSyncedScene(Scene* scene)
+{
+    for(SyncedSceneMap::iterator i = scenes_.begin(); i != scenes_.end(); ++i)
+        if (i->second.scene.lock().get() == scene)
+            return &i->second;
+    return 0;
+}
+
+SyncManager::SyncedScene* SyncManager::GetSyncedScene(kNet::MessageConnection* connection)
+{
+    if (!owner_->IsServer())
+        return scenes_.empty() ? 0 : &scenes_.begin()->second;
+    
+    UserConnection* user = owner_->GetKristalliModule()->GetUserConnection(connection);
+    if (!user || !user->syncState)
+        return 0;
+    SyncedSceneMap::iterator i = scenes_.find(user->sceneId);
+    return i != scenes_.end() ? &i->second : 0;
+}
+
+ScenePtr SyncManager::GetRegisteredScene(kNet::MessageConnection* connection)
+{
+    SyncedScene* synced = GetSyncedScene(connection);
+    return synced ? synced->scene.lock() : ScenePtr();
+}
+
+bool SyncManager::IsSceneSyncMessage(kNet::message_id_t id)
+{
+    switch (id)
+    {
+    case cCreateEntityMessage:
+    case cCreateComponentsMessage:
+    case cCreateAttributesMessage:
+    case cEditAttributesMessage:
+    case cRemoveAttributesMessage:
+    case cRemoveComponentsMessage:
+    case cRemoveEntityMessage:
+    case cCreateEntityReplyMessage:
+    case cCreateComponentsReplyMessage:
+    case cEntityActionMessage:
+    case cEntityActionBinaryMessage:
+        return true;
+    default:
+        return false;
+    }
 }
 
 void SyncManager::HandleKristalliMessage(kNet::MessageConnection* source, kNet::message_id_t id, const char* data, size_t numBytes)
+{
+    if (id == cSyncBatchMessage)
+    {
+        HandleSyncBatch(source, data, numBytes);
+        return;
+    }
+    if (!IsSceneSyncMessage(id))
+        return;
+    
+    // Apply right away if the budget allows and nothing is waiting before this message
+    if (incomingMessages_.empty() && (applyBudget_ <= 0.0f || applyTimeUsed_ < applyBudget_))
+    {
+        tick_t start = GetCurrentClockTime();
+        ApplyMessage(source, id, data, numBytes);
+        applyTimeUsed_ += (double)(GetCurrentClockTime() - start) / GetCurrentClockFreq();
+        return;
+    }
+    
+    incomingMessages_.push_back(IncomingMessage());
+    IncomingMessage& msg = incomingMessages_.back();
+    msg.source = Ptr(kNet::MessageConnection)(source);
+    msg.id = id;
+    if (!freeMessageBuffers_.empty())
+    {
+        msg.data.swap(freeMessageBuffers_.back());
+        freeMessageBuffers_.pop_back();
+    }
+    msg.data.assign(data, data + numBytes);
+    
+    if (incomingMessages_.size() >= cMaxIncomingMessages)
+    {
+        LogWarning("SyncManager: " + QString::number(incomingMessages_.size()) + " received messages queued, applying them all now");
+        ApplyIncomingMessages(true);
+    }
+}
+
+void SyncManager::HandleSyncBatch(kNet::MessageConnection* source, const char* data, size_t numBytes)
+{
+    PROFILE(SyncManager_HandleSyncBatch);
+    
+    if (owner_->IsServer())
+    {
+        LogWarning("SyncManager: Received a sync batch message from a client, ignoring");
+        return;
+    }
+    QByteArray messages;
+    QString error;
+    if (!DecompressSyncBatch(data, numBytes, messages, error))
+    {
+        LogError("SyncManager: " + error + ", ignoring");
+        return;
+    }
+    const char* payload = messages.constData();
+    size_t payloadBytes = messages.size();
+    
+    try
+    {
+        kNet::DataDeserializer dd(payload, payloadBytes);
+        while (dd.BytesLeft() > 0)
+        {
+            kNet::message_id_t id = dd.ReadVLE<kNet::VLE8_16_32>();
+            size_t msgBytes = dd.ReadVLE<kNet::VLE8_16_32>();
+            if (msgBytes > dd.BytesLeft())
+            {
+                LogError("SyncManager: Truncated message " + QString::number(id) + " in a sync batch message");
+                return;
+            }
+            const char* msgData = payload + dd.BytePos();
+            dd.SkipBytes(msgBytes);
+            
+            if (IsSceneSyncMessage(id))
+                HandleKristalliMessage(source, id, msgData, msgBytes);
+            else
+                LogWarning("SyncManager: Ignoring message " + QString::number(id) + " in a sync batch message");
+        }
+    }
+    catch (kNet::NetException& e)
+    {
+        LogError("Exception while handling sync batch message: " + QString(e.what()));
+    }
+}
+
+void SyncManager::ApplyIncomingMessages(bool force)
+{
+    PROFILE(SyncManager_ApplyIncomingMessages);
+    
+    KristalliProtocol::KristalliProtocolModule* kristalli = owner_->GetKristalliModule();
+    bool isServer = owner_->IsServer();
+    tick_t start = GetCurrentClockTime();
+    double freq = (double)GetCurrentClockFreq();
+    
+    while (!incomingMessages_.empty())
+    {
+        if (!force && applyBudget_ > 0.0f && applyTimeUsed_ + (GetCurrentClockTime() - start) / freq >= applyBudget_)
+            break;
+        
+        IncomingMessage& msg = incomingMessages_.front();
+        // Discard messages from connections that have been closed while the messages were waiting
+        kNet::MessageConnection* source = msg.source.ptr();
+        bool connected = isServer ? kristalli->GetUserConnection(source) != 0 : kristalli->GetMessageConnection() == source;
+        if (connected)
+            ApplyMessage(source, msg.id, msg.data.empty() ? 0 : &msg.data[0], msg.data.size());
+        
+        if (freeMessageBuffers_.size() < cMaxFreeMessageBuffers)
+        {
+            freeMessageBuffers_.push_back(std::vector<char>());
+            freeMessageBuffers_.back().swap(msg.data);
+            freeMessageBuffers_.back().clear();
+        }
+        incomingMessages_.pop_front();
+    }
+    
+    applyTimeUsed_ += (GetCurrentClockTime() - start) / freq;
+}
+
+void SyncManager::ApplyMessage(kNet::MessageConnection* source, kNet::message_id_t id, const char* data, size_t numBytes)
 {
     // std::cout << "Handling message " << id << " size " << numBytes << std::endl;
     try
@@ -180,6 +648,9 @@ void SyncManager::HandleKristalliMessage(kNet::MessageConnection* source, kNet::
                 HandleEntityAction(source, msg);
             }
             break;
+        case cEntityActionBinaryMessage:
+            HandleEntityActionBinary(source, data, numBytes);
+            break;
         }
     }
     catch (kNet::NetException& e)
@@ -193,16 +664,47 @@ void SyncManager::NewUserConnected(UserConnection* user)
 {
     PROFILE(SyncManager_NewUserConnected);
 
-    ScenePtr scene = scene_.lock();
+    // Sync the user with the scene named in the login properties, or with the first registered scene
+    const QString sceneName = user->GetProperty("scene");
+    ScenePtr scene;
+    for(SyncedSceneMap::iterator i = scenes_.begin(); i != scenes_.end(); ++i)
+    {
+        ScenePtr candidate = i->second.scene.lock();
+        if (!candidate)
+            continue;
+        if (!scene || (!sceneName.isEmpty() && candidate->Name() == sceneName))
+        {
+            scene = candidate;
+            user->sceneId = i->first;
+            if (!sceneName.isEmpty() && candidate->Name() == sceneName)
+                break;
+        }
+    }
     if (!scene)
     {
         LogWarning("SyncManager: Cannot handle new user connection message - No scene set!");
         return;
     }
+    if (!sceneName.isEmpty() && scene->Name() != sceneName)
+        LogWarning("SyncManager: User " + QString::number(user->userID) + " asked for unknown scene \"" + sceneName + "\", syncing with \"" + scene->Name() + "\"");
     
     // Connect to actions sent to specifically to this user
     connect(user, SIGNAL(ActionTriggered(UserConnection*, Entity*, const QString&, const QStringList&)), this, SLOT(OnUserActionTriggered(UserConnection*, Entity*, const QString&, const QStringList&)));
     
+    // Pack the messages to this user into batches, and compress them, if both ends support it
+    user->batched = user->GetProperty("syncbatch") == "1";
+    user->compressed = user->batched && compressionEnabled_ && user->GetProperty("compression") == "zlib";
+    if (user->batched && !GetOutgoingBatch(user->connection.ptr()))
+    {
+        boost::shared_ptr<OutgoingBatch> newBatch(new OutgoingBatch());
+        newBatch->connection = user->connection;
+        newBatch->numMessages = 0;
+        outgoingBatches_.insert(user->connection.ptr(), newBatch);
+    }
+    OutgoingBatch* batch = GetOutgoingBatch(user->connection.ptr());
+    if (batch)
+        batch->compressed = user->compressed;
+    
     // Mark all entities in the sync state as new so we will send them
     user->syncState = boost::shared_ptr<SceneSyncState>(new SceneSyncState());
     for(Scene::iterator iter = scene->begin(); iter != scene->end(); ++iter)
@@ -215,99 +717,72 @@ void SyncManager::NewUserConnected(UserConnection* user)
     }
 }
 
-void SyncManager::OnAttributeChanged(IComponent* comp, IAttribute* attr, AttributeChange::Type change)
+void SyncManager::AttributeChangeListener(void *userData, Scene *scene, const AttributeChangeRecord *records, size_t count)
 {
-    assert(comp && attr);
-    if (!comp || !attr)
-        return;
+    static_cast<SyncManager*>(userData)->OnAttributeChanges(scene, records, count);
+}
 
+void SyncManager::OnAttributeChanges(Scene *scene, const AttributeChangeRecord *records, size_t count)
+{
+    PROFILE(SyncManager_OnAttributeChanges);
+
+    SyncedScene* synced = FindSyncedScene(scene);
+    if (!synced)
+        return;
     bool isServer = owner_->IsServer();
+    UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
     
-    // Client: Check for stopping interpolation, if we change a currently interpolating variable ourselves
-    if (!isServer)
+    for(size_t i = 0; i < count; ++i)
     {
-        ScenePtr scene = scene_.lock();
-        if ((scene) && (!scene->IsInterpolating()) && (!currentSender))
+        const AttributeChangeRecord &record = records[i];
+        
+        // Client: Check for stopping interpolation, if we change a currently interpolating variable ourselves
+        if (!isServer && record.kind == AttributeChangeRecord::Changed && !record.interpolated && !currentSender)
         {
-            if ((attr->Metadata()) && (attr->Metadata()->interpolation == AttributeMetadata::Interpolate))
+            EntityPtr entity = scene->GetEntity(record.entityId);
+            ComponentPtr comp = entity ? entity->GetComponentById(record.componentId) : ComponentPtr();
+            IAttribute* attr = comp && record.attributeIndex < comp->Attributes().size() ? comp->Attributes()[record.attributeIndex] : 0;
+            if ((attr) && (attr->Metadata()) && (attr->Metadata()->interpolation == AttributeMetadata::Interpolate))
                 // Note: it does not matter if the attribute was not actually interpolating
                 scene->EndAttributeInterpolation(attr);
         }
-    }
-    
-    if ((change != AttributeChange::Replicate) || (comp->IsLocal()))
-        return;
-    Entity* entity = comp->ParentEntity();
-    if ((!entity) || (entity->IsLocal()))
-        return;
-    
-    if (isServer)
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) (*i)->syncState->MarkAttributeDirty(entity->Id(), comp->Id(), attr->Index());
-    }
-    else
-    {
-        server_syncstate_.MarkAttributeDirty(entity->Id(), comp->Id(), attr->Index());
+        
+        // Local entities and components have their ids in the local range
+        if (record.entityId >= UniqueIdGenerator::FIRST_LOCAL_ID || record.componentId >= UniqueIdGenerator::FIRST_LOCAL_ID)
+            continue;
+        // The serialized entity is out of date also after local only changes, as they are included in a full update
+        synced->snapshot.Invalidate(record.entityId);
+        // We do not allow to create or remove attributes in local or disconnected signaling mode in a replicated component.
+        // Always replicate the creation and removal, because the client & server must have their attribute count in sync to
+        // be able to send attribute bitmasks
+        if (record.kind == AttributeChangeRecord::Changed && record.change != AttributeChange::Replicate)
+            continue;
+        
+        if (isServer)
+        {
+            for(UserConnectionList::iterator j = users.begin(); j != users.end(); ++j)
+                if (IsUserInScene(j->get(), synced->id)) MarkAttributeChange((*j)->syncState.get(), record);
+        }
+        else
+        {
+            MarkAttributeChange(&server_syncstate_, record);
+        }
     }
 }
 
-void SyncManager::OnAttributeAdded(IComponent* comp, IAttribute* attr, AttributeChange::Type change)
+void SyncManager::MarkAttributeChange(SceneSyncState* state, const AttributeChangeRecord &record)
 {
-    assert(comp && attr);
-    if (!comp || !attr)
-        return;
-
-    bool isServer = owner_->IsServer();
-    
-    // We do not allow to create attributes in local or disconnected signaling mode in a replicated component.
-    // Always replicate the creation, because the client & server must have their attribute count in sync to 
-    // be able to send attribute bitmasks
-    if (comp->IsLocal())
-        return;
-    Entity* entity = comp->ParentEntity();
-    if ((!entity) || (entity->IsLocal()))
-        return;
-    
-    if (isServer)
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) (*i)->syncState->MarkAttributeCreated(entity->Id(), comp->Id(), attr->Index());
-    }
-    else
-    {
-        server_syncstate_.MarkAttributeCreated(entity->Id(), comp->Id(), attr->Index());
-    }
-}
-
-void SyncManager::OnAttributeRemoved(IComponent* comp, IAttribute* attr, AttributeChange::Type change)
-{
-    assert(comp && attr);
-    if (!comp || !attr)
-        return;
-
-    bool isServer = owner_->IsServer();
-    
-    // We do not allow to remove attributes in local or disconnected signaling mode in a replicated component.
-    // Always replicate the removeal, because the client & server must have their attribute count in sync to
-    // be able to send attribute bitmasks
-    if (comp->IsLocal())
-        return;
-    Entity* entity = comp->ParentEntity();
-    if ((!entity) || (entity->IsLocal()))
-        return;
-    
-    if (isServer)
-    {
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) (*i)->syncState->MarkAttributeRemoved(entity->Id(), comp->Id(), attr->Index());
-    }
-    else
-    {
-        server_syncstate_.MarkAttributeRemoved(entity->Id(), comp->Id(), attr->Index());
+    switch(record.kind)
+    {
+    case AttributeChangeRecord::Changed:
+        state->MarkAttributeDirty(record.entityId, record.componentId, record.attributeIndex);
+        break;
+    case AttributeChangeRecord::Added:
+        state->MarkAttributeCreated(record.entityId, record.componentId, record.attributeIndex);
+        break;
+    case AttributeChangeRecord::Removed:
+        state->MarkAttributeRemoved(record.entityId, record.componentId, record.attributeIndex);
+        break;
     }
 }
 
@@ -316,6 +791,10 @@ void SyncManager::OnComponentAdded(Entity* entity, IComponent* comp, AttributeCh
     assert(entity && comp);
     if (!entity || !comp)
         return;
+    SyncedScene* synced = FindSyncedScene(entity->ParentScene());
+    if (!synced)
+        return;
+    synced->snapshot.Invalidate(entity->Id());
 
     if ((change != AttributeChange::Replicate) || (comp->IsLocal()))
         return;
@@ -326,7 +805,7 @@ void SyncManager::OnComponentAdded(Entity* entity, IComponent* comp, AttributeCh
     {
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) (*i)->syncState->MarkComponentDirty(entity->Id(), comp->Id());
+            if (IsUserInScene(i->get(), synced->id)) (*i)->syncState->MarkComponentDirty(entity->Id(), comp->Id());
     }
     else
     {
@@ -339,6 +818,10 @@ void SyncManager::OnComponentRemoved(Entity* entity, IComponent* comp, Attribute
     assert(entity && comp);
     if (!entity || !comp)
         return;
+    SyncedScene* synced = FindSyncedScene(entity->ParentScene());
+    if (!synced)
+        return;
+    synced->snapshot.Invalidate(entity->Id());
     if ((change != AttributeChange::Replicate) || (comp->IsLocal()))
         return;
     if (entity->IsLocal())
@@ -348,7 +831,7 @@ void SyncManager::OnComponentRemoved(Entity* entity, IComponent* comp, Attribute
     {
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) (*i)->syncState->MarkComponentRemoved(entity->Id(), comp->Id());
+            if (IsUserInScene(i->get(), synced->id)) (*i)->syncState->MarkComponentRemoved(entity->Id(), comp->Id());
     }
     else
     {
@@ -361,6 +844,10 @@ void SyncManager::OnEntityCreated(Entity* entity, AttributeChange::Type change)
     assert(entity);
     if (!entity)
         return;
+    SyncedScene* synced = FindSyncedScene(entity->ParentScene());
+    if (!synced)
+        return;
+    synced->snapshot.Invalidate(entity->Id());
     if ((change != AttributeChange::Replicate) || (entity->IsLocal()))
         return;
 
@@ -369,7 +856,7 @@ void SyncManager::OnEntityCreated(Entity* entity, AttributeChange::Type change)
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
         {
-            if ((*i)->syncState)
+            if (IsUserInScene(i->get(), synced->id))
             {
                 (*i)->syncState->MarkEntityDirty(entity->Id());
                 if ((*i)->syncState->entities[entity->Id()].removed)
@@ -391,6 +878,10 @@ void SyncManager::OnEntityRemoved(Entity* entity, AttributeChange::Type change)
     assert(entity);
     if (!entity)
         return;
+    SyncedScene* synced = FindSyncedScene(entity->ParentScene());
+    if (!synced)
+        return;
+    synced->snapshot.Invalidate(entity->Id());
     if (change != AttributeChange::Replicate)
         return;
     if (entity->IsLocal())
@@ -400,7 +891,7 @@ void SyncManager::OnEntityRemoved(Entity* entity, AttributeChange::Type change)
     {
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) (*i)->syncState->MarkEntityRemoved(entity->Id());
+            if (IsUserInScene(i->get(), synced->id)) (*i)->syncState->MarkEntityRemoved(entity->Id());
     }
     else
     {
@@ -410,6 +901,10 @@ void SyncManager::OnEntityRemoved(Entity* entity, AttributeChange::Type change)
 
 void SyncManager::OnActionTriggered(Entity *entity, const QString &action, const QStringList &params, EntityAction::ExecTypeField type)
 {
+    // Actions executed by id were already replicated by the action listener
+    if (entity->ParentScene() && entity->ParentScene()->IsEmittingActionById())
+        return;
+    
     //Scene* scene = scene_.lock().get();
     //assert(scene);
 
@@ -443,10 +938,13 @@ void SyncManager::OnActionTriggered(Entity *entity, const QString &action, const
 
     if (isServer && (type & EntityAction::Peers) != 0)
     {
+        SyncedScene* synced = FindSyncedScene(entity->ParentScene());
+        if (!synced)
+            return;
         msg.executionType = (u8)EntityAction::Local; // Propagate as local actions.
         foreach(UserConnectionPtr c, owner_->GetKristalliModule()->GetUserConnections())
         {
-            if (c->properties["authenticated"] == "true" && c->connection)
+            if (c->properties["authenticated"] == "true" && c->connection && c->sceneId == synced->id)
             {
                 //LogInfo("peer " + action);
                 c->connection->Send(msg);
@@ -455,6 +953,54 @@ void SyncManager::OnActionTriggered(Entity *entity, const QString &action, const
     }
 }
 
+void SyncManager::EntityActionListener(void *userData, Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type)
+{
+    static_cast<SyncManager*>(userData)->OnActionTriggered(entity, id, args, type);
+}
+
+void SyncManager::WriteEntityActionBinary(kNet::DataSerializer& ds, entity_id_t entityId, entity_action_id_t id, const EntityActionArgs &args, u8 type)
+{
+    ds.AddVLE<kNet::VLE8_16_32>(entityId);
+    ds.AddVLE<kNet::VLE8_16_32>(id);
+    ds.Add<u8>(type);
+    ds.Add<u8>(args.DataSize());
+    ds.AddArray<u8>(args.Data(), args.DataSize());
+}
+
+void SyncManager::OnActionTriggered(Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type)
+{
+    if (!args.IsValid())
+    {
+        LogError("SyncManager: Not replicating entity action " + QString::number(id) + ", its parameters did not fit into the parameter buffer.");
+        return;
+    }
+
+    // Same execution rules as for the string-based actions
+    bool isServer = owner_->IsServer();
+    if (isServer && (type & EntityAction::Server) != 0)
+        entity->Exec(EntityAction::Local, id, args);
+
+    if (!isServer && ((type & EntityAction::Server) != 0 || (type & EntityAction::Peers) != 0) && owner_->GetClient()->GetConnection())
+    {
+        // send without Local flag
+        kNet::DataSerializer ds(entityActionBuffer_, sizeof(entityActionBuffer_));
+        WriteEntityActionBinary(ds, entity->Id(), id, args, (u8)(type & ~EntityAction::Local));
+        QueueMessage(owner_->GetClient()->GetConnection(), cEntityActionBinaryMessage, true, true, ds);
+    }
+
+    if (isServer && (type & EntityAction::Peers) != 0)
+    {
+        SyncedScene* synced = FindSyncedScene(entity->ParentScene());
+        if (!synced)
+            return;
+        kNet::DataSerializer ds(entityActionBuffer_, sizeof(entityActionBuffer_));
+        WriteEntityActionBinary(ds, entity->Id(), id, args, (u8)EntityAction::Local); // Propagate as local actions.
+        foreach(UserConnectionPtr c, owner_->GetKristalliModule()->GetUserConnections())
+            if (c->properties["authenticated"] == "true" && c->connection && c->sceneId == synced->id)
+                QueueMessage(c->connection, cEntityActionBinaryMessage, true, true, ds);
+    }
+}
+
 void SyncManager::OnUserActionTriggered(UserConnection* user, Entity *entity, const QString &action, const QStringList &params)
 {
     assert(user && entity);
@@ -483,38 +1029,117 @@ void SyncManager::Update(f64 frametime)
 {
     PROFILE(SyncManager_Update);
     
+    // Start a new frame's budget, and apply the received messages that did not fit into the previous frames
+    applyTimeUsed_ = 0.0;
+    ApplyIncomingMessages(false);
+    
     updateAcc_ += (float)frametime;
     if (updateAcc_ < updatePeriod_)
+    {
+        // Send the replies queued while handling received messages
+        FlushOutgoingBatches();
         return;
+    }
     // If multiple updates passed, update still just once
     while(updateAcc_ >= updatePeriod_)
         updateAcc_ -= updatePeriod_;
     
-    ScenePtr scene = scene_.lock();
-    if (!scene)
+    // Make sure all attribute changes so far have been marked dirty
+    bool hasScene = false;
+    for(SyncedSceneMap::iterator i = scenes_.begin(); i != scenes_.end(); ++i)
+    {
+        ScenePtr scene = i->second.scene.lock();
+        if (scene)
+        {
+            scene->FlushAttributeChanges();
+            hasScene = true;
+        }
+    }
+    if (!hasScene)
         return;
     
     if (owner_->IsServer())
     {
-        // If we are server, process all authenticated users
-        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState) ProcessSyncState((*i)->connection, (*i)->syncState.get());
+        // If we are server, process all authenticated users of all scenes together. The scenes are all only read meanwhile
+        UserConnectionList& userList = owner_->GetKristalliModule()->GetUserConnections();
+        std::vector<UserConnection*> users;
+        for(UserConnectionList::iterator i = userList.begin(); i != userList.end(); ++i)
+        {
+            if (!(*i)->syncState)
+                continue;
+            SyncedSceneMap::const_iterator scene = scenes_.find((*i)->sceneId);
+            if (scene != scenes_.end() && !scene->second.scene.expired())
+                users.push_back(i->get());
+        }
+        
+        PROFILE(SyncManager_ProcessUserSyncStates);
+        
+        size_t numThreads = std::min((size_t)std::max(QThread::idealThreadCount(), 1), users.size());
+        while(workspaces_.size() < numThreads)
+            workspaces_.push_back(new SyncWorkspace());
+        if (numThreads <= 1)
+            ProcessUserSyncStates(&users, 0, users.size(), workspaces_[0]);
+        else
+        {
+            // The scenes are only read while the users are processed, and each user's sync state, batch and connection
+            // are touched by one thread only, so the users can be processed in parallel. The main thread processes
+            // the first range and then waits for the sync threads to finish the rest
+            size_t usersPerThread = (users.size() + numThreads - 1) / numThreads;
+            for(size_t begin = usersPerThread, i = 1; begin < users.size(); begin += usersPerThread, ++i)
+                syncThreadPool_.start(new UserSyncJob(this, &users, begin, std::min(begin + usersPerThread, users.size()), workspaces_[i]));
+            ProcessUserSyncStates(&users, 0, usersPerThread, workspaces_[0]);
+            syncThreadPool_.waitForDone();
+        }
+        for(size_t i = 0; i < numThreads; ++i)
+            FlushWorkspaceLog(*workspaces_[i]);
+        
+        // Send the replies queued while handling received messages, and forget the batches of disconnected users
+        FlushOutgoingBatches();
     }
     else
     {
         // If we are client, process just the server sync state
         kNet::MessageConnection* connection = owner_->GetKristalliModule()->GetMessageConnection();
         if (connection)
-            ProcessSyncState(connection, &server_syncstate_);
+        {
+            PROFILE(SyncManager_ProcessSyncState);
+            ProcessSyncState(connection, &server_syncstate_, scenes_.begin()->second, *workspaces_[0]);
+            FlushWorkspaceLog(*workspaces_[0]);
+        }
     }
 }
 
-void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state)
+void SyncManager::ProcessUserSyncStates(const std::vector<UserConnection*>* users, size_t begin, size_t end, SyncWorkspace* ws)
 {
-    PROFILE(SyncManager_ProcessSyncState);
-    
-    unsigned sceneId = 0; ///\todo Replace with proper scene ID once multiscene support is in place.
+    // Run in the worker threads, so nothing here or in the functions called may use the profiler, which is not thread-safe
+    for(size_t i = begin; i < end; ++i)
+    {
+        UserConnection* user = (*users)[i];
+        // The scenes are not added or removed meanwhile, so looking them up from several threads is safe
+        SyncedScene& scene = scenes_.find(user->sceneId)->second;
+        ProcessSyncState(user->connection.ptr(), user->syncState.get(), scene, *ws);
+        // Compress the batch here too, to spread also that work over the threads
+        OutgoingBatch* batch = GetOutgoingBatch(user->connection.ptr());
+        if (batch)
+            FlushOutgoingBatch(*batch);
+    }
+}
+
+void SyncManager::FlushWorkspaceLog(SyncWorkspace& ws)
+{
+    for(size_t i = 0; i < ws.log.size(); ++i)
+    {
+        if (ws.log[i].first)
+            LogError(ws.log[i].second);
+        else
+            LogWarning(ws.log[i].second);
+    }
+    ws.log.clear();
+}
+
+void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state, SyncedScene& syncedScene, SyncWorkspace& ws)
+{
+    unsigned sceneId = syncedScene.id;
     
     /*
     static int counter = 0;
@@ -526,7 +1151,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
     }
     */
     
-    ScenePtr scene = scene_.lock();
+    ScenePtr scene = syncedScene.scene.lock();
     int numMessagesSent = 0;
     bool isServer = owner_->IsServer();
     
@@ -543,7 +1168,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
         if (!entity)
         {
             if (!entityState.removed)
-                LogWarning("Entity " + QString::number(entityState.id) + " has gone missing from the scene without the remove properly signalled. Removing from replication state");
+                ws.Warning("Entity " + QString::number(entityState.id) + " has gone missing from the scene without the remove properly signalled. Removing from replication state");
             entityState.isNew = false;
             removeState = true;
         }
@@ -560,7 +1185,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
             // If we have both new & removed flags on the entity, it will probably result in buggy behaviour
             if (entityState.isNew)
             {
-                LogWarning("Entity " + QString::number(entityState.id) + " queued for both deletion and creation. Buggy behaviour will possibly result!");
+                ws.Warning("Entity " + QString::number(entityState.id) + " queued for both deletion and creation. Buggy behaviour will possibly result!");
                 // The delete has been processed. Do not remember it anymore, but requeue the state for creation
                 entityState.removed = false;
                 removeState = false;
@@ -570,7 +1195,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
             else
                 removeState = true;
             
-            kNet::DataSerializer ds(removeEntityBuffer_, 1024);
+            kNet::DataSerializer ds(ws.removeEntityBuffer, 1024);
             ds.AddVLE<kNet::VLE8_16_32>(sceneId);
             ds.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
             QueueMessage(destination, cRemoveEntityMessage, true, true, ds);
@@ -579,46 +1204,37 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
         // New entity
         else if (entityState.isNew)
         {
-            kNet::DataSerializer ds(createEntityBuffer_, 64 * 1024);
-            
-            // Entity identification and temporary flag
-            ds.AddVLE<kNet::VLE8_16_32>(sceneId);
-            ds.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
-            // Do not write the temporary flag as a bit to not desync the byte alignment at this point, as a lot of data potentially follows
-            ds.Add<u8>(entity->IsTemporary() ? 1 : 0);
-            
-            const Entity::ComponentMap& components = entity->Components();
-            // Count the amount of replicated components
-            uint numReplicatedComponents = 0;
-            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
-                if (i->second->IsReplicated()) ++numReplicatedComponents;
-            ds.AddVLE<kNet::VLE8_16_32>(numReplicatedComponents);
-            
-            // Serialize each replicated component
-            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+            // On the server, the same serialized entity is shared by all users it is sent to
+            if (isServer)
             {
-                ComponentPtr comp = i->second;
-                if (!comp->IsReplicated())
-                    continue;
-                WriteComponentFullUpdate(ds, comp);
-                // Mark the component undirty in the receiver's syncstate
-                state->MarkComponentProcessed(entity->Id(), comp->Id());
+                const EntitySnapshot& snapshot = GetEntitySnapshot(syncedScene, entity.get(), ws);
+                QueueMessage(destination, cCreateEntityMessage, true, true, &snapshot.data[0], snapshot.data.size());
+            }
+            else
+            {
+                kNet::DataSerializer ds(ws.createEntityBuffer, 64 * 1024);
+                WriteEntityFullUpdate(ds, sceneId, entity.get(), ws);
+                QueueMessage(destination, cCreateEntityMessage, true, true, ds);
             }
-            
-            QueueMessage(destination, cCreateEntityMessage, true, true, ds);
             ++numMessagesSent;
             
+            // Mark the components undirty in the receiver's syncstate
+            const Entity::ComponentMap& components = entity->Components();
+            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+                if (i->second->IsReplicated())
+                    state->MarkComponentProcessed(entity->Id(), i->second->Id());
+            
             // The create has been processed fully. Clear dirty flags.
             state->MarkEntityProcessed(entity->Id());
         }
         else if (entity)
         {
             // Components or attributes have been added, changed, or removed. Prepare the dataserializers
-            kNet::DataSerializer removeCompsDs(removeCompsBuffer_, 1024);
-            kNet::DataSerializer removeAttrsDs(removeAttrsBuffer_, 1024);
-            kNet::DataSerializer createCompsDs(createCompsBuffer_, 64 * 1024);
-            kNet::DataSerializer createAttrsDs(createAttrsBuffer_, 16 * 1024);
-            kNet::DataSerializer editAttrsDs(editAttrsBuffer_, 64 * 1024);
+            kNet::DataSerializer removeCompsDs(ws.removeCompsBuffer, 1024);
+            kNet::DataSerializer removeAttrsDs(ws.removeAttrsBuffer, 1024);
+            kNet::DataSerializer createCompsDs(ws.createCompsBuffer, 64 * 1024);
+            kNet::DataSerializer createAttrsDs(ws.createAttrsBuffer, 16 * 1024);
+            kNet::DataSerializer editAttrsDs(ws.editAttrsBuffer, 64 * 1024);
             
             while (!entityState.dirtyQueue.empty())
             {
@@ -631,7 +1247,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                 if (!comp)
                 {
                     if (!compState.removed)
-                        LogWarning("Component " + QString::number(compState.id) + " of " + entity->ToString() + " has gone missing from the scene without the remove properly signalled. Removing from client replication state->");
+                        ws.Warning("Component " + QString::number(compState.id) + " of " + entity->ToString() + " has gone missing from the scene without the remove properly signalled. Removing from client replication state->");
                     compState.isNew = false;
                     removeCompState = true;
                 }
@@ -666,7 +1282,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                         createCompsDs.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
                     }
                     // Then add the component data
-                    WriteComponentFullUpdate(createCompsDs, comp);
+                    WriteComponentFullUpdate(createCompsDs, comp, ws);
                     // Mark the component undirty in the receiver's syncstate
                     state->MarkComponentProcessed(entity->Id(), comp->Id());
                 }
@@ -685,9 +1301,9 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                         {
                             // Create attribute. Make sure it exists and is dynamic.
                             if (attrIndex >= attrs.size() || !attrs[attrIndex])
-                                LogError("CreateAttribute for nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
+                                ws.Error("CreateAttribute for nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
                             else if (!attrs[attrIndex]->IsDynamic())
-                                LogError("CreateAttribute for a static attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
+                                ws.Error("CreateAttribute for a static attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
                             else
                             {
                                 // If first attribute, write the entity ID first
@@ -721,7 +1337,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                     compState.newAndRemovedAttributes.clear();
                     
                     // Now, if remaining dirty bits exist, they must be sent in the edit attributes message. These are the majority of our network data.
-                    changedAttributes_.clear();
+                    ws.changedAttributes.clear();
                     unsigned numBytes = (attrs.size() + 7) >> 3;
                     for (unsigned i = 0; i < numBytes; ++i)
                     {
@@ -734,14 +1350,14 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                                 {
                                     u8 attrIndex = i * 8 + j;
                                     if (attrIndex < attrs.size() && attrs[attrIndex])
-                                        changedAttributes_.push_back(attrIndex);
+                                        ws.changedAttributes.push_back(attrIndex);
                                     else
-                                        LogError("Attribute change for a nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
+                                        ws.Error("Attribute change for a nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
                                 }
                             }
                         }
                     }
-                    if (changedAttributes_.size())
+                    if (ws.changedAttributes.size())
                     {
                         // If first component for which attribute changes are sent, write the entity ID first
                         if (!editAttrsDs.BytesFilled())
@@ -752,20 +1368,20 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                         editAttrsDs.AddVLE<kNet::VLE8_16_32>(compState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
                         
                         // Create a nested dataserializer for the actual attribute data, so we can skip components
-                        kNet::DataSerializer attrDataDs(attrDataBuffer_, 16 * 1024);
+                        kNet::DataSerializer attrDataDs(ws.attrDataBuffer, 16 * 1024);
                         
                         // There are changed attributes. Check if it is more optimal to send attribute indices, or the whole bitmask
-                        unsigned bitsMethod1 = changedAttributes_.size() * 8 + 8;
+                        unsigned bitsMethod1 = ws.changedAttributes.size() * 8 + 8;
                         unsigned bitsMethod2 = attrs.size();
                         // Method 1: indices
                         if (bitsMethod1 <= bitsMethod2)
                         {
                             attrDataDs.Add<kNet::bit>(0);
-                            attrDataDs.Add<u8>(changedAttributes_.size());
-                            for (unsigned i = 0; i < changedAttributes_.size(); ++i)
+                            attrDataDs.Add<u8>(ws.changedAttributes.size());
+                            for (unsigned i = 0; i < ws.changedAttributes.size(); ++i)
                             {
-                                attrDataDs.Add<u8>(changedAttributes_[i]);
-                                attrs[changedAttributes_[i]]->ToBinary(attrDataDs);
+                                attrDataDs.Add<u8>(ws.changedAttributes[i]);
+                                attrs[ws.changedAttributes[i]]->ToBinary(attrDataDs);
                             }
                         }
                         // Method 2: bitmask
@@ -786,7 +1402,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                         
                         // Add the attribute data array to the main serializer
                         editAttrsDs.AddVLE<kNet::VLE8_16_32>(attrDataDs.BytesFilled());
-                        editAttrsDs.AddArray<u8>((unsigned char*)attrDataBuffer_, attrDataDs.BytesFilled());
+                        editAttrsDs.AddArray<u8>((unsigned char*)ws.attrDataBuffer, attrDataDs.BytesFilled());
                         
                         // Now zero out all remaining dirty bits
                         for (unsigned i = 0; i < numBytes; ++i)
@@ -859,7 +1475,7 @@ void SyncManager::HandleCreateEntity(kNet::MessageConnection* source, const char
     
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding CreateEntity message");
@@ -874,7 +1490,7 @@ void SyncManager::HandleCreateEntity(kNet::MessageConnection* source, const char
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     entity_id_t senderEntityID = entityID;
     
@@ -973,7 +1589,7 @@ void SyncManager::HandleCreateEntity(kNet::MessageConnection* source, const char
     // Send CreateEntityReply (server only)
     if (isServer)
     {
-        kNet::DataSerializer replyDs(createEntityBuffer_, 64 * 1024);
+        kNet::DataSerializer replyDs(workspaces_[0]->createEntityBuffer, 64 * 1024);
         replyDs.AddVLE<kNet::VLE8_16_32>(sceneID);
         replyDs.AddVLE<kNet::VLE8_16_32>(senderEntityID & UniqueIdGenerator::LAST_REPLICATED_ID);
         replyDs.AddVLE<kNet::VLE8_16_32>(entityID & UniqueIdGenerator::LAST_REPLICATED_ID);
@@ -995,7 +1611,7 @@ void SyncManager::HandleCreateComponents(kNet::MessageConnection* source, const
     assert(source);
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding CreateComponents message");
@@ -1007,7 +1623,7 @@ void SyncManager::HandleCreateComponents(kNet::MessageConnection* source, const
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     
     if (!ValidateAction(source, cCreateComponentsMessage, entityID))
@@ -1090,7 +1706,7 @@ void SyncManager::HandleCreateComponents(kNet::MessageConnection* source, const
     // Send CreateComponentsReply (server only)
     if (isServer)
     {
-        kNet::DataSerializer replyDs(createEntityBuffer_, 64 * 1024);
+        kNet::DataSerializer replyDs(workspaces_[0]->createEntityBuffer, 64 * 1024);
         replyDs.AddVLE<kNet::VLE8_16_32>(sceneID);
         replyDs.AddVLE<kNet::VLE8_16_32>(entityID & UniqueIdGenerator::LAST_REPLICATED_ID);
         replyDs.AddVLE<kNet::VLE8_16_32>(componentIdRewrites.size());
@@ -1112,7 +1728,7 @@ void SyncManager::HandleRemoveEntity(kNet::MessageConnection* source, const char
     assert(source);
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding RemoveEntity message");
@@ -1124,7 +1740,7 @@ void SyncManager::HandleRemoveEntity(kNet::MessageConnection* source, const char
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     
     if (!ValidateAction(source, cRemoveEntityMessage, entityID))
@@ -1147,7 +1763,7 @@ void SyncManager::HandleRemoveComponents(kNet::MessageConnection* source, const
     assert(source);
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding RemoveComponents message");
@@ -1159,7 +1775,7 @@ void SyncManager::HandleRemoveComponents(kNet::MessageConnection* source, const
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     
     if (!ValidateAction(source, cRemoveComponentsMessage, entityID))
@@ -1196,7 +1812,7 @@ void SyncManager::HandleCreateAttributes(kNet::MessageConnection* source, const
     assert(source);
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding CreateAttributes message");
@@ -1208,7 +1824,7 @@ void SyncManager::HandleCreateAttributes(kNet::MessageConnection* source, const
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     
     if (!ValidateAction(source, cCreateAttributesMessage, entityID))
@@ -1260,19 +1876,20 @@ void SyncManager::HandleCreateAttributes(kNet::MessageConnection* source, const
         
         addedAttrs.push_back(attr);
         attr->FromBinary(ds, AttributeChange::Disconnected);
-        
-        // Remove the corresponding add command from the sender's syncstate, so that the attribute add is not echoed back
-        state->entities[entityID].components[compID].newAndRemovedAttributes.erase(attrIndex);
     }
     
     // Signal attribute changes after creating and reading all
+    for (unsigned i = 0; i < addedAttrs.size(); ++i)
+        addedAttrs[i]->Owner()->EmitAttributeChanged(addedAttrs[i], change);
+    
+    // Mark the changes dirty now, then remove the add commands and dirty bits from sender's syncstate so that we do not echo them back
+    scene->FlushAttributeChanges();
     for (unsigned i = 0; i < addedAttrs.size(); ++i)
     {
-        IComponent* owner = addedAttrs[i]->Owner();
         u8 attrIndex = addedAttrs[i]->Index();
-        owner->EmitAttributeChanged(addedAttrs[i], change);
-        // Remove the dirty bit from sender's syncstate so that we do not echo the change back
-        state->entities[entityID].components[owner->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
+        ComponentSyncState& compState = state->entities[entityID].components[addedAttrs[i]->Owner()->Id()];
+        compState.newAndRemovedAttributes.erase(attrIndex);
+        compState.dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
 }
 
@@ -1281,7 +1898,7 @@ void SyncManager::HandleRemoveAttributes(kNet::MessageConnection* source, const
     assert(source);
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding RemoveAttributes message");
@@ -1293,7 +1910,7 @@ void SyncManager::HandleRemoveAttributes(kNet::MessageConnection* source, const
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     
     if (!ValidateAction(source, cRemoveAttributesMessage, entityID))
@@ -1306,6 +1923,7 @@ void SyncManager::HandleRemoveAttributes(kNet::MessageConnection* source, const
         return;
     }
     
+    std::vector<std::pair<component_id_t, u8> > removedAttrs;
     while (ds.BitsLeft() >= 8)
     {
         component_id_t compID = ds.ReadVLE<kNet::VLE8_16_32>();
@@ -1319,9 +1937,13 @@ void SyncManager::HandleRemoveAttributes(kNet::MessageConnection* source, const
         }
         
         comp->RemoveAttribute(attrIndex, change);
-        // Remove the corresponding remove command from the sender's syncstate, so that the attribute remove is not echoed back
-        state->entities[entityID].components[compID].newAndRemovedAttributes.erase(attrIndex);
+        removedAttrs.push_back(std::make_pair(compID, attrIndex));
     }
+    
+    // Mark the removes dirty now, then remove the corresponding remove commands from the sender's syncstate so that they are not echoed back
+    scene->FlushAttributeChanges();
+    for (unsigned i = 0; i < removedAttrs.size(); ++i)
+        state->entities[entityID].components[removedAttrs[i].first].newAndRemovedAttributes.erase(removedAttrs[i].second);
 }
 
 void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const char* data, size_t numBytes)
@@ -1329,19 +1951,22 @@ void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const ch
     assert(source);
     // Get matching syncstate for reflecting the changes
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding EditAttributes message");
         return;
     }
     
+    // Handle pending local changes first, so that they do not end the interpolations started by this message
+    scene->FlushAttributeChanges();
+    
     bool isServer = owner_->IsServer();
     // For clients, the change type is LocalOnly. For server, the change type is Replicate, so that it will get replicated to all clients in turn
     AttributeChange::Type change = isServer ? AttributeChange::Replicate : AttributeChange::LocalOnly;
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     
     if (!ValidateAction(source, cRemoveAttributesMessage, entityID))
@@ -1452,13 +2077,15 @@ void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const ch
     }
     
     // Signal attribute changes after reading all
+    for (unsigned i = 0; i < changedAttrs.size(); ++i)
+        changedAttrs[i]->Owner()->EmitAttributeChanged(changedAttrs[i], change);
+    
+    // Mark the changes dirty now, then remove the dirty bits from sender's syncstate so that we do not echo the changes back
+    scene->FlushAttributeChanges();
     for (unsigned i = 0; i < changedAttrs.size(); ++i)
     {
-        IComponent* owner = changedAttrs[i]->Owner();
         u8 attrIndex = changedAttrs[i]->Index();
-        owner->EmitAttributeChanged(changedAttrs[i], change);
-        // Remove the dirty bit from sender's syncstate so that we do not echo the change back
-        state->entities[entityID].components[owner->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
+        state->entities[entityID].components[changedAttrs[i]->Owner()->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
 }
 
@@ -1466,7 +2093,7 @@ void SyncManager::HandleCreateEntityReply(kNet::MessageConnection* source, const
 {
     assert(source);
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding CreateEntityReply message");
@@ -1481,9 +2108,11 @@ void SyncManager::HandleCreateEntityReply(kNet::MessageConnection* source, const
     }
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t senderEntityID = ds.ReadVLE<kNet::VLE8_16_32>() | UniqueIdGenerator::FIRST_UNACKED_ID;
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
+    // Mark the changes made before the ack dirty while the journal records still match the unacked IDs
+    scene->FlushAttributeChanges();
     scene->ChangeEntityId(senderEntityID, entityID);
     state->RemoveFromQueue(senderEntityID); // Make sure we don't have stale pointers in the dirty queue
     state->entities[entityID] = state->entities[senderEntityID]; // Copy the sync state to the new ID
@@ -1533,7 +2162,7 @@ void SyncManager::HandleCreateComponentsReply(kNet::MessageConnection* source, c
 {
     assert(source);
     SceneSyncState* state = GetSceneSyncState(source);
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene || !state)
     {
         LogWarning("Null scene or sync state, disregarding CreateComponentsReply message");
@@ -1548,8 +2177,10 @@ void SyncManager::HandleCreateComponentsReply(kNet::MessageConnection* source, c
     }
     
     kNet::DataDeserializer ds(data, numBytes);
-    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); // The scene is that of the sender, so the ID is not needed
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
+    // Mark the changes made before the ack dirty while the journal records still match the unacked IDs
+    scene->FlushAttributeChanges();
     state->RemoveFromQueue(entityID); // Make sure we don't have stale pointers in the dirty queue
     EntitySyncState& entityState = state->entities[entityID];
     
@@ -1589,7 +2220,7 @@ void SyncManager::HandleEntityAction(kNet::MessageConnection* source, MsgEntityA
 {
     bool isServer = owner_->IsServer();
     
-    ScenePtr scene = GetRegisteredScene();
+    ScenePtr scene = GetRegisteredScene(source);
     if (!scene)
     {
         LogWarning("SyncManager: Ignoring received MsgEntityAction as no scene exists!");
@@ -1634,8 +2265,9 @@ void SyncManager::HandleEntityAction(kNet::MessageConnection* source, MsgEntityA
     if (isServer && (type & EntityAction::Peers) != 0)
     {
         msg.executionType = (u8)EntityAction::Local;
+        UserConnection* sender = owner_->GetKristalliModule()->GetUserConnection(source);
         foreach(UserConnectionPtr userConn, owner_->GetKristalliModule()->GetUserConnections())
-            if (userConn->connection != source) // The EC action will not be sent to the machine that originated the request to send an action to all peers.
+            if (userConn->connection != source && sender && IsUserInScene(userConn.get(), sender->sceneId)) // The EC action will not be sent to the machine that originated the request to send an action to all peers.
                 userConn->connection->Send(msg);
         handled = true;
     }
@@ -1649,6 +2281,76 @@ void SyncManager::HandleEntityAction(kNet::MessageConnection* source, MsgEntityA
         server->SetActionSender(0);
 }
 
+void SyncManager::HandleEntityActionBinary(kNet::MessageConnection* source, const char* data, size_t numBytes)
+{
+    bool isServer = owner_->IsServer();
+    
+    ScenePtr scene = GetRegisteredScene(source);
+    if (!scene)
+    {
+        LogWarning("SyncManager: Ignoring received EntityActionBinary message as no scene exists!");
+        return;
+    }
+    
+    kNet::DataDeserializer dd(data, numBytes);
+    entity_id_t entityId = dd.ReadVLE<kNet::VLE8_16_32>();
+    entity_action_id_t id = dd.ReadVLE<kNet::VLE8_16_32>();
+    EntityAction::ExecType type = (EntityAction::ExecType)dd.Read<u8>();
+    uint argsSize = dd.Read<u8>();
+    u8 argsData[EntityActionArgs::cMaxDataSize];
+    EntityActionArgs args;
+    if (argsSize > EntityActionArgs::cMaxDataSize || argsSize > dd.BytesLeft())
+    {
+        LogWarning("SyncManager: Received malformed EntityActionBinary message for action " + QString::number(id));
+        return;
+    }
+    dd.ReadArray<u8>(argsData, argsSize);
+    if (!args.SetData(argsData, argsSize))
+    {
+        LogWarning("SyncManager: Received malformed parameters in EntityActionBinary message for action " + QString::number(id));
+        return;
+    }
+    
+    EntityPtr entity = scene->GetEntity(entityId);
+    if (!entity)
+    {
+        LogWarning("Entity " + ToString<int>(entityId) + " not found for EntityActionBinary message.");
+        return;
+    }
+
+    // If we are server, get the user who sent the action, so it can be queried
+    Server *server = owner_->GetServer().get();
+    if (isServer && server)
+        server->SetActionSender(owner_->GetKristalliModule()->GetUserConnection(source));
+
+    bool handled = false;
+
+    if ((type & EntityAction::Local) != 0 || (isServer && (type & EntityAction::Server) != 0))
+    {
+        entity->Exec(EntityAction::Local, id, args); // Execute the action locally, so that it doesn't immediately propagate back to network for sending.
+        handled = true;
+    }
+
+    // If execution type is Peers, replicate to all peers but the sender.
+    if (isServer && (type & EntityAction::Peers) != 0)
+    {
+        kNet::DataSerializer ds(entityActionBuffer_, sizeof(entityActionBuffer_));
+        WriteEntityActionBinary(ds, entityId, id, args, (u8)EntityAction::Local);
+        UserConnection* sender = owner_->GetKristalliModule()->GetUserConnection(source);
+        foreach(UserConnectionPtr userConn, owner_->GetKristalliModule()->GetUserConnections())
+            if (userConn->connection != source && sender && IsUserInScene(userConn.get(), sender->sceneId))
+                QueueMessage(userConn->connection, cEntityActionBinaryMessage, true, true, ds);
+        handled = true;
+    }
+    
+    if (!handled)
+        LogWarning("SyncManager: Received EntityActionBinary message for action " + QString::number(id) + ", but it went unhandled because of its type=" + QString::number(type));
+
+    // Clear the action sender after action handling
+    if (server)
+        server->SetActionSender(0);
+}
+
 SceneSyncState* SyncManager::GetSceneSyncState(kNet::MessageConnection* connection)
 {
     if (!owner_->IsServer())
@@ -5,10 +5,19 @@
 #include "IComponent.h"
 #include "Entity.h"
 #include "SyncState.h"
+#include "AttributeChangeJournal.h"
+
+#include "kNet/SharedPtr.h"
 
 #include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <list>
 #include <map>
 #include <set>
+#include <vector>
+#include <utility>
 
 struct MsgEntityAction;
 
@@ -45,8 +54,17 @@ public:
     ~SyncManager();
     
     /// Register to entity/component change signals from a specific scene and start syncing them
+    /** Stops syncing the scenes registered before. The scene gets ID 0 in the sync messages. */
     void RegisterToScene(ScenePtr scene);
     
+    /// Start syncing an additional scene, besides the ones registered before (server operation only)
+    /** Users are synced with the scene whose name they give in the "scene" login property, or with the first registered scene.
+        @return ID of the scene in the sync messages, or -1 if the scene is null or already registered */
+    int AddScene(ScenePtr scene);
+    
+    /// Stop syncing a scene. The users in it stop receiving changes (server operation only)
+    void RemoveScene(ScenePtr scene);
+    
     /// Accumulate time & send pending sync messages if enough time passed from last update
     void Update(f64 frametime);
     
@@ -60,16 +78,20 @@ public slots:
     /// Get update period
     float GetUpdatePeriod() { return updatePeriod_; }
     
-private slots:
-    /// Trigger EC sync because of component attributes changing
-    void OnAttributeChanged(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
-
-    /// Trigger EC sync because of component attribute added
-    void OnAttributeAdded(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
-
-    /// Trigger EC sync because of component attribute removed
-    void OnAttributeRemoved(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
+    /// Set the time budget per frame for applying received scene changes (seconds). Zero or less applies them all as they arrive.
+    /** The changes that do not fit into the budget are queued in the order they arrived, and applied in the following frames. */
+    void SetApplyBudget(float budget);
+    
+    /// Get the time budget per frame for applying received scene changes
+    float GetApplyBudget() { return applyBudget_; }
+    
+    /// Set whether scene sync messages are compressed for the users that support it. Affects only users that connect afterwards (server operation only)
+    void SetCompressionEnabled(bool enabled) { compressionEnabled_ = enabled; }
     
+    /// Get whether scene sync messages are compressed
+    bool IsCompressionEnabled() const { return compressionEnabled_; }
+    
+private slots:
     /// Trigger EC sync because of component added to entity
     void OnComponentAdded(Entity* entity, IComponent* comp, AttributeChange::Type change);
     
@@ -93,14 +115,116 @@ private slots:
     void HandleKristalliMessage(kNet::MessageConnection* source, kNet::message_id_t id, const char* data, size_t numBytes);
 
 private:
+    /// Job that processes the sync states of a range of users in the sync thread pool
+    class UserSyncJob;
+    
+    /// A synced scene. On the server, each user is synced with one scene, see UserConnection::sceneId
+    struct SyncedScene
+    {
+        SyncedScene() : id(0) {}
+        
+        unsigned id; ///< ID of the scene in the sync messages
+        SceneWeakPtr scene; ///< The scene
+        SceneSnapshot snapshot; ///< Serialized entities shared by the users in the scene (server only)
+    };
+    typedef std::map<unsigned, SyncedScene> SyncedSceneMap;
+    
+    /// Received scene sync message waiting to be applied
+    struct IncomingMessage
+    {
+        Ptr(kNet::MessageConnection) source;
+        kNet::message_id_t id;
+        std::vector<char> data;
+    };
+    
+    /// Buffers for crafting messages and deferred log messages, used by one thread at a time to process sync states
+    struct SyncWorkspace
+    {
+        char createEntityBuffer[64 * 1024];
+        char createCompsBuffer[64 * 1024];
+        char editAttrsBuffer[64 * 1024];
+        char createAttrsBuffer[16 * 1024];
+        char attrDataBuffer[16 * 1024];
+        char removeCompsBuffer[1024];
+        char removeEntityBuffer[1024];
+        char removeAttrsBuffer[1024];
+        std::vector<u8> changedAttributes;
+        /// Warnings (false) and errors (true) to be logged by the main thread, as logging is not thread-safe
+        std::vector<std::pair<bool, QString> > log;
+        
+        void Warning(const QString &msg) { log.push_back(std::make_pair(false, msg)); }
+        void Error(const QString &msg) { log.push_back(std::make_pair(true, msg)); }
+    };
+    
+    /// Scene sync messages waiting to be sent to a connection as one batch
+    struct OutgoingBatch
+    {
+        Ptr(kNet::MessageConnection) connection;
+        /// The messages, each as its id and size as VLE, followed by its data
+        std::vector<char> data;
+        /// Number of messages in the batch
+        unsigned numMessages;
+        /// Whether the batch is compressed. Uncompressed batches are kept small enough to fit into one datagram
+        bool compressed;
+    };
+    
+    /// Return whether the message is handled by the sync manager
+    static bool IsSceneSyncMessage(kNet::message_id_t id);
+    
+    /// Apply a received scene sync message to the scene
+    void ApplyMessage(kNet::MessageConnection* source, kNet::message_id_t id, const char* data, size_t numBytes);
+    
+    /// Apply queued messages in order until the budget of this frame is used, or all of them if force is true
+    void ApplyIncomingMessages(bool force);
+    
     /// Queue a message to the receiver from a given DataSerializer.
     void QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds);
     
+    /// Queue a message to the receiver from raw message data.
+    /** If the receiver supports batches, reliable in-order messages are added to its batch, which is sent when it is full or at the end of the frame. */
+    void QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, const char* data, size_t numBytes);
+    
+    /// Queue a message to the receiver from raw message data, bypassing the batch.
+    void QueueUnbatchedMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, const char* data, size_t numBytes);
+    
+    /// Return the batch of a connection, or null if the connection does not support batches
+    OutgoingBatch* GetOutgoingBatch(kNet::MessageConnection* connection);
+    
+    /// Compress and send a batch, and empty it
+    void FlushOutgoingBatch(OutgoingBatch& batch);
+    
+    /// Send all batches, and forget the batches of closed connections
+    void FlushOutgoingBatches();
+    
+    /// Handle a batch of scene sync messages, by handling each message in it in order.
+    void HandleSyncBatch(kNet::MessageConnection* source, const char* data, size_t numBytes);
+    
     /// Craft a component full update, with all static and dynamic attributes.
-    void WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp);
+    void WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp, SyncWorkspace& ws);
+    
+    /// Craft an entity full update with all its replicated components, ie. the create entity message.
+    void WriteEntityFullUpdate(kNet::DataSerializer& ds, unsigned sceneId, Entity* entity, SyncWorkspace& ws);
+    
+    /// Return the shared create entity message of an entity, serializing it if it is not in the scene snapshot yet (server operation only).
+    /** Can be called from several threads at once. */
+    const EntitySnapshot& GetEntitySnapshot(SyncedScene& scene, Entity* entity, SyncWorkspace& ws);
     
     /// Handle entity action message.
     void HandleEntityAction(kNet::MessageConnection* source, MsgEntityAction& msg);
+    /// Handle binary entity action message.
+    void HandleEntityActionBinary(kNet::MessageConnection* source, const char* data, size_t numBytes);
+    /// Scene attribute change journal listener, forwards to OnAttributeChanges.
+    static void AttributeChangeListener(void *userData, Scene *scene, const AttributeChangeRecord *records, size_t count);
+    /// Trigger EC sync because of component attributes changing, added or removed
+    void OnAttributeChanges(Scene *scene, const AttributeChangeRecord *records, size_t count);
+    /// Mark one attribute change dirty in a sync state
+    void MarkAttributeChange(SceneSyncState* state, const AttributeChangeRecord &record);
+    /// Trigger sync of entity action executed by integer id. Called by EntityActionListener.
+    void OnActionTriggered(Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type);
+    /// Scene action listener, forwards to OnActionTriggered.
+    static void EntityActionListener(void *userData, Entity *entity, entity_action_id_t id, const EntityActionArgs &args, EntityAction::ExecTypeField type);
+    /// Craft a binary entity action message.
+    void WriteEntityActionBinary(kNet::DataSerializer& ds, entity_id_t entityId, entity_action_id_t id, const EntityActionArgs &args, u8 type);
     /// Handle create entity message.
     void HandleCreateEntity(kNet::MessageConnection* source, const char* data, size_t numBytes);
     /// Handle create components message.
@@ -122,10 +246,19 @@ private:
     
     /// Process one sync state for changes in the scene
     /** \todo For now, sends all changed entities/components. In the future, this shall be subject to interest management
+        The scene is only read, so the sync states of different users can be processed in parallel, as long as the scene is not modified meanwhile.
         @param destination MessageConnection where to send the messages
         @param state Syncstate to process
+        @param scene Scene the syncstate belongs to
+        @param ws Workspace of the calling thread
      */
-    void ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state);
+    void ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state, SyncedScene& scene, SyncWorkspace& ws);
+    
+    /// Process the sync states of a range of users and send their batches. Run in the sync threads and the main thread (server operation only)
+    void ProcessUserSyncStates(const std::vector<UserConnection*>* users, size_t begin, size_t end, SyncWorkspace* ws);
+    
+    /// Log and clear the messages of a workspace
+    void FlushWorkspaceLog(SyncWorkspace& ws);
     
     /// Validate the scene manipulation action. If returns false, it is ignored
     /** @param source Where the action came from
@@ -139,7 +272,20 @@ private:
      */
     SceneSyncState* GetSceneSyncState(kNet::MessageConnection* connection);
 
-    ScenePtr GetRegisteredScene() const { return scene_.lock(); }
+    /// Get the synced scene of a messageconnection: the scene of the user on the server, and the registered scene on the client
+    SyncedScene* GetSyncedScene(kNet::MessageConnection* connection);
+    
+    /// Get the synced scene of a scene, or null if it is not synced
+    SyncedScene* FindSyncedScene(Scene* scene);
+    
+    /// Get the scene where changes from a messageconnection are applied
+    ScenePtr GetRegisteredScene(kNet::MessageConnection* connection);
+    
+    /// Connect to the change signals and listeners of a scene
+    void ConnectToScene(Scene* scene);
+    
+    /// Disconnect from the change signals and listeners of a scene
+    void DisconnectFromScene(Scene* scene);
 
     /// Owning module
     TundraLogicModule* owner_;
@@ -147,8 +293,10 @@ private:
     /// Framework pointer
     Framework* framework_;
     
-    /// Scene pointer
-    SceneWeakPtr scene_;
+    /// Synced scenes by ID
+    SyncedSceneMap scenes_;
+    /// ID to give to the next added scene
+    unsigned nextSceneId_;
     
     /// Time period for update, default 1/30th of a second
     float updatePeriod_;
@@ -158,16 +306,32 @@ private:
     /// Server sync state (client only)
     SceneSyncState server_syncstate_;
     
-    /// Fixed buffers for crafting messages
-    char createEntityBuffer_[64 * 1024];
-    char createCompsBuffer_[64 * 1024];
-    char editAttrsBuffer_[64 * 1024];
-    char createAttrsBuffer_[16 * 1024];
+    /// Guards the scene snapshots while the sync states are processed in parallel
+    QMutex snapshotMutex_;
+    
+    /// Workspaces for processing sync states, one for each thread. The first one is used by the main thread
+    std::vector<SyncWorkspace*> workspaces_;
+    /// Threads for processing sync states, not shared with the other users of the global thread pool (server only)
+    QThreadPool syncThreadPool_;
+    
+    /// Time budget per frame for applying received messages, default 5 ms
+    float applyBudget_;
+    /// Time used for applying received messages during this frame
+    double applyTimeUsed_;
+    /// Received messages that did not fit into the budget
+    std::list<IncomingMessage> incomingMessages_;
+    /// Data buffers of applied messages, for reuse
+    std::vector<std::vector<char> > freeMessageBuffers_;
+    
+    /// Whether compression is offered to new users, default true (server only)
+    bool compressionEnabled_;
+    typedef QHash<kNet::MessageConnection*, boost::shared_ptr<OutgoingBatch> > OutgoingBatchMap;
+    /// Batches of the users that support them, by connection (server only)
+    OutgoingBatchMap outgoingBatches_;
+    
+    /// Fixed buffers for handling received messages and crafting entity actions
     char attrDataBuffer_[16 * 1024];
-    char removeCompsBuffer_[1024];
-    char removeEntityBuffer_[1024];
-    char removeAttrsBuffer_[1024];
-    std::vector<u8> changedAttributes_;
+    char entityActionBuffer_[256];
 };
 
 }
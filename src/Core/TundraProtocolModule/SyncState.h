@@ -9,6 +9,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 
 /// Component's per-user network sync state
 struct ComponentSyncState
@@ -290,3 +291,35 @@ struct SceneSyncState
         compState.MarkAttributeRemoved(attrIndex);
     }
 };
+
+/// Serialized create entity message of an entity, shared by all users that receive the entity as new
+struct EntitySnapshot
+{
+    EntitySnapshot() :
+        temporary(false)
+    {
+    }
+    
+    std::vector<char> data; ///< Message data
+    bool temporary; ///< Temporary flag of the entity at the time of serialization
+    std::vector<std::pair<component_id_t, unsigned> > componentVersions; ///< Ids and change versions of the replicated components at the time of serialization
+};
+
+/// Serialized replicated entities of the scene, shared by all users on the server.
+/** When several users join at once, each entity is serialized once instead of once per user. The entities are serialized on demand
+    when they are sent as new to a user, and forgotten when they or their replicated components or attributes change. Changes that
+    are not signalled, such as AttributeChange::Disconnected ones, are caught by comparing the change versions of the components on use. */
+struct SceneSnapshot
+{
+    std::map<entity_id_t, EntitySnapshot> entities; ///< Entity snapshots
+    
+    void Clear()
+    {
+        entities.clear();
+    }
+    
+    void Invalidate(entity_id_t id)
+    {
+        entities.erase(id);
+    }
+};
@@ -8,6 +8,7 @@
 #include "Server.h"
 #include "SceneImporter.h"
 #include "SyncManager.h"
+#include "LoadTest.h"
 #include "PhysicsModule.h"
 #include "PhysicsWorld.h"
 #include "Profiler.h"
@@ -187,6 +188,7 @@ void TundraLogicModule::Initialize()
     syncManager_ = boost::shared_ptr<SyncManager>(new SyncManager(this));
     client_ = boost::shared_ptr<Client>(new Client(this));
     server_ = boost::shared_ptr<Server>(new Server(this));
+    loadTest_ = boost::shared_ptr<LoadTest>(new LoadTest(this));
     
     framework_->RegisterDynamicObject("client", client_.get());
     framework_->RegisterDynamicObject("server", server_.get());
@@ -225,6 +227,19 @@ void TundraLogicModule::Initialize()
         "Usage: importmesh(filename,x=0,y=0,z=0,xrot=0,yrot=0,zrot=0,xscale=1,yscale=1,zscale=1,inspectForMaterialsAndSkeleton=true)",
         this, SLOT(ImportMesh(QString, float, float, float, float, float, float, float, float, float, bool)));
 
+    framework_->Console()->RegisterCommand("startbots",
+        "Starts headless bots that log in to a server and move their avatars, and reports the replication load every 5 seconds. "
+        "Usage: startbots(count,address=127.0.0.1,port=2345,protocol=tcp,movesPerSecond=1,actionsPerSecond=1)",
+        loadTest_.get(), SLOT(StartBots(const StringVector &)));
+
+    framework_->Console()->RegisterCommand("stopbots",
+        "Stops all bots started with startbots",
+        loadTest_.get(), SLOT(StopBots()));
+
+    framework_->Console()->RegisterCommand("botreport",
+        "Prints the load test statistics since the previous report",
+        loadTest_.get(), SLOT(Report()));
+
     // Take a pointer to KristalliProtocolModule so that we don't have to take/check it every time
     kristalliModule_ = framework_->GetModule<KristalliProtocol::KristalliProtocolModule>();
     if (!kristalliModule_)
@@ -272,10 +287,14 @@ void TundraLogicModule::Initialize()
                 LogError("--netrate parameter is not a valid integer.");
         }
     }
+    
+    if (framework_->HasCommandLineParameter("--nonetcompression"))
+        syncManager_->SetCompressionEnabled(false);
 }
 
 void TundraLogicModule::Uninitialize()
 {
+    loadTest_.reset();
     kristalliModule_ = 0;
     syncManager_.reset();
     client_.reset();
@@ -333,6 +352,9 @@ void TundraLogicModule::Update(f64 frametime)
         client_->Update(frametime);
     if (server_)
         server_->Update(frametime);
+    // Run load test bots, if any
+    if (loadTest_)
+        loadTest_->Update(frametime);
     // Run scene sync
     if (syncManager_)
         syncManager_->Update(frametime);
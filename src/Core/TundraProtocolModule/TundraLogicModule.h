@@ -23,6 +23,7 @@ namespace TundraLogic
 class Client;
 class Server;
 class SyncManager;
+class LoadTest;
 
 /// Implements the Tundra protocol server and client functionality.
 class TUNDRALOGIC_MODULE_API TundraLogicModule : public IModule
@@ -53,6 +54,9 @@ public:
     /// Returns server
     const boost::shared_ptr<Server>& GetServer() const { return server_; }
 
+    /// Returns the load test driver
+    const boost::shared_ptr<LoadTest>& GetLoadTest() const { return loadTest_; }
+
 public slots:
     /// Starts the server.
     /** @param port Port.
@@ -96,6 +100,7 @@ private:
     boost::shared_ptr<SyncManager> syncManager_; ///< Sync manager
     boost::shared_ptr<Client> client_; ///< Client
     boost::shared_ptr<Server> server_; ///< Server
+    boost::shared_ptr<LoadTest> loadTest_; ///< Load test bots
     KristalliProtocol::KristalliProtocolModule *kristalliModule_; ///< KristalliProtocolModule pointer
     bool autoStartServer_; ///< Whether to autostart the server
     short autoStartServerPort_; ///< Autostart server port
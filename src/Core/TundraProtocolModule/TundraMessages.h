@@ -1,5 +1,8 @@
 #pragma once
 
+#include <QByteArray>
+#include <QString>
+
 // Login
 const unsigned long cLoginMessage = 100;
 const unsigned long cLoginReplyMessage = 101;
@@ -16,10 +19,55 @@ const unsigned long cRemoveComponentsMessage = 115;
 const unsigned long cRemoveEntityMessage = 116;
 const unsigned long cCreateEntityReplyMessage = 117; // Server->client only
 const unsigned long cCreateComponentsReplyMessage = 118; // Server->client only
+const unsigned long cSyncBatchMessage = 119; // Server->client only, scene sync messages of any number of entities, optionally compressed
+const unsigned long cMaxSyncBatchBytes = 256 * 1024; // Largest uncompressed size of a compressed sync batch accepted, four times what the server sends
 
 // Entity action
 const unsigned long cEntityActionMessage = 120;
+const unsigned long cEntityActionBinaryMessage = 123; // Action by integer id with typed binary parameters
 
 // Assets
 const unsigned long cAssetDiscoveryMessage = 121;
 const unsigned long cAssetDeletedMessage = 122;
+
+/// Extracts the serialized messages of a sync batch message: a flag byte telling whether the rest is qCompress'd, then the messages.
+/** qUncompress allocates the size declared in the first 4 bytes (big-endian) of the compressed data,
+    so it is checked against cMaxSyncBatchBytes first. An uncompressed batch is not copied, so data must outlive messages.
+    @param messages Receives the messages, each a VLE message ID and a VLE size followed by the message data.
+    @param error Receives the reason the batch was rejected.
+    @return True on success. */
+inline bool DecompressSyncBatch(const char* data, size_t numBytes, QByteArray& messages, QString& error)
+{
+    if (!numBytes)
+    {
+        error = "Empty sync batch message";
+        return false;
+    }
+    const char* payload = data + 1;
+    size_t payloadBytes = numBytes - 1;
+    if (!data[0])
+    {
+        messages = QByteArray::fromRawData(payload, (int)payloadBytes);
+        return true;
+    }
+    
+    if (payloadBytes < 4)
+    {
+        error = "Truncated compressed sync batch message";
+        return false;
+    }
+    const unsigned char* header = (const unsigned char*)payload;
+    size_t declaredBytes = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) | ((size_t)header[2] << 8) | (size_t)header[3];
+    if (declaredBytes > cMaxSyncBatchBytes)
+    {
+        error = "Compressed sync batch message declares " + QString::number(declaredBytes) + " uncompressed bytes";
+        return false;
+    }
+    messages = qUncompress((const unsigned char*)payload, (int)payloadBytes);
+    if (messages.isEmpty())
+    {
+        error = "Failed to decompress a sync batch message of " + QString::number(payloadBytes) + " bytes";
+        return false;
+    }
+    return true;
+}
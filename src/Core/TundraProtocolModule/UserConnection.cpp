@@ -37,6 +37,13 @@ QString UserConnection::GetLoginData() const
     return loginData;
 }
 
+float UserConnection::GetCompressionRatio() const
+{
+    if (!uncompressedBytes)
+        return 1.0f;
+    return (float)((double)compressedBytes / (double)uncompressedBytes);
+}
+
 QString UserConnection::GetProperty(const QString& key) const
 {
     static QString empty;
@@ -27,20 +27,35 @@ public:
     Q_PROPERTY (int id READ GetConnectionID)
     
     UserConnection() :
-        userID(0)
+        userID(0),
+        sceneId(0),
+        batched(false),
+        compressed(false),
+        uncompressedBytes(0),
+        compressedBytes(0)
     {
     }
     
     /// Message connection
     Ptr(kNet::MessageConnection) connection;
     /// Connection ID
-    u8 userID;
+    u32 userID;
     /// Raw xml login data
     QString loginData;
     /// Property map
     std::map<QString, QString> properties;
     /// Scene sync state, created and used by the SyncManager
     boost::shared_ptr<SceneSyncState> syncState;
+    /// ID of the scene the user is synced with. Chosen at login by the SyncManager
+    u32 sceneId;
+    /// Whether scene sync messages to this user are packed into batch messages. Negotiated at login by the SyncManager
+    bool batched;
+    /// Whether the batches sent to this user are compressed. Negotiated at login by the SyncManager
+    bool compressed;
+    /// Bytes of scene sync messages sent to this user, before compression
+    u64 uncompressedBytes;
+    /// Bytes of scene sync messages sent to this user, after compression
+    u64 compressedBytes;
     
 public slots:
     /// Execute an action on an entity, sent only to the specific user
@@ -54,6 +69,12 @@ public slots:
     
     /// Get raw login data
     QString GetLoginData() const;
+    
+    /// Returns whether scene sync messages to this user are compressed
+    bool IsCompressed() const { return compressed; }
+    
+    /// Returns the size of the sent scene sync messages after compression relative to their size before it, or 1 if nothing has been sent
+    float GetCompressionRatio() const;
      
     /// Set a property
     void SetProperty(const QString& key, const QString& value);
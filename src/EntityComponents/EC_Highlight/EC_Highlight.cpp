@@ -60,14 +60,17 @@ void  EC_Highlight::Show()
     
     inApply = true;
     
-    // Remove old materials first if they exist
+    // Remove old materials first if they exist. Keep the old variants referenced until the new ones have been acquired,
+    // so that the variants which are still needed are not recreated
+    std::vector<HighlightMaterialPtr> oldMaterials;
+    oldMaterials.swap(materials_);
     Hide();
     
     EC_Mesh* mesh = mesh_.lock().get();
     AssetAPI* assetAPI = framework->Asset();
     
-    // Clone all valid material assets that we can find from the mesh
-    /// \todo Currently will clone the same material several times if used on several submeshes
+    // Get the highlight variants of all valid material assets that we can find from the mesh. The variants are cloned only once
+    // per material and colors, and shared by all highlights
     /// \todo What if the material is yet pending, or is not an asset (LitTextured)
     AssetReferenceList materialList = mesh->meshMaterial.Get();
     for(int i = 0; i < materialList.Size(); ++i)
@@ -76,16 +79,11 @@ void  EC_Highlight::Show()
         {
             QString assetFullName = assetAPI->ResolveAssetRef("", materialList[i].ref);
             AssetPtr asset = assetAPI->GetAsset(assetFullName);
-            if ((asset) && (asset->IsLoaded()) && (dynamic_cast<OgreMaterialAsset*>(asset.get())))
+            HighlightMaterialPtr variant = HighlightMaterial::ForMaterial(assetAPI, asset, solidColor.Get(), outlineColor.Get());
+            if (variant)
             {
-                AssetPtr clone = asset->Clone(QString::fromStdString(world_.lock()->GetUniqueObjectName("EC_Highlight_Material")) + ".material");
-                if (clone)
-                {
-                    OgreMaterialAsset* matAsset = dynamic_cast<OgreMaterialAsset*>(clone.get());
-                    CreateHighlightToOgreMaterial(matAsset);
-                    mesh->SetMaterial(i, clone->Name());
-                    materials_.push_back(clone);
-                }
+                mesh->SetMaterial(i, variant->Asset()->Name());
+                materials_.push_back(variant);
             }
         }
     }
@@ -100,10 +98,7 @@ void EC_Highlight::Hide()
         mesh->ApplyMaterial();
     }
     
-    // Destroy all the highlight materials
-    AssetAPI* assetAPI = framework->Asset();
-    for (unsigned i = 0; i < materials_.size(); ++i)
-        assetAPI->ForgetAsset(materials_[i], false);
+    // Release the highlight materials. A variant is destroyed when no other highlight uses it
     materials_.clear();
 }
 
@@ -165,8 +160,9 @@ void EC_Highlight::OnAttributeUpdated(IAttribute *attribute)
             Hide();
     }
     
-    if ((attribute == &solidColor) || (attribute == &outlineColor))
-        ApplyHighlightColors();
+    // The variants are shared, so switch to the variants of the new colors instead of modifying them
+    if (((attribute == &solidColor) || (attribute == &outlineColor)) && IsVisible())
+        Show();
 }
 
 void EC_Highlight::TriggerReapply()
@@ -189,54 +185,3 @@ void EC_Highlight::ReapplyHighlight()
         Show();
     reapplyPending_ = false;
 }
-
-void EC_Highlight::CreateHighlightToOgreMaterial(OgreMaterialAsset* mat)
-{
-    if (!mat)
-        return;
-    
-    unsigned numTech = mat->GetNumTechniques();
-    for (unsigned i = 0; i < numTech; ++i)
-    {
-        int pass1 = mat->CreatePass(i);
-        int pass2 = mat->CreatePass(i);
-        
-        // Setting the shaders requires the SolidAmbient.material to exist in the resource groups, so that the shaders exist
-        mat->SetLighting(i, pass1, false);
-        mat->SetSceneBlend(i, pass1, Ogre::SBT_TRANSPARENT_ALPHA);
-        mat->SetDepthWrite(i, pass1, false);
-        mat->SetDepthBias(i, pass1, 1.f);
-        mat->SetVertexShader(i, pass1, "SolidAmbientVP");
-        mat->SetPixelShader(i, pass1, "SolidAmbientFP");
-        mat->SetAmbientColor(i, pass1, solidColor.Get());
-
-        mat->SetLighting(i, pass2, false);
-        mat->SetSceneBlend(i, pass2, Ogre::SBT_TRANSPARENT_ALPHA);
-        mat->SetDepthWrite(i, pass2, false);
-        mat->SetDepthBias(i, pass2, 2.f);
-        mat->SetVertexShader(i, pass2, "SolidAmbientVP");
-        mat->SetPixelShader(i, pass2, "SolidAmbientFP");
-        mat->SetAmbientColor(i, pass2, outlineColor.Get());
-        mat->SetPolygonMode(i, pass2, Ogre::PM_WIREFRAME);
-    }
-}
-
-void EC_Highlight::ApplyHighlightColors()
-{
-    for (unsigned i = 0; i < materials_.size(); ++i)
-    {
-        OgreMaterialAsset* mat = dynamic_cast<OgreMaterialAsset*>(materials_[i].get());
-        unsigned numTech = mat->GetNumTechniques();
-        for (unsigned i = 0; i < numTech; ++i)
-        {
-            unsigned numPasses = mat->GetNumPasses(i);
-            // Modify the diffuse color of the last 2 passes
-            // (this should be a highlight material that we added the 2 passes to)
-            if (numPasses >= 2)
-            {
-                mat->SetAmbientColor(i, numPasses - 2, solidColor.Get());
-                mat->SetAmbientColor(i, numPasses - 1, outlineColor.Get());
-            }
-        }
-    }
-}
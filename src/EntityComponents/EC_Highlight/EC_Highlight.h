@@ -12,6 +12,7 @@
 #include "AssetFwd.h"
 #include "Color.h"
 #include "OgreModuleFwd.h"
+#include "HighlightMaterial.h"
 
 /// Enables visual highlighting effect for of scene entity.
 /**
@@ -105,20 +106,14 @@ private slots:
     void ReapplyHighlight();
     
 private:
-    /// Create highlight pass to an Ogre material's all techniques
-    void CreateHighlightToOgreMaterial(OgreMaterialAsset* mat);
-    
-    /// Apply a color change to all existing highlight materials
-    void ApplyHighlightColors();
-        
     /// Mesh component pointer
     boost::weak_ptr<EC_Mesh> mesh_;
     
     /// Ogre World
     OgreWorldWeakPtr world_;
     
-    /// Highlight material assets, cloned from the mesh component's materials
-    std::vector<AssetPtr> materials_;
+    /// Highlight variants of the mesh component's materials, shared with other highlights of the same materials and colors
+    std::vector<HighlightMaterialPtr> materials_;
     
     /// Delayed reapply already pending -flag
     bool reapplyPending_;
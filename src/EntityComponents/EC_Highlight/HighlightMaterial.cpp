@@ -0,0 +1,121 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   HighlightMaterial.cpp
+ *  @brief  Highlight variant of a material, shared by all EC_Highlight components using the same material and colors.
+ */
+
+#include "DebugOperatorNew.h"
+#include "HighlightMaterial.h"
+
+#include "AssetAPI.h"
+#include "OgreMaterialAsset.h"
+#include "LoggingFunctions.h"
+
+#include <OgreMaterial.h>
+
+#include <map>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+    typedef std::map<QString, boost::weak_ptr<HighlightMaterial> > HighlightMaterialMap;
+
+    /// Variants by the source material name and the highlight colors.
+    HighlightMaterialMap &Variants()
+    {
+        static HighlightMaterialMap variants;
+        return variants;
+    }
+
+    QString ColorKey(const Color &color)
+    {
+        return QString("%1,%2,%3,%4").arg(color.r).arg(color.g).arg(color.b).arg(color.a);
+    }
+}
+
+HighlightMaterial::HighlightMaterial(AssetAPI *assetAPI, const AssetPtr &source, const AssetPtr &asset, const Color &solidColor, const Color &outlineColor, const QString &key) :
+    assetAPI_(assetAPI),
+    asset_(asset),
+    solidColor_(solidColor),
+    outlineColor_(outlineColor),
+    key_(key)
+{
+    AddHighlightPasses();
+    connect(source.get(), SIGNAL(Loaded(AssetPtr)), SLOT(OnSourceLoaded(AssetPtr)));
+}
+
+HighlightMaterial::~HighlightMaterial()
+{
+    HighlightMaterialMap &variants = Variants();
+    HighlightMaterialMap::iterator i = variants.find(key_);
+    if (i != variants.end() && i->second.expired())
+        variants.erase(i);
+
+    if (asset_)
+        assetAPI_->ForgetAsset(asset_, false);
+}
+
+HighlightMaterialPtr HighlightMaterial::ForMaterial(AssetAPI *assetAPI, const AssetPtr &source, const Color &solidColor, const Color &outlineColor)
+{
+    if (!source || !source->IsLoaded() || !dynamic_cast<OgreMaterialAsset*>(source.get()))
+        return HighlightMaterialPtr();
+
+    QString key = source->Name() + "|" + ColorKey(solidColor) + "|" + ColorKey(outlineColor);
+    HighlightMaterialMap &variants = Variants();
+    HighlightMaterialPtr variant = variants[key].lock();
+    if (variant)
+        return variant;
+
+    static uint nextVariantId = 0;
+    AssetPtr clone = source->Clone(QString("EC_Highlight_Material_%1.material").arg(++nextVariantId));
+    if (!clone)
+        return HighlightMaterialPtr();
+
+    variant = HighlightMaterialPtr(new HighlightMaterial(assetAPI, source, clone, solidColor, outlineColor, key));
+    variants[key] = variant;
+    return variant;
+}
+
+void HighlightMaterial::OnSourceLoaded(AssetPtr source)
+{
+    OgreMaterialAsset* mat = dynamic_cast<OgreMaterialAsset*>(asset_.get());
+    if (!mat)
+        return;
+
+    mat->CopyContent(source);
+    AddHighlightPasses();
+}
+
+void HighlightMaterial::AddHighlightPasses()
+{
+    OgreMaterialAsset* mat = dynamic_cast<OgreMaterialAsset*>(asset_.get());
+    if (!mat)
+        return;
+
+    unsigned numTech = mat->GetNumTechniques();
+    for (unsigned i = 0; i < numTech; ++i)
+    {
+        int pass1 = mat->CreatePass(i);
+        int pass2 = mat->CreatePass(i);
+
+        // Setting the shaders requires the SolidAmbient.material to exist in the resource groups, so that the shaders exist
+        mat->SetLighting(i, pass1, false);
+        mat->SetSceneBlend(i, pass1, Ogre::SBT_TRANSPARENT_ALPHA);
+        mat->SetDepthWrite(i, pass1, false);
+        mat->SetDepthBias(i, pass1, 1.f);
+        mat->SetVertexShader(i, pass1, "SolidAmbientVP");
+        mat->SetPixelShader(i, pass1, "SolidAmbientFP");
+        mat->SetAmbientColor(i, pass1, solidColor_);
+
+        mat->SetLighting(i, pass2, false);
+        mat->SetSceneBlend(i, pass2, Ogre::SBT_TRANSPARENT_ALPHA);
+        mat->SetDepthWrite(i, pass2, false);
+        mat->SetDepthBias(i, pass2, 2.f);
+        mat->SetVertexShader(i, pass2, "SolidAmbientVP");
+        mat->SetPixelShader(i, pass2, "SolidAmbientFP");
+        mat->SetAmbientColor(i, pass2, outlineColor_);
+        mat->SetPolygonMode(i, pass2, Ogre::PM_WIREFRAME);
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   HighlightMaterial.h
+ *  @brief  Highlight variant of a material, shared by all EC_Highlight components using the same material and colors.
+ */
+
+#pragma once
+
+#include "AssetFwd.h"
+#include "Color.h"
+
+#include <QObject>
+#include <QString>
+
+#include <boost/shared_ptr.hpp>
+
+class AssetAPI;
+class HighlightMaterial;
+typedef boost::shared_ptr<HighlightMaterial> HighlightMaterialPtr;
+
+/// Highlight variant of a material, shared by all EC_Highlight components using the same material and colors.
+/** The variant is a clone of the source material asset with a solid and an outline (wireframe) pass added to each technique.
+    It follows reloads of the source material, and is forgotten from the AssetAPI when the last user releases it.
+
+    Use ForMaterial() to get the variant of a material. */
+class HighlightMaterial : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~HighlightMaterial();
+
+    /// Returns the highlight variant of a material asset with the given colors, creating it if necessary.
+    /** @return The variant, or null if the source is not a loaded OgreMaterialAsset or it could not be cloned. */
+    static HighlightMaterialPtr ForMaterial(AssetAPI *assetAPI, const AssetPtr &source, const Color &solidColor, const Color &outlineColor);
+
+    /// Returns the highlight material asset.
+    const AssetPtr &Asset() const { return asset_; }
+
+private slots:
+    /// Copies the reloaded source material to the variant, and adds the highlight passes again.
+    void OnSourceLoaded(AssetPtr source);
+
+private:
+    HighlightMaterial(AssetAPI *assetAPI, const AssetPtr &source, const AssetPtr &asset, const Color &solidColor, const Color &outlineColor, const QString &key);
+
+    /// Adds the solid and outline passes to all techniques of the highlight material.
+    void AddHighlightPasses();
+
+    AssetAPI *assetAPI_;
+    AssetPtr asset_;
+    Color solidColor_;
+    Color outlineColor_;
+    /// Key of the variant in the cache.
+    QString key_;
+};
@@ -9,6 +9,7 @@
 #include "DebugOperatorNew.h"
 
 #include "EC_HoveringText.h"
+#include "HoveringTextBatch.h"
 #include "IModule.h"
 #include "Renderer.h"
 #include "EC_Placeable.h"
@@ -52,7 +53,8 @@ EC_HoveringText::EC_HoveringText(Scene* scene) :
     height(this, "Height", 1.0),
     texWidth(this, "Texture Width", 256),
     texHeight(this, "Texture Height", 256),
-    cornerRadius(this, "Corner radius", float2(20.0, 20.0))
+    cornerRadius(this, "Corner radius", float2(20.0, 20.0)),
+    batchTextId_(0)
 {
     if (scene)
         world_ = scene->GetWorld<OgreWorld>();
@@ -61,11 +63,6 @@ EC_HoveringText::EC_HoveringText(Scene* scene) :
 
 EC_HoveringText::~EC_HoveringText()
 {
-    if (texture_.get() != 0)
-    {
-        AssetAPI* asset = framework->Asset();
-        asset->ForgetAsset(texture_,false);
-    }
     Destroy();
 }
 
@@ -74,6 +71,26 @@ void EC_HoveringText::Destroy()
     if (!ViewEnabled())
         return;
 
+    RemoveFromBatch();
+    DestroyBillboard();
+}
+
+void EC_HoveringText::RemoveFromBatch()
+{
+    if (batch_ && batchTextId_)
+        batch_->RemoveText(batchTextId_);
+    batchTextId_ = 0;
+}
+
+void EC_HoveringText::DestroyBillboard()
+{
+    if (texture_.get() != 0)
+    {
+        AssetAPI* asset = framework->Asset();
+        asset->ForgetAsset(texture_,false);
+        texture_.reset();
+    }
+
     if (!world_.expired())
     {
         Ogre::SceneManager* sceneMgr = world_.lock()->GetSceneManager();
@@ -112,6 +129,8 @@ void EC_HoveringText::SetPosition(const float3& position)
     if (!ViewEnabled())
         return;
 
+    if (batchTextId_)
+        batch_->SetPosition(batchTextId_, position);
     if (billboard_)
         billboard_->setPosition(Ogre::Vector3(position.x, position.y, position.z));
 }
@@ -145,6 +164,8 @@ void EC_HoveringText::Show()
     if (!ViewEnabled())
         return;
 
+    if (batchTextId_)
+        batch_->SetVisible(batchTextId_, true);
     if (billboardSet_)
         billboardSet_->setVisible(true);
 }
@@ -154,12 +175,22 @@ void EC_HoveringText::Hide()
     if (!ViewEnabled())
         return;
 
+    if (batchTextId_)
+        batch_->SetVisible(batchTextId_, false);
     if (billboardSet_)
         billboardSet_->setVisible(false);
 }
 
 void EC_HoveringText::SetOverlayAlpha(float alpha)
 {
+    if (batchTextId_)
+    {
+        HoveringTextStyle style = batch_->Style(batchTextId_);
+        style.alpha = alpha;
+        batch_->SetStyle(batchTextId_, style);
+        return;
+    }
+
     Ogre::MaterialManager &mgr = Ogre::MaterialManager::getSingleton();
     Ogre::MaterialPtr material = mgr.getByName(materialName_);
     if (!material.get() || material->getNumTechniques() < 1 || material->getTechnique(0)->getNumPasses() < 1 || material->getTechnique(0)->getPass(0)->getNumTextureUnitStates() < 1)
@@ -171,6 +202,13 @@ void EC_HoveringText::SetOverlayAlpha(float alpha)
 
 void EC_HoveringText::SetBillboardSize(float width, float height)
 {
+    if (batchTextId_)
+    {
+        HoveringTextStyle style = batch_->Style(batchTextId_);
+        style.worldWidth = width;
+        style.worldHeight = height;
+        batch_->SetStyle(batchTextId_, style);
+    }
     if (billboard_)
         billboard_->setDimensions(width, height);
 }
@@ -180,6 +218,8 @@ bool EC_HoveringText::IsVisible() const
     if (!ViewEnabled())
         return false;
 
+    if (batchTextId_)
+        return batch_->IsVisible(batchTextId_);
     if (billboardSet_)
         return billboardSet_->isVisible();
     else
@@ -211,7 +251,7 @@ void EC_HoveringText::ShowMessage(const QString &text)
     if (!entity)
         return;
 
-    EC_Placeable *node = entity->GetComponent<EC_Placeable>().get();
+    boost::shared_ptr<EC_Placeable> node = entity->GetComponent<EC_Placeable>();
     if (!node)
         return;
 
@@ -220,6 +260,26 @@ void EC_HoveringText::ShowMessage(const QString &text)
     if (!sceneNode)
         return;
 
+    if (UsesBatch())
+    {
+        DestroyBillboard();
+        if (!batchTextId_)
+        {
+            if (!batch_)
+                batch_ = HoveringTextBatch::ForWorld(world);
+            if (!batch_)
+                return;
+            batchTextId_ = batch_->AddText(node);
+            SetBillboardSize(width.Get(), height.Get());
+            SetOverlayAlpha(overlayAlpha.Get());
+            SetPosition(position.Get());
+        }
+        Redraw();
+        return;
+    }
+
+    RemoveFromBatch();
+
     // Create billboard if it doesn't exist.
     if (!billboardSet_)
     {
@@ -251,6 +311,27 @@ void EC_HoveringText::Redraw()
     if (!ViewEnabled())
         return;
 
+    if (batchTextId_)
+    {
+        // Only the glyphs missing from the shared atlas are rasterized when the text is drawn.
+        HoveringTextStyle style = batch_->Style(batchTextId_);
+        style.text = text.Get();
+        style.font = font_;
+        style.textColor = textColor_;
+        if (usingGrad.Get())
+        {
+            QGradientStops stops = bg_grad_.stops();
+            style.backgroundTop = stops.size() ? stops.first().second : QColor(Qt::transparent);
+            style.backgroundBottom = stops.size() ? stops.last().second : QColor(Qt::transparent);
+        }
+        else
+            style.backgroundTop = style.backgroundBottom = (QColor)backgroundColor.Get();
+        style.boxWidth = texWidth.Get();
+        style.boxHeight = texHeight.Get();
+        batch_->SetStyle(batchTextId_, style);
+        return;
+    }
+
     if (world_.expired() || !billboardSet_ || !billboard_)
         return;
 
@@ -319,23 +400,26 @@ void EC_HoveringText::Redraw()
     }
 }
 
-void EC_HoveringText::UpdateSignals()
+bool EC_HoveringText::UsesBatch() const
 {
-    disconnect(this, SLOT(OnAttributeUpdated(IComponent *, IAttribute *)));
-    if(ParentEntity())
-    {
-        Scene *scene = ParentEntity()->ParentScene();
-        if(scene)
-        connect(scene, SIGNAL(AttributeChanged(IComponent*, IAttribute*, AttributeChange::Type)),
-                this, SLOT(OnAttributeUpdated(IComponent*, IAttribute*))); 
-    }
+    // Borders and rounded backgrounds are only drawn to the texture of the component.
+    const Color border = borderColor.Get();
+    const bool hasBorder = borderThickness.Get() > 0.f && border.a > 0.f;
+    const bool hasBackground = usingGrad.Get() || backgroundColor.Get().a > 0.f;
+    const float2 corners = cornerRadius.Get();
+    const bool roundedBackground = hasBackground && (corners.x > 0.f || corners.y > 0.f);
+    return !hasBorder && !roundedBackground && HoveringTextBatch::CanDraw(text.Get());
 }
 
-void EC_HoveringText::OnAttributeUpdated(IComponent *component, IAttribute *attribute)
+void EC_HoveringText::UpdateSignals()
 {
-    if(component != this)
-        return;
+    // Listen to the changes of this component only, rather than to every attribute change in the scene
+    connect(this, SIGNAL(AttributeChanged(IAttribute*, AttributeChange::Type)),
+            this, SLOT(OnAttributeUpdated(IAttribute*)), Qt::UniqueConnection);
+}
 
+void EC_HoveringText::OnAttributeUpdated(IAttribute *attribute)
+{
     if(font.Name() == attribute->Name() || fontSize.Name() == attribute->Name())
     {
         SetFont(QFont(font.Get(), fontSize.Get()));
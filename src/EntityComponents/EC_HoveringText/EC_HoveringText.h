@@ -23,6 +23,7 @@
 
 class QTimeLine;
 class TextureAsset;
+class HoveringTextBatch;
 
 namespace Ogre
 {
@@ -38,6 +39,9 @@ namespace Ogre
 <h2>HoveringText</h2>
 HoveringText shows a hovering text attached to an entity.
 
+Texts without a border and without a rounded background are drawn from a glyph atlas shared by all hovering texts
+of the scene, in one batch. Other texts are drawn to a texture of their own.
+
 <b>Attributes</b>:
 
 <ul>
@@ -205,10 +209,19 @@ private slots:
     void UpdateSignals();
 
     /// Handles attribute updates.
-    void OnAttributeUpdated(IComponent *component, IAttribute *attribute);
+    void OnAttributeUpdated(IAttribute *attribute);
 
 private:
+    /// Returns true if the current text and appearance can be drawn by the shared batch.
+    bool UsesBatch() const;
+
+    /// Destroys the billboard and texture used when the text is not drawn by the batch.
+    void DestroyBillboard();
+
+    /// Removes the text from the batch.
+    void RemoveFromBatch();
     
+
     /// Ogre world pointer.
     OgreWorldWeakPtr world_;
     
@@ -235,5 +248,11 @@ private:
 
     // Texture which contains hovering text
     boost::shared_ptr<TextureAsset> texture_;  
+
+    /// Batch drawing the hovering texts of the scene from a shared glyph atlas.
+    boost::shared_ptr<HoveringTextBatch> batch_;
+
+    /// Id of the text in the batch, or 0 if the text is not drawn by the batch.
+    uint batchTextId_;
 };
 
@@ -0,0 +1,181 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   HoveringTextAtlas.cpp
+ *  @brief  Dynamic glyph atlas texture shared by the hovering texts of one OgreWorld.
+ */
+
+#include "DebugOperatorNew.h"
+
+#include "HoveringTextAtlas.h"
+#include "LoggingFunctions.h"
+
+#include <Ogre.h>
+#include <QImage>
+#include <QPainter>
+#include <QFontMetrics>
+
+#include <algorithm>
+#include <vector>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+    /// Empty pixels around each glyph, so that bilinear filtering does not bleed the neighbours in.
+    const int cGlyphPadding = 1;
+    /// Size of the solid white block in the top-left corner of the atlas.
+    const int cWhiteBlockSize = 4;
+}
+
+HoveringTextAtlas::HoveringTextAtlas(const std::string &textureName, int size) :
+    textureName_(textureName),
+    size_(size),
+    rowX_(0),
+    rowY_(0),
+    rowHeight_(0),
+    whiteUV_(0.f),
+    generation_(0),
+    full_(false)
+{
+    CreateTexture();
+    Clear();
+}
+
+HoveringTextAtlas::~HoveringTextAtlas()
+{
+    texture_.setNull();
+    try
+    {
+        Ogre::TextureManager::getSingleton().remove(textureName_);
+    }
+    catch(...)
+    {
+    }
+}
+
+void HoveringTextAtlas::Resize(int size)
+{
+    texture_.setNull();
+    try
+    {
+        Ogre::TextureManager::getSingleton().remove(textureName_);
+    }
+    catch(...)
+    {
+    }
+
+    size_ = size;
+    CreateTexture();
+    Clear();
+}
+
+void HoveringTextAtlas::CreateTexture()
+{
+    whiteUV_ = 0.5f * cWhiteBlockSize / size_;
+    try
+    {
+        texture_ = Ogre::TextureManager::getSingleton().createManual(textureName_, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+            Ogre::TEX_TYPE_2D, size_, size_, 0, Ogre::PF_A8R8G8B8, Ogre::TU_DEFAULT);
+    }
+    catch(Ogre::Exception &e)
+    {
+        LogError("HoveringTextAtlas: Failed to create texture " + textureName_ + ": " + std::string(e.what()));
+    }
+}
+
+void HoveringTextAtlas::Clear()
+{
+    glyphs_.clear();
+    ++generation_;
+    full_ = false;
+
+    // The old glyphs do not need to be erased, as nothing refers to them anymore.
+    rowX_ = 0;
+    rowY_ = 0;
+    rowHeight_ = 0;
+    int x, y;
+    if (Allocate(cWhiteBlockSize, cWhiteBlockSize, x, y))
+    {
+        std::vector<u32> white(cWhiteBlockSize * cWhiteBlockSize, 0xFFFFFFFF);
+        Upload(reinterpret_cast<const u8 *>(&white[0]), x, y, cWhiteBlockSize, cWhiteBlockSize);
+    }
+}
+
+const HoveringTextAtlas::Glyph *HoveringTextAtlas::GetGlyph(const QFont &font, uint character)
+{
+    QPair<QString, uint> key(font.key(), character);
+    QHash<QPair<QString, uint>, Glyph>::const_iterator iter = glyphs_.find(key);
+    if (iter != glyphs_.end())
+        return &iter.value();
+
+    const QString str = QString::fromUcs4(&character, 1);
+    QFontMetrics metrics(font);
+    QRect bounds = metrics.boundingRect(str);
+
+    Glyph glyph;
+    glyph.width = bounds.width() + 2 * cGlyphPadding;
+    glyph.height = bounds.height() + 2 * cGlyphPadding;
+    glyph.offsetX = bounds.left() - cGlyphPadding;
+    glyph.offsetY = bounds.top() - cGlyphPadding;
+
+    int x, y;
+    if (!Allocate(glyph.width, glyph.height, x, y))
+    {
+        full_ = true;
+        return 0;
+    }
+
+    // Draw the glyph in white, the text color comes from the vertex color.
+    QImage image(glyph.width, glyph.height, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    {
+        QPainter painter(&image);
+        painter.setFont(font);
+        painter.setPen(Qt::white);
+        painter.drawText(-glyph.offsetX, -glyph.offsetY, str);
+    }
+    Upload(image.bits(), x, y, glyph.width, glyph.height);
+
+    glyph.u0 = (float)x / size_;
+    glyph.v0 = (float)y / size_;
+    glyph.u1 = (float)(x + glyph.width) / size_;
+    glyph.v1 = (float)(y + glyph.height) / size_;
+    return &glyphs_.insert(key, glyph).value();
+}
+
+bool HoveringTextAtlas::Allocate(int w, int h, int &x, int &y)
+{
+    if (w > size_ || h > size_)
+        return false;
+    if (rowX_ + w > size_)
+    {
+        rowY_ += rowHeight_;
+        rowX_ = 0;
+        rowHeight_ = 0;
+    }
+    if (rowY_ + h > size_)
+        return false;
+
+    x = rowX_;
+    y = rowY_;
+    rowX_ += w;
+    rowHeight_ = std::max(rowHeight_, h);
+    return true;
+}
+
+void HoveringTextAtlas::Upload(const u8 *pixels, int x, int y, int w, int h)
+{
+    if (texture_.isNull() || w <= 0 || h <= 0)
+        return;
+
+    try
+    {
+        Ogre::PixelBox src(w, h, 1, Ogre::PF_A8R8G8B8, const_cast<u8 *>(pixels));
+        texture_->getBuffer()->blitFromMemory(src, Ogre::Image::Box(x, y, x + w, y + h));
+    }
+    catch(Ogre::Exception &e)
+    {
+        LogError("HoveringTextAtlas: Failed to update texture " + textureName_ + ": " + std::string(e.what()));
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   HoveringTextAtlas.h
+ *  @brief  Dynamic glyph atlas texture shared by the hovering texts of one OgreWorld.
+ */
+
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QFont>
+
+#include <OgreTexture.h>
+
+/// Dynamic glyph atlas texture shared by the hovering texts of one OgreWorld.
+/** Glyphs are rasterized with QPainter on first use and packed to the texture in rows. Only the region of a new
+    glyph is uploaded to the texture, glyphs already in the atlas are never redrawn. When the atlas is full,
+    it must be cleared with Clear() and the glyphs requested again. */
+class HoveringTextAtlas
+{
+public:
+    /// Location and metrics of a glyph in the atlas. The metrics are in pixels of the rasterized font.
+    struct Glyph
+    {
+        float u0, v0, u1, v1;
+        /// Size of the glyph bitmap.
+        int width;
+        int height;
+        /// Offset from the pen position on the baseline to the top-left corner of the bitmap.
+        int offsetX;
+        int offsetY;
+    };
+
+    /// Creates the atlas texture.
+    /** @param textureName Name of the Ogre texture to create.
+        @param size Width and height of the texture in pixels. */
+    HoveringTextAtlas(const std::string &textureName, int size);
+    ~HoveringTextAtlas();
+
+    /// Returns the glyph for a character of the font, rasterizing it to the atlas if necessary.
+    /** @return The glyph, or null if it did not fit into the atlas. The pointer is valid until the next call. */
+    const Glyph *GetGlyph(const QFont &font, uint character);
+
+    /// Forgets all glyphs and increments the generation.
+    void Clear();
+
+    /// Recreates the texture with a new size. Forgets all glyphs and increments the generation.
+    /** Materials using the texture must be updated to refer to the new texture. */
+    void Resize(int size);
+
+    /// Returns the width and height of the texture in pixels.
+    int Size() const { return size_; }
+
+    /// Returns the number of times the atlas has been cleared. Glyph coordinates from older generations are invalid.
+    uint Generation() const { return generation_; }
+
+    /// Returns true if a glyph did not fit into the atlas since the last Clear().
+    bool IsFull() const { return full_; }
+
+    /// Returns the coordinates of a solid white texel, used for drawing backgrounds.
+    float WhiteU() const { return whiteUV_; }
+    float WhiteV() const { return whiteUV_; }
+
+    const std::string &TextureName() const { return textureName_; }
+
+private:
+    /// Creates the texture of the current size.
+    void CreateTexture();
+
+    /// Reserves a w*h region from the atlas. Returns false if the atlas is full.
+    bool Allocate(int w, int h, int &x, int &y);
+
+    /// Uploads ARGB32 pixels to the given region of the texture.
+    void Upload(const u8 *pixels, int x, int y, int w, int h);
+
+    std::string textureName_;
+    Ogre::TexturePtr texture_;
+    int size_;
+
+    /// Glyphs by the font key and character.
+    QHash<QPair<QString, uint>, Glyph> glyphs_;
+
+    /// Current row of the packer.
+    int rowX_;
+    int rowY_;
+    int rowHeight_;
+
+    float whiteUV_;
+    uint generation_;
+    bool full_;
+};
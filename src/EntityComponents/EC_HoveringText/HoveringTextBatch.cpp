@@ -0,0 +1,537 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   HoveringTextBatch.cpp
+ *  @brief  Draws all atlas-based hovering texts of one OgreWorld in a single batch.
+ */
+
+#include "DebugOperatorNew.h"
+
+#include "HoveringTextBatch.h"
+#include "HoveringTextAtlas.h"
+#include "EC_Placeable.h"
+#include "OgreWorld.h"
+#include "OgreMaterialUtils.h"
+#include "CoreDefines.h"
+#include "Profiler.h"
+
+#include <Ogre.h>
+#include <QFontInfo>
+#include <QFontMetrics>
+#include <QStringList>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <cmath>
+#include <cstring>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+    /// Initial and maximum size of the glyph atlas. The atlas grows when it gets full, and is cleared when it can not grow anymore.
+    const int cInitialAtlasSize = 512;
+    const int cMaxAtlasSize = 2048;
+    /// Glyphs are rasterized at most at this pixel size and scaled up, so that large fonts do not fill the atlas.
+    const int cMaxGlyphPixelSize = 64;
+    /// Number of floats per vertex: position, packed color and texture coordinate.
+    const int cVertexSize = 6;
+    /// Quads per batch are limited by the 16-bit index buffer.
+    const size_t cMaxQuads = 65536 / 4;
+
+    typedef std::map<OgreWorld *, boost::weak_ptr<HoveringTextBatch> > BatchMap;
+    BatchMap batches;
+
+    u32 PackColor(const QColor &color, float alpha)
+    {
+        Ogre::ColourValue value(color.redF(), color.greenF(), color.blueF(), color.alphaF() * alpha);
+        Ogre::uint32 packed = 0;
+        Ogre::Root::getSingleton().convertColourValue(value, &packed);
+        return packed;
+    }
+
+    QColor Interpolate(const QColor &a, const QColor &b, float t)
+    {
+        t = std::min(1.f, std::max(0.f, t));
+        QColor color;
+        color.setRgbF(a.redF() + (b.redF() - a.redF()) * t, a.greenF() + (b.greenF() - a.greenF()) * t,
+            a.blueF() + (b.blueF() - a.blueF()) * t, a.alphaF() + (b.alphaF() - a.alphaF()) * t);
+        return color;
+    }
+
+    inline float *WriteVertex(float *v, const Ogre::Vector3 &pos, u32 color, float u, float tv)
+    {
+        *v++ = pos.x;
+        *v++ = pos.y;
+        *v++ = pos.z;
+        memcpy(v++, &color, sizeof(color));
+        *v++ = u;
+        *v++ = tv;
+        return v;
+    }
+}
+
+#include "DisableMemoryLeakCheck.h"
+
+/// The Ogre renderable of a HoveringTextBatch. Regenerates the batch geometry for each camera.
+class HoveringTextRenderable : public Ogre::SimpleRenderable
+{
+public:
+    explicit HoveringTextRenderable(HoveringTextBatch *batch) :
+        batch_(batch),
+        numQuads_(0)
+    {
+        mRenderOp.vertexData = new Ogre::VertexData();
+        mRenderOp.indexData = new Ogre::IndexData();
+        mRenderOp.vertexData->vertexCount = 0;
+        mRenderOp.vertexData->vertexStart = 0;
+        mRenderOp.indexData->indexCount = 0;
+        mRenderOp.indexData->indexStart = 0;
+        mRenderOp.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+        mRenderOp.useIndexes = true;
+
+        Ogre::VertexDeclaration *decl = mRenderOp.vertexData->vertexDeclaration;
+        decl->addElement(0, 0, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+        decl->addElement(0, 12, Ogre::VET_COLOUR, Ogre::VES_DIFFUSE);
+        decl->addElement(0, 16, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
+
+        // The vertices are in world space and culled per text, so the renderable itself is never culled.
+        mBox.setInfinite();
+        setCastShadows(false);
+        setQueryFlags(0);
+    }
+
+    ~HoveringTextRenderable()
+    {
+        delete mRenderOp.vertexData;
+        delete mRenderOp.indexData;
+    }
+
+    /// Copies the vertices of numQuads quads to the vertex buffer.
+    void Upload(const float *vertices, size_t numQuads)
+    {
+        numQuads_ = numQuads;
+        mRenderOp.vertexData->vertexCount = numQuads * 4;
+        mRenderOp.indexData->indexCount = numQuads * 6;
+        if (!numQuads)
+            return;
+
+        if (vbuf_.isNull() || vbuf_->getNumVertices() < numQuads * 4)
+        {
+            // Grow to the next power of two, so that the buffers are not recreated every time a text is added.
+            size_t capacity = 64;
+            while(capacity < numQuads)
+                capacity *= 2;
+            capacity = std::min(capacity, cMaxQuads);
+
+            Ogre::HardwareBufferManager &mgr = Ogre::HardwareBufferManager::getSingleton();
+            mRenderOp.vertexData->vertexBufferBinding->unsetAllBindings();
+            vbuf_ = mgr.createVertexBuffer(cVertexSize * sizeof(float), capacity * 4, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+            mRenderOp.vertexData->vertexBufferBinding->setBinding(0, vbuf_);
+
+            mRenderOp.indexData->indexBuffer = mgr.createIndexBuffer(Ogre::HardwareIndexBuffer::IT_16BIT, capacity * 6, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            u16 *indices = static_cast<u16 *>(mRenderOp.indexData->indexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+            for(size_t i = 0; i < capacity; ++i)
+            {
+                const u16 first = (u16)(i * 4);
+                *indices++ = first;
+                *indices++ = first + 1;
+                *indices++ = first + 2;
+                *indices++ = first;
+                *indices++ = first + 2;
+                *indices++ = first + 3;
+            }
+            mRenderOp.indexData->indexBuffer->unlock();
+        }
+
+        vbuf_->writeData(0, numQuads * 4 * cVertexSize * sizeof(float), vertices, true);
+    }
+
+    void _notifyCurrentCamera(Ogre::Camera *cam)
+    {
+        Ogre::SimpleRenderable::_notifyCurrentCamera(cam);
+        batch_->UpdateGeometry(cam);
+    }
+
+    void _updateRenderQueue(Ogre::RenderQueue *queue)
+    {
+        if (numQuads_)
+            Ogre::SimpleRenderable::_updateRenderQueue(queue);
+    }
+
+    /// The texts are sorted internally, and drawn after the other transparent objects.
+    Ogre::Real getSquaredViewDepth(const Ogre::Camera *) const { return 0; }
+    Ogre::Real getBoundingRadius() const { return 0; }
+
+private:
+    HoveringTextBatch *batch_;
+    Ogre::HardwareVertexBufferSharedPtr vbuf_;
+    size_t numQuads_;
+};
+
+HoveringTextBatch::HoveringTextBatch(const OgreWorldPtr &world) :
+    world_(world),
+    atlas_(0),
+    renderable_(0),
+    nextTextId_(1)
+{
+    atlas_ = new HoveringTextAtlas(world->GetUniqueObjectName("HoveringTextAtlas"), cInitialAtlasSize);
+
+    materialName_ = world->GetUniqueObjectName("HoveringTextBatch_material");
+    Ogre::MaterialPtr material = OgreRenderer::CloneMaterial("HoveringText", materialName_);
+    OgreRenderer::SetTextureUnitOnMaterial(material, atlas_->TextureName());
+    if (!material.isNull() && material->getNumTechniques() > 0 && material->getTechnique(0)->getNumPasses() > 0 &&
+        material->getTechnique(0)->getPass(0)->getNumTextureUnitStates() > 0)
+    {
+        // The text color and opacity come from the vertex colors.
+        Ogre::TextureUnitState *tu = material->getTechnique(0)->getPass(0)->getTextureUnitState(0);
+        tu->setAlphaOperation(Ogre::LBX_MODULATE, Ogre::LBS_TEXTURE, Ogre::LBS_CURRENT);
+        tu->setTextureAddressingMode(Ogre::TextureUnitState::TAM_CLAMP);
+    }
+
+    renderable_ = new HoveringTextRenderable(this);
+    renderable_->setMaterial(materialName_);
+    world->GetSceneManager()->getRootSceneNode()->attachObject(renderable_);
+}
+
+#include "EnableMemoryLeakCheck.h"
+
+HoveringTextBatch::~HoveringTextBatch()
+{
+    // If the world is already gone, the scene manager has detached the renderable.
+    if (!world_.expired() && renderable_->isAttached())
+        renderable_->getParentSceneNode()->detachObject(renderable_);
+    SAFE_DELETE(renderable_);
+
+    try
+    {
+        Ogre::MaterialManager::getSingleton().remove(materialName_);
+    }
+    catch(...)
+    {
+    }
+    SAFE_DELETE(atlas_);
+}
+
+HoveringTextBatchPtr HoveringTextBatch::ForWorld(const OgreWorldPtr &world)
+{
+    if (!world)
+        return HoveringTextBatchPtr();
+
+    // A batch which outlived its world may be found with the address of a new world, so check the world too.
+    HoveringTextBatchPtr batch = batches[world.get()].lock();
+    if (!batch || batch->world_.lock() != world)
+    {
+        batch = HoveringTextBatchPtr(new HoveringTextBatch(world));
+        batches[world.get()] = batch;
+    }
+
+    // Forget the batches that have been destroyed.
+    for(BatchMap::iterator iter = batches.begin(); iter != batches.end();)
+    {
+        if (iter->second.expired())
+            batches.erase(iter++);
+        else
+            ++iter;
+    }
+    return batch;
+}
+
+bool HoveringTextBatch::CanDraw(const QString &text)
+{
+    for(int i = 0; i < text.size(); ++i)
+    {
+        const QChar ch = text[i];
+        if (ch.unicode() < 0x80)
+            continue;
+        const QChar::Direction direction = ch.direction();
+        if (direction == QChar::DirR || direction == QChar::DirAL || direction == QChar::DirRLE || direction == QChar::DirRLO)
+            return false;
+        if (ch.joining() != QChar::OtherJoining)
+            return false;
+        const QChar::Category category = ch.category();
+        if (category == QChar::Mark_NonSpacing || category == QChar::Mark_SpacingCombining || category == QChar::Mark_Enclosing)
+            return false;
+    }
+    return true;
+}
+
+uint HoveringTextBatch::AddText(const boost::shared_ptr<EC_Placeable> &placeable)
+{
+    Text text;
+    text.placeable = placeable;
+    text.position = float3::zero;
+    text.visible = true;
+    text.radius = 0.f;
+    text.atlasGeneration = 0;
+    text.worldPosition = float3::zero;
+    text.worldScaleX = 1.f;
+    text.worldScaleY = 1.f;
+
+    const uint id = nextTextId_++;
+    texts_.insert(id, text);
+    return id;
+}
+
+void HoveringTextBatch::RemoveText(uint id)
+{
+    texts_.remove(id);
+}
+
+void HoveringTextBatch::SetStyle(uint id, const HoveringTextStyle &style)
+{
+    QHash<uint, Text>::iterator iter = texts_.find(id);
+    if (iter == texts_.end())
+        return;
+    iter->style = style;
+    iter->atlasGeneration = 0;
+}
+
+HoveringTextStyle HoveringTextBatch::Style(uint id) const
+{
+    QHash<uint, Text>::const_iterator iter = texts_.find(id);
+    return iter != texts_.end() ? iter->style : HoveringTextStyle();
+}
+
+void HoveringTextBatch::SetPosition(uint id, const float3 &position)
+{
+    QHash<uint, Text>::iterator iter = texts_.find(id);
+    if (iter != texts_.end())
+        iter->position = position;
+}
+
+void HoveringTextBatch::SetVisible(uint id, bool visible)
+{
+    QHash<uint, Text>::iterator iter = texts_.find(id);
+    if (iter != texts_.end())
+        iter->visible = visible;
+}
+
+bool HoveringTextBatch::IsVisible(uint id) const
+{
+    QHash<uint, Text>::const_iterator iter = texts_.find(id);
+    return iter != texts_.end() && iter->visible;
+}
+
+void HoveringTextBatch::Layout(Text &text)
+{
+    PROFILE(HoveringTextBatch_Layout);
+
+    text.quads.clear();
+    text.atlasGeneration = atlas_->Generation();
+
+    const HoveringTextStyle &style = text.style;
+    text.radius = 0.5f * sqrtf(style.worldWidth * style.worldWidth + style.worldHeight * style.worldHeight);
+
+    QString str = style.text;
+    str.replace("\\n", "\n");
+    if (str.trimmed().isEmpty() || style.boxWidth <= 0.f || style.boxHeight <= 0.f)
+        return;
+
+    // Large fonts are rasterized at a smaller size, and the layout is done in the pixels of the rasterized font.
+    const int pixelSize = std::max(1, QFontInfo(style.font).pixelSize());
+    QFont font(style.font);
+    font.setPixelSize(std::min(pixelSize, cMaxGlyphPixelSize));
+    const float fontScale = (float)pixelSize / font.pixelSize();
+    const QFontMetrics metrics(font);
+    const float boxWidth = style.boxWidth / fontScale;
+    const float boxHeight = style.boxHeight / fontScale;
+
+    // Break the text to lines at word boundaries, like Qt::TextWordWrap.
+    QStringList lines;
+    foreach(const QString &paragraph, str.split('\n'))
+    {
+        QString line;
+        foreach(const QString &word, paragraph.split(' ', QString::SkipEmptyParts))
+        {
+            const QString candidate = line.isEmpty() ? word : line + ' ' + word;
+            if (!line.isEmpty() && metrics.width(candidate) > boxWidth)
+            {
+                lines << line;
+                line = word;
+            }
+            else
+                line = candidate;
+        }
+        lines << line;
+    }
+
+    // Center the lines in the box, like Qt::AlignCenter.
+    const float textHeight = (float)(lines.size() * metrics.lineSpacing() - metrics.leading());
+    const float top = (boxHeight - textHeight) * 0.5f;
+    std::vector<float> lineLeft(lines.size());
+    float left = boxWidth;
+    float right = 0.f;
+    for(int i = 0; i < lines.size(); ++i)
+    {
+        const float width = (float)metrics.width(lines[i]);
+        lineLeft[i] = (boxWidth - width) * 0.5f;
+        left = std::min(left, lineLeft[i]);
+        right = std::max(right, lineLeft[i] + width);
+    }
+
+    // Box pixels to world units, relative to the center of the box.
+    const float toWorldX = style.worldWidth / boxWidth;
+    const float toWorldY = style.worldHeight / boxHeight;
+    const float centerX = boxWidth * 0.5f;
+    const float centerY = boxHeight * 0.5f;
+
+    // The background covers the lines of text. A gradient goes from the top to the bottom of the box.
+    if (style.backgroundTop.alpha() > 0 || style.backgroundBottom.alpha() > 0)
+    {
+        const float bgLeft = std::max(0.f, left);
+        const float bgRight = std::min(boxWidth, right);
+        const float bgTop = std::max(0.f, top);
+        const float bgBottom = std::min(boxHeight, top + textHeight);
+        if (bgLeft < bgRight && bgTop < bgBottom)
+        {
+            Quad quad;
+            quad.left = (bgLeft - centerX) * toWorldX;
+            quad.right = (bgRight - centerX) * toWorldX;
+            quad.top = (centerY - bgTop) * toWorldY;
+            quad.bottom = (centerY - bgBottom) * toWorldY;
+            quad.u0 = quad.u1 = atlas_->WhiteU();
+            quad.v0 = quad.v1 = atlas_->WhiteV();
+            quad.topColor = PackColor(Interpolate(style.backgroundTop, style.backgroundBottom, bgTop / boxHeight), style.alpha);
+            quad.bottomColor = PackColor(Interpolate(style.backgroundTop, style.backgroundBottom, bgBottom / boxHeight), style.alpha);
+            text.quads.push_back(quad);
+        }
+    }
+
+    const u32 textColor = PackColor(style.textColor, style.alpha);
+    for(int i = 0; i < lines.size(); ++i)
+    {
+        const QString &line = lines[i];
+        const float baseline = top + i * metrics.lineSpacing() + metrics.ascent();
+        // Lines outside the box would have been clipped by the texture
+        if (baseline - metrics.ascent() >= boxHeight || baseline + metrics.descent() <= 0.f)
+            continue;
+
+        for(int j = 0; j < line.size(); ++j)
+        {
+            if (line[j].isSpace())
+                continue;
+
+            // Measure the whole prefix, so that kerning is taken into account.
+            const float penX = lineLeft[i] + metrics.width(line.left(j));
+            uint character = line[j].unicode();
+            if (line[j].isHighSurrogate() && j + 1 < line.size() && line[j+1].isLowSurrogate())
+            {
+                character = QChar::surrogateToUcs4(line[j], line[j+1]);
+                ++j;
+            }
+
+            const HoveringTextAtlas::Glyph *glyph = atlas_->GetGlyph(font, character);
+            if (!glyph)
+                continue;
+
+            const float x0 = penX + glyph->offsetX;
+            const float y0 = baseline + glyph->offsetY;
+            Quad quad;
+            quad.left = (x0 - centerX) * toWorldX;
+            quad.right = (x0 + glyph->width - centerX) * toWorldX;
+            quad.top = (centerY - y0) * toWorldY;
+            quad.bottom = (centerY - y0 - glyph->height) * toWorldY;
+            quad.u0 = glyph->u0;
+            quad.v0 = glyph->v0;
+            quad.u1 = glyph->u1;
+            quad.v1 = glyph->v1;
+            quad.topColor = textColor;
+            quad.bottomColor = textColor;
+            text.quads.push_back(quad);
+        }
+    }
+}
+
+void HoveringTextBatch::UpdateGeometry(Ogre::Camera *camera)
+{
+    PROFILE(HoveringTextBatch_UpdateGeometry);
+
+    if (atlas_->IsFull())
+    {
+        // Grow the atlas if possible. Otherwise start over with only the glyphs that are in use.
+        if (atlas_->Size() < cMaxAtlasSize)
+        {
+            atlas_->Resize(atlas_->Size() * 2);
+            OgreRenderer::SetTextureUnitOnMaterial(Ogre::MaterialManager::getSingleton().getByName(materialName_), atlas_->TextureName());
+        }
+        else
+            atlas_->Clear();
+    }
+
+    const Ogre::Vector3 cameraPos = camera->getDerivedPosition();
+    std::vector<std::pair<Ogre::Real, Text *> > visibleTexts;
+    visibleTexts.reserve(texts_.size());
+    size_t numQuads = 0;
+
+    for(QHash<uint, Text>::iterator iter = texts_.begin(); iter != texts_.end(); ++iter)
+    {
+        Text &text = iter.value();
+        if (!text.visible)
+            continue;
+        boost::shared_ptr<EC_Placeable> placeable = text.placeable.lock();
+        if (!placeable || !placeable->visible.Get())
+            continue;
+        Ogre::SceneNode *node = placeable->GetSceneNode();
+        if (!node || !node->isInSceneGraph())
+            continue;
+
+        if (text.atlasGeneration != atlas_->Generation())
+            Layout(text);
+        if (text.quads.empty())
+            continue;
+
+        const Ogre::Vector3 pos = node->_getFullTransform() * Ogre::Vector3(text.position.x, text.position.y, text.position.z);
+        const Ogre::Vector3 &scale = node->_getDerivedScale();
+        const float radius = text.radius * std::max(fabs(scale.x), fabs(scale.y));
+        if (!camera->isVisible(Ogre::Sphere(pos, radius)))
+            continue;
+
+        text.worldPosition = float3(pos.x, pos.y, pos.z);
+        text.worldScaleX = scale.x;
+        text.worldScaleY = scale.y;
+        visibleTexts.push_back(std::make_pair(cameraPos.squaredDistance(pos), &text));
+        numQuads += text.quads.size();
+    }
+
+    numQuads = std::min(numQuads, cMaxQuads);
+
+    // Draw back to front for correct blending. When the quads need to be limited, the nearest texts are drawn.
+    std::sort(visibleTexts.begin(), visibleTexts.end(), std::greater<std::pair<Ogre::Real, Text *> >());
+    size_t skipQuads = 0;
+    size_t totalQuads = 0;
+    for(size_t i = 0; i < visibleTexts.size(); ++i)
+        totalQuads += visibleTexts[i].second->quads.size();
+    if (totalQuads > numQuads)
+        skipQuads = totalQuads - numQuads;
+
+    vertices_.resize(numQuads * 4 * cVertexSize);
+    float *v = numQuads ? &vertices_[0] : 0;
+    const Ogre::Vector3 cameraRight = camera->getDerivedRight();
+    const Ogre::Vector3 cameraUp = camera->getDerivedUp();
+    for(size_t i = 0; i < visibleTexts.size(); ++i)
+    {
+        const Text &text = *visibleTexts[i].second;
+        if (skipQuads >= text.quads.size())
+        {
+            skipQuads -= text.quads.size();
+            continue;
+        }
+
+        const Ogre::Vector3 origin(text.worldPosition.x, text.worldPosition.y, text.worldPosition.z);
+        const Ogre::Vector3 right = cameraRight * text.worldScaleX;
+        const Ogre::Vector3 up = cameraUp * text.worldScaleY;
+        for(size_t j = skipQuads; j < text.quads.size(); ++j)
+        {
+            const Quad &q = text.quads[j];
+            v = WriteVertex(v, origin + right * q.left + up * q.top, q.topColor, q.u0, q.v0);
+            v = WriteVertex(v, origin + right * q.left + up * q.bottom, q.bottomColor, q.u0, q.v1);
+            v = WriteVertex(v, origin + right * q.right + up * q.bottom, q.bottomColor, q.u1, q.v1);
+            v = WriteVertex(v, origin + right * q.right + up * q.top, q.topColor, q.u1, q.v0);
+        }
+        skipQuads = 0;
+    }
+
+    renderable_->Upload(numQuads ? &vertices_[0] : 0, numQuads);
+}
@@ -0,0 +1,136 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   HoveringTextBatch.h
+ *  @brief  Draws all atlas-based hovering texts of one OgreWorld in a single batch.
+ */
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Math/float3.h"
+#include "OgreModuleFwd.h"
+
+#include <QString>
+#include <QFont>
+#include <QColor>
+#include <QHash>
+
+#include <vector>
+
+class HoveringTextAtlas;
+class HoveringTextRenderable;
+
+/// Appearance of a hovering text drawn by HoveringTextBatch.
+/** The text is laid out in a box of boxWidth x boxHeight pixels, in the same way as EC_HoveringText draws it
+    to its texture, and the box is then shown as a camera-facing quad of worldWidth x worldHeight units. */
+struct HoveringTextStyle
+{
+    HoveringTextStyle() : boxWidth(256.f), boxHeight(256.f), worldWidth(1.f), worldHeight(1.f), alpha(1.f) {}
+
+    QString text;
+    QFont font;
+    QColor textColor;
+    /// Background color at the top and bottom of the box. The background is drawn behind the lines of text,
+    /// with the color interpolated from these. A transparent color draws no background.
+    QColor backgroundTop;
+    QColor backgroundBottom;
+    float boxWidth;
+    float boxHeight;
+    float worldWidth;
+    float worldHeight;
+    /// Opacity multiplier of the whole text.
+    float alpha;
+};
+
+/// Draws all atlas-based hovering texts of one OgreWorld in a single batch.
+/** The glyphs of all texts are stored in one shared HoveringTextAtlas, and the texts are drawn as camera-facing quads
+    in one vertex buffer, which is regenerated for each camera the world is rendered from. Changing a text only
+    rasterizes the glyphs the atlas does not have yet.
+
+    Use ForWorld() to get the batch of a world. The batch is destroyed when the last user releases it. */
+class HoveringTextBatch
+{
+public:
+    ~HoveringTextBatch();
+
+    /// Returns the batch of the given world, creating it if necessary.
+    static boost::shared_ptr<HoveringTextBatch> ForWorld(const OgreWorldPtr &world);
+
+    /// Returns true if the text can be drawn from the glyph atlas.
+    /** Texts which need complex shaping, i.e. right-to-left, joining or combining characters, can not be drawn glyph by glyph. */
+    static bool CanDraw(const QString &text);
+
+    /// Adds a text, which follows the scene node of the given placeable. Returns the id of the text.
+    uint AddText(const boost::shared_ptr<EC_Placeable> &placeable);
+
+    /// Removes a text.
+    void RemoveText(uint id);
+
+    /// Sets the text and appearance of a text. The glyphs are rasterized when the text is drawn for the first time.
+    void SetStyle(uint id, const HoveringTextStyle &style);
+
+    /// Returns the text and appearance of a text.
+    HoveringTextStyle Style(uint id) const;
+
+    /// Sets the position of a text relative to the scene node it follows.
+    void SetPosition(uint id, const float3 &position);
+
+    /// Shows or hides a text.
+    void SetVisible(uint id, bool visible);
+
+    /// Returns true if a text is shown.
+    bool IsVisible(uint id) const;
+
+private:
+    friend class HoveringTextRenderable;
+
+    /// A glyph or background quad, relative to the text origin, in world units.
+    struct Quad
+    {
+        float left, bottom, right, top;
+        /// Texture coordinates of the top-left and bottom-right corners.
+        float u0, v0, u1, v1;
+        /// Vertex colors in the format of the render system.
+        u32 topColor;
+        u32 bottomColor;
+    };
+
+    struct Text
+    {
+        boost::weak_ptr<EC_Placeable> placeable;
+        float3 position;
+        bool visible;
+        HoveringTextStyle style;
+        std::vector<Quad> quads;
+        /// Radius of the text around its origin, used for culling.
+        float radius;
+        /// Atlas generation the quads were laid out with. Zero if the text needs to be laid out again.
+        uint atlasGeneration;
+        /// World position and scale of the text origin, valid while the geometry is generated.
+        float3 worldPosition;
+        float worldScaleX;
+        float worldScaleY;
+    };
+
+    explicit HoveringTextBatch(const OgreWorldPtr &world);
+
+    /// Lays out the quads of a text, rasterizing the missing glyphs to the atlas.
+    void Layout(Text &text);
+
+    /// Regenerates the vertices for the given camera. Called by the renderable when the world is rendered.
+    void UpdateGeometry(Ogre::Camera *camera);
+
+    OgreWorldWeakPtr world_;
+    HoveringTextAtlas *atlas_;
+    HoveringTextRenderable *renderable_;
+    std::string materialName_;
+
+    QHash<uint, Text> texts_;
+    uint nextTextId_;
+
+    /// Vertex data scratch buffer, kept to avoid reallocation every frame.
+    std::vector<float> vertices_;
+};
+
+typedef boost::shared_ptr<HoveringTextBatch> HoveringTextBatchPtr;